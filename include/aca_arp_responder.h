@@ -17,8 +17,11 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <chrono>
 #include "hashmap/HashMap.h"
 #include <mutex>
+#include "marl/event.h"
 
 using namespace std;
 
@@ -69,6 +72,12 @@ struct arp_table_data {
   string mac_address;
 };
 
+// an on-demand request waiting for an arp entry to be programmed
+struct arp_entry_waiter {
+  uint64_t waiter_id;
+  marl::Event ready;
+};
+
 struct arp_message {
   uint16_t hrd;
   uint16_t pro;
@@ -96,12 +105,24 @@ struct vlan_message {
 #define ARP_MSG_HRD_LEN (0x6)
 #define ARP_MSG_PRO_LEN (0x4)
 
+// ethernet + vlan + arp headers of a serialized arp message
+#define ARP_PACKET_MAX_LEN (14 + 4 + 28)
+
 class ACA_ARP_Responder {
   public:
   static ACA_ARP_Responder &get_instance();
 
   bool does_arp_entry_exist(arp_entry_data stData);
 
+  /*
+   * wait until the arp entry of (ip, vlan) is added or the timeout expires.
+   * The wait is a marl::Event, so on a marl worker only the fiber is
+   * suspended and the worker thread keeps running other tasks.
+   * Return:
+   *    true if the arp entry exists
+   */
+  bool wait_for_arp_entry(arp_entry_data stData, std::chrono::microseconds timeout);
+
   /* Managemet Plane Ops*/
   int add_arp_entry(arp_config *arp_config_in);
   int create_or_update_arp_entry(arp_config *arp_config_in);
@@ -120,6 +141,13 @@ class ACA_ARP_Responder {
 
   CTSL::HashMap<arp_entry_data, arp_table_data *, arp_hash> _arp_db;
 
+  // requests waiting for an arp entry, woken up when the entry is added
+  unordered_map<arp_entry_data, vector<arp_entry_waiter>, arp_hash> _arp_waiters;
+  mutex _arp_waiters_mutex;
+  uint64_t _next_waiter_id;
+
+  void _notify_arp_waiters(const arp_entry_data &stData);
+
   /*************** Initialization and De-initialization ***********************/
   void _init_arp_db();
   void _deinit_arp_db();
@@ -137,7 +165,9 @@ class ACA_ARP_Responder {
 
   arp_message *_pack_arp_reply(arp_message *arpreq, string mac_address);
 
-  string _serialize_arp_message(vlan_message *vlanmsg, arp_message *arpmsg);
+  // write the frame of arpmsg to packet, which has room for ARP_PACKET_MAX_LEN bytes,
+  // returns its length or 0 if arpmsg is null
+  size_t _serialize_arp_message(vlan_message *vlanmsg, arp_message *arpmsg, uint8_t *packet);
 };
 } // namespace aca_arp_responder
 #endif // #ifndef ACA_ARP_RESPONDER_H
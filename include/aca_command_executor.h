@@ -0,0 +1,163 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_COMMAND_EXECUTOR_H
+#define ACA_COMMAND_EXECUTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace aca_net_config
+{
+struct Command_Result {
+  // the wait status of "/bin/sh -c <command>" like system(), -ETIMEDOUT if
+  // it was killed after its timeout, -errno if it could not be spawned
+  int rc;
+  // stdout of the command when captured, cut at the output buffer size
+  std::string output;
+  // microseconds from the spawn to the exit of the command
+  ulong elapse_time;
+};
+
+/*
+  Runs shell commands without blocking their caller. A command is spawned
+  with posix_spawn, which does not copy the page tables of the agent like
+  the fork of system() and popen(), and one reaper thread waits for all the
+  children on the pidfd of each, with epoll.
+
+  At most max_running commands run at a time, the ones submitted past it
+  wait in FIFO order. Each running slot has its output buffer allocated up
+  front. A command still running after its timeout is killed together with
+  the processes it started.
+*/
+class Aca_Command_Executor {
+  public:
+  typedef std::function<void(Command_Result &&result)> done_fn_t;
+
+  static Aca_Command_Executor &get_instance();
+
+  Aca_Command_Executor(size_t max_running, uint64_t timeout_us, size_t output_max_bytes);
+
+  // kills the commands still running, the ones waiting get -ECANCELED
+  ~Aca_Command_Executor();
+
+  // compiler will flag the error when below is called.
+  Aca_Command_Executor(Aca_Command_Executor const &) = delete;
+  void operator=(Aca_Command_Executor const &) = delete;
+
+  /*
+   * run a command.
+   * Input:
+   *    bool capture_output: false leaves stdout to the agent's, like system()
+   *    uint64_t timeout_us: 0 for the timeout of the executor
+   * Return:
+   *    the result once the command exited
+   */
+  std::future<Command_Result> submit(const std::string &cmd_string,
+                                     bool capture_output = false, uint64_t timeout_us = 0);
+
+  // done runs on the reaper thread, it must not wait for another command
+  void submit(const std::string &cmd_string, bool capture_output, uint64_t timeout_us,
+              done_fn_t done);
+
+  /*
+   * run a command and wait for it, a marl fiber waiting yields its worker.
+   * The caller must not hold a std::mutex across it: another fiber run by the
+   * worker meanwhile blocks the worker thread on that mutex, and the fiber
+   * holding it never gets its worker back. Use execute_blocking() then.
+   */
+  Command_Result execute(const std::string &cmd_string, bool capture_output = false,
+                         uint64_t timeout_us = 0);
+
+  // run the commands side by side and wait for all of them, the results are
+  // in the order of the commands, same rule as above for a std::mutex held
+  std::vector<Command_Result> execute(const std::vector<std::string> &cmd_strings,
+                                      bool capture_output = false, uint64_t timeout_us = 0);
+
+  // like execute() but the calling thread waits, even in a marl fiber, so
+  // the caller may hold a std::mutex
+  std::vector<Command_Result> execute_blocking(const std::vector<std::string> &cmd_strings,
+                                               bool capture_output = false,
+                                               uint64_t timeout_us = 0);
+
+  // commands running or waiting to run
+  size_t outstanding();
+
+  private:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  struct Command {
+    std::string cmd_string;
+    bool capture_output;
+    uint64_t timeout_us;
+    done_fn_t done;
+  };
+
+  struct Slot {
+    Command command;
+    pid_t pid;
+    // -1 when the kernel has no pidfd, the child is then polled
+    int pidfd;
+    int output_fd;
+    // output_max_bytes, allocated once
+    std::vector<char> output;
+    size_t output_size;
+    time_point start_time;
+    time_point deadline;
+    bool timed_out;
+  };
+
+  // the caller holds _mutex for the rest of the _ methods, the done calls
+  // are made once it is released
+
+  // returns false if no slot is free, the command is left as it is
+  bool _start(Command &command, std::vector<std::function<void()> > &done_calls);
+
+  int _spawn(Slot &slot, size_t slot_index);
+
+  // the reaper thread
+  void _reap();
+
+  void _read_output(Slot &slot);
+
+  void _finish(size_t slot_index, int status, std::vector<std::function<void()> > &done_calls);
+
+  int _get_wait_timeout_ms();
+
+  // takes no lock
+  void _wakeup();
+
+  const size_t _max_running;
+  const uint64_t _timeout_us;
+  std::mutex _mutex;
+  std::vector<Slot> _slots;
+  std::vector<size_t> _free_slots;
+  std::deque<Command> _waiting;
+  size_t _running;
+  bool _shutdown;
+  int _epoll_fd;
+  // eventfd waking up the reaper for a new command or the shutdown
+  int _wakeup_fd;
+  std::thread _reaper_thread;
+};
+} // namespace aca_net_config
+#endif // #ifndef ACA_COMMAND_EXECUTOR_H
@@ -27,12 +27,117 @@
 
 #define DEFAULT_MTU 9000
 
-#define ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS 10000000 // 10 seconds
+// tick of the on-demand request timing wheel, expired entries are cleaned up every tick
+#define ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS 100000 // 100 milliseconds
 
 #define ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS 10000000 // 10 seconds
 
 #define REQUEST_UUID_ON_DEMAND_PAYLOAD_MAP_MAX_SIZE 1000000 // one million
 
+// how long an on-demand arp request waits for its arp entry to be programmed
+#define ON_DEMAND_ARP_WAIT_TIMEOUT_IN_MICROSECONDS 1000000 // one second
+
+// limits of the packets to one destination waiting on its outstanding on-demand
+// request, the oldest packets are dropped when a new one doesn't fit
+#define ON_DEMAND_PENDING_QUEUE_MAX_PACKETS 64
+
+#define ON_DEMAND_PENDING_QUEUE_MAX_BYTES 16384
+
+// destinations NCM has no goal state for are not requested again for this long,
+// unless their neighbor goal state arrives first
+#define ON_DEMAND_NEGATIVE_CACHE_TTL_IN_MICROSECONDS 5000000 // 5 seconds
+
+#define ON_DEMAND_NEGATIVE_CACHE_MAX_SIZE 65536
+
+// direct paths the zeta OAM server remembers as programmed, an injection of
+// one of them is not sent to the switch again
+#define ZETA_OAM_PATH_CACHE_MAX_SIZE 65536
+
+// max number of on-demand requests waiting for room in the request table,
+// requests over it are dropped according to ON_DEMAND_ADMISSION_POLICY
+#define ON_DEMAND_ADMISSION_QUEUE_SIZE 4096
+
+// admission_policy used when the queue is full, 2 is the per-port fair share
+#define ON_DEMAND_ADMISSION_POLICY 2
+
+// number of completion queues, each with its own poller thread, for the replies of NCM
+#define ON_DEMAND_REPLY_SHARD_COUNT 4
+
+// on-demand requests sent within this window share one call to NCM, 0 sends every
+// request in its own call
+#define ON_DEMAND_BATCH_WINDOW_IN_MICROSECONDS 200
+
+// a batch is sent right away once it holds this many requests
+#define ON_DEMAND_BATCH_MAX_REQUESTS 64
+
+// max number of batches waiting for the reply of NCM, the next batch waits for a reply
+#define ON_DEMAND_BATCH_MAX_OUTSTANDING 16
+
+// requests over it are not batched but sent in their own call
+#define ON_DEMAND_BATCH_MAX_PENDING_REQUESTS 4096
+
+// a call to NCM not answered by then fails with DEADLINE_EXCEEDED, which gives
+// its slot among the outstanding batches back
+#define ON_DEMAND_GRPC_DEADLINE_IN_MICROSECONDS 5000000 // 5 seconds
+
+// max number of flow-mods in one OpenFlow bundle of a goal state, 0 sends the
+// flow-mods one by one as they are programmed
+#define OVS_FLOW_BUNDLE_SIZE 4096
+// how long a goal state waits for the switches to answer its flows, the
+// operation statuses of the flows not answered by then are reported failed
+#define OVS_FLOW_COMPLETION_TIMEOUT_IN_MICROSECONDS (5 * 1000 * 1000)
+// flows of a bridge the flow shadow remembers, the flows past it are sent
+// every time without being de-duplicated
+#define OVS_FLOW_SHADOW_MAX_FLOWS_PER_BRIDGE (1024 * 1024)
+// the flows the agent programs carry OVS_FLOW_AGENT_COOKIE in the bits of
+// OVS_FLOW_AGENT_COOKIE_MASK, the other bits change with every agent run
+#define OVS_FLOW_AGENT_COOKIE 0xaca0000000000000UL
+#define OVS_FLOW_AGENT_COOKIE_MASK 0xffff000000000000UL
+// after an agent restart, the flows found on a bridge which the goal states
+// don't program again within this grace are deleted
+#define OVS_FLOW_RECONCILE_GRACE_IN_SECONDS 300
+// unix socket of the local ovsdb-server, the ovsdb changes on the port
+// programming path go through one connection to it instead of ovs-vsctl
+#define OVSDB_SOCKET_PATH "/var/run/openvswitch/db.sock"
+// how long an ovsdb transaction waits for its reply
+#define OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS (5 * 1000 * 1000)
+// ports waiting for their interface to get an ofport before their vlan tag
+// is set, the ports past it are refused
+#define OVSDB_MAX_PENDING_PORTS 16384
+// how long a port waits for its interface before giving up
+#define OVSDB_PENDING_PORT_TIMEOUT_IN_MICROSECONDS                             \
+  (MAX_PORT_SCAN_RETRY * PORT_SCAN_SLEEP_INTERVAL * 1000UL)
+// commands the command executor runs at the same time, the ones past it wait
+// for a running command to exit
+#define SYSTEM_COMMAND_MAX_RUNNING 32
+// a command still running after it is killed
+#define SYSTEM_COMMAND_TIMEOUT_IN_MICROSECONDS (60 * 1000 * 1000)
+// stdout kept of a command whose output is captured, the rest is dropped
+#define SYSTEM_COMMAND_OUTPUT_MAX_BYTES (64 * 1024)
+// how Aca_Net_Config sets up the namespaces and veths, 0 runs ip commands,
+// 1 sends rtnetlink messages (-y 1)
+#define NET_CONFIG_BACKEND 0
+// the named network namespaces, shared with "ip netns"
+#define NET_CONFIG_NETNS_DIR "/var/run/netns"
+
+// prefetch_mode of the neighbors after an on-demand request succeeds,
+// 0 disables it, 1 prefetches the co-accessed destinations, 2 also the rest of the /24
+#define ON_DEMAND_PREFETCH_MODE 0
+
+// max number of destinations being prefetched at the same time in one VPC
+#define ON_DEMAND_PREFETCH_MAX_OUTSTANDING_PER_VPC 64
+
+// a source going to two destinations within this window makes them co-accessed
+#define ON_DEMAND_PREFETCH_CO_ACCESS_WINDOW_IN_MICROSECONDS 100000 // 100 milliseconds
+
+#define ON_DEMAND_PREFETCH_MAX_CO_ACCESSED_PEERS 8
+
+// prefetched destinations not used within this time count as unused
+#define ON_DEMAND_PREFETCH_TRACKING_TTL_IN_MICROSECONDS 10000000 // 10 seconds
+
+// max number of sources, destinations and prefetched destinations remembered
+#define ON_DEMAND_PREFETCH_MAX_ENTRIES 65536
+
 #define REQUEST_UUID_ON_DEMAND_PAYLOAD_MAP_SIZE_CHECK_FREQUENCY_IN_MICROSECONDS \
   1000 // 10 microsecond, which is 1 millisecond
 
@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <vector>
 
 using namespace aca_dhcp_programming_if;
 
@@ -135,9 +136,18 @@ struct udphear {
 #define DHCP_MSG_IP_HEADER_DS (0) //different service field
 
 //DHCP message l2 layer
-#define DHCP_MSG_L2_HEADER_DEST_MAC ("ffffffffffff")
-#define DHCP_MSG_L2_HEADER_SRC_MAC ("60d755f7c209") // hard code for l2 src mac 60:d7:55:f7:c2:09
-#define DHCP_MSG_L2_HEADER_TYPE ("0800")
+#define DHCP_MSG_L2_HEADER_DEST_MAC                                            \
+  {                                                                            \
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff                                         \
+  }
+#define DHCP_MSG_L2_HEADER_SRC_MAC                                             \
+  {                                                                            \
+    0x60, 0xd7, 0x55, 0xf7, 0xc2, 0x09                                         \
+  } // hard code for l2 src mac 60:d7:55:f7:c2:09
+#define DHCP_MSG_L2_HEADER_TYPE (0x0800)
+
+// ethernet header + ip and udp headers in front of a serialized dhcp message
+#define DHCP_MSG_PACKET_HEADER_LEN (14 + 28)
 
 struct dhcp_message {
   uint8_t op;
@@ -294,8 +304,11 @@ class ACA_Dhcp_Server : public aca_dhcp_programming_if::ACA_Dhcp_Programming_Int
   int _pack_dhcp_opt_dns(uint8_t *option, string dns_addresses[]);
 
   unsigned short check_sum(unsigned char *a, int len);
-  string _serialize_dhcp_message(dhcp_message *dhcpmsg);
-  string _serialize_dhcp_ip_header_message(dhcp_message *dhcpmsg, int dhcp_message_len);
+  // write the frame of dhcpmsg to packet, returns its length or 0 if dhcpmsg is null
+  size_t _serialize_dhcp_message(dhcp_message *dhcpmsg, vector<uint8_t> &packet);
+  // append the DHCP_MSG_PACKET_HEADER_LEN bytes of headers to header
+  void _serialize_dhcp_ip_header_message(dhcp_message *dhcpmsg, int dhcp_message_len,
+                                         vector<uint8_t> &header);
 
   /****************** Private variables ******************/
   int _dhcp_entry_thresh;
@@ -100,6 +100,10 @@ class Aca_Goal_State_Handler {
           int operation_rc, ulong culminative_dataplane_programming_time,
           ulong culminative_network_configuration_time, ulong state_elapse_time);
 
+  // an operation status reported before its flows failed in the switch
+  void set_goal_state_operation_failed(alcor::schema::GoalStateOperationReply &gsOperationReply,
+                                       int status_index);
+
   // compiler will flag error when below is called
   Aca_Goal_State_Handler(Aca_Goal_State_Handler const &) = delete;
   void operator=(Aca_Goal_State_Handler const &) = delete;
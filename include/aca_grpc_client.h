@@ -27,11 +27,19 @@ using grpc::ServerReaderWriter;
 using grpc::ServerWriter;
 using grpc::Status;
 
+struct AsyncClientCall;
+
 class GoalStateProvisionerClientImpl final : public GoalStateProvisioner::Service {
   public:
   std::unique_ptr<GoalStateProvisioner::Stub> stub_;
   std::shared_ptr<grpc_impl::Channel> chan_;
   void RequestGoalStates(HostRequest *request, grpc::CompletionQueue *cq);
+  /*
+   * send the request with a call allocated by the caller, the call is the tag
+   * of its reply on cq. Returns false if it could not be sent, the caller
+   * keeps the ownership of call then.
+   */
+  bool RequestGoalStates(HostRequest *request, grpc::CompletionQueue *cq, AsyncClientCall *call);
   explicit GoalStateProvisionerClientImpl(){};
   void ConnectToNCM();
   void RunClient();
@@ -43,4 +51,6 @@ struct AsyncClientCall {
   grpc::ClientContext context;
   grpc::Status status;
   std::unique_ptr<grpc::ClientAsyncResponseReader<alcor::schema::HostRequestReply> > response_reader;
+  // the on-demand request id the call was sent with
+  uint64_t request_id = 0;
 };
\ No newline at end of file
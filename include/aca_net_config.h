@@ -15,6 +15,7 @@
 #ifndef ACA_NET_CONFIG_H
 #define ACA_NET_CONFIG_H
 
+#include <functional>
 #include <string>
 
 using std::string;
@@ -31,10 +32,24 @@ struct veth_config {
 
 namespace aca_net_config
 {
+// how the namespaces, links and addresses are configured
+enum net_config_backend {
+  // one ip command per change, through Aca_Command_Executor
+  NET_CONFIG_BACKEND_SHELL = 0,
+  // rtnetlink messages, through Aca_Netlink_Config
+  NET_CONFIG_BACKEND_NETLINK = 1,
+  NET_CONFIG_BACKEND_MAX = 2
+};
+
 class Aca_Net_Config {
   public:
   static Aca_Net_Config &get_instance();
 
+  // an unknown backend falls back to the shell
+  void configure(net_config_backend backend);
+
+  net_config_backend get_backend();
+
   int create_namespace(string ns_name, ulong &culminative_time);
 
   int create_veth_pair(string veth_name, string peer_name, ulong &culminative_time);
@@ -63,8 +78,14 @@ class Aca_Net_Config {
   void operator=(Aca_Net_Config const &) = delete;
 
   private:
-  Aca_Net_Config(){};
+  Aca_Net_Config();
   ~Aca_Net_Config(){};
+
+  // runs an operation of Aca_Netlink_Config, timed like a system command
+  int _execute_netlink(const string &operation, const std::function<int()> &netlink_fn,
+                       ulong &culminative_time);
+
+  net_config_backend _backend;
 };
 
 } // namespace aca_net_config
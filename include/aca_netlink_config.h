@@ -0,0 +1,164 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_NETLINK_CONFIG_H
+#define ACA_NETLINK_CONFIG_H
+
+#include "aca_net_config.h"
+#include <cstdint>
+#include <linux/netlink.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace aca_net_config
+{
+// one rtnetlink request, see Aca_Netlink_Config::_transact()
+class Netlink_Message {
+  public:
+  // NLM_F_REQUEST and NLM_F_ACK are always set
+  Netlink_Message(uint16_t type, uint16_t flags);
+
+  // the fixed header of the message type, like struct ifinfomsg
+  void put(const void *data, size_t len);
+
+  void put_attr(uint16_t type, const void *data, size_t len);
+
+  void put_attr_u32(uint16_t type, uint32_t value);
+
+  // with its terminating NUL, as the kernel wants the names
+  void put_attr_string(uint16_t type, const std::string &value);
+
+  // returns the offset of the nest to pass to end_nest()
+  size_t begin_nest(uint16_t type);
+
+  void end_nest(size_t offset);
+
+  struct nlmsghdr *header();
+
+  private:
+  void _append(const void *data, size_t len);
+
+  std::vector<char> _buffer;
+};
+
+/*
+  The network configuration of Aca_Net_Config over NETLINK_ROUTE sockets,
+  instead of one ip command per change. A socket is kept open for the
+  agent's network namespace and for each named namespace configured, it
+  is created from within its namespace and stays there.
+
+  The messages of one operation go out in a single sendmsg(), each asks for
+  an ACK which is told from the others by its sequence number. The kernel
+  runs them in order and one failing does not stop the next ones.
+
+  The named namespaces are the files of netns_dir, like "ip netns". The
+  methods return EXIT_SUCCESS or -errno like the rest of Aca_Net_Config,
+  ns_name is empty for the agent's namespace.
+*/
+class Aca_Netlink_Config {
+  public:
+  static Aca_Netlink_Config &get_instance();
+
+  explicit Aca_Netlink_Config(const std::string &netns_dir);
+
+  ~Aca_Netlink_Config();
+
+  // compiler will flag the error when below is called.
+  Aca_Netlink_Config(Aca_Netlink_Config const &) = delete;
+  void operator=(Aca_Netlink_Config const &) = delete;
+
+  // "ip netns add <ns_name>"
+  int create_namespace(const std::string &ns_name);
+
+  // "ip link add <veth_name> type veth peer name <peer_name>"
+  int create_veth_pair(const std::string &veth_name, const std::string &peer_name);
+
+  // "ip link delete <link_name>"
+  int delete_link(const std::string &link_name);
+
+  // "ip link set dev <link_name> up mtu <mtu>", mtu 0 leaves it as it is
+  int set_link_up(const std::string &ns_name, const std::string &link_name, uint mtu);
+
+  // "ip link set <link_name> netns <ns_name>"
+  int move_to_namespace(const std::string &link_name, const std::string &ns_name);
+
+  /*
+   * address, mac, link up and default route of a veth moved into ns_name,
+   * in one batch.
+   * Return:
+   *    the error of the address or of the link, the default route may be
+   *    there already
+   */
+  int setup_veth_device(const std::string &ns_name, const veth_config &new_veth_config);
+
+  // link down, renamed and up again, in one batch
+  int rename_link(const std::string &ns_name, const std::string &link_name,
+                  const std::string &new_link_name);
+
+  // "route add default gw <gateway_ip>"
+  int add_default_route(const std::string &ns_name, const std::string &gateway_ip);
+
+  // the ifindex of a link, or -errno
+  int get_link_index(const std::string &ns_name, const std::string &link_name);
+
+  private:
+  struct Netlink_Socket {
+    // closes fd
+    ~Netlink_Socket();
+
+    int fd;
+    // the inode of the namespace, a namespace deleted and added again
+    // under the same name is another one
+    ino_t netns_ino;
+    uint32_t next_seq;
+    // _sockets_used when the socket was last taken from _sockets
+    uint64_t last_used;
+    std::mutex mutex;
+  };
+
+  // the socket stays in _sockets until its namespace is gone or changes, or
+  // it is evicted, nullptr and rc set if it can't be opened
+  std::shared_ptr<Netlink_Socket> _get_socket(const std::string &ns_name, int &rc);
+
+  // close the sockets of the namespaces gone and make room for a new one,
+  // the caller holds _sockets_mutex
+  void _evict_sockets();
+
+  // _transact() on the socket of ns_name, rc is the first error
+  int _execute(const std::string &ns_name, std::vector<Netlink_Message> &messages);
+
+  /*
+   * send the messages in one sendmsg() and wait for the ACK of each.
+   * Input:
+   *    std::vector<int> &errors: the error of each message, 0 if it succeeded
+   *    int *link_index: the ifindex of the link a RTM_GETLINK message returned
+   * Return:
+   *    EXIT_SUCCESS once every message is answered, -errno of the socket
+   */
+  int _transact(Netlink_Socket &netlink_socket, std::vector<Netlink_Message> &messages,
+                std::vector<int> &errors, int *link_index = nullptr);
+
+  int _get_link_index(Netlink_Socket &netlink_socket, const std::string &link_name);
+
+  const std::string _netns_dir;
+  std::mutex _sockets_mutex;
+  std::unordered_map<std::string, std::shared_ptr<Netlink_Socket> > _sockets;
+  uint64_t _sockets_used;
+};
+} // namespace aca_net_config
+#endif // #ifndef ACA_NETLINK_CONFIG_H
@@ -0,0 +1,200 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_ON_DEMAND_ADMISSION_QUEUE_H
+#define ACA_ON_DEMAND_ADMISSION_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+// what to do with a new request when the admission queue is full
+enum admission_policy {
+  // drop the new request
+  ADMISSION_DROP_NEWEST = 0,
+  // drop the oldest queued request to make room for the new one
+  ADMISSION_DROP_OLDEST = 1,
+  // every port gets an equal share of the queue, a port over its share
+  // loses its new request, otherwise the port using the most loses its oldest
+  ADMISSION_PORT_FAIR_SHARE = 2,
+  ADMISSION_POLICY_MAX = 3
+};
+
+/*
+  Bounded multi-producer single-consumer queue in front of the on-demand
+  request table. Packet-in handlers push() without ever blocking, when the
+  queue is full the configured admission_policy decides which request is
+  dropped, and the dispatcher pop()s the requests in arrival order.
+*/
+template <typename T> class ACA_On_Demand_Admission_Queue {
+  public:
+  ACA_On_Demand_Admission_Queue(size_t capacity, admission_policy policy)
+          : _capacity(capacity == 0 ? 1 : capacity), _policy(policy), _shutdown(false)
+  {
+  }
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Admission_Queue(ACA_On_Demand_Admission_Queue const &) = delete;
+  void operator=(ACA_On_Demand_Admission_Queue const &) = delete;
+
+  /*
+   * queue a request received on "port".
+   * Input:
+   *    std::vector<T> &dropped: requests dropped to honor the capacity, it can be
+   *                             "item" itself or requests queued before it
+   * Return:
+   *    ADMISSION_POLICY_MAX if nothing was dropped,
+   *    otherwise the policy which dropped the requests
+   */
+  admission_policy push(uint32_t port, const T &item, std::vector<T> &dropped)
+  {
+    admission_policy dropped_by = ADMISSION_POLICY_MAX;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+
+      if (_fifo.size() >= _capacity) {
+        dropped_by = _policy;
+        if (_policy == ADMISSION_DROP_NEWEST) {
+          dropped.push_back(item);
+          return dropped_by;
+        } else if (_policy == ADMISSION_DROP_OLDEST) {
+          dropped.push_back(_remove_oldest(_fifo.front().port));
+        } else {
+          auto found = _ports.find(port);
+          size_t queued = found == _ports.end() ? 0 : found->second.size();
+          size_t active_ports = _ports.size() + (queued == 0 ? 1 : 0);
+          size_t fair_share = _capacity / active_ports;
+          if (queued >= (fair_share == 0 ? 1 : fair_share)) {
+            dropped.push_back(item);
+            return dropped_by;
+          }
+          dropped.push_back(_remove_oldest(_get_largest_port()));
+        }
+      }
+
+      _fifo.push_back(Node{ port, item });
+      _ports[port].push_back(std::prev(_fifo.end()));
+    }
+    _cv.notify_one();
+    return dropped_by;
+  }
+
+  // wait for a request, returns false once the queue is shut down and drained
+  bool pop(T &item)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] { return _shutdown || !_fifo.empty(); });
+    if (_fifo.empty()) {
+      return false;
+    }
+    item = _remove_oldest(_fifo.front().port);
+    return true;
+  }
+
+  // wait up to "timeout" for a request, returns false on timeout or shutdown
+  bool pop(T &item, std::chrono::microseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_cv.wait_for(lock, timeout, [this] { return _shutdown || !_fifo.empty(); })) {
+      return false;
+    }
+    if (_fifo.empty()) {
+      return false;
+    }
+    item = _remove_oldest(_fifo.front().port);
+    return true;
+  }
+
+  void set_policy(admission_policy policy)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy = policy;
+  }
+
+  // wakes up the consumer, pop() returns false once the queue is drained
+  void shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _shutdown = true;
+    }
+    _cv.notify_all();
+  }
+
+  size_t size()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _fifo.size();
+  }
+
+  size_t size(uint32_t port)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _ports.find(port);
+    return found == _ports.end() ? 0 : found->second.size();
+  }
+
+  private:
+  struct Node {
+    uint32_t port;
+    T item;
+  };
+  typedef typename std::list<Node>::iterator node_iterator;
+
+  // remove the oldest request of a port, the caller holds _mutex
+  T _remove_oldest(uint32_t port)
+  {
+    auto found = _ports.find(port);
+    node_iterator node = found->second.front();
+    T item = node->item;
+    found->second.pop_front();
+    if (found->second.empty()) {
+      _ports.erase(found);
+    }
+    _fifo.erase(node);
+    return item;
+  }
+
+  uint32_t _get_largest_port()
+  {
+    uint32_t largest_port = 0;
+    size_t largest_size = 0;
+    for (auto &port : _ports) {
+      if (port.second.size() > largest_size) {
+        largest_port = port.first;
+        largest_size = port.second.size();
+      }
+    }
+    return largest_port;
+  }
+
+  const size_t _capacity;
+  admission_policy _policy;
+  bool _shutdown;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  // all the queued requests in arrival order
+  std::list<Node> _fifo;
+  // the queued requests of each port, oldest first
+  std::unordered_map<uint32_t, std::deque<node_iterator> > _ports;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_ADMISSION_QUEUE_H
@@ -29,6 +29,17 @@
 #include <grpcpp/grpcpp.h>
 #include <unordered_map>
 #include "aca_log.h"
+#include "aca_config.h"
+#include "aca_on_demand_request_table.h"
+#include "aca_on_demand_negative_cache.h"
+#include "aca_on_demand_admission_queue.h"
+#include "aca_on_demand_pool.h"
+#include "aca_on_demand_pending_queue.h"
+#include "aca_on_demand_inflight_table.h"
+#include "aca_on_demand_prefetcher.h"
+#include "aca_on_demand_reply_shards.h"
+#include "aca_on_demand_request_batcher.h"
+#include "of_packet_in.h"
 #include "goalstateprovisioner.grpc.pb.h"
 
 #include "marl/defer.h"
@@ -40,16 +51,56 @@ using namespace alcor::schema;
 using namespace std;
 
 extern int thread_pools_size;
+extern uint g_on_demand_reply_shard_count;
+extern uint g_on_demand_batch_window_us;
+extern uint g_on_demand_batch_max_requests;
+extern uint g_on_demand_batch_max_outstanding;
+
+// destination of an on-demand request, requests to the same destination are coalesced
+struct on_demand_flow_key {
+  uint16_t vlan_id;
+  uint32_t ip_dest; // network byte order
+  alcor::schema::Protocol protocol;
+  bool operator==(const on_demand_flow_key &p) const
+  {
+    return vlan_id == p.vlan_id && ip_dest == p.ip_dest && protocol == p.protocol;
+  }
+};
+
+struct on_demand_flow_key_hash {
+  size_t operator()(const on_demand_flow_key &p) const
+  {
+    uint64_t key = ((uint64_t)p.ip_dest << 32) | ((uint64_t)p.vlan_id << 16) |
+                   (uint16_t)p.protocol;
+    // std::hash of an integer is the identity, mix the bits for the shard index
+    return (key * 0x9E3779B97F4A7C15ULL) >> 32;
+  }
+};
 
 // using namespace grpc;
 struct on_demand_payload {
   std::chrono::_V2::steady_clock::time_point insert_time;
-  string uuid;
+  uint64_t request_id;
+  on_demand_flow_key flow_key;
+  uint32_t ip_src; // network byte order
+  uint tunnel_id;
   uint32_t in_port;
-  void *packet;
-  int packet_size;
+  // copy of the packet headers needed to replay the packet
+  aca_on_demand_engine::ACA_Packet_Buffer_Pool::Buffer packet;
   alcor::schema::Protocol protocol;
 };
+
+typedef aca_on_demand_engine::ACA_Object_Pool<on_demand_payload>::handle on_demand_payload_handle;
+
+// a request admitted to be sent to NCM, waiting for room in the request table
+struct on_demand_pending_request {
+  on_demand_payload *payload;
+  string ip_src;
+  string ip_dest;
+  int port_src;
+  int port_dest;
+};
+
 // ACA on-demand engine implementation class
 namespace aca_on_demand_engine
 {
@@ -58,24 +109,68 @@ class ACA_On_Demand_Engine {
   /* This thread is responsible for processing hostOperationReplies from NCM */
   std::thread *on_demand_reply_processing_thread;
   /* 
-  This thread checks request_uuid_on_demand_payload_map periodically and removes any 
+  This thread checks request_id_on_demand_payload_table periodically and removes any 
   entry that has been staying in the map for more than ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS
   */
   std::thread *on_demand_payload_cleaning_thread;
-  grpc::CompletionQueue _cq;
 
   /*
-      If there is a good way to iterate thru the CTSL::HashMap,
-      we should change this request_uuid_on_demand_payload_map 
-      back to this HashMap. Using unordered_map and locking it 
-      with a mutex will prabably bring performance issues in the future.
+      Pools of the packet copies and of the payload records, declared before
+      the tables below so they outlive every payload pointer stored there.
+  */
+  ACA_Packet_Buffer_Pool _packet_buffer_pool;
+  ACA_Object_Pool<on_demand_payload> _payload_pool;
+
+  /*
+      Outstanding on-demand requests, keyed by their request id.
+      The table is sharded and expires its entries with a timing wheel,
+      so there is no global lock and no full scan of the requests.
+  */
+  ACA_On_Demand_Request_Table<on_demand_payload *> request_id_on_demand_payload_table;
+  /*
+      In-flight request index, keyed by (vlan id, destination ip, protocol).
+      Packets to a destination which already has an outstanding request are
+      held in its pending queue instead of sending another request to NCM,
+      and replayed together once the reply comes back.
+  */
+  ACA_On_Demand_Inflight_Table<on_demand_flow_key, on_demand_payload *, on_demand_flow_key_hash> _inflight_requests;
+  /*
+      New requests wait here until there is room in the request table,
+      parse_packet() never blocks, the admission policy drops requests
+      when the queue is full.
+  */
+  ACA_On_Demand_Admission_Queue<on_demand_pending_request> _admission_queue;
+  /*
+      Packs the requests of a batching window into one call to NCM, its
+      flusher sends through _reply_shards and is stopped by the destructor
+      before the shards go away.
   */
-  unordered_map<std::string, on_demand_payload *, std::hash<std::string> > request_uuid_on_demand_payload_map;
-  std::mutex _payload_map_mutex;
+  ACA_On_Demand_Request_Batcher _request_batcher;
+  /*
+      Completion queues of the requests to NCM, sharded by request id and
+      polled by their own threads. Declared after the tables above, so the
+      pollers are stopped before the tables go away.
+  */
+  ACA_On_Demand_Reply_Shards _reply_shards;
   /* This records when clean_remaining_payload() ran last time, 
   its initial value should be the time  when clean_remaining_payload() was first called*/
   std::chrono::_V2::steady_clock::time_point last_time_cleaned_remaining_payload;
 
+  /*
+   * generate a new on-demand request id, lock free.
+   * The ids are unique on this node and monotonic: the counter starts at the
+   * wall clock time in microseconds when the agent starts, so the ids of a
+   * restarted agent don't collide with the replies still due to the previous one.
+   */
+  static uint64_t generate_request_id();
+
+  /*
+   * the request id is only rendered as text for the request_id of HostRequest,
+   * and parsed back from the request_id of the NCM reply.
+   */
+  static string request_id_to_string(uint64_t request_id);
+  static bool parse_request_id(const string &request_id_str, uint64_t &request_id);
+
   static ACA_On_Demand_Engine &get_instance();
 
   /*
@@ -83,12 +178,26 @@ class ACA_On_Demand_Engine {
    * Input:
    *    uint32 in_port: the port received the packet
    *    void *packet: packet data.
+   *    size_t packet_len: length of the packet data.
    * example:
-   *    ACA_ON_Demand_Engine::get_instance().parse_packet(1, packet) 
+   *    ACA_ON_Demand_Engine::get_instance().parse_packet(1, packet, packet_len) 
    */
-  void parse_packet(uint32_t in_port, void *packet);
+  void parse_packet(uint32_t in_port, void *packet, size_t packet_len);
+
+  /*
+   * parse a packet-in received by the openflow controller, without copying it.
+   * Input:
+   *    const packet_in_ptr_t &packet_in: view over the received packet-in message
+   */
+  void parse_packet(const packet_in_ptr_t &packet_in);
 
   void clean_remaining_payload();
+
+  /*
+   * move the admitted requests into the request table and send them to NCM,
+   * waiting for room in the table when it is full.
+   */
+  void dispatch_on_demand_requests();
   /*
    * print out the contents of packet payload data.
    * Input:
@@ -99,13 +208,44 @@ class ACA_On_Demand_Engine {
    */
   void print_payload(const u_char *payload, int len);
   void print_hex_ascii_line(const u_char *payload, int len, int offset);
-  void on_demand(string uuid_for_call, OperationStatus status, uint32_t in_port,
-                 void *packet, int packet_size, Protocol protocol,
-                 std::chrono::_V2::steady_clock::time_point insert_time);
-  void unknown_recv(uint16_t vlan_id, string ip_src, string ip_dest, int port_src,
-                    int port_dest, Protocol protocol, char *uuid_str);
-  void process_async_grpc_replies();
-  void process_async_replies_asyncly(string request_id, OperationStatus replyStatus,
+  /*
+   * answer the packets of an on-demand request once its reply came back.
+   * Input:
+   *    std::vector<on_demand_payload *> &payloads: the payload of the request
+   *        followed by its pending packets, all to the same destination
+   * Arp requests are answered by the arp responder, other packets are sent
+   * back to ovs in one batched packet-out once the neighbor is programmed.
+   */
+  void on_demand(uint64_t request_id, OperationStatus status,
+                 const std::vector<on_demand_payload *> &payloads);
+  void unknown_recv(uint tunnel_id, string ip_src, string ip_dest, int port_src,
+                    int port_dest, Protocol protocol, uint64_t request_id);
+  /*
+   * ask NCM in one request for the neighbors ACA_On_Demand_Prefetcher expects
+   * to be needed soon after the successful on-demand request of payload.
+   */
+  void prefetch_neighbors(on_demand_payload *payload);
+  /*
+   * queue a payload on the outstanding request of its destination,
+   * or register it as the outstanding request if there is none.
+   * Older pending packets are dropped when the queue is over
+   * g_on_demand_pending_queue_max_packets or g_on_demand_pending_queue_max_bytes.
+   * Return:
+   *    true if the payload was queued (or dropped because it is over the limits),
+   *    payload is empty then. false if the caller needs to send a new request to NCM
+   */
+  bool coalesce_on_demand_request(on_demand_payload_handle &payload);
+  /*
+   * remove the in-flight request of a payload, its pending payloads
+   * are moved to pending_payloads, oldest first.
+   */
+  void release_on_demand_request(on_demand_payload *payload,
+                                 std::vector<on_demand_payload *> &pending_payloads);
+  // send a batch of requests built by _request_batcher
+  bool send_on_demand_batch(HostRequest *request, uint64_t batch_id);
+  // process a finished call to NCM, runs on the poller thread of its shard
+  void process_async_grpc_reply(AsyncClientCall *call, bool ok);
+  void process_async_replies_asyncly(uint64_t request_id, OperationStatus replyStatus,
                                      std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time);
 /* ethernet headers are always exactly 14 bytes [1] */
 #define SIZE_ETHERNET 14
@@ -169,23 +309,60 @@ class ACA_On_Demand_Engine {
   void operator=(ACA_On_Demand_Engine const &) = delete;
 
   private:
+  void _free_payload(on_demand_payload *payload)
+  {
+    // the packet buffer goes back to its pool along with the record
+    _payload_pool.destroy(payload);
+  }
+
+  // drop a request which was never sent, along with its pending packets
+  void _drop_on_demand_request(on_demand_payload *payload)
+  {
+    std::vector<on_demand_payload *> pending_payloads;
+    release_on_demand_request(payload, pending_payloads);
+    for (auto pending_payload : pending_payloads) {
+      _free_payload(pending_payload);
+    }
+    _free_payload(payload);
+  }
+
+  // answer an on-demand arp request with the arp responder
+  void _reply_on_demand_arp(uint64_t request_id, on_demand_payload *payload);
+
   ACA_On_Demand_Engine()
+          : request_id_on_demand_payload_table(ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS,
+                                                 ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS),
+            _admission_queue(ON_DEMAND_ADMISSION_QUEUE_SIZE,
+                             (admission_policy)ON_DEMAND_ADMISSION_POLICY),
+            _request_batcher(
+                    [this](HostRequest *request, uint64_t batch_id) {
+                      return send_on_demand_batch(request, batch_id);
+                    },
+                    g_on_demand_batch_window_us, g_on_demand_batch_max_requests,
+                    g_on_demand_batch_max_outstanding, ON_DEMAND_BATCH_MAX_PENDING_REQUESTS),
+            _reply_shards(
+                    g_on_demand_reply_shard_count,
+                    [this](AsyncClientCall *call, bool ok) {
+                      process_async_grpc_reply(call, ok);
+                    },
+                    marl::Scheduler::get())
   {
     ACA_LOG_DEBUG("%s\n", "Constructor of a new on demand engine, need to create a new thread to process the grpc replies");
     int cores = std::thread::hardware_concurrency();
     ACA_LOG_DEBUG("This host has %ld cores, setting the size of the thread pools to be %ld\n",
                   cores, thread_pools_size);
     marl::schedule([=]{
-      process_async_grpc_replies();
+      clean_remaining_payload();
     });
     marl::schedule([=]{
-      clean_remaining_payload();
+      dispatch_on_demand_requests();
     });
   };
   ~ACA_On_Demand_Engine()
   {
-    _cq.Shutdown();
-    request_uuid_on_demand_payload_map.clear();
+    _request_batcher.shutdown();
+    _admission_queue.shutdown();
+    request_id_on_demand_payload_table.clear();
     delete on_demand_reply_processing_thread;
     delete on_demand_payload_cleaning_thread;
   };
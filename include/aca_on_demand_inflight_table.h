@@ -0,0 +1,146 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_ON_DEMAND_INFLIGHT_TABLE_H
+#define ACA_ON_DEMAND_INFLIGHT_TABLE_H
+
+#include "aca_on_demand_pending_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define ON_DEMAND_INFLIGHT_SHARD_COUNT 64 // must be a power of two
+
+namespace aca_on_demand_engine
+{
+/*
+  Outstanding on-demand requests keyed by their destination. The first packet
+  to a destination becomes its request, the packets to the same destination
+  coming before the reply are attached to that request in its pending queue
+  instead of issuing requests of their own, and they are all released by the
+  single reply. The table is sharded by the hash of the key, each shard with
+  its own lock.
+*/
+template <typename Key, typename T, typename Hash> class ACA_On_Demand_Inflight_Table {
+  public:
+  ACA_On_Demand_Inflight_Table() : _issued(0), _coalesced(0)
+  {
+  }
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Inflight_Table(ACA_On_Demand_Inflight_Table const &) = delete;
+  void operator=(ACA_On_Demand_Inflight_Table const &) = delete;
+
+  /*
+   * attach a packet to the outstanding request of its destination, or
+   * register it as the outstanding request if there is none.
+   * Input:
+   *    uint64_t request_id: id of the request "item" would be sent with
+   *    size_t bytes, max_packets, max_bytes: see ACA_On_Demand_Pending_Queue::push()
+   *    std::vector<T> &dropped: packets dropped from the pending queue, "item"
+   *                             itself if it is over the limits alone
+   * Return:
+   *    true if "item" was attached (or dropped), false if the caller has to
+   *    issue request_id, "item" is its request then
+   */
+  bool coalesce(const Key &key, uint64_t request_id, const T &item, size_t bytes,
+                size_t max_packets, size_t max_bytes, std::vector<T> &dropped)
+  {
+    auto &shard = _get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.requests.find(key);
+    if (found == shard.requests.end()) {
+      shard.requests[key].request_id = request_id;
+      _issued++;
+      return false;
+    }
+
+    if (!found->second.pending_items.push(item, bytes, max_packets, max_bytes, dropped)) {
+      dropped.push_back(item);
+    }
+    _coalesced++;
+    return true;
+  }
+
+  /*
+   * remove the outstanding request request_id of a destination, its pending
+   * packets are moved to "items", oldest first.
+   * Return:
+   *    false if the destination has no request or a newer one than request_id
+   */
+  bool release(const Key &key, uint64_t request_id, std::vector<T> &items)
+  {
+    auto &shard = _get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.requests.find(key);
+    // the destination may already have a newer request, only release our own
+    if (found == shard.requests.end() || found->second.request_id != request_id) {
+      return false;
+    }
+    found->second.pending_items.take(items);
+    shard.requests.erase(found);
+    return true;
+  }
+
+  // number of outstanding requests
+  size_t size()
+  {
+    size_t total = 0;
+    for (auto &shard : _shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total += shard.requests.size();
+    }
+    return total;
+  }
+
+  // number of requests registered so far
+  uint64_t issued() const
+  {
+    return _issued;
+  }
+
+  // number of packets attached to an outstanding request so far
+  uint64_t coalesced() const
+  {
+    return _coalesced;
+  }
+
+  private:
+  // an outstanding request and the packets waiting for the same reply
+  struct Inflight_Request {
+    uint64_t request_id;
+    ACA_On_Demand_Pending_Queue<T> pending_items;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, Inflight_Request, Hash> requests;
+  };
+
+  Shard &_get_shard(const Key &key)
+  {
+    return _shards[Hash()(key) & (ON_DEMAND_INFLIGHT_SHARD_COUNT - 1)];
+  }
+
+  Shard _shards[ON_DEMAND_INFLIGHT_SHARD_COUNT];
+  std::atomic<uint64_t> _issued;
+  std::atomic<uint64_t> _coalesced;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_INFLIGHT_TABLE_H
@@ -0,0 +1,105 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_ON_DEMAND_NEGATIVE_CACHE_H
+#define ACA_ON_DEMAND_NEGATIVE_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace aca_on_demand_engine
+{
+#define NEGATIVE_CACHE_SHARD_COUNT 16 // must be a power of two
+
+/*
+  Destinations that NCM recently answered with a non-SUCCESS status, keyed by
+  (tunnel id, destination ip). While an entry is alive, packets to that
+  destination are dropped locally instead of asking NCM again.
+
+  Every entry lives for the same TTL, so each shard keeps its entries in
+  insertion order: the oldest entry is both the next one to expire and the
+  one evicted when the shard is full.
+*/
+class ACA_On_Demand_Negative_Cache {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  static ACA_On_Demand_Negative_Cache &get_instance();
+
+  ACA_On_Demand_Negative_Cache(size_t max_entries, uint64_t ttl_us);
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Negative_Cache(ACA_On_Demand_Negative_Cache const &) = delete;
+  void operator=(ACA_On_Demand_Negative_Cache const &) = delete;
+
+  // change the size and TTL, existing entries keep their expiration time
+  void configure(size_t max_entries, uint64_t ttl_us);
+
+  // remember that NCM has no state for this destination
+  void add(uint32_t tunnel_id, uint32_t ip_dest,
+           time_point now = std::chrono::steady_clock::now());
+
+  // true if the destination has an entry that has not expired yet
+  bool contains(uint32_t tunnel_id, uint32_t ip_dest,
+                time_point now = std::chrono::steady_clock::now());
+
+  // forget a destination, called when its neighbor goal state arrives
+  bool invalidate(uint32_t tunnel_id, uint32_t ip_dest);
+  bool invalidate(uint32_t tunnel_id, const std::string &ip_dest);
+
+  size_t size() const
+  {
+    return _size.load(std::memory_order_relaxed);
+  }
+
+  void clear();
+
+  private:
+  struct Entry {
+    time_point expire_time;
+    std::list<uint64_t>::iterator order;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    // keys from the oldest to the newest entry
+    std::list<uint64_t> order;
+  };
+
+  static uint64_t _get_key(uint32_t tunnel_id, uint32_t ip_dest)
+  {
+    return ((uint64_t)tunnel_id << 32) | ip_dest;
+  }
+
+  Shard &_get_shard(uint64_t key)
+  {
+    uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+    return _shards[(h >> 32) & (NEGATIVE_CACHE_SHARD_COUNT - 1)];
+  }
+
+  void _erase(Shard &shard, std::unordered_map<uint64_t, Entry>::iterator entry);
+
+  std::atomic<size_t> _max_entries_per_shard;
+  std::atomic<uint64_t> _ttl_us;
+  std::atomic<size_t> _size;
+  Shard _shards[NEGATIVE_CACHE_SHARD_COUNT];
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_NEGATIVE_CACHE_H
@@ -0,0 +1,98 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_ON_DEMAND_PENDING_QUEUE_H
+#define ACA_ON_DEMAND_PENDING_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+/*
+  Packets to one destination held while its on-demand request is outstanding,
+  like the unresolved queue of a kernel neighbor entry. The queue is bounded by
+  both a packet count and a byte count; when a new packet does not fit, the
+  oldest packets are dropped to make room for it. The queue is not thread safe,
+  the in-flight shard owning it serializes the access.
+*/
+template <typename T> class ACA_On_Demand_Pending_Queue {
+  public:
+  ACA_On_Demand_Pending_Queue() : _bytes(0)
+  {
+  }
+
+  /*
+   * queue a packet of "bytes" bytes.
+   * Input:
+   *    size_t max_packets, max_bytes: limits of this queue
+   *    std::vector<T> &dropped: older packets dropped to make room for "item"
+   * Return:
+   *    false if "item" alone is over the limits, it is not queued then
+   */
+  bool push(const T &item, size_t bytes, size_t max_packets, size_t max_bytes,
+            std::vector<T> &dropped)
+  {
+    if (max_packets == 0 || bytes > max_bytes) {
+      return false;
+    }
+    while (_entries.size() >= max_packets || _bytes + bytes > max_bytes) {
+      dropped.push_back(_entries.front().item);
+      _bytes -= _entries.front().bytes;
+      _entries.pop_front();
+    }
+    _entries.push_back(Entry{ item, bytes });
+    _bytes += bytes;
+    return true;
+  }
+
+  // move all the queued packets to "items", oldest first
+  void take(std::vector<T> &items)
+  {
+    items.reserve(items.size() + _entries.size());
+    for (auto &entry : _entries) {
+      items.push_back(entry.item);
+    }
+    _entries.clear();
+    _bytes = 0;
+  }
+
+  size_t size() const
+  {
+    return _entries.size();
+  }
+
+  size_t bytes() const
+  {
+    return _bytes;
+  }
+
+  bool empty() const
+  {
+    return _entries.empty();
+  }
+
+  private:
+  struct Entry {
+    T item;
+    size_t bytes;
+  };
+
+  std::deque<Entry> _entries;
+  size_t _bytes;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_PENDING_QUEUE_H
@@ -0,0 +1,341 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_ON_DEMAND_POOL_H
+#define ACA_ON_DEMAND_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+#define POOL_BLOCKS_PER_SLAB 256
+#define PACKET_BUFFER_SIZE_CLASS_COUNT 3
+// size classes of the packet buffers, the largest one holds the biggest
+// ethernet + vlan + ip + tcp headers (14 + 4 + 60 + 60 bytes)
+#define PACKET_BUFFER_SIZE_CLASSES                                             \
+  {                                                                            \
+    64, 128, 256                                                               \
+  }
+
+/*
+  Free list of fixed size blocks, carved out of slabs of POOL_BLOCKS_PER_SLAB
+  blocks. Freed blocks go back to the free list and are reused, slabs are only
+  released when the pool is destroyed, so the memory used under a steady load
+  stays at its high water mark instead of churning through malloc/free.
+*/
+class ACA_Block_Pool {
+  public:
+  ACA_Block_Pool(size_t block_size, size_t blocks_per_slab = POOL_BLOCKS_PER_SLAB)
+          : _block_size(_align(block_size)),
+            _blocks_per_slab(blocks_per_slab == 0 ? 1 : blocks_per_slab),
+            _free_list(nullptr), _total_blocks(0), _free_blocks(0)
+  {
+  }
+
+  ~ACA_Block_Pool()
+  {
+    for (auto slab : _slabs) {
+      free(slab);
+    }
+  }
+
+  // compiler will flag the error when below is called.
+  ACA_Block_Pool(ACA_Block_Pool const &) = delete;
+  void operator=(ACA_Block_Pool const &) = delete;
+
+  void *allocate()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_free_list == nullptr && !_add_slab()) {
+      return nullptr;
+    }
+    Block *block = _free_list;
+    _free_list = block->next;
+    _free_blocks--;
+    return block;
+  }
+
+  void deallocate(void *ptr)
+  {
+    if (ptr == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    Block *block = static_cast<Block *>(ptr);
+    block->next = _free_list;
+    _free_list = block;
+    _free_blocks++;
+  }
+
+  size_t block_size() const
+  {
+    return _block_size;
+  }
+
+  size_t total_blocks()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _total_blocks;
+  }
+
+  size_t used_blocks()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _total_blocks - _free_blocks;
+  }
+
+  private:
+  // a free block stores the next free block in its first bytes
+  struct Block {
+    Block *next;
+  };
+
+  static size_t _align(size_t size)
+  {
+    const size_t alignment = alignof(std::max_align_t);
+    if (size < sizeof(Block)) {
+      size = sizeof(Block);
+    }
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  bool _add_slab()
+  {
+    char *slab = static_cast<char *>(malloc(_block_size * _blocks_per_slab));
+    if (slab == nullptr) {
+      return false;
+    }
+    _slabs.push_back(slab);
+    for (size_t i = 0; i < _blocks_per_slab; i++) {
+      Block *block = reinterpret_cast<Block *>(slab + i * _block_size);
+      block->next = _free_list;
+      _free_list = block;
+    }
+    _total_blocks += _blocks_per_slab;
+    _free_blocks += _blocks_per_slab;
+    return true;
+  }
+
+  const size_t _block_size;
+  const size_t _blocks_per_slab;
+  std::mutex _mutex;
+  Block *_free_list;
+  std::vector<char *> _slabs;
+  size_t _total_blocks;
+  size_t _free_blocks;
+};
+
+/*
+  Pool of packet buffers in PACKET_BUFFER_SIZE_CLASSES, a buffer is handed out
+  as a move only handle which gives the block back to its pool when destroyed.
+*/
+class ACA_Packet_Buffer_Pool {
+  public:
+  class Buffer {
+    public:
+    Buffer() : _pool(nullptr), _data(nullptr), _size(0)
+    {
+    }
+
+    Buffer(Buffer &&other) : _pool(other._pool), _data(other._data), _size(other._size)
+    {
+      other._pool = nullptr;
+      other._data = nullptr;
+      other._size = 0;
+    }
+
+    Buffer &operator=(Buffer &&other)
+    {
+      if (this != &other) {
+        reset();
+        std::swap(_pool, other._pool);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+      }
+      return *this;
+    }
+
+    ~Buffer()
+    {
+      reset();
+    }
+
+    // compiler will flag the error when below is called.
+    Buffer(Buffer const &) = delete;
+    void operator=(Buffer const &) = delete;
+
+    void reset()
+    {
+      if (_pool != nullptr) {
+        _pool->deallocate(_data);
+      }
+      _pool = nullptr;
+      _data = nullptr;
+      _size = 0;
+    }
+
+    uint8_t *data() const
+    {
+      return _data;
+    }
+
+    size_t size() const
+    {
+      return _size;
+    }
+
+    explicit operator bool() const
+    {
+      return _data != nullptr;
+    }
+
+    private:
+    friend class ACA_Packet_Buffer_Pool;
+
+    ACA_Block_Pool *_pool;
+    uint8_t *_data;
+    size_t _size;
+  };
+
+  ACA_Packet_Buffer_Pool()
+  {
+    const size_t size_classes[PACKET_BUFFER_SIZE_CLASS_COUNT] = PACKET_BUFFER_SIZE_CLASSES;
+    for (int i = 0; i < PACKET_BUFFER_SIZE_CLASS_COUNT; i++) {
+      _pools[i].reset(new ACA_Block_Pool(size_classes[i]));
+    }
+  }
+
+  // compiler will flag the error when below is called.
+  ACA_Packet_Buffer_Pool(ACA_Packet_Buffer_Pool const &) = delete;
+  void operator=(ACA_Packet_Buffer_Pool const &) = delete;
+
+  // returns an empty buffer if size is larger than the largest size class
+  Buffer allocate(size_t size)
+  {
+    Buffer buffer;
+    for (int i = 0; i < PACKET_BUFFER_SIZE_CLASS_COUNT; i++) {
+      if (size <= _pools[i]->block_size()) {
+        buffer._data = static_cast<uint8_t *>(_pools[i]->allocate());
+        if (buffer._data != nullptr) {
+          buffer._pool = _pools[i].get();
+          buffer._size = size;
+        }
+        break;
+      }
+    }
+    return buffer;
+  }
+
+  Buffer copy(const void *data, size_t size)
+  {
+    Buffer buffer = allocate(size);
+    if (buffer) {
+      memcpy(buffer.data(), data, size);
+    }
+    return buffer;
+  }
+
+  size_t used_blocks()
+  {
+    size_t used = 0;
+    for (int i = 0; i < PACKET_BUFFER_SIZE_CLASS_COUNT; i++) {
+      used += _pools[i]->used_blocks();
+    }
+    return used;
+  }
+
+  size_t total_blocks()
+  {
+    size_t total = 0;
+    for (int i = 0; i < PACKET_BUFFER_SIZE_CLASS_COUNT; i++) {
+      total += _pools[i]->total_blocks();
+    }
+    return total;
+  }
+
+  private:
+  std::unique_ptr<ACA_Block_Pool> _pools[PACKET_BUFFER_SIZE_CLASS_COUNT];
+};
+
+/*
+  Pool of T records. make() returns a unique_ptr handle which destroys the
+  record and gives its block back to the pool, release() it to pass the
+  record around as a raw pointer and adopt() it again to take back ownership.
+*/
+template <typename T> class ACA_Object_Pool {
+  public:
+  struct Deleter {
+    ACA_Object_Pool *pool;
+    void operator()(T *object) const
+    {
+      pool->destroy(object);
+    }
+  };
+  typedef std::unique_ptr<T, Deleter> handle;
+
+  ACA_Object_Pool(size_t objects_per_slab = POOL_BLOCKS_PER_SLAB)
+          : _pool(sizeof(T), objects_per_slab)
+  {
+  }
+
+  // compiler will flag the error when below is called.
+  ACA_Object_Pool(ACA_Object_Pool const &) = delete;
+  void operator=(ACA_Object_Pool const &) = delete;
+
+  template <typename... Args> handle make(Args &&... args)
+  {
+    void *block = _pool.allocate();
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    return adopt(new (block) T(std::forward<Args>(args)...));
+  }
+
+  handle adopt(T *object)
+  {
+    return handle(object, Deleter{ this });
+  }
+
+  void destroy(T *object)
+  {
+    if (object != nullptr) {
+      object->~T();
+      _pool.deallocate(object);
+    }
+  }
+
+  size_t used_blocks()
+  {
+    return _pool.used_blocks();
+  }
+
+  size_t total_blocks()
+  {
+    return _pool.total_blocks();
+  }
+
+  private:
+  ACA_Block_Pool _pool;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_POOL_H
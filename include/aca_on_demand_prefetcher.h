@@ -0,0 +1,171 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_ON_DEMAND_PREFETCHER_H
+#define ACA_ON_DEMAND_PREFETCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+// which neighbors are prefetched after an on-demand request succeeds
+enum prefetch_mode {
+  PREFETCH_DISABLED = 0,
+  // the destinations the same sources went to right after this one before
+  PREFETCH_CO_ACCESSED = 1,
+  // the co-accessed destinations, then the rest of the destination's /24
+  PREFETCH_SUBNET = 2,
+  PREFETCH_MODE_MAX = 3
+};
+
+/*
+  Picks the neighbors worth asking NCM about before any packet goes to them.
+  After an on-demand request of a source to destination X succeeds, the
+  destinations that source (or another one) went to right after X before are
+  likely to be next, and so are X's /24 peers.
+
+  Every VPC has a budget of outstanding prefetched destinations, a prefetch
+  request gives its budget back when its reply comes or it expires.
+  Prefetched destinations are tracked for a while to measure the hit rate:
+  a hit is an arp request answered locally because of a prefetch, a late
+  prefetch is a destination that still needed an on-demand request.
+*/
+class ACA_On_Demand_Prefetcher {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  static ACA_On_Demand_Prefetcher &get_instance();
+
+  ACA_On_Demand_Prefetcher(prefetch_mode mode, size_t max_outstanding_per_vpc);
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Prefetcher(ACA_On_Demand_Prefetcher const &) = delete;
+  void operator=(ACA_On_Demand_Prefetcher const &) = delete;
+
+  void configure(prefetch_mode mode, size_t max_outstanding_per_vpc);
+
+  bool enabled()
+  {
+    return _mode != PREFETCH_DISABLED;
+  }
+
+  /*
+   * learn from a successful on-demand request and pick the destinations to prefetch.
+   * Input:
+   *    uint32_t ip_src, ip_dest: addresses of the request, in network byte order
+   *    uint64_t request_id: id of the prefetch request, charged with the picked destinations
+   *    is_programmed: tells if the neighbor of a destination is already programmed,
+   *                   those are not picked. Called without the lock held
+   *    std::vector<uint32_t> &prefetch_ips: the picked destinations, within the VPC budget
+   * Return:
+   *    number of destinations picked
+   */
+  size_t prefetch(uint32_t tunnel_id, uint16_t vlan_id, uint32_t ip_src, uint32_t ip_dest,
+                  uint64_t request_id, const std::function<bool(uint32_t)> &is_programmed,
+                  std::vector<uint32_t> &prefetch_ips,
+                  time_point now = std::chrono::steady_clock::now());
+
+  // the reply of a prefetch request came, returns false if request_id is not a prefetch
+  bool complete(uint64_t request_id);
+
+  /*
+   * give back the budget of the prefetch requests without reply for too long,
+   * and stop tracking the destinations prefetched too long ago.
+   * Return:
+   *    number of tracked destinations which were never used
+   */
+  size_t expire(time_point now = std::chrono::steady_clock::now());
+
+  // an arp request to this destination was answered locally, true if it was prefetched
+  bool on_arp_replied(uint16_t vlan_id, uint32_t ip_dest);
+
+  // this destination needs an on-demand request, true if it was prefetched too late
+  bool on_demand_requested(uint16_t vlan_id, uint32_t ip_dest);
+
+  size_t outstanding(uint32_t tunnel_id);
+
+  size_t tracked();
+
+  private:
+  struct Outstanding_Request {
+    uint32_t tunnel_id;
+    size_t count;
+    time_point expire_time;
+  };
+
+  struct Tracked_Destination {
+    time_point expire_time;
+    std::list<uint64_t>::iterator order;
+  };
+
+  // destinations a source went to, most recent last
+  struct Access_History {
+    uint32_t last_ip_dest;
+    time_point last_access_time;
+    std::list<uint64_t>::iterator order;
+  };
+
+  struct Co_Accessed_Peers {
+    std::deque<uint32_t> ip_dests;
+    std::list<uint64_t>::iterator order;
+  };
+
+  static uint64_t _get_key(uint32_t high, uint32_t low)
+  {
+    return ((uint64_t)high << 32) | low;
+  }
+
+  void _learn(uint32_t tunnel_id, uint32_t ip_src, uint32_t ip_dest, time_point now);
+  // destinations the VPC can still have prefetched
+  size_t _budget(uint32_t tunnel_id);
+  bool _is_tracked(uint16_t vlan_id, uint32_t ip_dest);
+  // start tracking a picked destination, false if it is tracked already
+  bool _track(uint16_t vlan_id, uint32_t ip_dest, time_point now);
+  // stop tracking a destination, true if it was tracked
+  bool _untrack(uint16_t vlan_id, uint32_t ip_dest);
+  void _untrack(std::unordered_map<uint64_t, Tracked_Destination>::iterator tracked);
+
+  std::mutex _mutex;
+  // written under _mutex, read without it on the arp path
+  std::atomic<prefetch_mode> _mode;
+  size_t _max_outstanding_per_vpc;
+
+  // keyed by request id, expired in insertion order
+  std::unordered_map<uint64_t, Outstanding_Request> _outstanding_requests;
+  std::deque<uint64_t> _outstanding_order;
+  std::unordered_map<uint32_t, size_t> _outstanding_per_vpc;
+
+  // keyed by (vlan id, destination ip), expired in insertion order
+  std::unordered_map<uint64_t, Tracked_Destination> _tracked_destinations;
+  std::list<uint64_t> _tracked_order;
+  // size of _tracked_destinations, read without _mutex
+  std::atomic<size_t> _tracked_count;
+
+  // keyed by (tunnel id, ip), least recently used first in the order lists
+  std::unordered_map<uint64_t, Access_History> _access_history;
+  std::list<uint64_t> _access_history_order;
+  std::unordered_map<uint64_t, Co_Accessed_Peers> _co_accessed_peers;
+  std::list<uint64_t> _co_accessed_peers_order;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_PREFETCHER_H
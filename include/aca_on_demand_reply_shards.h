@@ -0,0 +1,90 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_ON_DEMAND_REPLY_SHARDS_H
+#define ACA_ON_DEMAND_REPLY_SHARDS_H
+
+#include "aca_grpc_client.h"
+#include "aca_on_demand_pool.h"
+#include "marl/scheduler.h"
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+/*
+  Completion queues of the on-demand requests to NCM, each one drained by its
+  own poller thread. A request goes to the shard of its request id, so the
+  replies are processed in parallel while the replies of one request always
+  come out of the same queue.
+  The AsyncClientCall records come from a pool, a call is destroyed and its
+  block recycled as soon as the reply handler returns.
+*/
+class ACA_On_Demand_Reply_Shards {
+  public:
+  /*
+   * handles a finished call on its poller thread, the call is recycled
+   * when it returns.
+   * Input:
+   *    bool ok: false if the call did not finish, its reply is not valid then
+   */
+  typedef std::function<void(AsyncClientCall *call, bool ok)> reply_handler_t;
+
+  /*
+   * Input:
+   *    marl::Scheduler *scheduler: bound to the poller threads so that the
+   *                                handler can marl::schedule(), can be nullptr
+   */
+  ACA_On_Demand_Reply_Shards(size_t shard_count, reply_handler_t reply_handler,
+                             marl::Scheduler *scheduler = nullptr);
+
+  // shuts down the completion queues and waits for the poller threads
+  ~ACA_On_Demand_Reply_Shards();
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Reply_Shards(ACA_On_Demand_Reply_Shards const &) = delete;
+  void operator=(ACA_On_Demand_Reply_Shards const &) = delete;
+
+  /*
+   * send a request to NCM on the shard of request_id.
+   * Return:
+   *    false if the request could not be sent, no reply will come then
+   */
+  bool send(GoalStateProvisionerClientImpl *client, HostRequest *request, uint64_t request_id);
+
+  size_t shard_count() const
+  {
+    return _cqs.size();
+  }
+
+  // number of calls waiting for their reply
+  size_t outstanding_calls()
+  {
+    return _call_pool.used_blocks();
+  }
+
+  private:
+  void _poll(size_t shard);
+
+  ACA_Object_Pool<AsyncClientCall> _call_pool;
+  reply_handler_t _reply_handler;
+  marl::Scheduler *_scheduler;
+  std::vector<std::unique_ptr<grpc::CompletionQueue> > _cqs;
+  std::vector<std::thread> _pollers;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_REPLY_SHARDS_H
@@ -0,0 +1,113 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_ON_DEMAND_REQUEST_BATCHER_H
+#define ACA_ON_DEMAND_REQUEST_BATCHER_H
+
+#include "goalstateprovisioner.grpc.pb.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+using namespace alcor::schema;
+
+namespace aca_on_demand_engine
+{
+/*
+  Packs the on-demand state requests into one HostRequest per batching
+  window, so that a burst of misses costs NCM one call instead of one call
+  per miss. A batch is sent as soon as it holds max_batch_size requests, or
+  when its oldest request has waited window_us.
+
+  At most max_outstanding_batches batches wait for their reply at a time,
+  while the limit is reached the new requests keep piling up in the next
+  batch. add() refuses a request once max_pending_requests are waiting, the
+  caller sends it on its own then.
+*/
+class ACA_On_Demand_Request_Batcher {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  /*
+   * sends a batch, runs on the flusher thread.
+   * Input:
+   *    uint64_t batch_id: request id of the first request in the batch, it
+   *                       has to be handed back to complete() with the reply
+   * Return:
+   *    false if the batch could not be sent, no reply will come then
+   */
+  typedef std::function<bool(HostRequest *request, uint64_t batch_id)> send_fn_t;
+
+  ACA_On_Demand_Request_Batcher(send_fn_t send, uint64_t window_us, size_t max_batch_size,
+                                size_t max_outstanding_batches, size_t max_pending_requests);
+
+  // stops the flusher, the requests not sent yet are dropped
+  ~ACA_On_Demand_Request_Batcher();
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Request_Batcher(ACA_On_Demand_Request_Batcher const &) = delete;
+  void operator=(ACA_On_Demand_Request_Batcher const &) = delete;
+
+  // batching is off with a window of 0 or a batch size of 1
+  bool enabled() const
+  {
+    return _window_us > 0 && _max_batch_size > 1;
+  }
+
+  // queue a state request, false if max_pending_requests are already waiting
+  bool add(uint64_t request_id, const HostRequest_ResourceStateRequest &state_request);
+
+  // the reply of a call came back, returns false if it was not a batch
+  bool complete(uint64_t batch_id);
+
+  // stops the flusher thread, add() refuses every request afterwards
+  void shutdown();
+
+  size_t pending();
+
+  size_t outstanding();
+
+  private:
+  struct Pending_Request {
+    uint64_t request_id;
+    time_point enqueue_time;
+    HostRequest_ResourceStateRequest state_request;
+  };
+
+  void _flush();
+
+  // true if a batch has to go now, the caller holds _mutex
+  bool _batch_ready(time_point now) const;
+
+  send_fn_t _send;
+  const uint64_t _window_us;
+  const size_t _max_batch_size;
+  const size_t _max_outstanding_batches;
+  const size_t _max_pending_requests;
+  bool _shutdown;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  // requests waiting for their batch, oldest first
+  std::deque<Pending_Request> _pending;
+  // batches sent and waiting for their reply
+  std::unordered_set<uint64_t> _outstanding;
+  std::thread _flusher;
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_REQUEST_BATCHER_H
@@ -0,0 +1,326 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_ON_DEMAND_REQUEST_TABLE_H
+#define ACA_ON_DEMAND_REQUEST_TABLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace aca_on_demand_engine
+{
+#define REQUEST_TABLE_SHARD_COUNT 64 // must be a power of two
+#define REQUEST_TABLE_WHEEL_LEVELS 4
+#define REQUEST_TABLE_WHEEL_BITS 6
+#define REQUEST_TABLE_WHEEL_SLOTS (1 << REQUEST_TABLE_WHEEL_BITS)
+#define REQUEST_TABLE_WHEEL_MASK (REQUEST_TABLE_WHEEL_SLOTS - 1)
+
+/*
+  Concurrent table of outstanding on-demand requests, keyed by a compact
+  64 bit request id.
+
+  The table is split into REQUEST_TABLE_SHARD_COUNT shards, each one with its
+  own mutex, so inserts/lookups/erases for different requests rarely contend.
+  Every shard also owns a hierarchical timing wheel (REQUEST_TABLE_WHEEL_LEVELS
+  levels of REQUEST_TABLE_WHEEL_SLOTS slots), entries are linked into the wheel
+  slot of their deadline, so expire() only touches the slots that the clock
+  passed and the entries that actually expired, instead of scanning the map.
+*/
+template <typename V> class ACA_On_Demand_Request_Table {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  ACA_On_Demand_Request_Table(uint64_t expiration_us, uint64_t tick_us,
+                              size_t expected_size = 0)
+          : _tick_us(tick_us == 0 ? 1 : tick_us),
+            _timeout_ticks((expiration_us + _tick_us - 1) / _tick_us),
+            _epoch(std::chrono::steady_clock::now()), _size(0)
+  {
+    // size the shards up front to avoid rehashing on the packet-in path
+    for (int i = 0; i < REQUEST_TABLE_SHARD_COUNT; i++) {
+      _shards[i].entries.reserve(expected_size / REQUEST_TABLE_SHARD_COUNT);
+    }
+  }
+
+  ~ACA_On_Demand_Request_Table() = default;
+
+  // compiler will flag the error when below is called.
+  ACA_On_Demand_Request_Table(ACA_On_Demand_Request_Table const &) = delete;
+  void operator=(ACA_On_Demand_Request_Table const &) = delete;
+
+  // insert a new request, returns false if the request id already exists
+  bool insert(uint64_t request_id, const V &value,
+              time_point now = std::chrono::steady_clock::now())
+  {
+    Shard &shard = _get_shard(request_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto result = shard.entries.emplace(request_id, Entry());
+    if (!result.second) {
+      return false;
+    }
+
+    uint64_t now_tick = _to_tick(now);
+    if (shard.entries.size() == 1 && now_tick > shard.current_tick) {
+      // the shard was empty, its wheel can catch up with the clock for free
+      shard.current_tick = now_tick;
+    }
+
+    Entry &entry = result.first->second;
+    entry.request_id = request_id;
+    entry.value = value;
+    entry.expire_tick = now_tick + _timeout_ticks;
+    shard.link(&entry);
+    _size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // find a request and copy its value into "value"
+  bool find(uint64_t request_id, V &value)
+  {
+    Shard &shard = _get_shard(request_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.entries.find(request_id);
+    if (found == shard.entries.end()) {
+      return false;
+    }
+    value = found->second.value;
+    return true;
+  }
+
+  // atomically find and remove a request, only one caller can ever take
+  // a given request, whether it is the reply path or the expiry path
+  bool take(uint64_t request_id, V &value)
+  {
+    Shard &shard = _get_shard(request_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.entries.find(request_id);
+    if (found == shard.entries.end()) {
+      return false;
+    }
+    value = found->second.value;
+    shard.unlink(&found->second);
+    shard.entries.erase(found);
+    _size.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool erase(uint64_t request_id)
+  {
+    V not_used;
+    return take(request_id, not_used);
+  }
+
+  /*
+    Advance the timing wheel of every shard up to "now", the values of all the
+    expired requests are appended to "expired" and removed from the table.
+    Returns the number of expired requests.
+  */
+  size_t expire(std::vector<V> &expired, time_point now = std::chrono::steady_clock::now())
+  {
+    size_t expired_before = expired.size();
+    uint64_t now_tick = _to_tick(now);
+
+    for (int i = 0; i < REQUEST_TABLE_SHARD_COUNT; i++) {
+      Shard &shard = _shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      size_t count = shard.advance(now_tick, expired);
+      _size.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    return expired.size() - expired_before;
+  }
+
+  size_t size() const
+  {
+    return _size.load(std::memory_order_relaxed);
+  }
+
+  void clear()
+  {
+    for (int i = 0; i < REQUEST_TABLE_SHARD_COUNT; i++) {
+      Shard &shard = _shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      _size.fetch_sub(shard.entries.size(), std::memory_order_relaxed);
+      shard.entries.clear();
+      shard.reset_wheel();
+    }
+  }
+
+  private:
+  struct Entry {
+    uint64_t request_id = 0;
+    V value{};
+    uint64_t expire_tick = 0;
+    // the wheel slot this entry is linked into, and its neighbours there
+    Entry **slot = nullptr;
+    Entry *prev = nullptr;
+    Entry *next = nullptr;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    // unordered_map never moves its nodes, so the entries can be linked into
+    // the wheel slots with plain pointers
+    std::unordered_map<uint64_t, Entry> entries;
+    Entry *wheel[REQUEST_TABLE_WHEEL_LEVELS][REQUEST_TABLE_WHEEL_SLOTS] = {};
+    // last tick this shard's wheel was advanced to
+    uint64_t current_tick = 0;
+
+    Entry **slot_of(Entry *entry)
+    {
+      uint64_t delta =
+              entry->expire_tick > current_tick ? entry->expire_tick - current_tick : 0;
+      for (int level = 0; level < REQUEST_TABLE_WHEEL_LEVELS; level++) {
+        if (delta < (1ULL << (REQUEST_TABLE_WHEEL_BITS * (level + 1)))) {
+          uint64_t index = (entry->expire_tick >> (REQUEST_TABLE_WHEEL_BITS * level)) &
+                           REQUEST_TABLE_WHEEL_MASK;
+          return &wheel[level][index];
+        }
+      }
+      // further than the wheel can hold, park it in the top level slot which
+      // is cascaded last, it gets placed again from there
+      int top_shift = REQUEST_TABLE_WHEEL_BITS * (REQUEST_TABLE_WHEEL_LEVELS - 1);
+      uint64_t index = ((current_tick >> top_shift) - 1) & REQUEST_TABLE_WHEEL_MASK;
+      return &wheel[REQUEST_TABLE_WHEEL_LEVELS - 1][index];
+    }
+
+    void link(Entry *entry)
+    {
+      Entry **head = slot_of(entry);
+      entry->slot = head;
+      entry->prev = nullptr;
+      entry->next = *head;
+      if (*head != nullptr) {
+        (*head)->prev = entry;
+      }
+      *head = entry;
+    }
+
+    void unlink(Entry *entry)
+    {
+      if (entry->prev != nullptr) {
+        entry->prev->next = entry->next;
+      } else if (entry->slot != nullptr) {
+        *entry->slot = entry->next;
+      }
+      if (entry->next != nullptr) {
+        entry->next->prev = entry->prev;
+      }
+      entry->slot = nullptr;
+      entry->prev = entry->next = nullptr;
+    }
+
+    Entry *detach_slot(int level, uint64_t index)
+    {
+      Entry *list = wheel[level][index];
+      wheel[level][index] = nullptr;
+      return list;
+    }
+
+    void cascade(int level)
+    {
+      uint64_t index = (current_tick >> (REQUEST_TABLE_WHEEL_BITS * level)) &
+                       REQUEST_TABLE_WHEEL_MASK;
+      Entry *entry = detach_slot(level, index);
+      while (entry != nullptr) {
+        Entry *next = entry->next;
+        link(entry);
+        entry = next;
+      }
+    }
+
+    size_t advance(uint64_t now_tick, std::vector<V> &expired)
+    {
+      size_t count = 0;
+
+      while (current_tick < now_tick) {
+        if (entries.empty()) {
+          // nothing left to expire, jump straight to now
+          current_tick = now_tick;
+          break;
+        }
+
+        current_tick++;
+
+        // cascade the higher levels down when the lower level wrapped,
+        // the highest level first so its entries can keep falling down
+        int highest = 0;
+        for (int level = 1; level < REQUEST_TABLE_WHEEL_LEVELS; level++) {
+          uint64_t lower_mask = (1ULL << (REQUEST_TABLE_WHEEL_BITS * level)) - 1;
+          if ((current_tick & lower_mask) != 0) {
+            break;
+          }
+          highest = level;
+        }
+        for (int level = highest; level >= 1; level--) {
+          cascade(level);
+        }
+
+        Entry *entry = detach_slot(0, current_tick & REQUEST_TABLE_WHEEL_MASK);
+        while (entry != nullptr) {
+          Entry *next = entry->next;
+          if (entry->expire_tick <= current_tick) {
+            expired.push_back(entry->value);
+            entries.erase(entry->request_id);
+            count++;
+          } else {
+            link(entry);
+          }
+          entry = next;
+        }
+      }
+
+      return count;
+    }
+
+    void reset_wheel()
+    {
+      for (int level = 0; level < REQUEST_TABLE_WHEEL_LEVELS; level++) {
+        for (int index = 0; index < REQUEST_TABLE_WHEEL_SLOTS; index++) {
+          wheel[level][index] = nullptr;
+        }
+      }
+    }
+  };
+
+  Shard &_get_shard(uint64_t request_id)
+  {
+    // request ids can be sequential, mix the bits before picking a shard
+    uint64_t h = request_id * 0x9E3779B97F4A7C15ULL;
+    return _shards[(h >> 32) & (REQUEST_TABLE_SHARD_COUNT - 1)];
+  }
+
+  uint64_t _to_tick(time_point now) const
+  {
+    if (now <= _epoch) {
+      return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - _epoch).count() / _tick_us;
+  }
+
+  const uint64_t _tick_us;
+  const uint64_t _timeout_ticks;
+  const time_point _epoch;
+  std::atomic<size_t> _size;
+  Shard _shards[REQUEST_TABLE_SHARD_COUNT];
+};
+} // namespace aca_on_demand_engine
+#endif // #ifndef ACA_ON_DEMAND_REQUEST_TABLE_H
@@ -0,0 +1,152 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_OVS_FLOW_SHADOW_H
+#define ACA_OVS_FLOW_SHADOW_H
+
+#include "of_flow_builder.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace aca_ovs_l2_programmer
+{
+/*
+  Flows the agent programmed on each bridge, keyed by (table, priority,
+  match) with their cookie and actions. A flow-mod which would leave the
+  bridge as it is, like re-adding a flow with the same actions, is left out,
+  so a full resync of unchanged states only sends the real deltas.
+
+  Only FlowBuilder flows are shadowed. A flow text or an ovs-ofctl command
+  can't be keyed reliably, the flows of the table it touches are no longer
+  known to be on the bridge and are sent again. Flows with a timeout are
+  never shadowed, OVS may expire them on its own. The same happens to all the
+  flows of a bridge when its switch reports an error or leaves flows of a
+  goal state unanswered.
+
+  The shadow is also what the agent wants on the bridges. When a switch
+  connects, reconcile() diffs the flows dumped from it against the shadow,
+  so only the missing flows are added and the stale ones deleted. The first
+  time after an agent restart, the flows found on a bridge are kept until
+  sweep() instead, a goal state programming them again changes nothing.
+
+  A bridge holds at most max_flows_per_bridge flows. Past it the shadow no
+  longer knows all the flows wanted there, so reconcile() reports no flow of
+  that bridge stale until it is cleared.
+*/
+class ACA_OVS_Flow_Shadow {
+  public:
+  static ACA_OVS_Flow_Shadow &get_instance();
+
+  // cookie is what tag() gives the flows the agent programs
+  explicit ACA_OVS_Flow_Shadow(size_t max_flows_per_bridge, uint64_t cookie = 0);
+
+  // compiler will flag the error when below is called.
+  ACA_OVS_Flow_Shadow(ACA_OVS_Flow_Shadow const &) = delete;
+  void operator=(ACA_OVS_Flow_Shadow const &) = delete;
+
+  /*
+   * record a flow-mod about to be sent to the bridge.
+   * Input:
+   *    const std::string &action: "add", "mod" or "del" like execute_openflow
+   * Return:
+   *    false if the flow-mod changes nothing and should not be sent
+   */
+  bool update(const std::string &bridge, const FlowBuilder &flow, const std::string &action);
+
+  // a flow text sent to the bridge, the flows of the table it touches are
+  // sent again, all the flows of the bridge if it names no table
+  void invalidate(const std::string &bridge, const std::string &flow);
+
+  // an ovs-ofctl command like "add-flow br-tun table=20,...", commands which
+  // are not about flows are ignored
+  void invalidate_command(const std::string &command);
+
+  // the flows of the bridge are sent again, they are still wanted there
+  void invalidate(const std::string &bridge);
+
+  /*
+   * diff the flows found on a bridge against the flows wanted there, the
+   * wanted flows are known to be on the bridge afterwards.
+   * Input:
+   *    const std::vector<FlowBuilder> &found: the flows of the bridge with the
+   *                                           agent cookie, each with its cookie
+   *    bool keep_unknown: keep the found flows which are not wanted until
+   *                       sweep(), instead of reporting them stale
+   * Output:
+   *    std::vector<FlowBuilder> &missing: wanted flows to add to the bridge
+   *    std::vector<size_t> &stale: indexes in found of the flows to delete,
+   *                                empty if the bridge overflowed the shadow
+   */
+  void reconcile(const std::string &bridge, const std::vector<FlowBuilder> &found,
+                 bool keep_unknown, std::vector<FlowBuilder> &missing,
+                 std::vector<size_t> &stale);
+
+  // the flows reconcile() kept which nothing programmed since, each with the
+  // cookie it was found with, they are forgotten
+  std::vector<FlowBuilder> sweep(const std::string &bridge);
+
+  // the flow with the agent cookie, unless it has a cookie of its own
+  FlowBuilder tag(const FlowBuilder &flow) const;
+
+  uint64_t cookie() const
+  {
+    return _cookie;
+  }
+
+  // the bridge and its flows are gone
+  void clear(const std::string &bridge);
+
+  void clear();
+
+  size_t size(const std::string &bridge);
+
+  private:
+  struct Entry {
+    // cookie and actions of the flow
+    std::string value;
+    FlowBuilder flow;
+    // programmed by the agent, otherwise kept by reconcile() until sweep()
+    bool wanted;
+    // the bridge is known to have the flow as it is
+    bool in_sync;
+  };
+
+  // k is the table, v maps the match of a flow to its entry
+  typedef std::map<uint8_t, std::unordered_map<std::string, Entry> > bridge_flows_t;
+
+  static std::string _get_value(const FlowBuilder &flow);
+
+  static uint64_t _get_run_cookie();
+
+  // the caller holds _mutex
+  void _set_overflowed(const std::string &bridge);
+
+  const size_t _max_flows_per_bridge;
+  const uint64_t _cookie;
+  std::mutex _mutex;
+  // k is the bridge name
+  std::unordered_map<std::string, bridge_flows_t> _bridges;
+  // k is the bridge name, v is the number of flows it has in _bridges
+  std::unordered_map<std::string, size_t> _sizes;
+  // bridges with flows past max_flows_per_bridge, which the shadow does not know
+  std::unordered_set<std::string> _overflowed;
+};
+} // namespace aca_ovs_l2_programmer
+#endif // #ifndef ACA_OVS_FLOW_SHADOW_H
@@ -0,0 +1,150 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_OVS_FLOW_TRANSACTION_H
+#define ACA_OVS_FLOW_TRANSACTION_H
+
+#include "of_flow_completion.h"
+#include "of_message.h"
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aca_ovs_l2_programmer
+{
+/*
+  Flow-mods programmed while one goal state is processed. The transaction
+  begins when it is created, ACA_OVS_L2_Programmer::execute_openflow add()s
+  the flows of the fibers within its Scope, and commit() sends them to each
+  bridge as ordered and atomic OpenFlow bundles, so the datapath never sees
+  half of a goal state. A bundle holds at most bundle_size flow-mods, a larger
+  transaction goes out in several bundles.
+
+  The work items of a goal state run in fibers of their own, they enter the
+  Scope of the transaction which was current() when they were scheduled.
+
+  The flows a fiber adds belong to the operation status it reports next, see
+  attach_operation_status(). commit() follows the bundles of each bridge with
+  a single barrier and wait_for_completion() tells which operation statuses
+  have a flow the switch rejected or did not answer.
+
+  The state which tells that a flow is in place, like the arp entry of a
+  neighbor the on-demand engine waits for, is only updated after_commit().
+*/
+class ACA_OVS_Flow_Transaction {
+  public:
+  // makes a transaction the one of the calling fiber until it goes out of scope
+  class Scope {
+    public:
+    // a null transaction leaves the fiber without any
+    explicit Scope(ACA_OVS_Flow_Transaction *transaction);
+
+    ~Scope();
+
+    // compiler will flag the error when below is called.
+    Scope(Scope const &) = delete;
+    void operator=(Scope const &) = delete;
+
+    private:
+    const void *_fiber;
+    ACA_OVS_Flow_Transaction *_transaction;
+    ACA_OVS_Flow_Transaction *_previous;
+  };
+
+  explicit ACA_OVS_Flow_Transaction(size_t bundle_size);
+
+  // the flows not committed are dropped
+  ~ACA_OVS_Flow_Transaction() = default;
+
+  // compiler will flag the error when below is called.
+  ACA_OVS_Flow_Transaction(ACA_OVS_Flow_Transaction const &) = delete;
+  void operator=(ACA_OVS_Flow_Transaction const &) = delete;
+
+  // the transaction of the calling fiber, nullptr if there is none
+  static ACA_OVS_Flow_Transaction *current();
+
+  // thread safe, the flows of a bridge keep the order they were added in,
+  // the action is "add", "mod" or "del" like execute_openflow
+  void add(const std::string &bridge, const std::string &flow, const std::string &action);
+
+  void add(const std::string &bridge, const FlowBuilder &flow, const std::string &action);
+
+  /*
+   * run action once the flows added so far are committed and answered, at the
+   * end of wait_for_completion() and in the order the actions were added.
+   * It runs right away if the calling fiber has no transaction.
+   */
+  static void after_commit(std::function<void()> action);
+
+  // the flows the calling fiber added since its last call belong to the
+  // operation status at status_index of the goal state reply
+  void attach_operation_status(int status_index);
+
+  /*
+   * send the flows added so far and empty the transaction.
+   * Return:
+   *    number of bundles sent
+   */
+  int commit(ulong &culminative_time);
+
+  /*
+   * wait for the switches to answer the flows of the commit()s so far.
+   * Return:
+   *    indexes of the operation statuses with a flow which failed or was not
+   *    answered within timeout, in ascending order
+   */
+  std::vector<int> wait_for_completion(std::chrono::microseconds timeout);
+
+  size_t size();
+
+  private:
+  struct Flow {
+    ofmsg_ptr_t flow_mod;
+    // -1 until the flow is attached to an operation status
+    int status_index;
+  };
+
+  struct Pending_Completion {
+    std::string bridge;
+    flow_completion_ptr_t completion;
+    std::vector<int> status_indexes;
+  };
+
+  void _add(const std::string &bridge, ofmsg_ptr_t flow_mod);
+
+  // the fiber left its scope, its flows not attached so far stay unattached
+  void _release_fiber(const void *fiber);
+
+  const size_t _bundle_size;
+  std::mutex _mutex;
+  size_t _size;
+  // bridges in the order of their first flow
+  std::vector<std::string> _bridges;
+  std::unordered_map<std::string, std::vector<Flow> > _flows;
+  // k is the fiber, v are its flows not attached to an operation status yet
+  std::unordered_map<const void *, std::vector<std::pair<std::string, size_t> > > _unattached_flows;
+  // completions of the bridges committed and not waited for yet
+  std::vector<Pending_Completion> _completions;
+  // actions of the flows not committed yet
+  std::vector<std::function<void()> > _actions;
+  // actions of the flows committed and not waited for yet
+  std::vector<std::function<void()> > _committed_actions;
+};
+} // namespace aca_ovs_l2_programmer
+#endif // #ifndef ACA_OVS_FLOW_TRANSACTION_H
@@ -18,6 +18,8 @@
 #include "goalstateprovisioner.grpc.pb.h"
 #undef UNUSED
 #include "of_controller.h"
+#include "aca_ovsdb_client.h"
+#include <functional>
 #include <string>
 #include <unordered_map>
 
@@ -61,16 +63,52 @@ class ACA_OVS_L2_Programmer {
   void execute_ovsdb_command(const std::string cmd_string,
                              ulong &culminative_time, int &overall_rc);
 
+  // "ovs-vsctl set port <port_name> tag=<vlan_id>" through the ovsdb client,
+  // returns EXIT_SUCCESS or the error of the transaction
+  int set_port_tag(const std::string port_name, uint vlan_id, ulong &culminative_time);
+
   void execute_openflow_command(const std::string cmd_string,
                                 ulong &culminative_time, int &overall_rc);
 
+  // the flow goes into the ACA_OVS_Flow_Transaction of the calling fiber if
+  // there is one, it is sent right away otherwise
   void execute_openflow(ulong &culminative_time,
                         const std::string bridge,
                         const std::string flow_string,
                         const std::string action = "add");
 
+  // same as above for a flow built with FlowBuilder, no flow text is parsed
+  void execute_openflow(ulong &culminative_time, const std::string bridge,
+                        const FlowBuilder &flow, const std::string action = "add");
+
+  // program the flow-mods in one ordered and atomic bundle, flow-mod i is
+  // flow (offset + i) of completion, if any
+  void execute_openflow_bundle(ulong &culminative_time, const std::string bridge,
+                               const std::vector<ofmsg_ptr_t> &flow_mods,
+                               const flow_completion_ptr_t &completion = nullptr,
+                               size_t offset = 0);
+
+  // resolve completion once the bridge has answered the flows sent before
+  void execute_openflow_barrier(const std::string bridge,
+                                const flow_completion_ptr_t &completion);
+
+  // see OFController::execute_group_mod(), the group-mod is flow index of
+  // completion, if any
+  void execute_openflow_group_mod(ulong &culminative_time, const std::string bridge,
+                                  group_mod_command command, uint32_t group_id,
+                                  uint8_t group_type, const std::vector<GroupBucket> &buckets,
+                                  const flow_completion_ptr_t &completion = nullptr,
+                                  size_t index = 0);
+
   void packet_out(const char *bridge, const char *options);
 
+  // send a frame without going through the ofp text syntax
+  void packet_out(const char *bridge, uint32_t in_port, const uint8_t *packet,
+                  size_t len, const packet_out_actions_t &actions);
+
+  // send all the frames to the bridge at once
+  void packet_out(const char *bridge, const std::vector<PacketOutFrame> &frames);
+
   // compiler will flag the error when below is called.
   ACA_OVS_L2_Programmer(ACA_OVS_L2_Programmer const &) = delete;
   void operator=(ACA_OVS_L2_Programmer const &) = delete;
@@ -87,6 +125,15 @@ class ACA_OVS_L2_Programmer {
   std::unordered_map<uint64_t, std::string> get_ovs_bridge_mapping();
 
   std::unordered_map<std::string, std::string> get_system_port_ids();
+
+  // run a transaction through the ovsdb client, or cmd_string through
+  // ovs-vsctl when ovsdb-server can't be reached on its socket
+  int _execute_ovsdb_transaction(const std::function<int(ACA_OVSDB_Client &)> &transaction,
+                                 const std::string &cmd_string, ulong &culminative_time);
+
+  template <typename Flow>
+  void _execute_openflow(ulong &culminative_time, const std::string &bridge,
+                         const Flow &flow, const std::string &action);
 };
 } // namespace aca_ovs_l2_programmer
 #endif // #ifndef ACA_OVS_L2_PROGRAMMER_H
\ No newline at end of file
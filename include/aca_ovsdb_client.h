@@ -0,0 +1,147 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_OVSDB_CLIENT_H
+#define ACA_OVSDB_CLIENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct json;
+struct json_parser;
+
+namespace aca_ovs_l2_programmer
+{
+/*
+  JSON-RPC (RFC 7047) connection to the local ovsdb-server, for the changes
+  and queries of the Open_vSwitch database on the port programming path. An
+  ovs-vsctl call forks a process which opens its own connection to the
+  database, a transaction on the connection kept here is one round trip.
+
+  One transaction is in flight at a time. The connection is opened on first
+  use, and closed after an I/O error or a timeout so the next call starts on
+  a clean stream. Like "ovs-vsctl --no-wait", a call returns once the
+  database committed the change, ovs-vswitchd applies it on its own.
+
+  A connection can instead monitor the interfaces, see monitor_ofports().
+
+  The calls return EXIT_SUCCESS or an errno:
+    ENOTCONN   ovsdb-server can't be reached, ovs-vsctl may still work
+    ETIMEDOUT  no reply within the timeout
+    ENOENT     the port, interface or bridge does not exist
+    EEXIST     the port added exists already
+    EPROTO     ovsdb-server refused the transaction
+*/
+class ACA_OVSDB_Client {
+  public:
+  // an interface and its openflow port number, 0 while it has none or once
+  // the interface is deleted
+  typedef std::function<void(const std::string &interface, int64_t ofport)> ofport_fn_t;
+
+  static ACA_OVSDB_Client &get_instance();
+
+  ACA_OVSDB_Client(const std::string &socket_path, uint64_t timeout_us);
+
+  ~ACA_OVSDB_Client();
+
+  // compiler will flag the error when below is called.
+  ACA_OVSDB_Client(ACA_OVSDB_Client const &) = delete;
+  void operator=(ACA_OVSDB_Client const &) = delete;
+
+  // "ovs-vsctl set port <port> tag=<tag>"
+  int set_port_tag(const std::string &port, uint32_t tag);
+
+  /*
+   * "ovs-vsctl add-port <bridge> <port> tag=<tag>
+   *     -- set interface <port> type=<type> options:<key>=<value>"
+   * Input:
+   *    uint32_t tag: 0 to leave the port untagged
+   *    const std::string &type: interface type, empty for a system interface
+   */
+  int add_port(const std::string &bridge, const std::string &port, uint32_t tag = 0,
+               const std::string &type = "",
+               const std::map<std::string, std::string> &options = {});
+
+  // "ovs-vsctl del-port <bridge> <port>"
+  int del_port(const std::string &bridge, const std::string &port);
+
+  // "ovs-vsctl br-exists <bridge>", ENOENT if it does not exist
+  int bridge_exists(const std::string &bridge);
+
+  // datapath id of every bridge by bridge name, in one round trip
+  int get_datapath_ids(std::unordered_map<std::string, uint64_t> &datapath_ids);
+
+  // "ovs-vsctl get interface <interface> ofport", ENOENT until it has one
+  int get_ofport(const std::string &interface, int64_t &ofport);
+
+  /*
+   * monitor the ofport of the interfaces. on_ofport gets the interfaces
+   * there already before this returns, then every interface added, changed
+   * or deleted from wait_for_updates(). on_ofport runs with the connection
+   * locked, it must not call the client back.
+   */
+  int monitor_ofports(ofport_fn_t on_ofport);
+
+  // wait up to timeout_us for the updates of the monitor, ETIMEDOUT if none
+  // came, ENOTCONN once the connection is lost and the monitor has to start over
+  int wait_for_updates(uint64_t timeout_us);
+
+  void close();
+
+  private:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  /*
+   * run a transaction on the Open_vSwitch database.
+   * Input:
+   *    struct json *params: the database name and the operations, see
+   *                         _create_transaction(), it is always consumed
+   *    struct json **result: the result of each operation, to json_destroy()
+   *                          when EXIT_SUCCESS is returned
+   */
+  int _transact(struct json *params, struct json **result);
+
+  // the caller holds _mutex for the rest of the _ methods
+  int _call(const char *method, struct json *params, struct json **result);
+
+  // echo and update requests of ovsdb-server
+  int _handle_request(struct json *msg, time_point deadline);
+
+  void _dispatch_updates(const struct json *table_updates);
+
+  int _connect();
+
+  void _close();
+
+  int _send(struct json *msg, time_point deadline);
+
+  int _receive(struct json **msg, time_point deadline);
+
+  const std::string _socket_path;
+  const uint64_t _timeout_us;
+  std::mutex _mutex;
+  int _fd;
+  int64_t _next_id;
+  // the bytes received and not fed to _parser yet
+  std::string _input;
+  struct json_parser *_parser;
+  ofport_fn_t _on_ofport;
+};
+} // namespace aca_ovs_l2_programmer
+#endif // #ifndef ACA_OVSDB_CLIENT_H
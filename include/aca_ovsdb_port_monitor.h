@@ -0,0 +1,113 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef ACA_OVSDB_PORT_MONITOR_H
+#define ACA_OVSDB_PORT_MONITOR_H
+
+#include "aca_ovsdb_client.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace aca_ovs_l2_programmer
+{
+/*
+  Ports whose vlan tag can't be set yet, because nova has not plugged their
+  interface. One thread monitors the Interface table of ovsdb-server and
+  sets the tag of a pending port as soon as its interface gets an ofport,
+  instead of one thread per port polling with ovs-vsctl.
+
+  At most max_pending_ports wait at a time, a port is dropped when it is
+  still not plugged after timeout_us. A port whose tag could not be set is
+  tried again every retry_interval_us. While ovsdb-server can't be
+  monitored, all the pending ports are tried every retry_interval_us.
+*/
+class ACA_OVSDB_Port_Monitor {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  // sets the vlan tag of a port, returns EXIT_SUCCESS or the error
+  typedef std::function<int(const std::string &port_name, uint32_t vlan_id)> configure_fn_t;
+
+  static ACA_OVSDB_Port_Monitor &get_instance();
+
+  ACA_OVSDB_Port_Monitor(const std::string &socket_path, configure_fn_t configure,
+                         size_t max_pending_ports, uint64_t timeout_us,
+                         uint64_t retry_interval_us);
+
+  // stops the monitor, the pending ports are dropped
+  ~ACA_OVSDB_Port_Monitor();
+
+  // compiler will flag the error when below is called.
+  ACA_OVSDB_Port_Monitor(ACA_OVSDB_Port_Monitor const &) = delete;
+  void operator=(ACA_OVSDB_Port_Monitor const &) = delete;
+
+  /*
+   * set the vlan tag of a port once its interface is plugged.
+   * Return:
+   *    EINPROGRESS if the port is pending, ENOSPC if max_pending_ports are
+   *    pending already, the result of configure if the interface is plugged
+   */
+  int add(const std::string &port_name, uint32_t vlan_id);
+
+  // forget a pending port, returns false if it was not pending
+  bool remove(const std::string &port_name);
+
+  size_t pending();
+
+  // stops the monitor thread, add() refuses every port afterwards
+  void shutdown();
+
+  private:
+  struct Pending_Port {
+    uint32_t vlan_id;
+    time_point expire_time;
+    // when the port is tried again after its tag could not be set
+    time_point retry_time;
+  };
+
+  void _monitor();
+
+  // from the monitor of the Interface table, runs under the client lock
+  void _on_ofport(const std::string &interface, int64_t ofport);
+
+  // configure the ports which are due, drop the expired ones
+  void _configure_ports(bool monitored);
+
+  const configure_fn_t _configure;
+  const size_t _max_pending_ports;
+  const uint64_t _timeout_us;
+  const uint64_t _retry_interval_us;
+  bool _shutdown;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::unordered_map<std::string, Pending_Port> _pending;
+  // pending ports whose interface just got an ofport
+  std::vector<std::string> _plugged;
+  // all the interfaces having an ofport, as last reported by the monitor
+  std::unordered_set<std::string> _interfaces;
+  time_point _next_scan;
+  // a connection of its own, it is busy waiting for the updates
+  ACA_OVSDB_Client _client;
+  std::thread _monitor_thread;
+};
+} // namespace aca_ovs_l2_programmer
+#endif // #ifndef ACA_OVSDB_PORT_MONITOR_H
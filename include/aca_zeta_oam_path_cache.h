@@ -0,0 +1,84 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef ACA_ZETA_OAM_PATH_CACHE_H
+#define ACA_ZETA_OAM_PATH_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace aca_zeta_oam_server
+{
+/*
+  Direct paths the OAM server injected, keyed by the match of their flow
+  with the whole flow as value. An entry lives for the idle_timeout of its
+  flow from the injection: the switch can only expire the flow that long
+  after its last packet, so while the entry is alive the flow is still on
+  the bridge and an injection of the same flow is dropped. A flow without
+  idle_timeout has nothing to mirror and is not remembered.
+
+  The entries are also kept in the order they expire, the first one is
+  both the next to expire and the one evicted when the cache is full.
+*/
+class ACA_Zeta_Oam_Path_Cache {
+  public:
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  static ACA_Zeta_Oam_Path_Cache &get_instance();
+
+  explicit ACA_Zeta_Oam_Path_Cache(size_t max_entries);
+
+  // compiler will flag the error when below is called.
+  ACA_Zeta_Oam_Path_Cache(ACA_Zeta_Oam_Path_Cache const &) = delete;
+  void operator=(ACA_Zeta_Oam_Path_Cache const &) = delete;
+
+  // true if the same flow was injected for the match and can't have expired yet
+  bool contains(const std::string &match, const std::string &flow,
+                time_point now = std::chrono::steady_clock::now());
+
+  // remember a flow programmed for the match, replacing the one it had
+  void add(const std::string &match, const std::string &flow, uint16_t idle_timeout,
+           time_point now = std::chrono::steady_clock::now());
+
+  // forget a match, called when its direct path is deleted
+  bool invalidate(const std::string &match);
+
+  size_t size();
+
+  void clear();
+
+  private:
+  typedef std::multimap<time_point, std::string> expire_order_t;
+
+  struct Entry {
+    std::string flow;
+    expire_order_t::iterator order;
+  };
+
+  // the caller holds _mutex
+  void _expire(time_point now);
+
+  const size_t _max_entries;
+  std::mutex _mutex;
+  std::unordered_map<std::string, Entry> _entries;
+  // k is the expiration time of an entry, v is its match
+  expire_order_t _expire_order;
+};
+} // namespace aca_zeta_oam_server
+#endif // #ifndef ACA_ZETA_OAM_PATH_CACHE_H
@@ -21,6 +21,8 @@
 #include <net/ethernet.h>
 //#include <netinet/ether.h>
 #include "hashmap/HashMap.h"
+#include "of_flow_builder.h"
+#include "of_message.h"
 #include "goalstateprovisioner.grpc.pb.h"
 
 using namespace std;
@@ -97,6 +99,9 @@ class ACA_Zeta_Oam_Server {
   oam_match _get_oam_match_field(oam_message *oammsg);
   oam_action _get_oam_action_field(oam_message *oammsg);
 
+  FlowBuilder _get_direct_path_flow(const oam_match &match);
+  int _execute_direct_path_flow(ofmsg_ptr_t flow_mod);
+
   int _add_direct_path(oam_match match, oam_action action);
   int _del_direct_path(oam_match match);
 
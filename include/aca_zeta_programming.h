@@ -17,9 +17,11 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <atomic>
 #include "goalstateprovisioner.grpc.pb.h"
 #include "hashmap/HashMap.h"
+#include "of_group_mod.h"
 
 using namespace std;
 
@@ -65,9 +67,12 @@ class FWD_Info_Hash {
 struct zeta_config {
   uint group_id;
   uint oam_port;
+  // id of the next bucket added to the group, a fwd keeps its bucket id
+  // until it leaves the gateway
+  uint32_t next_bucket_id;
 
-  // CTSL::HashMap <key: FWD_Info, value: int* (not used), hash: FWD_Info_Hash>
-  CTSL::HashMap<FWD_Info, int *, FWD_Info_Hash> zeta_buckets;
+  // CTSL::HashMap <key: FWD_Info, value: bucket id in the group, hash: FWD_Info_Hash>
+  CTSL::HashMap<FWD_Info, uint32_t *, FWD_Info_Hash> zeta_buckets;
 };
 
 class ACA_Zeta_Programming {
@@ -100,9 +105,16 @@ class ACA_Zeta_Programming {
   int _delete_group_punt_rule(uint tunnel_id);
 
   int _create_zeta_group_entry(zeta_config *zeta_config_in);
-  int _update_zeta_group_entry(zeta_config *zeta_config_in);
+  // insert the buckets of the fwds added and remove the ones of the fwds
+  // removed, the other buckets of the group are left as they are
+  int _update_zeta_group_entry(zeta_config *zeta_config_in, const vector<FWD_Info> &added_fwds,
+                               const vector<FWD_Info> &removed_fwds);
   int _delete_zeta_group_entry(zeta_config *zeta_config_in);
 
+  // send a group-mod of the zeta group to br-tun and wait for its answer
+  int _execute_group_mod(group_mod_command command, uint group_id,
+                         const std::vector<GroupBucket> &buckets);
+
   // hashtable <key: zeta_gateway_id, value: zeta_config>
   CTSL::HashMap<string, zeta_config *> _zeta_config_table;
 
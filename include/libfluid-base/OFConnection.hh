@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 namespace fluid_base {
 class BaseOFConnection;
@@ -132,6 +134,22 @@ public:
     */
     void send(void* data, size_t len);
 
+    /**
+    Send several buffers through the connection in one go, they are queued
+    back to back without another message in between.
+
+    @param iov the buffers to send
+    @param iovcnt number of buffers
+    @return the bytes queued, -1 if the connection is closed
+    */
+    ssize_t send(const struct iovec* iov, int iovcnt);
+
+    /**
+    Return how many bytes were sent through the connection but not written to
+    the socket yet, 0 if the connection is closed.
+    */
+    size_t get_send_backlog();
+
     /**
     Set up a function to be called forever with an argument at a regular
     interval. This is a utility function provided for no specific use case, but
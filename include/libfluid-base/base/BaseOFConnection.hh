@@ -18,6 +18,7 @@
 #define __BASEOFCONNECTION_HH__
 
 #include <stdlib.h>
+#include <sys/uio.h>
 #include <vector>
 #include <string>
 
@@ -76,6 +77,25 @@ public:
     */
     void send(void* data, size_t len);
 
+    /**
+    Send several buffers through this connection, they are appended to the
+    output buffer under a single lock.
+
+    This method is thread-safe.
+
+    @param iov the buffers to send
+    @param iovcnt number of buffers
+    @return the bytes queued
+    */
+    size_t send(const struct iovec* iov, int iovcnt);
+
+    /**
+    Get how many bytes are waiting in the output buffer for the socket.
+
+    This method is thread-safe.
+    */
+    size_t get_send_backlog();
+
     /**
     Set up a function to be called forever with an argument at a regular
     interval.
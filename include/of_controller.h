@@ -14,7 +14,12 @@
 
 #pragma once
 
+#include "of_flow_completion.h"
+#include "of_group_mod.h"
 #include "of_message.h"
+#include "of_packet_in.h"
+#include "of_packet_out.h"
+#include "of_send_queue.h"
 
 #undef OFP_ASSERT
 #undef CONTAINER_OF
@@ -32,6 +37,7 @@
 
 #include <arpa/inet.h>
 #include <atomic>
+#include <shared_mutex>
 #include <vector>
 #include <chrono>
 #include <unistd.h>
@@ -39,6 +45,7 @@
 #include <thread>
 #include <pthread.h>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -60,12 +67,17 @@ public:
                  const int nthreads = 4,
                  bool secure = false) :
             xid(0),
+            bundle_id(0),
             switch_dpid_map(switch_dpid_map),
             port_id_map(port_id_map),
+            sweep_cancel(marl::Event::Mode::Manual),
             OFServer(address, port, nthreads, secure,
                      OFServerSettings()
                          .supported_version(4) // OF version 1 is OF 1.0 and version 4 is 1.3
-                         .echo_interval(30)) {
+                         .echo_interval(30)
+                         // packet-ins are handed to the packet handlers without a copy,
+                         // message_callback() frees the message buffers itself
+                         .keep_data_ownership(false)) {
                           }
 
     ~OFController() = default;
@@ -92,13 +104,46 @@ public:
 
     void execute_flow(const std::string br, const std::string flow_str, const std::string action = "add");
 
+    // same as above without going through the ofp text syntax
+    void execute_flow(const std::string br, const FlowBuilder& flow, const std::string action = "add");
+
+    // program the flow-mods in one ordered and atomic bundle, flow-mod i is
+    // flow (offset + i) of completion, if any
+    void execute_flow_bundle(const std::string br, const std::vector<ofmsg_ptr_t>& flow_mods,
+                             const flow_completion_ptr_t& completion = nullptr, size_t offset = 0);
+
+    // resolve completion once the switch has answered every message sent to br before
+    void execute_barrier(const std::string br, const flow_completion_ptr_t& completion);
+
+    /*
+     * program a group without going through the ofp text syntax. An insert
+     * bucket sends the buckets given and a remove bucket the ids of the
+     * buckets given, not the whole group, on a switch speaking OpenFlow 1.5.
+     * OpenFlow 1.3 has no bucket commands, the buckets the controller sent
+     * to the group are kept encoded and go out as a modify of the group.
+     * The group-mod is flow index of completion, if any.
+     */
+    void execute_group_mod(const std::string br, group_mod_command command, uint32_t group_id,
+                           uint8_t group_type, const std::vector<GroupBucket>& buckets,
+                           const flow_completion_ptr_t& completion = nullptr, size_t index = 0);
+
     void packet_out(const char* br, const char* opt);
 
+    // encode the packet-out straight from the frame, in_port is usually OF13_PORT_CONTROLLER
+    void packet_out(const char* br, uint32_t in_port, const uint8_t* packet, size_t len,
+                    const packet_out_actions_t& actions);
+
+    // send several packet-outs to a bridge with a single write
+    void packet_out(const char* br, const std::vector<PacketOutFrame>& frames);
+
 private:
 
     // tracking xid (ovs transaction id)
     std::atomic<uint32_t> xid;
 
+    // id of the next flow bundle
+    std::atomic<uint32_t> bundle_id;
+
     // k is bridge name like 'br-int', v is OFConnection* obj
     std::unordered_map<std::string, OFConnection*> switch_conn_map;
 
@@ -113,9 +158,82 @@ private:
 
     std::mutex switch_map_mutex;
 
-    void send_flow(OFConnection *ofconn, ofmsg_ptr_t &&p);
+    // flow-mods and barriers sent for a flow completion, waiting for their answer
+    FlowCompletionTracker flow_completions;
+
+    // flows of a bridge being dumped to reconcile them with the flow shadow
+    struct FlowDump {
+        std::string bridge;
+        // the first dump of the bridge since the controller started
+        bool first;
+        std::vector<DumpedFlow> flows;
+    };
+
+    // k is (ofconnection id << 32 | xid) of a flow stats request waiting for its last reply
+    std::unordered_map<uint64_t, FlowDump> flow_dumps;
+
+    // bridges dumped since the controller started
+    std::set<std::string> dumped_bridges;
+
+    std::mutex flow_dump_mutex;
+
+    // buckets of a group programmed by execute_group_mod
+    struct GroupState {
+        uint8_t type;
+        // k is the bucket id, v is the bucket encoded for OpenFlow 1.3
+        std::map<uint32_t, std::vector<uint8_t>> buckets;
+    };
+
+    // k is bridge name, v is the groups of the bridge by group id
+    std::unordered_map<std::string, std::unordered_map<uint32_t, GroupState>> groups;
+
+    // also keeps the group-mods of a group in the order of its bucket changes
+    std::mutex group_mutex;
+
+    // signaled when the controller stops, the sweeps waiting for their grace give up
+    marl::Event sweep_cancel;
+
+    // k is ofconnection id, v is the send queue of the connection, a queue is
+    // shut down with its connection and erased by the next add_send_queue once
+    // its flusher exited, the senders keep their reference until they are done
+    std::unordered_map<int, std::shared_ptr<OFSendQueue>> send_queues;
+
+    // shared by the senders looking up their queue
+    std::shared_mutex send_queue_mutex;
+
+    // create the send queue of a connection, the caller holds switch_map_mutex
+    void add_send_queue(OFConnection *ofconn);
+
+    // the flusher does not touch the connection anymore once it returned, the
+    // connection can be closed then
+    void shutdown_send_queue(OFConnection *ofconn);
+
+    // every message to a switch goes through here to keep them in order
+    void send_data(OFConnection *ofconn, void *data, size_t len);
+
+    void send_flow(OFConnection *ofconn, ofmsg_ptr_t &&p,
+                   const flow_completion_ptr_t &completion = nullptr, size_t index = 0);
 
     void send_packet_out(OFConnection *ofconn, ofbuf_ptr_t &&po);
 
-    void send_bundle_flow_mods(OFConnection *ofconn, std::vector<ofmsg_ptr_t> flow_mods);
+    void send_bundle_flow_mods(OFConnection *ofconn, std::vector<ofmsg_ptr_t> flow_mods,
+                               const flow_completion_ptr_t &completion = nullptr, size_t offset = 0);
+
+    // program flow_mods in as many bundles of g_ovs_flow_bundle_size (-x) as
+    // needed, one by one if it is 0
+    void execute_flow_bundles(const std::string br, const std::vector<ofmsg_ptr_t>& flow_mods);
+
+    // dump the flows with the agent cookie from a bridge which just connected
+    void dump_flows(OFConnection *ofconn, const std::string &bridge);
+
+    void on_flow_stats_reply(OFConnection *ofconn, void *data);
+
+    // the connection closed before its flow dumps finished
+    void drop_flow_dumps(int ofconn_id);
+
+    // diff the flows dumped from the bridge against the flow shadow, on a marl fiber
+    void reconcile_flows(const std::string bridge, bool first, std::vector<DumpedFlow> &flows);
+
+    // delete the flows found after a restart which no goal state programmed again
+    void sweep_flows(const std::string bridge, std::vector<ofmsg_ptr_t> &deletes);
 };
@@ -0,0 +1,660 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// the ports as ovs numbers them in a flow
+#define FLOW_PORT_IN_PORT 0xfff8
+#define FLOW_PORT_NORMAL 0xfffa
+#define FLOW_PORT_CONTROLLER 0xfffd
+#define FLOW_PORT_LOCAL 0xfffe
+#define FLOW_DEFAULT_PRIORITY 0x8000
+#define FLOW_ETH_TYPE_IP 0x0800
+#define FLOW_ETH_TYPE_ARP 0x0806
+#define FLOW_IP_PROTO_ICMP 1
+#define FLOW_IP_PROTO_TCP 6
+#define FLOW_IP_PROTO_UDP 17
+
+/*
+  A flow built field by field instead of being written in the ovs-ofctl
+  syntax, for example "table=20,priority=50,dl_vlan=2,dl_dst=<mac>,
+  actions=strip_vlan,output:100" is
+
+      FlowBuilder().table(20).priority(50).dl_vlan(2).dl_dst(mac)
+              .strip_vlan().output(100)
+
+  create_add_flow() and the other flow-mod helpers fill the ofputil_flow_mod
+  straight from it, the ovs flow parser never runs. The addresses and ports
+  given as strings are checked here, a malformed one leaves the flow invalid
+  and its flow-mod is logged and dropped, like a flow string which fails to
+  parse.
+*/
+class FlowBuilder {
+public:
+    enum match_field {
+        MATCH_IN_PORT = 1 << 0,
+        MATCH_DL_TYPE = 1 << 1,
+        MATCH_DL_VLAN = 1 << 2,
+        MATCH_DL_SRC = 1 << 3,
+        MATCH_DL_DST = 1 << 4,
+        MATCH_NW_PROTO = 1 << 5,
+        MATCH_NW_SRC = 1 << 6,
+        MATCH_NW_DST = 1 << 7,
+        MATCH_TP_SRC = 1 << 8,
+        MATCH_TP_DST = 1 << 9,
+        MATCH_TUN_ID = 1 << 10,
+    };
+
+    // the ip addresses and masks are in network byte order
+    struct Match {
+        uint32_t fields;
+        uint16_t in_port;
+        uint16_t dl_type;
+        uint16_t dl_vlan;
+        uint8_t dl_src[6];
+        uint8_t dl_src_mask[6];
+        uint8_t dl_dst[6];
+        uint8_t dl_dst_mask[6];
+        uint8_t nw_proto;
+        uint32_t nw_src;
+        uint32_t nw_src_mask;
+        uint32_t nw_dst;
+        uint32_t nw_dst_mask;
+        uint16_t tp_src;
+        uint16_t tp_dst;
+        uint64_t tun_id;
+    };
+
+    enum action_type {
+        ACTION_OUTPUT,              // output:<value>
+        ACTION_RESUBMIT,            // resubmit(,<value>)
+        ACTION_GROUP,               // group:<value>
+        ACTION_STRIP_VLAN,          // strip_vlan
+        ACTION_MOD_VLAN_VID,        // mod_vlan_vid:<value>
+        ACTION_MOD_DL_SRC,          // mod_dl_src:<mac>
+        ACTION_MOD_DL_DST,          // mod_dl_dst:<mac>
+        ACTION_MOD_NW_SRC,          // mod_nw_src:<value>
+        ACTION_MOD_NW_DST,          // mod_nw_dst:<value>
+        ACTION_LOAD_TUN_ID,         // load:<value>->NXM_NX_TUN_ID[]
+        ACTION_SET_TUN_DST,         // set_field:<value>->tun_dst
+        ACTION_LOAD_NW_TTL,         // load:<value>->NXM_NX_IP_TTL[]
+        ACTION_LOAD_ICMP_TYPE,      // load:<value>->NXM_OF_ICMP_TYPE[]
+        ACTION_MOVE_DL_SRC_TO_DST,  // move:NXM_OF_ETH_SRC[]->NXM_OF_ETH_DST[]
+        ACTION_MOVE_NW_SRC_TO_DST,  // move:NXM_OF_IP_SRC[]->NXM_OF_IP_DST[]
+    };
+
+    struct Action {
+        action_type type;
+        // port, table, group, vlan, tunnel id, ttl or icmp type,
+        // an ip address is in network byte order
+        uint64_t value;
+        uint8_t mac[6];
+    };
+
+    FlowBuilder() :
+            _valid(true),
+            _table_id(0),
+            _priority(FLOW_DEFAULT_PRIORITY),
+            _has_cookie(false),
+            _cookie(0),
+            _idle_timeout(0),
+            _hard_timeout(0) {
+        memset(&_match, 0, sizeof(_match));
+    }
+
+    FlowBuilder& table(uint8_t table_id) {
+        _table_id = table_id;
+        return *this;
+    }
+
+    FlowBuilder& priority(uint16_t priority) {
+        _priority = priority;
+        return *this;
+    }
+
+    // the cookie of the flow to add or modify, a cookie to match for a delete
+    FlowBuilder& cookie(uint64_t cookie) {
+        _has_cookie = true;
+        _cookie = cookie;
+        return *this;
+    }
+
+    FlowBuilder& idle_timeout(uint16_t seconds) {
+        _idle_timeout = seconds;
+        return *this;
+    }
+
+    FlowBuilder& hard_timeout(uint16_t seconds) {
+        _hard_timeout = seconds;
+        return *this;
+    }
+
+    // match fields
+
+    FlowBuilder& in_port(uint16_t port) {
+        _match.fields |= MATCH_IN_PORT;
+        _match.in_port = port;
+        return *this;
+    }
+
+    FlowBuilder& in_port(const std::string& port) {
+        uint16_t number;
+        _valid &= parse_port(port, number);
+        return in_port(number);
+    }
+
+    FlowBuilder& dl_type(uint16_t eth_type) {
+        _match.fields |= MATCH_DL_TYPE;
+        _match.dl_type = eth_type;
+        return *this;
+    }
+
+    FlowBuilder& ip() {
+        return dl_type(FLOW_ETH_TYPE_IP);
+    }
+
+    FlowBuilder& arp() {
+        return dl_type(FLOW_ETH_TYPE_ARP);
+    }
+
+    FlowBuilder& icmp() {
+        return ip().nw_proto(FLOW_IP_PROTO_ICMP);
+    }
+
+    FlowBuilder& tcp() {
+        return ip().nw_proto(FLOW_IP_PROTO_TCP);
+    }
+
+    FlowBuilder& udp() {
+        return ip().nw_proto(FLOW_IP_PROTO_UDP);
+    }
+
+    FlowBuilder& dl_vlan(uint16_t vlan_id) {
+        _match.fields |= MATCH_DL_VLAN;
+        _match.dl_vlan = vlan_id;
+        _valid &= vlan_id < 4096;
+        return *this;
+    }
+
+    // "<mac>" or "<mac>/<mask>"
+    FlowBuilder& dl_src(const std::string& mac) {
+        _match.fields |= MATCH_DL_SRC;
+        _valid &= parse_mac(mac, _match.dl_src, _match.dl_src_mask);
+        return *this;
+    }
+
+    FlowBuilder& dl_dst(const std::string& mac) {
+        _match.fields |= MATCH_DL_DST;
+        _valid &= parse_mac(mac, _match.dl_dst, _match.dl_dst_mask);
+        return *this;
+    }
+
+    FlowBuilder& nw_proto(uint8_t proto) {
+        _match.fields |= MATCH_NW_PROTO;
+        _match.nw_proto = proto;
+        return *this;
+    }
+
+    // "<ip>", "<ip>/<prefix length>" or "<ip>/<mask>"
+    FlowBuilder& nw_src(const std::string& ip) {
+        _match.fields |= MATCH_NW_SRC;
+        _valid &= parse_ip(ip, _match.nw_src, _match.nw_src_mask);
+        return *this;
+    }
+
+    FlowBuilder& nw_dst(const std::string& ip) {
+        _match.fields |= MATCH_NW_DST;
+        _valid &= parse_ip(ip, _match.nw_dst, _match.nw_dst_mask);
+        return *this;
+    }
+
+    FlowBuilder& tp_src(uint16_t port) {
+        _match.fields |= MATCH_TP_SRC;
+        _match.tp_src = port;
+        return *this;
+    }
+
+    FlowBuilder& tp_dst(uint16_t port) {
+        _match.fields |= MATCH_TP_DST;
+        _match.tp_dst = port;
+        return *this;
+    }
+
+    FlowBuilder& tun_id(uint64_t tunnel_id) {
+        _match.fields |= MATCH_TUN_ID;
+        _match.tun_id = tunnel_id;
+        return *this;
+    }
+
+    // actions, in the order they are added
+
+    FlowBuilder& output(uint16_t port) {
+        return add_action(ACTION_OUTPUT, port);
+    }
+
+    FlowBuilder& output(const std::string& port) {
+        uint16_t number;
+        _valid &= parse_port(port, number);
+        return output(number);
+    }
+
+    FlowBuilder& resubmit(uint8_t table_id) {
+        return add_action(ACTION_RESUBMIT, table_id);
+    }
+
+    FlowBuilder& group(uint32_t group_id) {
+        return add_action(ACTION_GROUP, group_id);
+    }
+
+    FlowBuilder& strip_vlan() {
+        return add_action(ACTION_STRIP_VLAN, 0);
+    }
+
+    // pushes a vlan header if the packet has none, like its ovs-ofctl namesake
+    FlowBuilder& mod_vlan_vid(uint16_t vlan_id) {
+        _valid &= vlan_id < 4096;
+        return add_action(ACTION_MOD_VLAN_VID, vlan_id);
+    }
+
+    FlowBuilder& mod_dl_src(const std::string& mac) {
+        return add_mac_action(ACTION_MOD_DL_SRC, mac);
+    }
+
+    FlowBuilder& mod_dl_dst(const std::string& mac) {
+        return add_mac_action(ACTION_MOD_DL_DST, mac);
+    }
+
+    FlowBuilder& mod_nw_src(const std::string& ip) {
+        return add_ip_action(ACTION_MOD_NW_SRC, ip);
+    }
+
+    FlowBuilder& mod_nw_dst(const std::string& ip) {
+        return add_ip_action(ACTION_MOD_NW_DST, ip);
+    }
+
+    FlowBuilder& load_tun_id(uint64_t tunnel_id) {
+        return add_action(ACTION_LOAD_TUN_ID, tunnel_id);
+    }
+
+    FlowBuilder& set_tun_dst(const std::string& ip) {
+        return add_ip_action(ACTION_SET_TUN_DST, ip);
+    }
+
+    FlowBuilder& load_nw_ttl(uint8_t ttl) {
+        return add_action(ACTION_LOAD_NW_TTL, ttl);
+    }
+
+    FlowBuilder& load_icmp_type(uint8_t icmp_type) {
+        return add_action(ACTION_LOAD_ICMP_TYPE, icmp_type);
+    }
+
+    FlowBuilder& move_dl_src_to_dst() {
+        return add_action(ACTION_MOVE_DL_SRC_TO_DST, 0);
+    }
+
+    FlowBuilder& move_nw_src_to_dst() {
+        return add_action(ACTION_MOVE_NW_SRC_TO_DST, 0);
+    }
+
+    // false if an address or a value given to the builder was malformed
+    bool valid() const {
+        return _valid;
+    }
+
+    uint8_t table_id() const {
+        return _table_id;
+    }
+
+    uint16_t priority() const {
+        return _priority;
+    }
+
+    bool has_cookie() const {
+        return _has_cookie;
+    }
+
+    uint64_t cookie() const {
+        return _cookie;
+    }
+
+    uint16_t idle_timeout() const {
+        return _idle_timeout;
+    }
+
+    uint16_t hard_timeout() const {
+        return _hard_timeout;
+    }
+
+    const Match& match() const {
+        return _match;
+    }
+
+    const std::vector<Action>& actions() const {
+        return _actions;
+    }
+
+    /*
+     * the flow in the ovs-ofctl syntax, to log it or to hand it to the text
+     * based helpers. A flow to delete has to leave its actions out.
+     */
+    std::string to_string(bool with_actions = true) const {
+        std::string flow = "table=" + std::to_string(_table_id) +
+                           ",priority=" + std::to_string(_priority);
+        if (_has_cookie) {
+            // a flow to delete matches its cookie
+            flow += ",cookie=" + hex_string(_cookie) + (with_actions ? "" : "/-1");
+        }
+        if (_idle_timeout != 0) {
+            flow += ",idle_timeout=" + std::to_string(_idle_timeout);
+        }
+        if (_hard_timeout != 0) {
+            flow += ",hard_timeout=" + std::to_string(_hard_timeout);
+        }
+        append_match(flow);
+
+        if (!with_actions) {
+            return flow;
+        }
+        flow += ",actions=";
+        append_actions(flow);
+        return flow;
+    }
+
+    // table, priority and match fields, what tells a flow of a table from another
+    std::string match_string() const {
+        std::string flow = "table=" + std::to_string(_table_id) +
+                           ",priority=" + std::to_string(_priority);
+        append_match(flow);
+        return flow;
+    }
+
+    std::string actions_string() const {
+        std::string actions;
+        append_actions(actions);
+        return actions;
+    }
+
+private:
+    void append_match(std::string& flow) const {
+        const Match& m = _match;
+        if (m.fields & MATCH_DL_TYPE) {
+            bool is_ip = m.dl_type == FLOW_ETH_TYPE_IP;
+            if (is_ip && (m.fields & MATCH_NW_PROTO) && m.nw_proto == FLOW_IP_PROTO_ICMP) {
+                flow += ",icmp";
+            } else if (is_ip && (m.fields & MATCH_NW_PROTO) && m.nw_proto == FLOW_IP_PROTO_TCP) {
+                flow += ",tcp";
+            } else if (is_ip && (m.fields & MATCH_NW_PROTO) && m.nw_proto == FLOW_IP_PROTO_UDP) {
+                flow += ",udp";
+            } else if (is_ip) {
+                flow += ",ip";
+            } else if (m.dl_type == FLOW_ETH_TYPE_ARP) {
+                flow += ",arp";
+            } else {
+                flow += ",dl_type=" + hex_string(m.dl_type);
+            }
+        }
+        if ((m.fields & MATCH_NW_PROTO) &&
+            !(m.dl_type == FLOW_ETH_TYPE_IP && (m.nw_proto == FLOW_IP_PROTO_ICMP ||
+                                                 m.nw_proto == FLOW_IP_PROTO_TCP ||
+                                                 m.nw_proto == FLOW_IP_PROTO_UDP))) {
+            flow += ",nw_proto=" + std::to_string(m.nw_proto);
+        }
+        if (m.fields & MATCH_IN_PORT) {
+            flow += ",in_port=" + port_string(m.in_port);
+        }
+        if (m.fields & MATCH_TUN_ID) {
+            flow += ",tun_id=" + std::to_string(m.tun_id);
+        }
+        if (m.fields & MATCH_DL_VLAN) {
+            flow += ",dl_vlan=" + std::to_string(m.dl_vlan);
+        }
+        if (m.fields & MATCH_DL_SRC) {
+            flow += ",dl_src=" + mac_string(m.dl_src, m.dl_src_mask);
+        }
+        if (m.fields & MATCH_DL_DST) {
+            flow += ",dl_dst=" + mac_string(m.dl_dst, m.dl_dst_mask);
+        }
+        if (m.fields & MATCH_NW_SRC) {
+            flow += ",nw_src=" + ip_string(m.nw_src, m.nw_src_mask);
+        }
+        if (m.fields & MATCH_NW_DST) {
+            flow += ",nw_dst=" + ip_string(m.nw_dst, m.nw_dst_mask);
+        }
+        // ovs-ofctl names the transport ports after the protocol
+        std::string tp = "tp";
+        if (m.nw_proto == FLOW_IP_PROTO_TCP) {
+            tp = "tcp";
+        } else if (m.nw_proto == FLOW_IP_PROTO_UDP) {
+            tp = "udp";
+        }
+        if (m.fields & MATCH_TP_SRC) {
+            flow += "," + tp + "_src=" + std::to_string(m.tp_src);
+        }
+        if (m.fields & MATCH_TP_DST) {
+            flow += "," + tp + "_dst=" + std::to_string(m.tp_dst);
+        }
+
+    }
+
+    void append_actions(std::string& flow) const {
+        if (_actions.empty()) {
+            flow += "drop";
+        }
+        for (size_t i = 0; i < _actions.size(); i++) {
+            const Action& a = _actions[i];
+            if (i > 0) {
+                flow += ",";
+            }
+            switch (a.type) {
+            case ACTION_OUTPUT:
+                flow += "output:" + port_string(a.value);
+                break;
+            case ACTION_RESUBMIT:
+                flow += "resubmit(," + std::to_string(a.value) + ")";
+                break;
+            case ACTION_GROUP:
+                flow += "group:" + std::to_string(a.value);
+                break;
+            case ACTION_STRIP_VLAN:
+                flow += "strip_vlan";
+                break;
+            case ACTION_MOD_VLAN_VID:
+                flow += "mod_vlan_vid:" + std::to_string(a.value);
+                break;
+            case ACTION_MOD_DL_SRC:
+                flow += "mod_dl_src:" + mac_string(a.mac, nullptr);
+                break;
+            case ACTION_MOD_DL_DST:
+                flow += "mod_dl_dst:" + mac_string(a.mac, nullptr);
+                break;
+            case ACTION_MOD_NW_SRC:
+                flow += "mod_nw_src:" + ip_string(a.value, 0xffffffff);
+                break;
+            case ACTION_MOD_NW_DST:
+                flow += "mod_nw_dst:" + ip_string(a.value, 0xffffffff);
+                break;
+            case ACTION_LOAD_TUN_ID:
+                flow += "load:" + std::to_string(a.value) + "->NXM_NX_TUN_ID[]";
+                break;
+            case ACTION_SET_TUN_DST:
+                flow += "set_field:" + ip_string(a.value, 0xffffffff) + "->tun_dst";
+                break;
+            case ACTION_LOAD_NW_TTL:
+                flow += "load:" + std::to_string(a.value) + "->NXM_NX_IP_TTL[]";
+                break;
+            case ACTION_LOAD_ICMP_TYPE:
+                flow += "load:" + std::to_string(a.value) + "->NXM_OF_ICMP_TYPE[]";
+                break;
+            case ACTION_MOVE_DL_SRC_TO_DST:
+                flow += "move:NXM_OF_ETH_SRC[]->NXM_OF_ETH_DST[]";
+                break;
+            case ACTION_MOVE_NW_SRC_TO_DST:
+                flow += "move:NXM_OF_IP_SRC[]->NXM_OF_IP_DST[]";
+                break;
+            }
+        }
+    }
+
+    FlowBuilder& add_action(action_type type, uint64_t value) {
+        Action action;
+        action.type = type;
+        action.value = value;
+        memset(action.mac, 0, sizeof(action.mac));
+        _actions.push_back(action);
+        return *this;
+    }
+
+    FlowBuilder& add_mac_action(action_type type, const std::string& mac) {
+        add_action(type, 0);
+        uint8_t mask[6];
+        _valid &= parse_mac(mac, _actions.back().mac, mask) && is_exact_mask(mask, 6);
+        return *this;
+    }
+
+    FlowBuilder& add_ip_action(action_type type, const std::string& ip) {
+        uint32_t addr = 0;
+        uint32_t mask = 0;
+        _valid &= parse_ip(ip, addr, mask) && mask == 0xffffffff;
+        return add_action(type, addr);
+    }
+
+    static bool is_exact_mask(const uint8_t* mask, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            if (mask[i] != 0xff) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool parse_port(const std::string& port, uint16_t& number) {
+        char* end = nullptr;
+        unsigned long value = strtoul(port.c_str(), &end, 10);
+        number = (uint16_t)value;
+        return !port.empty() && *end == '\0' && value <= 0xffff;
+    }
+
+    // "<mac>" or "<mac>/<mask>", the mac is masked like ovs does
+    static bool parse_mac(const std::string& str, uint8_t* mac, uint8_t* mask) {
+        int consumed = 0;
+        if (sscanf(str.c_str(), "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx%n", &mac[0], &mac[1],
+                   &mac[2], &mac[3], &mac[4], &mac[5], &consumed) != 6) {
+            return false;
+        }
+        memset(mask, 0xff, 6);
+        const char* rest = str.c_str() + consumed;
+        if (*rest == '/') {
+            int mask_consumed = 0;
+            if (sscanf(rest + 1, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx%n", &mask[0], &mask[1],
+                       &mask[2], &mask[3], &mask[4], &mask[5], &mask_consumed) != 6) {
+                return false;
+            }
+            rest += 1 + mask_consumed;
+        }
+        for (int i = 0; i < 6; i++) {
+            mac[i] &= mask[i];
+        }
+        return *rest == '\0';
+    }
+
+    // "<ip>", "<ip>/<prefix length>" or "<ip>/<mask>", the ip is masked like ovs does
+    static bool parse_ip(const std::string& str, uint32_t& ip, uint32_t& mask) {
+        size_t slash = str.find('/');
+        struct in_addr addr;
+
+        // inet_pton returns 1 for success 0 for failure
+        if (inet_pton(AF_INET, str.substr(0, slash).c_str(), &addr) != 1) {
+            return false;
+        }
+        ip = addr.s_addr;
+        mask = 0xffffffff;
+        if (slash != std::string::npos) {
+            std::string mask_str = str.substr(slash + 1);
+            if (inet_pton(AF_INET, mask_str.c_str(), &addr) == 1) {
+                mask = addr.s_addr;
+            } else {
+                char* end = nullptr;
+                unsigned long prefix_len = strtoul(mask_str.c_str(), &end, 10);
+                if (mask_str.empty() || *end != '\0' || prefix_len > 32) {
+                    return false;
+                }
+                mask = prefix_len == 0 ? 0 : htonl(0xffffffffu << (32 - prefix_len));
+            }
+        }
+        ip &= mask;
+        return true;
+    }
+
+    static std::string hex_string(uint64_t value) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)value);
+        return buf;
+    }
+
+    static std::string port_string(uint64_t port) {
+        switch (port) {
+        case FLOW_PORT_IN_PORT:
+            return "IN_PORT";
+        case FLOW_PORT_NORMAL:
+            return "NORMAL";
+        case FLOW_PORT_CONTROLLER:
+            return "CONTROLLER";
+        case FLOW_PORT_LOCAL:
+            return "LOCAL";
+        default:
+            return std::to_string(port);
+        }
+    }
+
+    static std::string mac_string(const uint8_t* mac, const uint8_t* mask) {
+        char buf[40];
+        int len = snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+                           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        if (mask != nullptr && !is_exact_mask(mask, 6)) {
+            snprintf(buf + len, sizeof(buf) - len, "/%02x:%02x:%02x:%02x:%02x:%02x",
+                     mask[0], mask[1], mask[2], mask[3], mask[4], mask[5]);
+        }
+        return buf;
+    }
+
+    static std::string ip_string(uint32_t ip, uint32_t mask) {
+        char buf[INET_ADDRSTRLEN];
+        struct in_addr addr;
+        addr.s_addr = ip;
+        std::string str = inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+        if (mask != 0xffffffff) {
+            addr.s_addr = mask;
+            str += "/" + std::string(inet_ntop(AF_INET, &addr, buf, sizeof(buf)));
+        }
+        return str;
+    }
+
+    bool _valid;
+    uint8_t _table_id;
+    uint16_t _priority;
+    bool _has_cookie;
+    uint64_t _cookie;
+    uint16_t _idle_timeout;
+    uint16_t _hard_timeout;
+    Match _match;
+    std::vector<Action> _actions;
+};
@@ -0,0 +1,193 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// OpenFlow 1.3 messages the completion of the flow-mods is read from
+#define OF13_HEADER_LEN 8
+#define OF13_ERROR_TYPE 1
+#define OF13_BARRIER_REQUEST_TYPE 20
+#define OF13_BARRIER_REPLY_TYPE 21
+
+// errors of the flow-mods the switch never answered, an OpenFlow error is
+// reported as (type << 16 | code)
+#define FLOW_ERROR_NO_CONNECTION 0xffff0001
+#define FLOW_ERROR_CONNECTION_CLOSED 0xffff0002
+#define FLOW_ERROR_MALFORMED 0xffff0003
+#define FLOW_ERROR_EXPIRED 0xffff0004
+
+// requests not answered by then are forgotten, well after their waiters gave up
+#define FLOW_COMPLETION_EXPIRY_IN_MICROSECONDS (30 * 1000 * 1000)
+
+/*
+  Outcome of flow-mods sent to a switch and awaited together. A flow-mod the
+  switch rejected is failed by the OFPT_ERROR answering it, the barrier sent
+  after the last flow-mod resolves all the others as applied, so awaiting any
+  number of flows costs one barrier round trip.
+*/
+class FlowCompletion {
+public:
+    explicit FlowCompletion(size_t flows) :
+            _done(false),
+            _failed(0),
+            _errors(flows, 0) { }
+
+    // compiler will flag the error when below is called.
+    FlowCompletion(FlowCompletion const &) = delete;
+    void operator=(FlowCompletion const &) = delete;
+
+    size_t size() const {
+        return _errors.size();
+    }
+
+    // false if the completion is not resolved within timeout
+    bool wait_for(std::chrono::microseconds timeout);
+
+    bool done();
+
+    // error of a flow, 0 if it was applied or is not answered yet
+    uint32_t error(size_t index);
+
+    // number of flows failed so far
+    size_t failed();
+
+    // fails a flow, a flow keeps the first error it got
+    void fail(size_t index, uint32_t error);
+
+    // fails flows [begin, end) not failed yet
+    void fail(size_t begin, size_t end, uint32_t error);
+
+    // the flows not failed so far are applied
+    void resolve();
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _done;
+    size_t _failed;
+    std::vector<uint32_t> _errors;
+};
+
+typedef std::shared_ptr<FlowCompletion> flow_completion_ptr_t;
+
+/*
+  Requests of the flow completions waiting for an answer, keyed by connection
+  and xid. The controller registers a request before sending it and hands the
+  OFPT_ERROR and OFPT_BARRIER_REPLY messages it receives to on_message().
+  A completion whose barrier is not answered within expiry of its first
+  request is failed with FLOW_ERROR_EXPIRED and its requests are forgotten.
+*/
+class FlowCompletionTracker {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    explicit FlowCompletionTracker(
+            std::chrono::microseconds expiry = std::chrono::microseconds(FLOW_COMPLETION_EXPIRY_IN_MICROSECONDS)) :
+            _expiry(expiry),
+            _next_sequence(0) { }
+
+    // compiler will flag the error when below is called.
+    FlowCompletionTracker(FlowCompletionTracker const &) = delete;
+    void operator=(FlowCompletionTracker const &) = delete;
+
+    // an error to the request xid fails flows [begin, end) of completion,
+    // a flow-mod covers its own flow, a bundle commit all the flows of the bundle
+    void add_flows(int conn_id, uint32_t xid, const flow_completion_ptr_t& completion,
+                   size_t begin, size_t end);
+
+    void add_flow(int conn_id, uint32_t xid, const flow_completion_ptr_t& completion, size_t index) {
+        add_flows(conn_id, xid, completion, index, index + 1);
+    }
+
+    // the reply to the barrier xid resolves completion
+    void add_barrier(int conn_id, uint32_t xid, const flow_completion_ptr_t& completion);
+
+    /*
+     * handle a message received on a connection.
+     * Return:
+     *    true if it answered a tracked request
+     */
+    bool on_message(int conn_id, const void* data, size_t len);
+
+    // the connection is gone, its requests will never be answered
+    void close_connection(int conn_id);
+
+    /*
+     * forget the completions not answered within expiry, registering a
+     * request expires them too.
+     * Return:
+     *    number of completions expired
+     */
+    size_t expire(time_point now = std::chrono::steady_clock::now());
+
+    // requests waiting for an answer
+    size_t pending();
+
+    static uint32_t read_xid(const void* data);
+
+    static void encode_barrier_request(uint8_t (&buf)[OF13_HEADER_LEN], uint32_t xid);
+
+private:
+    struct Request {
+        flow_completion_ptr_t completion;
+        size_t begin;
+        size_t end;
+        bool barrier;
+    };
+
+    struct CompletionKeys {
+        // tells a completion from a later one at the same address
+        uint64_t sequence;
+        std::vector<uint64_t> keys;
+    };
+
+    struct CompletionOrder {
+        time_point added;
+        uint64_t sequence;
+        const FlowCompletion* completion;
+    };
+
+    static uint64_t get_key(int conn_id, uint32_t xid) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(conn_id)) << 32) | xid;
+    }
+
+    void add(int conn_id, uint32_t xid, const Request& request);
+
+    // forget the requests of a completion, the caller holds _mutex
+    void remove(const FlowCompletion* completion);
+
+    // forget the completions expired by now, the caller holds _mutex
+    void take_expired(time_point now, std::vector<flow_completion_ptr_t>& expired);
+
+    static void fail_expired(const std::vector<flow_completion_ptr_t>& expired);
+
+    const std::chrono::microseconds _expiry;
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, Request> _requests;
+    // keys of the requests of each completion
+    std::unordered_map<const FlowCompletion*, CompletionKeys> _completion_keys;
+    // completions in the order of their first request, the ones already
+    // answered are dropped as they reach the front
+    std::deque<CompletionOrder> _completion_order;
+    uint64_t _next_sequence;
+};
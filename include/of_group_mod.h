@@ -0,0 +1,263 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include "of_flow_builder.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenFlow group-mod layout, see struct ofp11_group_mod and struct ofp15_group_mod
+#define OF13_GROUP_VERSION 4
+#define OF15_GROUP_VERSION 6
+#define OF_GROUP_MOD_TYPE 15
+#define OF13_GROUP_MOD_HEADER_LEN 16
+#define OF15_GROUP_MOD_HEADER_LEN 24
+// struct ofp11_bucket and struct ofp15_bucket, without their actions
+#define OF13_BUCKET_HEADER_LEN 16
+#define OF15_BUCKET_HEADER_LEN 8
+// the weight property of an OpenFlow 1.5 bucket, padded to 8 bytes
+#define OF15_BUCKET_PROP_WEIGHT 0
+#define OF15_BUCKET_PROP_WEIGHT_LEN 6
+#define OF_GROUP_TYPE_ALL 0
+#define OF_GROUP_TYPE_SELECT 1
+#define OF_GROUP_ANY 0xffffffff
+#define OF_GROUP_PORT_ANY 0xffffffff
+// command_bucket_id of an OpenFlow 1.5 group-mod
+#define OF15_BUCKET_ID_MAX 0xffffff00
+#define OF15_BUCKET_ID_LAST 0xfffffffe
+#define OF15_BUCKET_ID_ALL 0xffffffff
+// bucket actions
+#define OF_GROUP_ACTION_OUTPUT 0
+#define OF_GROUP_ACTION_SET_FIELD 25
+#define OF_GROUP_ACTION_OUTPUT_LEN 16
+// the oxm headers of the fields a bucket sets
+#define OXM_ETH_DST 0x80000606
+#define OXM_ETH_SRC 0x80000806
+#define OXM_IPV4_SRC 0x80001604
+#define OXM_IPV4_DST 0x80001804
+#define OXM_TUNNEL_ID 0x80004c08
+#define NXM_TUN_IPV4_DST 0x00014004
+
+enum group_mod_command {
+    GROUP_MOD_ADD = 0,
+    GROUP_MOD_MODIFY = 1,
+    GROUP_MOD_DELETE = 2,
+    // OpenFlow 1.5 only, the buckets are added after the ones of the group
+    GROUP_MOD_INSERT_BUCKET = 3,
+    // OpenFlow 1.5 only, the buckets with the ids given are removed
+    GROUP_MOD_REMOVE_BUCKET = 5,
+};
+
+/*
+  A bucket of a group, its actions are the ones of a FlowBuilder, like
+
+      GroupBucket(1, FlowBuilder().set_tun_dst(ip).mod_dl_dst(mac).output(100))
+
+  for "bucket=bucket_id:1,actions=set_field:<ip>->tun_dst,mod_dl_dst:<mac>,
+  output:100" in the ovs-ofctl syntax. The match of the FlowBuilder is not
+  used. OpenFlow 1.3 has no bucket ids, a switch numbers the buckets itself.
+*/
+struct GroupBucket {
+    GroupBucket() : bucket_id(0) { }
+
+    GroupBucket(uint32_t bucket_id, const FlowBuilder& actions) :
+            bucket_id(bucket_id),
+            actions(actions) { }
+
+    uint32_t bucket_id;
+    FlowBuilder actions;
+};
+
+inline void group_mod_write16(uint8_t* p, uint16_t v) {
+    v = htons(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+inline void group_mod_write32(uint8_t* p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// a set-field action with value in network byte order, padded to 8 bytes
+inline void encode_group_set_field(std::vector<uint8_t>& out, uint32_t oxm_header,
+                                   const void* value, size_t len) {
+    size_t action_len = (4 + 4 + len + 7) / 8 * 8;
+    size_t offset = out.size();
+    out.resize(offset + action_len, 0);
+    uint8_t* p = out.data() + offset;
+    group_mod_write16(p, OF_GROUP_ACTION_SET_FIELD);
+    group_mod_write16(p + 2, action_len);
+    group_mod_write32(p + 4, oxm_header);
+    memcpy(p + 8, value, len);
+}
+
+/*
+ * append the actions of a bucket to out, they are the same in OpenFlow 1.3
+ * and 1.5.
+ * Return:
+ *    false if the FlowBuilder is malformed or has an action a bucket can't
+ *    have here, out is unchanged then
+ */
+inline bool encode_group_bucket_actions(std::vector<uint8_t>& out, const FlowBuilder& actions) {
+    if (!actions.valid()) {
+        return false;
+    }
+
+    size_t offset = out.size();
+    for (auto& a : actions.actions()) {
+        uint32_t ip = (uint32_t)a.value;
+        uint64_t tunnel_id = htobe64(a.value);
+
+        switch (a.type) {
+            case FlowBuilder::ACTION_OUTPUT: {
+                size_t action_offset = out.size();
+                out.resize(action_offset + OF_GROUP_ACTION_OUTPUT_LEN, 0);
+                uint8_t* p = out.data() + action_offset;
+                group_mod_write16(p, OF_GROUP_ACTION_OUTPUT);
+                group_mod_write16(p + 2, OF_GROUP_ACTION_OUTPUT_LEN);
+                group_mod_write32(p + 4, a.value >= 0xff00 ? 0xffff0000 | a.value : a.value);
+                // max_len only matters for the packets sent to the controller
+                group_mod_write16(p + 8, a.value == FLOW_PORT_CONTROLLER ? 0xffff : 0);
+                break;
+            }
+            case FlowBuilder::ACTION_MOD_DL_SRC:
+                encode_group_set_field(out, OXM_ETH_SRC, a.mac, 6);
+                break;
+            case FlowBuilder::ACTION_MOD_DL_DST:
+                encode_group_set_field(out, OXM_ETH_DST, a.mac, 6);
+                break;
+            case FlowBuilder::ACTION_MOD_NW_SRC:
+                encode_group_set_field(out, OXM_IPV4_SRC, &ip, 4);
+                break;
+            case FlowBuilder::ACTION_MOD_NW_DST:
+                encode_group_set_field(out, OXM_IPV4_DST, &ip, 4);
+                break;
+            case FlowBuilder::ACTION_SET_TUN_DST:
+                encode_group_set_field(out, NXM_TUN_IPV4_DST, &ip, 4);
+                break;
+            case FlowBuilder::ACTION_LOAD_TUN_ID:
+                encode_group_set_field(out, OXM_TUNNEL_ID, &tunnel_id, 8);
+                break;
+            default:
+                out.resize(offset);
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * append a bucket of a group of group_type to out, in the layout of the
+ * OpenFlow version. A bucket of a select group has a weight of 1, like
+ * ovs-ofctl gives it.
+ * Return:
+ *    false if its actions can't be encoded, out is unchanged then
+ */
+inline bool encode_group_bucket(std::vector<uint8_t>& out, uint8_t version, uint8_t group_type,
+                                const GroupBucket& bucket) {
+    size_t offset = out.size();
+    size_t header_len = version >= OF15_GROUP_VERSION ? OF15_BUCKET_HEADER_LEN : OF13_BUCKET_HEADER_LEN;
+    out.resize(offset + header_len, 0);
+    if (!encode_group_bucket_actions(out, bucket.actions)) {
+        out.resize(offset);
+        return false;
+    }
+    size_t actions_len = out.size() - offset - header_len;
+    uint16_t weight = group_type == OF_GROUP_TYPE_SELECT ? 1 : 0;
+
+    if (version >= OF15_GROUP_VERSION) {
+        // the properties follow the actions
+        if (group_type == OF_GROUP_TYPE_SELECT) {
+            size_t prop_offset = out.size();
+            out.resize(prop_offset + 8, 0);
+            group_mod_write16(out.data() + prop_offset, OF15_BUCKET_PROP_WEIGHT);
+            group_mod_write16(out.data() + prop_offset + 2, OF15_BUCKET_PROP_WEIGHT_LEN);
+            group_mod_write16(out.data() + prop_offset + 4, weight);
+        }
+        uint8_t* p = out.data() + offset;
+        group_mod_write16(p, out.size() - offset);
+        group_mod_write16(p + 2, actions_len);
+        group_mod_write32(p + 4, bucket.bucket_id);
+    } else {
+        uint8_t* p = out.data() + offset;
+        group_mod_write16(p, out.size() - offset);
+        group_mod_write16(p + 2, weight);
+        group_mod_write32(p + 4, OF_GROUP_PORT_ANY);
+        group_mod_write32(p + 8, OF_GROUP_ANY);
+    }
+    return true;
+}
+
+/*
+ * append a group-mod to out, its buckets already encoded for the version
+ * by encode_group_bucket(). command_bucket_id is only in OpenFlow 1.5, the
+ * bucket an insert goes after or the one a remove takes out.
+ * Return:
+ *    false if the version has no such command or the message does not fit
+ *    in the 16 bits length, out is unchanged then
+ */
+inline bool encode_group_mod(std::vector<uint8_t>& out, uint8_t version, uint32_t xid,
+                             group_mod_command command, uint8_t group_type, uint32_t group_id,
+                             const uint8_t* buckets, size_t buckets_len,
+                             uint32_t command_bucket_id = OF15_BUCKET_ID_ALL) {
+    bool of15 = version >= OF15_GROUP_VERSION;
+    if (!of15 && (command == GROUP_MOD_INSERT_BUCKET || command == GROUP_MOD_REMOVE_BUCKET)) {
+        return false;
+    }
+    size_t header_len = of15 ? OF15_GROUP_MOD_HEADER_LEN : OF13_GROUP_MOD_HEADER_LEN;
+    size_t msg_len = header_len + buckets_len;
+    if (msg_len > 0xffff) {
+        return false;
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + msg_len, 0);
+    uint8_t* msg = out.data() + offset;
+
+    // header
+    msg[0] = version;
+    msg[1] = OF_GROUP_MOD_TYPE;
+    group_mod_write16(msg + 2, msg_len);
+    group_mod_write32(msg + 4, xid);
+    // command, type, 1 byte of padding and group_id
+    group_mod_write16(msg + 8, command);
+    msg[10] = group_type;
+    group_mod_write32(msg + 12, group_id);
+    if (of15) {
+        // bucket_array_len, 2 bytes of padding and command_bucket_id
+        group_mod_write16(msg + 16, buckets_len);
+        group_mod_write32(msg + 20, command_bucket_id);
+    }
+    if (buckets_len > 0) {
+        memcpy(msg + header_len, buckets, buckets_len);
+    }
+    return true;
+}
+
+// same as above with the buckets encoded on the way
+inline bool encode_group_mod(std::vector<uint8_t>& out, uint8_t version, uint32_t xid,
+                             group_mod_command command, uint8_t group_type, uint32_t group_id,
+                             const std::vector<GroupBucket>& buckets,
+                             uint32_t command_bucket_id = OF15_BUCKET_ID_ALL) {
+    std::vector<uint8_t> encoded_buckets;
+    for (auto& bucket : buckets) {
+        if (!encode_group_bucket(encoded_buckets, version, group_type, bucket)) {
+            return false;
+        }
+    }
+    return encode_group_mod(out, version, xid, command, group_type, group_id,
+                            encoded_buckets.data(), encoded_buckets.size(), command_bucket_id);
+}
@@ -13,6 +13,7 @@
 //     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
+#include "of_flow_builder.h"
 #include <atomic>
 #include <cstdint>
 #include <memory>
@@ -42,9 +43,11 @@ typedef std::shared_ptr<OFRawBuf> ofbuf_ptr_t;
 
 class BundleFlowModMessage {
 public:
-    BundleFlowModMessage(const std::vector<ofmsg_ptr_t> flow_mods, std::atomic<uint32_t>* fm_xid) :
-            _flow_mods(flow_mods),
-            _fm_xid(fm_xid) { }
+    BundleFlowModMessage(const std::vector<ofmsg_ptr_t> flow_mods, uint32_t bundle_id,
+                         std::atomic<uint32_t>* fm_xid) :
+            _bundle_id(bundle_id),
+            _fm_xid(fm_xid),
+            _flow_mods(flow_mods) { }
 
     ~BundleFlowModMessage() = default;
 
@@ -54,10 +57,11 @@ public:
 
     std::shared_ptr<OFRawBuf> pack_open_req();
     std::shared_ptr<OFRawBuf> pack_commit_req();
+    // one buffer per flow-mod, nullptr for a flow-mod which failed to pack
     std::vector<std::shared_ptr<OFRawBuf> > pack_flow_mods();
 
 private:
-    // bundle_id is generated from BundleCtrlMessage->pack()
+    // chosen by the caller, unique among the bundles open on the connection
     uint32_t _bundle_id;
     // starting x_id (auto increased for each message in this bundle, so all unique)
     // need to sync auto increased value with caller for overall OF msg xid management
@@ -80,7 +84,8 @@ public:
         return _type;
     }
 
-    void unpack(void* data);
+    // false if the message is not a bundle control reply
+    bool unpack(void* data);
 
 private:
     uint32_t _bundle_id;
@@ -92,4 +97,33 @@ ofmsg_ptr_t create_add_flow(const std::string& flow, bool bundle = false);
 ofmsg_ptr_t create_mod_flow(const std::string& flow, bool strict);
 ofmsg_ptr_t create_del_flow(const std::string& match, bool strict);
 std::vector<ofmsg_ptr_t> create_add_flows(const std::vector<std::string>& flows, bool bundle = false);
-ofbuf_ptr_t create_packet_out(const char* option);
\ No newline at end of file
+// flow-mods of a FlowBuilder, encoded without going through the ofp text syntax
+ofmsg_ptr_t create_add_flow(const FlowBuilder& flow);
+ofmsg_ptr_t create_mod_flow(const FlowBuilder& flow, bool strict);
+ofmsg_ptr_t create_del_flow(const FlowBuilder& flow, bool strict);
+// flow-mod of an "add", "mod" (strict) or "del" (strict) action, nullptr for any other action
+ofmsg_ptr_t create_flow_mod(const std::string& flow, const std::string& action);
+ofmsg_ptr_t create_flow_mod(const FlowBuilder& flow, const std::string& action);
+ofbuf_ptr_t create_packet_out(const char* option);
+
+// a flow of a flow stats reply
+struct DumpedFlow {
+    // the flow with its cookie, if decoded
+    FlowBuilder flow;
+    // false if the flow has a match field or an action FlowBuilder doesn't have
+    bool decoded;
+    // strict delete of the flow with its cookie, when it was not decoded
+    ofmsg_ptr_t delete_flow_mod;
+};
+
+// flow stats request for the flows of every table whose cookie matches cookie/cookie_mask
+ofmsg_ptr_t create_flow_stats_request(uint64_t cookie, uint64_t cookie_mask);
+
+/*
+ * decode a flow stats reply, the flows without a timeout are appended to flows.
+ * Output:
+ *    bool &more: more replies follow for the same request
+ * Return:
+ *    false if the message is not a flow stats reply or is malformed
+ */
+bool decode_flow_stats_reply(void* data, std::vector<DumpedFlow>& flows, bool& more);
\ No newline at end of file
@@ -0,0 +1,179 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <functional>
+#include <memory>
+
+// OpenFlow 1.3 packet-in layout, see struct ofp_packet_in
+#define OF13_PACKET_IN_TYPE 10
+#define OF13_PACKET_IN_MATCH_OFFSET 24
+#define OF13_OXM_CLASS_OPENFLOW_BASIC 0x8000
+#define OF13_OXM_FIELD_IN_PORT 0
+
+/*
+  Read-only view over an OpenFlow 1.3 packet-in message, as received from the
+  switch. The message buffer is borrowed from the connection and handed back
+  through the release callback when the last reference to the view is gone.
+  The fixed fields and the in_port are decoded once, the ethernet frame is
+  never copied.
+*/
+class PacketInView {
+public:
+    typedef std::function<void(void*)> release_fn_t;
+
+    /*
+     * decode a packet-in message, the view takes the ownership of data.
+     * Return:
+     *    nullptr if the message is malformed, data is released then
+     */
+    static std::shared_ptr<const PacketInView> create(void* data, size_t len, release_fn_t release) {
+        std::shared_ptr<PacketInView> view(new PacketInView(data, release));
+        if (!view->decode(len)) {
+            return nullptr;
+        }
+        return view;
+    }
+
+    ~PacketInView() {
+        if (_release) {
+            _release(_data);
+        }
+    }
+
+    // compiler will flag the error when below is called.
+    PacketInView(PacketInView const &) = delete;
+    void operator=(PacketInView const &) = delete;
+
+    uint32_t in_port() const {
+        return _in_port;
+    }
+
+    uint64_t cookie() const {
+        return _cookie;
+    }
+
+    uint8_t table_id() const {
+        return _table_id;
+    }
+
+    uint8_t reason() const {
+        return _reason;
+    }
+
+    uint32_t buffer_id() const {
+        return _buffer_id;
+    }
+
+    const uint8_t* frame() const {
+        return _frame;
+    }
+
+    size_t frame_len() const {
+        return _frame_len;
+    }
+
+private:
+    PacketInView(void* data, release_fn_t release) :
+            _data(data),
+            _release(release),
+            _in_port(0),
+            _cookie(0),
+            _table_id(0),
+            _reason(0),
+            _buffer_id(0),
+            _frame(nullptr),
+            _frame_len(0) { }
+
+    static uint16_t read16(const uint8_t* p) {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return ntohs(v);
+    }
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return ntohl(v);
+    }
+
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return be64toh(v);
+    }
+
+    bool decode(size_t len) {
+        const uint8_t* msg = static_cast<const uint8_t*>(_data);
+
+        // fixed part and the match header
+        if (len < OF13_PACKET_IN_MATCH_OFFSET + 4 || msg[1] != OF13_PACKET_IN_TYPE) {
+            return false;
+        }
+        size_t msg_len = read16(msg + 2);
+        if (msg_len > len) {
+            return false;
+        }
+
+        _buffer_id = read32(msg + 8);
+        _reason = msg[14];
+        _table_id = msg[15];
+        _cookie = read64(msg + 16);
+
+        size_t match_len = read16(msg + OF13_PACKET_IN_MATCH_OFFSET + 2);
+        size_t match_end = OF13_PACKET_IN_MATCH_OFFSET + match_len;
+        // the match is padded to 8 bytes and followed by 2 bytes of padding
+        size_t frame_offset = OF13_PACKET_IN_MATCH_OFFSET + (match_len + 7) / 8 * 8 + 2;
+        if (match_len < 4 || frame_offset > msg_len) {
+            return false;
+        }
+
+        // walk the oxm fields for the in_port
+        const uint8_t* oxm = msg + OF13_PACKET_IN_MATCH_OFFSET + 4;
+        while (oxm + 4 <= msg + match_end) {
+            uint16_t oxm_class = read16(oxm);
+            uint8_t oxm_field = oxm[2] >> 1;
+            uint8_t oxm_len = oxm[3];
+            if (oxm + 4 + oxm_len > msg + match_end) {
+                return false;
+            }
+            if (oxm_class == OF13_OXM_CLASS_OPENFLOW_BASIC &&
+                oxm_field == OF13_OXM_FIELD_IN_PORT && oxm_len == 4) {
+                _in_port = read32(oxm + 4);
+                break;
+            }
+            oxm += 4 + oxm_len;
+        }
+
+        _frame = msg + frame_offset;
+        _frame_len = msg_len - frame_offset;
+        return true;
+    }
+
+    void* _data;
+    release_fn_t _release;
+    uint32_t _in_port;
+    uint64_t _cookie;
+    uint8_t _table_id;
+    uint8_t _reason;
+    uint32_t _buffer_id;
+    const uint8_t* _frame;
+    size_t _frame_len;
+};
+
+typedef std::shared_ptr<const PacketInView> packet_in_ptr_t;
@@ -0,0 +1,138 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenFlow 1.3 packet-out layout, see struct ofp_packet_out
+#define OF13_VERSION 4
+#define OF13_PACKET_OUT_TYPE 13
+#define OF13_PACKET_OUT_HEADER_LEN 24
+#define OF13_NO_BUFFER 0xffffffff
+#define OF13_PORT_CONTROLLER 0xfffffffd
+#define OF13_ACTION_OUTPUT 0
+#define OF13_ACTION_EXPERIMENTER 0xffff
+// both the output and the resubmit actions are 16 bytes long
+#define OF13_ACTION_LEN 16
+// ovs extension actions, see struct nx_action_resubmit
+#define NX_VENDOR_ID 0x00002320
+#define NXAST_RESUBMIT_TABLE 14
+#define NX_PORT_IN_PORT 0xfff8
+
+/*
+  An action of a packet-out, the equivalent of "actions=output:<port>" and
+  "actions=resubmit(,<table>)" in the ovs-ofctl syntax.
+*/
+class PacketOutAction {
+public:
+    static PacketOutAction output(uint32_t port) {
+        return PacketOutAction(OF13_ACTION_OUTPUT, port, 0);
+    }
+
+    static PacketOutAction resubmit(uint8_t table_id) {
+        return PacketOutAction(OF13_ACTION_EXPERIMENTER, NX_PORT_IN_PORT, table_id);
+    }
+
+    // write the action at p, OF13_ACTION_LEN bytes
+    void encode(uint8_t* p) const {
+        memset(p, 0, OF13_ACTION_LEN);
+        write16(p, _type);
+        write16(p + 2, OF13_ACTION_LEN);
+        if (_type == OF13_ACTION_OUTPUT) {
+            write32(p + 4, _port);
+            // max_len only matters for the packets sent to the controller
+            write16(p + 8, _port == OF13_PORT_CONTROLLER ? 0xffff : 0);
+        } else {
+            write32(p + 4, NX_VENDOR_ID);
+            write16(p + 8, NXAST_RESUBMIT_TABLE);
+            write16(p + 10, (uint16_t)_port);
+            p[12] = _table_id;
+        }
+    }
+
+    static void write16(uint8_t* p, uint16_t v) {
+        v = htons(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+    static void write32(uint8_t* p, uint32_t v) {
+        v = htonl(v);
+        memcpy(p, &v, sizeof(v));
+    }
+
+private:
+    PacketOutAction(uint16_t type, uint32_t port, uint8_t table_id) :
+            _type(type),
+            _port(port),
+            _table_id(table_id) { }
+
+    uint16_t _type;
+    uint32_t _port;
+    uint8_t _table_id;
+};
+
+typedef std::vector<PacketOutAction> packet_out_actions_t;
+
+// a frame to send out of a bridge with its packet-out actions
+struct PacketOutFrame {
+    uint32_t in_port;
+    const uint8_t* packet;
+    size_t len;
+    packet_out_actions_t actions;
+};
+
+/*
+ * append the OpenFlow 1.3 packet-out of a frame to out, the frame is copied
+ * right behind the actions, no ofp text is parsed on the way.
+ * Return:
+ *    false if the message does not fit in the 16 bits length, out is unchanged then
+ */
+inline bool encode_packet_out(std::vector<uint8_t>& out, uint32_t xid, uint32_t in_port,
+                              const uint8_t* packet, size_t len,
+                              const packet_out_actions_t& actions) {
+    size_t actions_len = actions.size() * OF13_ACTION_LEN;
+    size_t msg_len = OF13_PACKET_OUT_HEADER_LEN + actions_len + len;
+    if (msg_len > 0xffff) {
+        return false;
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + msg_len);
+    uint8_t* msg = out.data() + offset;
+
+    // header
+    msg[0] = OF13_VERSION;
+    msg[1] = OF13_PACKET_OUT_TYPE;
+    PacketOutAction::write16(msg + 2, msg_len);
+    PacketOutAction::write32(msg + 4, xid);
+    // buffer_id, in_port, actions_len and 6 bytes of padding
+    PacketOutAction::write32(msg + 8, OF13_NO_BUFFER);
+    PacketOutAction::write32(msg + 12, in_port);
+    PacketOutAction::write16(msg + 16, actions_len);
+    memset(msg + 18, 0, 6);
+
+    uint8_t* p = msg + OF13_PACKET_OUT_HEADER_LEN;
+    for (auto& action : actions) {
+        action.encode(p);
+        p += OF13_ACTION_LEN;
+    }
+    if (len > 0) {
+        memcpy(p, packet, len);
+    }
+    return true;
+}
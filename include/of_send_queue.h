@@ -0,0 +1,190 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#pragma once
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// messages the send ring holds, rounded up to a power of 2
+#define OF_SEND_QUEUE_CAPACITY 4096
+// a batch is written as soon as it holds this many bytes...
+#define OF_SEND_QUEUE_FLUSH_BYTES (64 * 1024)
+// ...or once its first message waited this long
+#define OF_SEND_QUEUE_FLUSH_US 50
+// stop writing while the connection still has this many bytes for the socket
+#define OF_SEND_QUEUE_MAX_BACKLOG (4 * 1024 * 1024)
+// how long a sender waits for room in a full ring before giving up
+#define OF_SEND_QUEUE_SEND_TIMEOUT_MS 1000
+// buffers gathered in one write
+#define OF_SEND_QUEUE_MAX_IOV 256
+// ring slots grown past this size give their memory back once written
+#define OF_SEND_QUEUE_SLOT_RETAIN_BYTES 1024
+
+/*
+  Send queue of one OpenFlow connection. Any thread can send(), the message is
+  copied into a slot of a bounded lock-free ring and a single flusher thread
+  gathers the queued messages into one writev call, once the batch reaches
+  flush_bytes or its first message waited flush_us.
+
+  When the socket does not take more data (writev returns 0, or the backlog
+  of the connection is above max_backlog) the flusher stops draining the
+  ring, and once the ring is full send() blocks up to send_timeout_ms.
+*/
+class OFSendQueue {
+public:
+    /*
+     * writes the gathered messages.
+     * Return:
+     *    the bytes written, which may end in the middle of a message,
+     *    0 if the socket is full, -1 if the connection is gone
+     */
+    typedef std::function<ssize_t(const struct iovec* iov, int iovcnt)> writev_fn_t;
+
+    // bytes written but still waiting for the socket, 0 if unknown
+    typedef std::function<size_t()> backlog_fn_t;
+
+    OFSendQueue(writev_fn_t writev,
+                backlog_fn_t backlog = nullptr,
+                size_t capacity = OF_SEND_QUEUE_CAPACITY,
+                size_t flush_bytes = OF_SEND_QUEUE_FLUSH_BYTES,
+                uint64_t flush_us = OF_SEND_QUEUE_FLUSH_US,
+                size_t max_backlog = OF_SEND_QUEUE_MAX_BACKLOG,
+                uint64_t send_timeout_ms = OF_SEND_QUEUE_SEND_TIMEOUT_MS);
+
+    // shuts the queue down and waits for the flusher
+    ~OFSendQueue();
+
+    // compiler will flag the error when below is called.
+    OFSendQueue(OFSendQueue const &) = delete;
+    void operator=(OFSendQueue const &) = delete;
+
+    // queue a message, false if the queue is shut down or stayed full for send_timeout_ms
+    bool send(const void* data, size_t len);
+
+    /*
+     * stop taking messages and wait for a write in progress to return, the
+     * messages still queued are dropped. The flusher does not call writev or
+     * backlog anymore once it returned, so the connection can be closed.
+     */
+    void shutdown();
+
+    // true once the flusher exited after the shutdown, the queue can go then
+    bool finished() const {
+        return _finished.load();
+    }
+
+    uint64_t messages_sent() const {
+        return _messages_sent.load();
+    }
+
+    uint64_t bytes_sent() const {
+        return _bytes_sent.load();
+    }
+
+    // writev calls which took data
+    uint64_t writes() const {
+        return _writes.load();
+    }
+
+    // messages lost to a full ring, a closed connection or the shutdown
+    uint64_t dropped() const {
+        return _dropped.load();
+    }
+
+    // times the flusher waited for the socket
+    uint64_t backpressure_waits() const {
+        return _backpressure_waits.load();
+    }
+
+    // times a sender waited for room in the ring
+    uint64_t send_waits() const {
+        return _send_waits.load();
+    }
+
+private:
+    // a slot is free for the sender at position seq, and holds a message for
+    // the flusher at position seq - 1
+    struct Slot {
+        std::atomic<size_t> seq;
+        std::vector<uint8_t> data;
+    };
+
+    void _run();
+
+    // write out the published messages in order, until the ring is empty or
+    // the socket is full
+    void _flush();
+
+    // give the slots of the first "len" bytes written back to the senders,
+    // returns how many messages were complete
+    size_t _release(size_t len);
+
+    // true if the slot at the send position is free
+    bool _has_room();
+
+    // false if the queue was shut down meanwhile
+    bool _wait_for_socket();
+
+    // false once the queue is shut down, the connection must not be touched then
+    bool _begin_write();
+
+    void _end_write();
+
+    writev_fn_t _writev;
+    backlog_fn_t _backlog;
+    const size_t _mask;
+    const size_t _flush_bytes;
+    const uint64_t _flush_us;
+    const size_t _max_backlog;
+    const uint64_t _send_timeout_ms;
+    std::unique_ptr<Slot[]> _slots;
+
+    alignas(64) std::atomic<size_t> _send_pos;
+    // senders between the shutdown check and the end of send()
+    std::atomic<int> _active_senders;
+    std::atomic<bool> _shutdown;
+    std::atomic<bool> _finished;
+
+    alignas(64) std::atomic<size_t> _queued_bytes;
+    // only touched by the flusher
+    size_t _flush_pos;
+    // bytes of the message at _flush_pos already written
+    size_t _flush_offset;
+
+    std::mutex _mutex;
+    std::condition_variable _flusher_cv;
+    std::condition_variable _room_cv;
+    int _room_waiters;
+    // the flusher is in writev or backlog, shutdown() waits for it on _writing_cv
+    bool _writing;
+    std::condition_variable _writing_cv;
+
+    std::atomic<uint64_t> _messages_sent;
+    std::atomic<uint64_t> _bytes_sent;
+    std::atomic<uint64_t> _writes;
+    std::atomic<uint64_t> _dropped;
+    std::atomic<uint64_t> _backpressure_waits;
+    std::atomic<uint64_t> _send_waits;
+
+    std::thread _flusher;
+};
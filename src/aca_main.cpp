@@ -14,6 +14,7 @@
 
 #include "aca_log.h"
 #include "aca_util.h"
+#include "aca_config.h"
 #include "aca_message_pulsar_consumer.h"
 #include "aca_grpc.h"
 #include "aca_grpc_client.h"
@@ -21,6 +22,10 @@
 #undef UNUSED
 #include "of_controller.h"
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovsdb_port_monitor.h"
+#include "aca_on_demand_negative_cache.h"
+#include "aca_on_demand_prefetcher.h"
+#include "aca_net_config.h"
 
 #undef OFP_ASSERT
 #undef CONTAINER_OF
@@ -34,6 +39,10 @@
 #include <unistd.h> /* for getopt */
 #include <grpcpp/grpcpp.h>
 #include <cmath>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
 
 #include "marl/defer.h"
 #include "marl/event.h"
@@ -42,6 +51,9 @@
 
 using aca_message_pulsar::ACA_Message_Pulsar_Consumer;
 using aca_ovs_control::ACA_OVS_Control;
+using aca_on_demand_engine::ACA_On_Demand_Negative_Cache;
+using aca_on_demand_engine::ACA_On_Demand_Prefetcher;
+using aca_net_config::Aca_Net_Config;
 using std::string;
 
 // Defines
@@ -73,6 +85,17 @@ string g_ncm_address = EMPTY_STRING;
 string g_ncm_port = EMPTY_STRING;
 string g_ovs_ctrl_address = "127.0.0.1";
 int g_ovs_ctrl_port = 1234;
+// limits of the per-destination on-demand pending queues
+uint g_on_demand_pending_queue_max_packets = ON_DEMAND_PENDING_QUEUE_MAX_PACKETS;
+ulong g_on_demand_pending_queue_max_bytes = ON_DEMAND_PENDING_QUEUE_MAX_BYTES;
+// number of completion queues for the on-demand replies of NCM
+uint g_on_demand_reply_shard_count = ON_DEMAND_REPLY_SHARD_COUNT;
+// batching window, batch size and max outstanding batches of the on-demand requests
+uint g_on_demand_batch_window_us = ON_DEMAND_BATCH_WINDOW_IN_MICROSECONDS;
+uint g_on_demand_batch_max_requests = ON_DEMAND_BATCH_MAX_REQUESTS;
+uint g_on_demand_batch_max_outstanding = ON_DEMAND_BATCH_MAX_OUTSTANDING;
+// flow-mods per OpenFlow bundle of a goal state, 0 disables the bundles
+uint g_ovs_flow_bundle_size = OVS_FLOW_BUNDLE_SIZE;
 
 // total time for execute_system_command in microseconds
 std::atomic_ulong g_total_execute_system_time(0);
@@ -84,6 +107,40 @@ std::atomic_ulong g_total_execute_openflow_time(0);
 std::atomic_ulong g_total_vpcs_table_mutex_time(0);
 // total time for goal state update in microseconds
 std::atomic_ulong g_total_update_GS_time(0);
+// total number of on-demand requests sent to NCM
+std::atomic_ulong g_total_on_demand_requests_issued(0);
+// total number of packets coalesced into an outstanding on-demand request
+std::atomic_ulong g_total_on_demand_requests_coalesced(0);
+// number of on-demand packets dropped / let through by the NCM negative cache
+std::atomic_ulong g_total_on_demand_negative_cache_hits(0);
+std::atomic_ulong g_total_on_demand_negative_cache_misses(0);
+// number of on-demand requests dropped by each admission policy when overloaded
+std::atomic_ulong g_total_on_demand_dropped_newest(0);
+std::atomic_ulong g_total_on_demand_dropped_oldest(0);
+std::atomic_ulong g_total_on_demand_dropped_fair_share(0);
+// number of packets dropped from / replayed out of the per-destination pending queues
+std::atomic_ulong g_total_on_demand_pending_packets_dropped(0);
+std::atomic_ulong g_total_on_demand_pending_packets_replayed(0);
+// number of destinations prefetched, and how many of them were used by an arp request,
+// still needed an on-demand request, or were not used before they stopped being tracked
+std::atomic_ulong g_total_on_demand_prefetch_issued(0);
+std::atomic_ulong g_total_on_demand_prefetch_hits(0);
+std::atomic_ulong g_total_on_demand_prefetch_late(0);
+std::atomic_ulong g_total_on_demand_prefetch_unused(0);
+// number of on-demand batches sent to NCM and of the requests they carried
+std::atomic_ulong g_total_on_demand_batches_sent(0);
+std::atomic_ulong g_total_on_demand_batched_requests(0);
+// number of flow bundles committed for the goal states and of the flow-mods they carried
+std::atomic_ulong g_total_ovs_flow_bundles_committed(0);
+std::atomic_ulong g_total_ovs_bundled_flows(0);
+std::atomic_ulong g_total_ovs_failed_flows(0);
+std::atomic_ulong g_total_ovs_flows_suppressed(0);
+std::atomic_ulong g_total_ovs_flows_sent(0);
+// number of zeta OAM direct paths sent to the switch, dropped as already
+// programmed, and forgotten once their flow could have idled out
+std::atomic_ulong g_total_oam_direct_paths_injected(0);
+std::atomic_ulong g_total_oam_direct_paths_suppressed(0);
+std::atomic_ulong g_total_oam_direct_paths_expired(0);
 
 bool g_demo_mode = false;
 bool g_debug_mode = false;
@@ -118,6 +175,48 @@ static void aca_cleanup()
   ACA_LOG_DEBUG("g_total_update_GS_time = %lu microseconds or %lu milliseconds\n",
                 g_total_update_GS_time.load(), us_to_ms(g_total_update_GS_time.load()));
 
+  ACA_LOG_DEBUG("g_total_on_demand_requests_issued = %lu, g_total_on_demand_requests_coalesced = %lu\n",
+                g_total_on_demand_requests_issued.load(),
+                g_total_on_demand_requests_coalesced.load());
+
+  ACA_LOG_DEBUG("g_total_on_demand_negative_cache_hits = %lu, g_total_on_demand_negative_cache_misses = %lu\n",
+                g_total_on_demand_negative_cache_hits.load(),
+                g_total_on_demand_negative_cache_misses.load());
+
+  ACA_LOG_DEBUG("g_total_on_demand_dropped_newest = %lu, g_total_on_demand_dropped_oldest = %lu, g_total_on_demand_dropped_fair_share = %lu\n",
+                g_total_on_demand_dropped_newest.load(),
+                g_total_on_demand_dropped_oldest.load(),
+                g_total_on_demand_dropped_fair_share.load());
+
+  ACA_LOG_DEBUG("g_total_on_demand_pending_packets_dropped = %lu, g_total_on_demand_pending_packets_replayed = %lu\n",
+                g_total_on_demand_pending_packets_dropped.load(),
+                g_total_on_demand_pending_packets_replayed.load());
+
+  ACA_LOG_DEBUG("g_total_on_demand_prefetch_issued = %lu, g_total_on_demand_prefetch_hits = %lu (%.1f%%), g_total_on_demand_prefetch_late = %lu, g_total_on_demand_prefetch_unused = %lu\n",
+                g_total_on_demand_prefetch_issued.load(),
+                g_total_on_demand_prefetch_hits.load(),
+                g_total_on_demand_prefetch_issued.load() == 0 ?
+                        0.0 :
+                        100.0 * g_total_on_demand_prefetch_hits.load() /
+                                g_total_on_demand_prefetch_issued.load(),
+                g_total_on_demand_prefetch_late.load(),
+                g_total_on_demand_prefetch_unused.load());
+
+  ACA_LOG_DEBUG("g_total_on_demand_batches_sent = %lu, g_total_on_demand_batched_requests = %lu\n",
+                g_total_on_demand_batches_sent.load(),
+                g_total_on_demand_batched_requests.load());
+  ACA_LOG_DEBUG("g_total_ovs_flow_bundles_committed = %lu, g_total_ovs_bundled_flows = %lu, "
+                "g_total_ovs_failed_flows = %lu\n",
+                g_total_ovs_flow_bundles_committed.load(),
+                g_total_ovs_bundled_flows.load(), g_total_ovs_failed_flows.load());
+  ACA_LOG_DEBUG("g_total_ovs_flows_sent = %lu, g_total_ovs_flows_suppressed = %lu\n",
+                g_total_ovs_flows_sent.load(), g_total_ovs_flows_suppressed.load());
+  ACA_LOG_DEBUG("g_total_oam_direct_paths_injected = %lu, g_total_oam_direct_paths_suppressed = %lu, "
+                "g_total_oam_direct_paths_expired = %lu\n",
+                g_total_oam_direct_paths_injected.load(),
+                g_total_oam_direct_paths_suppressed.load(),
+                g_total_oam_direct_paths_expired.load());
+
   ACA_LOG_INFO("%s", "Program exiting, cleaning up...\n");
 
   // Optional: Delete all global objects allocated by libprotobuf.
@@ -160,12 +259,69 @@ static void aca_cleanup()
     ACA_LOG_ERROR("%s", "Unable to call delete, grpc client thread pointer is null.\n");
   }
 
+  // Stop waiting for the interfaces of the pending ports
+  aca_ovs_l2_programmer::ACA_OVSDB_Port_Monitor::get_instance().shutdown();
+
   // Stop the ovs controller and clean up
   aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().clean_up_ovs_controller();
 
   ACA_LOG_CLOSE();
 }
 
+// the usage of the agent, printed for an unknown option or an invalid value
+static void print_usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s\n"
+          "\t\t[-a NCM IP Address]\n"
+          "\t\t[-p NCM Port]\n"
+          "\t\t[-b pulsar broker list]\n"
+          "\t\t[-h pulsar host topic to listen]\n"
+          "\t\t[-g pulsar subscription name]\n"
+          "\t\t[-k pulsar hashed key]\n"
+          "\t\t[-s gRPC server port\n"
+          "\t\t[-c ofctl command]\n"
+          "\t\t[-n on-demand negative cache size]\n"
+          "\t\t[-l on-demand negative cache TTL in milliseconds]\n"
+          "\t\t[-q on-demand pending packets per destination]\n"
+          "\t\t[-u on-demand pending bytes per destination]\n"
+          "\t\t[-f on-demand prefetch mode, 0: off, 1: co-accessed, 2: co-accessed and /24]\n"
+          "\t\t[-e on-demand prefetches per VPC]\n"
+          "\t\t[-r on-demand reply completion queues]\n"
+          "\t\t[-w on-demand batching window in microseconds, 0: no batching]\n"
+          "\t\t[-z on-demand requests per batch]\n"
+          "\t\t[-i on-demand batches waiting for NCM]\n"
+          "\t\t[-x flow-mods per OpenFlow bundle of a goal state, 0: no bundles]\n"
+          "\t\t[-y network configuration backend, 0: ip commands, 1: netlink]\n"
+          "\t\t[-m enable demo mode]\n"
+          "\t\t[-d enable debug mode]\n",
+          program);
+}
+
+/*
+ * parse the value of a numeric option, a negative or partial number, or one
+ * above max_value, is invalid.
+ * Return:
+ *    false if the value is invalid, value is left as it is then
+ */
+template <typename T>
+static bool parse_option_value(const char *arg, T &value,
+                               unsigned long long max_value = std::numeric_limits<T>::max())
+{
+  // strtoull takes a leading '-' and white spaces
+  if (arg == nullptr || !isdigit((unsigned char)arg[0])) {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = strtoull(arg, &end, 10);
+  if (errno != 0 || *end != '\0' || parsed > max_value) {
+    return false;
+  }
+  value = static_cast<T>(parsed);
+  return true;
+}
+
 // function to handle ctrl-c and kill process
 static void aca_signal_handler(int sig_num)
 {
@@ -180,6 +336,11 @@ int main(int argc, char *argv[])
 {
   int option;
   int rc = 0;
+  size_t negative_cache_size = ON_DEMAND_NEGATIVE_CACHE_MAX_SIZE;
+  uint64_t negative_cache_ttl_us = ON_DEMAND_NEGATIVE_CACHE_TTL_IN_MICROSECONDS;
+  int on_demand_prefetch_mode = ON_DEMAND_PREFETCH_MODE;
+  size_t prefetch_max_outstanding = ON_DEMAND_PREFETCH_MAX_OUTSTANDING_PER_VPC;
+  int net_config_backend_type = NET_CONFIG_BACKEND;
 
   ACA_LOG_INIT(ACALOGNAME);
 
@@ -189,7 +350,9 @@ int main(int argc, char *argv[])
   signal(SIGINT, aca_signal_handler);
   signal(SIGTERM, aca_signal_handler);
 
-  while ((option = getopt(argc, argv, "a:p:b:h:g:k:s:c:t:o:md")) != -1) {
+  while ((option = getopt(argc, argv, "a:p:b:h:g:k:s:c:t:o:n:l:q:u:f:e:r:w:z:i:x:y:md")) != -1) {
+    bool valid_value = true;
+
     switch (option) {
     case 'a':
       g_ncm_address = optarg;
@@ -221,6 +384,48 @@ int main(int argc, char *argv[])
     case 'o':
       g_ofctl_options = optarg;
       break;
+    case 'n':
+      valid_value = parse_option_value(optarg, negative_cache_size);
+      break;
+    case 'l': {
+      uint64_t negative_cache_ttl_ms = 0;
+      valid_value = parse_option_value(optarg, negative_cache_ttl_ms,
+                                       std::numeric_limits<uint64_t>::max() / 1000);
+      negative_cache_ttl_us = negative_cache_ttl_ms * 1000;
+      break;
+    }
+    case 'q':
+      valid_value = parse_option_value(optarg, g_on_demand_pending_queue_max_packets);
+      break;
+    case 'u':
+      valid_value = parse_option_value(optarg, g_on_demand_pending_queue_max_bytes);
+      break;
+    case 'f':
+      valid_value = parse_option_value(optarg, on_demand_prefetch_mode,
+                                       aca_on_demand_engine::PREFETCH_MODE_MAX - 1);
+      break;
+    case 'e':
+      valid_value = parse_option_value(optarg, prefetch_max_outstanding);
+      break;
+    case 'r':
+      valid_value = parse_option_value(optarg, g_on_demand_reply_shard_count);
+      break;
+    case 'w':
+      valid_value = parse_option_value(optarg, g_on_demand_batch_window_us);
+      break;
+    case 'z':
+      valid_value = parse_option_value(optarg, g_on_demand_batch_max_requests);
+      break;
+    case 'i':
+      valid_value = parse_option_value(optarg, g_on_demand_batch_max_outstanding);
+      break;
+    case 'x':
+      valid_value = parse_option_value(optarg, g_ovs_flow_bundle_size);
+      break;
+    case 'y':
+      valid_value = parse_option_value(optarg, net_config_backend_type,
+                                       aca_net_config::NET_CONFIG_BACKEND_MAX - 1);
+      break;
     case 'm':
       g_demo_mode = true;
       break;
@@ -228,24 +433,24 @@ int main(int argc, char *argv[])
       g_debug_mode = true;
       break;
     default: //the '?' case when the option is not recognized
-      fprintf(stderr,
-              "Usage: %s\n"
-              "\t\t[-a NCM IP Address]\n"
-              "\t\t[-p NCM Port]\n"
-              "\t\t[-b pulsar broker list]\n"
-              "\t\t[-h pulsar host topic to listen]\n"
-              "\t\t[-g pulsar subscription name]\n"
-              "\t\t[-k pulsar hashed key]\n"
-              "\t\t[-s gRPC server port\n"
-              "\t\t[-c ofctl command]\n"
-              "\t\t[-m enable demo mode]\n"
-              "\t\t[-d enable debug mode]\n",
-              argv[0]);
+      print_usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+
+    if (!valid_value) {
+      fprintf(stderr, "Invalid value %s of option -%c\n", optarg, option);
+      print_usage(argv[0]);
       exit(EXIT_FAILURE);
     }
   }
 
-  
+  ACA_On_Demand_Negative_Cache::get_instance().configure(negative_cache_size,
+                                                        negative_cache_ttl_us);
+  ACA_On_Demand_Prefetcher::get_instance().configure(
+          (aca_on_demand_engine::prefetch_mode)on_demand_prefetch_mode, prefetch_max_outstanding);
+  Aca_Net_Config::get_instance().configure(
+          (aca_net_config::net_config_backend)net_config_backend_type);
+
   // fill in the information if not provided in command line args
   if (g_broker_list == EMPTY_STRING) {
     g_broker_list = BROKER_LIST;
@@ -15,18 +15,23 @@
 #include "aca_log.h"
 #include "aca_util.h"
 #include "aca_comm_mgr.h"
+#include "aca_config.h"
 #include "aca_goal_state_handler.h"
 #include "aca_dhcp_state_handler.h"
+#include "aca_ovs_flow_transaction.h"
 #include "goalstateprovisioner.grpc.pb.h"
+#include <memory>
 
 using namespace std;
 using namespace alcor::schema;
 using namespace aca_goal_state_handler;
 using namespace aca_dhcp_state_handler;
+using aca_ovs_l2_programmer::ACA_OVS_Flow_Transaction;
 
 extern string g_rpc_server;
 extern string g_rpc_protocol;
 extern std::atomic_ulong g_total_update_GS_time;
+extern uint g_ovs_flow_bundle_size;
 
 namespace aca_comm_manager
 {
@@ -109,6 +114,13 @@ int Aca_Comm_Manager::update_goal_state(GoalState &goal_state_message,
   int rc = EXIT_SUCCESS;
   auto start = chrono::steady_clock::now();
 
+  // the flows of the goal state are held back and sent as bundles at the end
+  std::unique_ptr<ACA_OVS_Flow_Transaction> flow_transaction;
+  if (g_ovs_flow_bundle_size > 0) {
+    flow_transaction.reset(new ACA_OVS_Flow_Transaction(g_ovs_flow_bundle_size));
+  }
+  ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction.get());
+
   ACA_LOG_DEBUG("Starting to update goal state with format_version: %u\n",
                 goal_state_message.format_version());
 
@@ -170,6 +182,21 @@ int Aca_Comm_Manager::update_goal_state(GoalState &goal_state_message,
     rc = exec_command_rc;
   }
 
+  if (flow_transaction) {
+    ulong flow_commit_time = 0;
+    int bundles = flow_transaction->commit(flow_commit_time);
+    ACA_LOG_INFO("[METRICS] Elapsed time for committing %d flow bundles took: %lu microseconds\n",
+                 bundles, flow_commit_time);
+
+    // the operations already reported are only successful if their flows are
+    for (int status_index : flow_transaction->wait_for_completion(
+                 std::chrono::microseconds(OVS_FLOW_COMPLETION_TIMEOUT_IN_MICROSECONDS))) {
+      Aca_Goal_State_Handler::get_instance().set_goal_state_operation_failed(
+              gsOperationReply, status_index);
+      rc = EXIT_FAILURE;
+    }
+  }
+
   auto end = chrono::steady_clock::now();
   auto dhcp_operation_time =
           cast_to_microseconds(end - neighbor_update_finished_time).count();
@@ -201,6 +228,13 @@ int Aca_Comm_Manager::update_goal_state(GoalStateV2 &goal_state_message,
   int rc = EXIT_SUCCESS;
   auto start = chrono::steady_clock::now();
 
+  // the flows of the goal state are held back and sent as bundles at the end
+  std::unique_ptr<ACA_OVS_Flow_Transaction> flow_transaction;
+  if (g_ovs_flow_bundle_size > 0) {
+    flow_transaction.reset(new ACA_OVS_Flow_Transaction(g_ovs_flow_bundle_size));
+  }
+  ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction.get());
+
   this->print_goal_state(goal_state_message);
 
   auto gs_printout_finished_time = chrono::steady_clock::now();
@@ -260,6 +294,21 @@ int Aca_Comm_Manager::update_goal_state(GoalStateV2 &goal_state_message,
     rc = exec_command_rc;
   }
 
+  if (flow_transaction) {
+    ulong flow_commit_time = 0;
+    int bundles = flow_transaction->commit(flow_commit_time);
+    ACA_LOG_INFO("[METRICS] Elapsed time for committing %d flow bundles took: %lu microseconds\n",
+                 bundles, flow_commit_time);
+
+    // the operations already reported are only successful if their flows are
+    for (int status_index : flow_transaction->wait_for_completion(
+                 std::chrono::microseconds(OVS_FLOW_COMPLETION_TIMEOUT_IN_MICROSECONDS))) {
+      Aca_Goal_State_Handler::get_instance().set_goal_state_operation_failed(
+              gsOperationReply, status_index);
+      rc = EXIT_FAILURE;
+    }
+  }
+
   auto end = chrono::steady_clock::now();
 
   auto dhcp_operation_time =
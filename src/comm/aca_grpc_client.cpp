@@ -27,6 +27,7 @@
 #include <grpcpp/server_context.h>
 #include "goalstateprovisioner.grpc.pb.h"
 #include "aca_comm_mgr.h"
+#include "aca_config.h"
 #include "aca_log.h"
 #include "aca_grpc_client.h"
 #include "aca_util.h"
@@ -40,6 +41,16 @@ using aca_comm_manager::Aca_Comm_Manager;
 
 void GoalStateProvisionerClientImpl::RequestGoalStates(HostRequest *request,
                                                        grpc::CompletionQueue *cq)
+{
+  AsyncClientCall *call = new AsyncClientCall;
+  if (!RequestGoalStates(request, cq, call)) {
+    delete call;
+  }
+}
+
+bool GoalStateProvisionerClientImpl::RequestGoalStates(HostRequest *request,
+                                                       grpc::CompletionQueue *cq,
+                                                       AsyncClientCall *call)
 {
   std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
   grpc::ClientContext ctx;
@@ -55,9 +66,11 @@ void GoalStateProvisionerClientImpl::RequestGoalStates(HostRequest *request,
     this->ConnectToNCM();
     reply.mutable_operation_statuses()->Add();
     reply.mutable_operation_statuses()->at(0).set_operation_status(OperationStatus::FAILURE);
-    return;
+    return false;
   }
-  AsyncClientCall *call = new AsyncClientCall;
+  // without a deadline a call NCM never answers would hold its batch slot forever
+  call->context.set_deadline(std::chrono::system_clock::now() +
+                             std::chrono::microseconds(ON_DEMAND_GRPC_DEADLINE_IN_MICROSECONDS));
   call->response_reader = stub_->AsyncRequestGoalStates(&call->context, *request, cq);
   call->response_reader->Finish(&call->reply, &call->status, (void *)call);
   ACA_LOG_INFO("Sent hostOperationRequest on thread: %ld\n", std::this_thread::get_id());
@@ -67,7 +80,7 @@ void GoalStateProvisionerClientImpl::RequestGoalStates(HostRequest *request,
   ACA_LOG_DEBUG("[METRICS] RequestGoalStates: [%ld], update finished at: [%ld]\nElapsed time for sending hostOperationRequest took: %ld microseconds or %ld milliseconds\n",
                 start, end, send_host_operation_request_time,
                 (send_host_operation_request_time / 1000));
-  return;
+  return true;
 }
 
 void GoalStateProvisionerClientImpl::ConnectToNCM()
@@ -20,6 +20,7 @@
 #include <arpa/inet.h>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include "aca_ovs_l2_programmer.h"
 
 #undef OFP_ASSERT
@@ -305,30 +306,21 @@ void ACA_Dhcp_Server::dhcps_xmit(uint32_t inport, void *message)
 {
   dhcp_message *dhcpmsg = nullptr;
   string bridge = "br-int";
-  string in_port = "in_port=controller";
-  string whitespace = " ";
-  string action = "actions=output:" + to_string(inport);
-  string packetpre = "packet=";
-  string packet;
-  string options;
+  vector<uint8_t> packet;
 
   dhcpmsg = (dhcp_message *)message;
   if (!dhcpmsg) {
     return;
   }
 
-  packet = _serialize_dhcp_message(dhcpmsg);
-  if (packet.empty()) {
+  if (_serialize_dhcp_message(dhcpmsg, packet) == 0) {
     return;
   }
 
-  //bridge = "br-int" opts = "in_port=controller packet=<hex-string> actions=normal"
-  options = in_port + whitespace + packetpre + packet + whitespace + action;
-
-  //aca_ovs_control::ACA_OVS_Control::get_instance().packet_out(bridge.c_str(),
-  //                                                            options.c_str());
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(bridge.c_str(),
-                                                                          options.c_str());
+  //bridge = "br-int", the equivalent of "in_port=controller packet=<packet> actions=output:<inport>"
+  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(
+          bridge.c_str(), OF13_PORT_CONTROLLER, packet.data(), packet.size(),
+          { PacketOutAction::output(inport) });
 
   delete dhcpmsg;
 }
@@ -847,80 +839,73 @@ unsigned short ACA_Dhcp_Server::check_sum(unsigned char *a, int len)
   return (unsigned short)(~sum);
 }
 
-string ACA_Dhcp_Server::_serialize_dhcp_message(dhcp_message *dhcpmsg)
+// append v in network byte order
+static void _append_be16(vector<uint8_t> &packet, uint16_t v)
+{
+  packet.push_back(v >> 8);
+  packet.push_back(v & 0xff);
+}
+
+static void _append_be32(vector<uint8_t> &packet, uint32_t v)
+{
+  _append_be16(packet, v >> 16);
+  _append_be16(packet, v & 0xffff);
+}
+
+size_t ACA_Dhcp_Server::_serialize_dhcp_message(dhcp_message *dhcpmsg, vector<uint8_t> &packet)
 {
-  string packet;
+  vector<uint8_t> packet_header;
 
   if (!dhcpmsg) {
-    return string();
+    return 0;
   }
 
+  // the headers go in front once the length of the message is known
+  packet.assign(DHCP_MSG_PACKET_HEADER_LEN, 0);
+
   //fix header
-  char str[80];
-  sprintf(str, "%02x", dhcpmsg->op);
-  packet.append(str);
-  sprintf(str, "%02x", dhcpmsg->htype);
-  packet.append(str);
-  sprintf(str, "%02x", dhcpmsg->hlen);
-  packet.append(str);
-  sprintf(str, "%02x", dhcpmsg->hops);
-  packet.append(str);
-
-  sprintf(str, "%08x", htonl(dhcpmsg->xid));
-  packet.append(str);
-  sprintf(str, "%04x", htons(dhcpmsg->secs));
-  packet.append(str);
-  sprintf(str, "%04x", htons(dhcpmsg->flags));
-  packet.append(str);
-  sprintf(str, "%08x", dhcpmsg->ciaddr);
-  packet.append(str);
-  sprintf(str, "%08x", dhcpmsg->yiaddr);
-  packet.append(str);
-  sprintf(str, "%08x", htonl(dhcpmsg->siaddr));
-  packet.append(str);
-  sprintf(str, "%08x", dhcpmsg->giaddr);
-  packet.append(str);
-
-  for (int i = 0; i < 16; i++) {
-    sprintf(str, "%02x", dhcpmsg->chaddr[i]);
-    packet.append(str);
-  }
-  for (int i = 0; i < 64; i++) {
-    sprintf(str, "%02x", dhcpmsg->sname[i]);
-    packet.append(str);
-  }
-  for (int i = 0; i < 128; i++) {
-    sprintf(str, "%02x", dhcpmsg->file[i]);
-    packet.append(str);
-  }
-
-  sprintf(str, "%08x", htonl(dhcpmsg->cookie));
-  packet.append(str);
+  packet.push_back(dhcpmsg->op);
+  packet.push_back(dhcpmsg->htype);
+  packet.push_back(dhcpmsg->hlen);
+  packet.push_back(dhcpmsg->hops);
+
+  _append_be32(packet, htonl(dhcpmsg->xid));
+  _append_be16(packet, htons(dhcpmsg->secs));
+  _append_be16(packet, htons(dhcpmsg->flags));
+  _append_be32(packet, dhcpmsg->ciaddr);
+  _append_be32(packet, dhcpmsg->yiaddr);
+  _append_be32(packet, htonl(dhcpmsg->siaddr));
+  _append_be32(packet, dhcpmsg->giaddr);
+
+  packet.insert(packet.end(), dhcpmsg->chaddr, dhcpmsg->chaddr + 16);
+  packet.insert(packet.end(), dhcpmsg->sname, dhcpmsg->sname + 64);
+  packet.insert(packet.end(), dhcpmsg->file, dhcpmsg->file + 128);
+
+  _append_be32(packet, htonl(dhcpmsg->cookie));
 
   //options part
   for (int i = 0; i < DHCP_MSG_OPTS_LENGTH;) {
     if (DHCP_OPT_END == dhcpmsg->options[i]) {
-      sprintf(str, "%02x", dhcpmsg->options[i]); // end
-      packet.append(str);
+      packet.push_back(dhcpmsg->options[i]); // end
       break;
     }
     // type code
-    sprintf(str, "%02x", dhcpmsg->options[i++]);
-    packet.append(str);
+    packet.push_back(dhcpmsg->options[i++]);
     int type_len = dhcpmsg->options[i];
-    for (int j = 0; j < type_len + 1; j++) {
-      sprintf(str, "%02x", dhcpmsg->options[i++]);
-      packet.append(str);
+    for (int j = 0; j < type_len + 1 && i < DHCP_MSG_OPTS_LENGTH; j++) {
+      packet.push_back(dhcpmsg->options[i++]);
     }
   }
 
-  // a byte contains two str char, we only need byte length
-  int len = packet.length() / 2;
-  packet.insert(0, _serialize_dhcp_ip_header_message(dhcpmsg, len));
-  return packet;
+  int len = packet.size() - DHCP_MSG_PACKET_HEADER_LEN;
+  _serialize_dhcp_ip_header_message(dhcpmsg, len, packet_header);
+  std::copy(packet_header.begin(), packet_header.end(), packet.begin());
+  return packet.size();
 }
 
-string ACA_Dhcp_Server::_serialize_dhcp_ip_header_message(dhcp_message *dhcpmsg, int dhcp_message_len)
+void ACA_Dhcp_Server::_serialize_dhcp_ip_header_message(dhcp_message *dhcpmsg,
+                                                        int dhcp_message_len,
+                                                        vector<uint8_t> &header)
 {
   //process udp header
   udphear udphdr;
@@ -969,41 +954,25 @@ string ACA_Dhcp_Server::_serialize_dhcp_ip_header_message(dhcp_message *dhcpmsg,
   iphr.udp_checksum = check_sum((unsigned char *)&udphdr, 20 + dhcp_message_len);
   iphr.checksum = check_sum((unsigned char *)&iphr, 20);
 
-  string packet_header;
-  char str[80];
-  packet_header.append(DHCP_MSG_L2_HEADER_DEST_MAC);
-  packet_header.append(DHCP_MSG_L2_HEADER_SRC_MAC);
-  packet_header.append(DHCP_MSG_L2_HEADER_TYPE);
-  sprintf(str, "%02x", iphr.version);
-  packet_header.append(str);
-  sprintf(str, "%02x", iphr.ds);
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.total_len));
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.identi));
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.fregment));
-  packet_header.append(str);
-  sprintf(str, "%02x", iphr.tol);
-  packet_header.append(str);
-  sprintf(str, "%02x", iphr.protocol);
-  packet_header.append(str);
-  sprintf(str, "%04x", iphr.checksum);
-  packet_header.append(str);
-  sprintf(str, "%08x", htonl(iphr.src_ip));
-  packet_header.append(str);
-  sprintf(str, "%08x", htonl(iphr.dst_ip));
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.src_port));
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.dst_port));
-  packet_header.append(str);
-  sprintf(str, "%04x", ntohs(iphr.len));
-  packet_header.append(str);
-  sprintf(str, "%04x", iphr.udp_checksum);
-  packet_header.append(str);
-
-  return packet_header;
+  const uint8_t dest_mac[6] = DHCP_MSG_L2_HEADER_DEST_MAC;
+  const uint8_t src_mac[6] = DHCP_MSG_L2_HEADER_SRC_MAC;
+  header.insert(header.end(), dest_mac, dest_mac + 6);
+  header.insert(header.end(), src_mac, src_mac + 6);
+  _append_be16(header, DHCP_MSG_L2_HEADER_TYPE);
+  header.push_back(iphr.version);
+  header.push_back(iphr.ds);
+  _append_be16(header, ntohs(iphr.total_len));
+  _append_be16(header, ntohs(iphr.identi));
+  _append_be16(header, ntohs(iphr.fregment));
+  header.push_back(iphr.tol);
+  header.push_back(iphr.protocol);
+  _append_be16(header, iphr.checksum);
+  _append_be32(header, htonl(iphr.src_ip));
+  _append_be32(header, htonl(iphr.dst_ip));
+  _append_be16(header, ntohs(iphr.src_port));
+  _append_be16(header, ntohs(iphr.dst_port));
+  _append_be16(header, ntohs(iphr.len));
+  _append_be16(header, iphr.udp_checksum);
 }
 
 } //namespace aca_dhcp_server
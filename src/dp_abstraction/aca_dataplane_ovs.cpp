@@ -23,12 +23,14 @@
 #include <errno.h>
 #include <arpa/inet.h>
 #include "aca_zeta_programming.h"
+#include "aca_on_demand_negative_cache.h"
 
 using namespace std;
 using namespace alcor::schema;
 using namespace aca_ovs_l2_programmer;
 using namespace aca_ovs_l3_programmer;
 using namespace aca_zeta_programming;
+using aca_on_demand_engine::ACA_On_Demand_Negative_Cache;
 
 namespace aca_dataplane_ovs
 {
@@ -109,6 +111,17 @@ static bool aca_lookup_zeta_gateway_info(GoalState &parsed_struct, const string
   return false;
 }
 
+// NCM has the goal state of a neighbor created, updated or sent as info,
+// on-demand requests to it don't need to be suppressed any more
+static void aca_invalidate_negative_cache(OperationType operation_type, uint tunnel_id,
+                                          const string &virtual_ip_address)
+{
+  if ((operation_type == OperationType::CREATE) || (operation_type == OperationType::UPDATE) ||
+      (operation_type == OperationType::INFO)) {
+    ACA_On_Demand_Negative_Cache::get_instance().invalidate(tunnel_id, virtual_ip_address);
+  }
+}
+
 int ACA_Dataplane_OVS::initialize()
 {
   // TODO: improve the logging system, and add logging to this module
@@ -642,6 +655,9 @@ int ACA_Dataplane_OVS::update_neighbor_state_workitem(NeighborState current_Neig
                   ip_index, virtual_ip_address.c_str(), virtual_mac_address.c_str(),
                   host_ip_address.c_str(), found_tunnel_id);
 
+          aca_invalidate_negative_cache(current_NeighborState.operation_type(),
+                                        found_tunnel_id, virtual_ip_address);
+
           // with Alcor DVR, a cross subnet packet will be routed to the destination subnet.
           // that means a L3 neighbor will become a L2 neighbor, therefore, call the below
           // for both L2 and L3 neighbor update
@@ -826,6 +842,9 @@ int ACA_Dataplane_OVS::update_neighbor_state_workitem(NeighborState current_Neig
                   ip_index, virtual_ip_address.c_str(), virtual_mac_address.c_str(),
                   host_ip_address.c_str(), found_tunnel_id);
 
+          aca_invalidate_negative_cache(current_NeighborState.operation_type(),
+                                        found_tunnel_id, virtual_ip_address);
+
           // with Alcor DVR, a cross subnet packet will be routed to the destination subnet.
           // that means a L3 neighbor will become a L2 neighbor, therefore, call the below
           // for both L2 and L3 neighbor update
@@ -17,6 +17,7 @@
 #include "aca_goal_state_handler.h"
 #include "goalstateprovisioner.grpc.pb.h"
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_transaction.h"
 #include <future>
 
 #include "marl/defer.h"
@@ -25,6 +26,7 @@
 #include "marl/waitgroup.h"
 
 using namespace alcor::schema;
+using aca_ovs_l2_programmer::ACA_OVS_Flow_Transaction;
 
 std::mutex gs_reply_mutex; // mutex for writing gs reply object
 const int resource_state_processing_batch_size = 10000; // batch size of concurrently processing a kind of resource states.
@@ -147,6 +149,8 @@ int Aca_Goal_State_Handler::update_port_states(GoalState &parsed_struct,
   int count = 1;
   GoalState* gs_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  // the work items program their flows into the transaction of the goal state
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.port_states_size());
   for (int i = 0; i < parsed_struct.port_states_size(); i++) {
     ACA_LOG_DEBUG("=====>parsing port states #%d\n", i);
@@ -155,6 +159,7 @@ int Aca_Goal_State_Handler::update_port_states(GoalState &parsed_struct,
     
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_port_state_workitem(current_PortState, *gs_ptr, *reply_ptr);
     });
     
@@ -182,6 +187,7 @@ int Aca_Goal_State_Handler::update_port_states(GoalStateV2 &parsed_struct,
   int count = 1;
   GoalStateV2* gsv2_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.port_states_size());
   
   // below is a c++ 17 feature
@@ -189,6 +195,7 @@ int Aca_Goal_State_Handler::update_port_states(GoalStateV2 &parsed_struct,
     ACA_LOG_DEBUG("=====>parsing port state: %s\n", port_id.c_str());
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_port_state_workitem_v2(current_PortState, *gsv2_ptr, *reply_ptr);
     });
   }
@@ -213,6 +220,7 @@ int Aca_Goal_State_Handler::update_neighbor_states(GoalState &parsed_struct,
   int count = 1;
   GoalState* gs_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.neighbor_states_size());
 
   for (int i = 0; i < parsed_struct.neighbor_states_size(); i++) {
@@ -221,6 +229,7 @@ int Aca_Goal_State_Handler::update_neighbor_states(GoalState &parsed_struct,
     NeighborState current_NeighborState = parsed_struct.neighbor_states(i);
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_neighbor_state_workitem(current_NeighborState, *gs_ptr, *reply_ptr);
     });
   }
@@ -245,6 +254,7 @@ int Aca_Goal_State_Handler::update_router_states(GoalState &parsed_struct,
   int count = 1;
   GoalState* gs_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.router_states_size());
 
   for (int i = 0; i < parsed_struct.router_states_size(); i++) {
@@ -253,6 +263,7 @@ int Aca_Goal_State_Handler::update_router_states(GoalState &parsed_struct,
     RouterState current_RouterState = parsed_struct.router_states(i);
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_router_state_workitem(current_RouterState, *gs_ptr, *reply_ptr);
     });
   }
@@ -277,11 +288,13 @@ int Aca_Goal_State_Handler::update_neighbor_states(GoalStateV2 &parsed_struct,
   int count = 1;
   GoalStateV2* gsv2_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.neighbor_states_size());
   
   for (auto &[neighbor_id, current_NeighborState] : parsed_struct.neighbor_states()) {
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_neighbor_state_workitem_v2(current_NeighborState, *gsv2_ptr, *reply_ptr);
     });
   }
@@ -306,12 +319,14 @@ int Aca_Goal_State_Handler::update_router_states(GoalStateV2 &parsed_struct,
   int count = 1;
   GoalStateV2* gsv2_ptr = &parsed_struct;
   GoalStateOperationReply* reply_ptr = &gsOperationReply;
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
   marl::WaitGroup wait_group(parsed_struct.router_states_size());
 
   for (auto &[router_id, current_RouterState] : parsed_struct.router_states()) {
     ACA_LOG_DEBUG("=====>parsing router state: %s\n", router_id.c_str());
     marl::schedule([=] {
       defer(wait_group.done());
+      ACA_OVS_Flow_Transaction::Scope flow_scope(flow_transaction);
       update_router_state_workitem_v2(current_RouterState, *gsv2_ptr, *reply_ptr);
     });
   }
@@ -360,8 +375,29 @@ void Aca_Goal_State_Handler::add_goal_state_operation_status(
   new_operation_statuses->set_dataplane_programming_time(culminative_dataplane_programming_time);
   new_operation_statuses->set_network_configuration_time(culminative_network_configuration_time);
   new_operation_statuses->set_state_elapse_time(state_elapse_time);
+  int status_index = gsOperationReply.operation_statuses_size() - 1;
   gs_reply_mutex.unlock();
   // -----critical section ends-----
+
+  // the flows programmed for this operation report their outcome into it
+  ACA_OVS_Flow_Transaction *flow_transaction = ACA_OVS_Flow_Transaction::current();
+  if (flow_transaction != nullptr) {
+    flow_transaction->attach_operation_status(status_index);
+  }
+}
+
+void Aca_Goal_State_Handler::set_goal_state_operation_failed(
+        GoalStateOperationReply &gsOperationReply, int status_index)
+{
+  gs_reply_mutex.lock();
+  if (status_index >= 0 && status_index < gsOperationReply.operation_statuses_size()) {
+    GoalStateOperationReply_GoalStateOperationStatus *operation_status =
+            gsOperationReply.mutable_operation_statuses(status_index);
+    ACA_LOG_ERROR("gsOperationReply - flows of resource_id: %s failed\n",
+                  operation_status->resource_id().c_str());
+    operation_status->set_operation_status(OperationStatus::FAILURE);
+  }
+  gs_reply_mutex.unlock();
 }
 
 } // namespace aca_goal_state_handler
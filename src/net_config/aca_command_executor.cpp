@@ -0,0 +1,469 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "aca_command_executor.h"
+#include "aca_log.h"
+#include "aca_util.h"
+#include "aca_config.h"
+#include "marl/event.h"
+#include "marl/scheduler.h"
+#include "marl/waitgroup.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// the libc headers may predate pidfd_open, its number is the same on every architecture
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+// how often the children are polled when the kernel has no pidfd (before 5.3)
+#define COMMAND_EXECUTOR_POLL_INTERVAL_IN_MILLISECONDS 10
+
+#define COMMAND_EXECUTOR_MAX_EVENTS 64
+
+// epoll data of the eventfd, the others are the slot index * 2, plus 1 for the output
+#define COMMAND_EXECUTOR_WAKEUP_EVENT UINT64_MAX
+
+extern char **environ;
+
+using namespace std;
+
+namespace aca_net_config
+{
+Aca_Command_Executor &Aca_Command_Executor::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static Aca_Command_Executor instance(SYSTEM_COMMAND_MAX_RUNNING,
+                                       SYSTEM_COMMAND_TIMEOUT_IN_MICROSECONDS,
+                                       SYSTEM_COMMAND_OUTPUT_MAX_BYTES);
+  return instance;
+}
+
+Aca_Command_Executor::Aca_Command_Executor(size_t max_running, uint64_t timeout_us,
+                                           size_t output_max_bytes)
+        : _max_running(max_running == 0 ? 1 : max_running), _timeout_us(timeout_us),
+          _running(0), _shutdown(false)
+{
+  _slots.resize(_max_running);
+  for (size_t i = 0; i < _max_running; i++) {
+    _slots[i].pid = 0;
+    _slots[i].pidfd = -1;
+    _slots[i].output_fd = -1;
+    _slots[i].output.resize(output_max_bytes);
+    _slots[i].output_size = 0;
+    _slots[i].timed_out = false;
+    // the first slots are taken first
+    _free_slots.push_back(_max_running - 1 - i);
+  }
+
+  _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  _wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (_epoll_fd < 0 || _wakeup_fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "command executor setup failed");
+  }
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u64 = COMMAND_EXECUTOR_WAKEUP_EVENT;
+  epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event);
+
+  _reaper_thread = std::thread(&Aca_Command_Executor::_reap, this);
+}
+
+Aca_Command_Executor::~Aca_Command_Executor()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _shutdown = true;
+  }
+  _wakeup();
+  if (_reaper_thread.joinable()) {
+    _reaper_thread.join();
+  }
+
+  std::vector<std::function<void()> > done_calls;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _slots.size(); i++) {
+      if (_slots[i].pid > 0) {
+        kill(-_slots[i].pid, SIGKILL);
+        waitpid(_slots[i].pid, nullptr, 0);
+        _finish(i, -ECANCELED, done_calls);
+      }
+    }
+    for (auto &command : _waiting) {
+      Command_Result result = { -ECANCELED, "", 0 };
+      done_fn_t done = std::move(command.done);
+      done_calls.push_back([done, result]() mutable { done(std::move(result)); });
+    }
+    _waiting.clear();
+  }
+  for (auto &done_call : done_calls) {
+    done_call();
+  }
+
+  close(_wakeup_fd);
+  close(_epoll_fd);
+}
+
+std::future<Command_Result> Aca_Command_Executor::submit(const std::string &cmd_string,
+                                                         bool capture_output, uint64_t timeout_us)
+{
+  auto promise = std::make_shared<std::promise<Command_Result> >();
+  std::future<Command_Result> future = promise->get_future();
+
+  submit(cmd_string, capture_output, timeout_us,
+         [promise](Command_Result &&result) { promise->set_value(std::move(result)); });
+  return future;
+}
+
+void Aca_Command_Executor::submit(const std::string &cmd_string, bool capture_output,
+                                  uint64_t timeout_us, done_fn_t done)
+{
+  Command command = { cmd_string, capture_output, timeout_us == 0 ? _timeout_us : timeout_us,
+                      std::move(done) };
+  std::vector<std::function<void()> > done_calls;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_shutdown) {
+      Command_Result result = { -ECANCELED, "", 0 };
+      done_fn_t done = std::move(command.done);
+      done_calls.push_back([done, result]() mutable { done(std::move(result)); });
+    } else if (!_waiting.empty() || !_start(command, done_calls)) {
+      // the commands submitted earlier start first
+      _waiting.push_back(std::move(command));
+    }
+  }
+
+  for (auto &done_call : done_calls) {
+    done_call();
+  }
+  // the reaper waits for the timeout of the new command too
+  _wakeup();
+}
+
+Command_Result Aca_Command_Executor::execute(const std::string &cmd_string,
+                                             bool capture_output, uint64_t timeout_us)
+{
+  if (marl::Scheduler::Fiber::current() == nullptr) {
+    return submit(cmd_string, capture_output, timeout_us).get();
+  }
+
+  // the worker runs other fibers until the command exits
+  Command_Result result;
+  marl::Event done(marl::Event::Mode::Manual);
+  submit(cmd_string, capture_output, timeout_us, [&result, done](Command_Result &&r) {
+    result = std::move(r);
+    done.signal();
+  });
+  done.wait();
+  return result;
+}
+
+std::vector<Command_Result> Aca_Command_Executor::execute(const std::vector<std::string> &cmd_strings,
+                                                          bool capture_output, uint64_t timeout_us)
+{
+  if (marl::Scheduler::Fiber::current() == nullptr) {
+    return execute_blocking(cmd_strings, capture_output, timeout_us);
+  }
+
+  std::vector<Command_Result> results(cmd_strings.size());
+  marl::WaitGroup wait_group(cmd_strings.size());
+  for (size_t i = 0; i < cmd_strings.size(); i++) {
+    submit(cmd_strings[i], capture_output, timeout_us,
+           [&results, i, wait_group](Command_Result &&result) {
+             results[i] = std::move(result);
+             wait_group.done();
+           });
+  }
+  wait_group.wait();
+  return results;
+}
+
+std::vector<Command_Result>
+Aca_Command_Executor::execute_blocking(const std::vector<std::string> &cmd_strings,
+                                       bool capture_output, uint64_t timeout_us)
+{
+  std::vector<Command_Result> results(cmd_strings.size());
+  std::vector<std::future<Command_Result> > futures;
+
+  for (auto &cmd_string : cmd_strings) {
+    futures.push_back(submit(cmd_string, capture_output, timeout_us));
+  }
+  for (size_t i = 0; i < futures.size(); i++) {
+    results[i] = futures[i].get();
+  }
+  return results;
+}
+
+size_t Aca_Command_Executor::outstanding()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _running + _waiting.size();
+}
+
+bool Aca_Command_Executor::_start(Command &command, std::vector<std::function<void()> > &done_calls)
+{
+  if (_free_slots.empty()) {
+    return false;
+  }
+  size_t slot_index = _free_slots.back();
+  _free_slots.pop_back();
+  _running++;
+
+  Slot &slot = _slots[slot_index];
+  slot.command = std::move(command);
+  slot.output_size = 0;
+  slot.timed_out = false;
+  slot.start_time = std::chrono::steady_clock::now();
+  slot.deadline = slot.start_time + std::chrono::microseconds(slot.command.timeout_us);
+
+  int rc = _spawn(slot, slot_index);
+  if (rc != EXIT_SUCCESS) {
+    ACA_LOG_ERROR("Aca_Command_Executor - failed to spawn: %s, rc: %d\n",
+                  slot.command.cmd_string.c_str(), rc);
+    _finish(slot_index, rc, done_calls);
+  }
+  return true;
+}
+
+int Aca_Command_Executor::_spawn(Slot &slot, size_t slot_index)
+{
+  int pipe_fds[2] = { -1, -1 };
+  posix_spawn_file_actions_t file_actions;
+  posix_spawnattr_t attr;
+  sigset_t empty_mask;
+
+  if (slot.command.capture_output && pipe2(pipe_fds, O_CLOEXEC) != 0) {
+    return -errno;
+  }
+
+  posix_spawn_file_actions_init(&file_actions);
+  if (slot.command.capture_output) {
+    posix_spawn_file_actions_adddup2(&file_actions, pipe_fds[1], STDOUT_FILENO);
+  }
+  // a process group of its own, so a timeout kills what the shell started too
+  posix_spawnattr_init(&attr);
+  sigemptyset(&empty_mask);
+  posix_spawnattr_setsigmask(&attr, &empty_mask);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+
+  const char *argv[] = { "sh", "-c", slot.command.cmd_string.c_str(), nullptr };
+  int rc = posix_spawn(&slot.pid, "/bin/sh", &file_actions, &attr,
+                       const_cast<char *const *>(argv), environ);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&file_actions);
+  if (pipe_fds[1] >= 0) {
+    close(pipe_fds[1]);
+  }
+  if (rc != 0) {
+    slot.pid = 0;
+    if (pipe_fds[0] >= 0) {
+      close(pipe_fds[0]);
+    }
+    return -rc;
+  }
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+
+  slot.output_fd = pipe_fds[0];
+  if (slot.output_fd >= 0) {
+    fcntl(slot.output_fd, F_SETFL, fcntl(slot.output_fd, F_GETFL) | O_NONBLOCK);
+    event.data.u64 = slot_index * 2 + 1;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, slot.output_fd, &event);
+  }
+
+  slot.pidfd = (int)syscall(SYS_pidfd_open, slot.pid, 0);
+  if (slot.pidfd >= 0) {
+    event.data.u64 = slot_index * 2;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, slot.pidfd, &event);
+  }
+  return EXIT_SUCCESS;
+}
+
+void Aca_Command_Executor::_reap()
+{
+  struct epoll_event events[COMMAND_EXECUTOR_MAX_EVENTS];
+
+  while (true) {
+    int timeout_ms;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shutdown) {
+        break;
+      }
+      timeout_ms = _get_wait_timeout_ms();
+    }
+
+    int n = epoll_wait(_epoll_fd, events, COMMAND_EXECUTOR_MAX_EVENTS, timeout_ms);
+    std::vector<std::function<void()> > done_calls;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+
+      for (int i = 0; i < n; i++) {
+        if (events[i].data.u64 == COMMAND_EXECUTOR_WAKEUP_EVENT) {
+          uint64_t count;
+          while (read(_wakeup_fd, &count, sizeof(count)) > 0)
+            ;
+        } else if (events[i].data.u64 % 2 == 1) {
+          Slot &slot = _slots[events[i].data.u64 / 2];
+          if (slot.pid > 0) {
+            _read_output(slot);
+          }
+        }
+      }
+
+      // a readable pidfd is a child which exited, the few slots are all checked
+      time_point now = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < _slots.size(); i++) {
+        Slot &slot = _slots[i];
+        if (slot.pid <= 0) {
+          continue;
+        }
+        int status = 0;
+        pid_t pid = waitpid(slot.pid, &status, WNOHANG);
+        if (pid == slot.pid || (pid < 0 && errno == ECHILD)) {
+          // SIGCHLD ignored by the agent reaps the children before us
+          _finish(i, pid == slot.pid ? status : -ECHILD, done_calls);
+        } else if (!slot.timed_out && now >= slot.deadline) {
+          ACA_LOG_ERROR("Aca_Command_Executor - killing the command after its timeout: %s\n",
+                        slot.command.cmd_string.c_str());
+          slot.timed_out = true;
+          kill(-slot.pid, SIGKILL);
+        }
+      }
+
+      while (!_waiting.empty() && _start(_waiting.front(), done_calls)) {
+        _waiting.pop_front();
+      }
+    }
+
+    for (auto &done_call : done_calls) {
+      done_call();
+    }
+  }
+}
+
+void Aca_Command_Executor::_read_output(Slot &slot)
+{
+  char discarded[4096];
+
+  while (slot.output_fd >= 0) {
+    // the output past the buffer is dropped, the pipe must not fill up
+    char *buffer = discarded;
+    size_t size = sizeof(discarded);
+    if (slot.output_size < slot.output.size()) {
+      buffer = slot.output.data() + slot.output_size;
+      size = slot.output.size() - slot.output_size;
+    }
+
+    ssize_t n = read(slot.output_fd, buffer, size);
+    if (n > 0) {
+      if (buffer != discarded) {
+        slot.output_size += n;
+      }
+    } else if (n < 0 && errno == EAGAIN) {
+      break;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      // end of the output
+      epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, slot.output_fd, nullptr);
+      close(slot.output_fd);
+      slot.output_fd = -1;
+    }
+  }
+}
+
+void Aca_Command_Executor::_finish(size_t slot_index, int status,
+                                   std::vector<std::function<void()> > &done_calls)
+{
+  Slot &slot = _slots[slot_index];
+
+  // what the child wrote before it exited is in the pipe already
+  _read_output(slot);
+  if (slot.pidfd >= 0) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, slot.pidfd, nullptr);
+    close(slot.pidfd);
+    slot.pidfd = -1;
+  }
+  if (slot.output_fd >= 0) {
+    // a process the command left running may still hold the pipe
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, slot.output_fd, nullptr);
+    close(slot.output_fd);
+    slot.output_fd = -1;
+  }
+
+  Command_Result result;
+  result.rc = slot.timed_out ? -ETIMEDOUT : status;
+  result.output.assign(slot.output.data(), slot.output_size);
+  result.elapse_time =
+          cast_to_microseconds(std::chrono::steady_clock::now() - slot.start_time).count();
+  done_fn_t done = std::move(slot.command.done);
+  done_calls.push_back([done, result]() mutable { done(std::move(result)); });
+
+  slot.pid = 0;
+  slot.command = Command();
+  _free_slots.push_back(slot_index);
+  _running--;
+}
+
+int Aca_Command_Executor::_get_wait_timeout_ms()
+{
+  int timeout_ms = -1;
+  time_point now = std::chrono::steady_clock::now();
+
+  for (auto &slot : _slots) {
+    if (slot.pid <= 0) {
+      continue;
+    }
+    int slot_timeout_ms = COMMAND_EXECUTOR_POLL_INTERVAL_IN_MILLISECONDS;
+    if (slot.pidfd >= 0) {
+      auto left_us = slot.timed_out ? 0 : cast_to_microseconds(slot.deadline - now).count();
+      slot_timeout_ms = left_us <= 0 ? COMMAND_EXECUTOR_POLL_INTERVAL_IN_MILLISECONDS :
+                                       (int)std::min<int64_t>((left_us + 999) / 1000, INT_MAX);
+    }
+    if (timeout_ms < 0 || slot_timeout_ms < timeout_ms) {
+      timeout_ms = slot_timeout_ms;
+    }
+  }
+  return timeout_ms;
+}
+
+void Aca_Command_Executor::_wakeup()
+{
+  uint64_t count = 1;
+  if (write(_wakeup_fd, &count, sizeof(count)) < 0) {
+    ACA_LOG_DEBUG("Aca_Command_Executor::_wakeup - eventfd write failed, errno: %d\n", errno);
+  }
+}
+} // namespace aca_net_config
@@ -16,6 +16,8 @@
 #include "aca_util.h"
 #include "aca_config.h"
 #include "aca_net_config.h"
+#include "aca_command_executor.h"
+#include "aca_netlink_config.h"
 
 #include <stdexcept>
 #include <stdio.h>
@@ -36,6 +38,21 @@ Aca_Net_Config &Aca_Net_Config::get_instance()
   return instance;
 }
 
+Aca_Net_Config::Aca_Net_Config()
+{
+  configure((net_config_backend)NET_CONFIG_BACKEND);
+}
+
+void Aca_Net_Config::configure(net_config_backend backend)
+{
+  _backend = backend < NET_CONFIG_BACKEND_MAX ? backend : NET_CONFIG_BACKEND_SHELL;
+}
+
+net_config_backend Aca_Net_Config::get_backend()
+{
+  return _backend;
+}
+
 int Aca_Net_Config::create_namespace(string ns_name, ulong &culminative_time)
 {
   int rc;
@@ -46,6 +63,13 @@ int Aca_Net_Config::create_namespace(string ns_name, ulong &culminative_time)
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink(
+            "create namespace " + ns_name,
+            [&] { return Aca_Netlink_Config::get_instance().create_namespace(ns_name); },
+            culminative_time);
+  }
+
   string cmd_string = IP_NETNS_PREFIX + "add " + ns_name;
 
   return execute_system_command(cmd_string, culminative_time);
@@ -69,6 +93,15 @@ int Aca_Net_Config::create_veth_pair(string veth_name, string peer_name, ulong &
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink("create veth pair " + veth_name + " " + peer_name,
+                            [&] {
+                              return Aca_Netlink_Config::get_instance().create_veth_pair(
+                                      veth_name, peer_name);
+                            },
+                            culminative_time);
+  }
+
   string cmd_string = "ip link add " + veth_name + " type veth peer name " + peer_name;
 
   return execute_system_command(cmd_string, culminative_time);
@@ -84,6 +117,13 @@ int Aca_Net_Config::delete_veth_pair(string peer_name, ulong &culminative_time)
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink(
+            "delete link " + peer_name,
+            [&] { return Aca_Netlink_Config::get_instance().delete_link(peer_name); },
+            culminative_time);
+  }
+
   string cmd_string = "ip link delete " + peer_name;
 
   return execute_system_command(cmd_string, culminative_time);
@@ -99,6 +139,15 @@ int Aca_Net_Config::setup_peer_device(string peer_name, ulong &culminative_time)
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink("set link up " + peer_name,
+                            [&] {
+                              return Aca_Netlink_Config::get_instance().set_link_up(
+                                      "", peer_name, DEFAULT_MTU);
+                            },
+                            culminative_time);
+  }
+
   string cmd_string =
           "ip link set dev " + peer_name + " up mtu " + std::to_string(DEFAULT_MTU);
 
@@ -121,6 +170,15 @@ int Aca_Net_Config::move_to_namespace(string veth_name, string ns_name, ulong &c
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink("move link " + veth_name + " to namespace " + ns_name,
+                            [&] {
+                              return Aca_Netlink_Config::get_instance().move_to_namespace(
+                                      veth_name, ns_name);
+                            },
+                            culminative_time);
+  }
+
   string cmd_string = "ip link set " + veth_name + " netns " + ns_name;
 
   return execute_system_command(cmd_string, culminative_time);
@@ -169,31 +227,45 @@ int Aca_Net_Config::setup_veth_device(string ns_name, veth_config new_veth_confi
     return overall_rc;
   }
 
-  cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ip addr add " +
-               new_veth_config.ip + "/" + new_veth_config.prefix_len + " dev " +
-               new_veth_config.veth_name;
-  command_rc = execute_system_command(cmd_string, culminative_time);
-  if (command_rc != EXIT_SUCCESS)
-    overall_rc = command_rc;
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    // address, mac, link up and gateway in one batch
+    overall_rc = _execute_netlink("setup veth device " + new_veth_config.veth_name +
+                                          " in namespace " + ns_name,
+                                  [&] {
+                                    return Aca_Netlink_Config::get_instance().setup_veth_device(
+                                            ns_name, new_veth_config);
+                                  },
+                                  culminative_time);
+  } else {
+    cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ip addr add " +
+                 new_veth_config.ip + "/" + new_veth_config.prefix_len + " dev " +
+                 new_veth_config.veth_name;
+    command_rc = execute_system_command(cmd_string, culminative_time);
+    if (command_rc != EXIT_SUCCESS)
+      overall_rc = command_rc;
 
-  cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ip link set dev " +
-               new_veth_config.veth_name + " up";
-  command_rc = execute_system_command(cmd_string, culminative_time);
-  if (command_rc != EXIT_SUCCESS)
-    overall_rc = command_rc;
+    cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ip link set dev " +
+                 new_veth_config.veth_name + " up";
+    command_rc = execute_system_command(cmd_string, culminative_time);
+    if (command_rc != EXIT_SUCCESS)
+      overall_rc = command_rc;
 
-  cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " route add default gw " +
-               new_veth_config.gateway_ip;
-  command_rc = execute_system_command(cmd_string, culminative_time);
-  // it is okay if the gateway is already setup
-  //   if (command_rc != EXIT_SUCCESS)
-  //     overall_rc = command_rc;
+    cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " route add default gw " +
+                 new_veth_config.gateway_ip;
+    command_rc = execute_system_command(cmd_string, culminative_time);
+    // it is okay if the gateway is already setup
+    //   if (command_rc != EXIT_SUCCESS)
+    //     overall_rc = command_rc;
 
-  cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ifconfig " +
-               new_veth_config.veth_name + " hw ether " + new_veth_config.mac;
-  command_rc = execute_system_command(cmd_string, culminative_time);
-  if (command_rc != EXIT_SUCCESS)
-    overall_rc = command_rc;
+    cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ifconfig " +
+                 new_veth_config.veth_name + " hw ether " + new_veth_config.mac;
+    command_rc = execute_system_command(cmd_string, culminative_time);
+    if (command_rc != EXIT_SUCCESS)
+      overall_rc = command_rc;
+  }
+
+  // sysctl and ethtool have no rtnetlink equivalent, the demo mode keeps
+  // running them as commands
 
   if (g_demo_mode) {
     cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " sysctl -w net.ipv4.tcp_mtu_probing=2";
@@ -249,6 +321,16 @@ int Aca_Net_Config::rename_veth_device(string ns_name, string org_veth_name,
     return overall_rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink("rename link " + org_veth_name + " to " + new_veth_name +
+                                    " in namespace " + ns_name,
+                            [&] {
+                              return Aca_Netlink_Config::get_instance().rename_link(
+                                      ns_name, org_veth_name, new_veth_name);
+                            },
+                            culminative_time);
+  }
+
   // bring the link down
   cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " ip link set dev " +
                org_veth_name + " down";
@@ -291,6 +373,15 @@ int Aca_Net_Config::add_gw(string ns_name, string gateway_ip, ulong &culminative
     return rc;
   }
 
+  if (_backend == NET_CONFIG_BACKEND_NETLINK) {
+    return _execute_netlink("add default gw " + gateway_ip + " in namespace " + ns_name,
+                            [&] {
+                              return Aca_Netlink_Config::get_instance().add_default_route(
+                                      ns_name, gateway_ip);
+                            },
+                            culminative_time);
+  }
+
   cmd_string = IP_NETNS_PREFIX + "exec " + ns_name + " route add default gw " + gateway_ip;
   rc = execute_system_command(cmd_string, culminative_time);
 
@@ -318,7 +409,7 @@ int Aca_Net_Config::execute_system_command(string cmd_string, ulong &culminative
 
   auto execute_system_time_start = chrono::steady_clock::now();
 
-  rc = system(cmd_string.c_str());
+  rc = Aca_Command_Executor::get_instance().execute(cmd_string).rc;
 
   auto execute_system_time_end = chrono::steady_clock::now();
 
@@ -345,30 +436,47 @@ int Aca_Net_Config::execute_system_command(string cmd_string, ulong &culminative
 
 std::string Aca_Net_Config::execute_system_command_with_return(string cmd_string)
 {
-    char buffer[128];
-    std::string result = "";
-
-    FILE* pipe = popen(cmd_string.c_str(), "r");
-    if (!pipe)
-    {
-        ACA_LOG_ERROR("Aca_Net_Config::execute_system_command_with_return - failed to read output from popen\n");
-    }
-
-    try
-    {
-        while (fgets(buffer, sizeof buffer, pipe) != NULL)
-        {
-            result += buffer;
-        }
-    }
-    catch (...)
-    {
-        pclose(pipe);
-        ACA_LOG_ERROR("Aca_Net_Config::execute_system_command_with_return - failed to pclose cmd pipe\n");
-    }
-    pclose(pipe);
-
-    return result;
+  Command_Result result = Aca_Command_Executor::get_instance().execute(cmd_string, true);
+
+  if (result.rc < 0) {
+    ACA_LOG_ERROR("Aca_Net_Config::execute_system_command_with_return - failed to run %s, rc: %d\n",
+                  cmd_string.c_str(), result.rc);
+  }
+
+  return result.output;
+}
+
+int Aca_Net_Config::_execute_netlink(const string &operation,
+                                     const std::function<int()> &netlink_fn,
+                                     ulong &culminative_time)
+{
+  ACA_LOG_INFO("Executing netlink operation: %s\n", operation.c_str());
+
+  auto execute_netlink_time_start = chrono::steady_clock::now();
+
+  int rc = netlink_fn();
+
+  auto execute_netlink_time_end = chrono::steady_clock::now();
+
+  auto execute_netlink_elapse_time =
+          cast_to_microseconds(execute_netlink_time_end - execute_netlink_time_start)
+                  .count();
+
+  culminative_time += execute_netlink_elapse_time;
+
+  g_total_execute_system_time += execute_netlink_elapse_time;
+
+  if (rc == EXIT_SUCCESS) {
+    ACA_LOG_INFO("%s", "Netlink operation succeeded!\n");
+  } else {
+    ACA_LOG_DEBUG("Netlink operation failed!!! rc: %d\n", rc);
+  }
+
+  ACA_LOG_DEBUG(" Elapsed time for netlink operation [%s] took: %ld microseconds or %ld milliseconds.\n",
+                operation.c_str(), execute_netlink_elapse_time,
+                us_to_ms(execute_netlink_elapse_time));
+
+  return rc;
 }
 
 } // namespace aca_net_config
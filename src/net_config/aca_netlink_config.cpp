@@ -0,0 +1,652 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "aca_netlink_config.h"
+#include "aca_log.h"
+#include "aca_config.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/veth.h>
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef NETLINK_CAP_ACK
+#define NETLINK_CAP_ACK 10
+#endif
+
+// how long a batch waits for its ACKs, rtnetlink answers them from within sendmsg()
+#define NETLINK_RECEIVE_TIMEOUT_IN_SECONDS 5
+
+#define NETLINK_RECEIVE_BUFFER_SIZE (32 * 1024)
+
+// a socket holds its namespace, the sockets of the namespaces not used for
+// the longest time are closed past this many
+#define NETLINK_MAX_CACHED_SOCKETS 256
+
+using namespace std;
+
+namespace aca_net_config
+{
+Netlink_Message::Netlink_Message(uint16_t type, uint16_t flags)
+{
+  struct nlmsghdr header;
+  memset(&header, 0, sizeof(header));
+  header.nlmsg_len = NLMSG_HDRLEN;
+  header.nlmsg_type = type;
+  header.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+  _buffer.reserve(256);
+  _append(&header, NLMSG_HDRLEN);
+}
+
+void Netlink_Message::put(const void *data, size_t len)
+{
+  _append(data, len);
+}
+
+void Netlink_Message::put_attr(uint16_t type, const void *data, size_t len)
+{
+  struct rtattr attr;
+  attr.rta_len = RTA_LENGTH(len);
+  attr.rta_type = type;
+  _append(&attr, sizeof(attr));
+  _append(data, len);
+}
+
+void Netlink_Message::put_attr_u32(uint16_t type, uint32_t value)
+{
+  put_attr(type, &value, sizeof(value));
+}
+
+void Netlink_Message::put_attr_string(uint16_t type, const std::string &value)
+{
+  put_attr(type, value.c_str(), value.size() + 1);
+}
+
+size_t Netlink_Message::begin_nest(uint16_t type)
+{
+  size_t offset = _buffer.size();
+  put_attr(type, nullptr, 0);
+  return offset;
+}
+
+void Netlink_Message::end_nest(size_t offset)
+{
+  struct rtattr *attr = reinterpret_cast<struct rtattr *>(_buffer.data() + offset);
+  attr->rta_len = _buffer.size() - offset;
+}
+
+struct nlmsghdr *Netlink_Message::header()
+{
+  return reinterpret_cast<struct nlmsghdr *>(_buffer.data());
+}
+
+void Netlink_Message::_append(const void *data, size_t len)
+{
+  // every piece starts aligned, the padding is zeroed
+  size_t offset = _buffer.size();
+  _buffer.resize(offset + NLMSG_ALIGN(len), 0);
+  if (len > 0) {
+    memcpy(_buffer.data() + offset, data, len);
+  }
+  header()->nlmsg_len = _buffer.size();
+}
+
+Aca_Netlink_Config::Netlink_Socket::~Netlink_Socket()
+{
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+static int parse_ip(const std::string &ip, int &family, unsigned char address[16], size_t &len)
+{
+  family = ip.find(':') == std::string::npos ? AF_INET : AF_INET6;
+  len = family == AF_INET ? 4 : 16;
+  return inet_pton(family, ip.c_str(), address) == 1 ? EXIT_SUCCESS : -EINVAL;
+}
+
+static int parse_mac(const std::string &mac, unsigned char address[6])
+{
+  char end;
+  int n = sscanf(mac.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx%c", &address[0], &address[1],
+                 &address[2], &address[3], &address[4], &address[5], &end);
+  return n == 6 ? EXIT_SUCCESS : -EINVAL;
+}
+
+static Netlink_Message create_link_message(int link_index, const std::string &link_name,
+                                           uint flags, uint change)
+{
+  Netlink_Message message(RTM_NEWLINK, 0);
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  ifi.ifi_index = link_index;
+  ifi.ifi_flags = flags;
+  ifi.ifi_change = change;
+  message.put(&ifi, sizeof(ifi));
+  // the kernel finds the link by its name when there is no index
+  if (link_index == 0) {
+    message.put_attr_string(IFLA_IFNAME, link_name);
+  }
+  return message;
+}
+
+static Netlink_Message create_default_route_message(int family, const unsigned char *gateway,
+                                                    size_t len)
+{
+  Netlink_Message message(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL);
+  struct rtmsg rtm;
+  memset(&rtm, 0, sizeof(rtm));
+  rtm.rtm_family = family;
+  rtm.rtm_table = RT_TABLE_MAIN;
+  rtm.rtm_protocol = RTPROT_BOOT;
+  rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+  rtm.rtm_type = RTN_UNICAST;
+  message.put(&rtm, sizeof(rtm));
+  message.put_attr(RTA_GATEWAY, gateway, len);
+  return message;
+}
+
+// like "ip netns add", the namespace mounts under dir propagate to the other
+// mount namespaces, dir is bind mounted on itself first if it is no mount point
+static int make_shared_mount(const std::string &dir)
+{
+  bool bind_mounted = false;
+
+  while (mount("", dir.c_str(), "none", MS_SHARED | MS_REC, nullptr) != 0) {
+    if (errno != EINVAL || bind_mounted) {
+      return -errno;
+    }
+    if (mount(dir.c_str(), dir.c_str(), "none", MS_BIND | MS_REC, nullptr) != 0) {
+      return -errno;
+    }
+    bind_mounted = true;
+  }
+  return EXIT_SUCCESS;
+}
+
+Aca_Netlink_Config &Aca_Netlink_Config::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static Aca_Netlink_Config instance(NET_CONFIG_NETNS_DIR);
+  return instance;
+}
+
+Aca_Netlink_Config::Aca_Netlink_Config(const std::string &netns_dir)
+        : _netns_dir(netns_dir), _sockets_used(0)
+{
+}
+
+Aca_Netlink_Config::~Aca_Netlink_Config()
+{
+}
+
+int Aca_Netlink_Config::create_namespace(const std::string &ns_name)
+{
+  if (ns_name.empty() || ns_name.find('/') != std::string::npos) {
+    return -EINVAL;
+  }
+
+  if (mkdir(_netns_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    int rc = -errno;
+    ACA_LOG_ERROR("Aca_Netlink_Config::create_namespace - can't create %s, rc: %d\n",
+                  _netns_dir.c_str(), rc);
+    return rc;
+  }
+  int rc = make_shared_mount(_netns_dir);
+  if (rc != EXIT_SUCCESS) {
+    ACA_LOG_ERROR("Aca_Netlink_Config::create_namespace - can't make %s a shared mount, rc: %d\n",
+                  _netns_dir.c_str(), rc);
+    return rc;
+  }
+  std::string netns_path = _netns_dir + "/" + ns_name;
+  int fd = open(netns_path.c_str(), O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0);
+  if (fd < 0) {
+    return -errno;
+  }
+  close(fd);
+
+  // a thread of its own enters the new namespace, which lives on in the
+  // bind mount once the thread is gone
+  std::thread([&rc, &netns_path] {
+    if (unshare(CLONE_NEWNET) != 0 ||
+        mount("/proc/thread-self/ns/net", netns_path.c_str(), "none", MS_BIND, nullptr) != 0) {
+      rc = -errno;
+    }
+  }).join();
+
+  if (rc != EXIT_SUCCESS) {
+    ACA_LOG_ERROR("Aca_Netlink_Config::create_namespace - can't create %s, rc: %d\n",
+                  ns_name.c_str(), rc);
+    unlink(netns_path.c_str());
+  }
+  return rc;
+}
+
+int Aca_Netlink_Config::create_veth_pair(const std::string &veth_name, const std::string &peer_name)
+{
+  std::vector<Netlink_Message> messages;
+  messages.emplace_back(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+  Netlink_Message &message = messages.back();
+
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  message.put(&ifi, sizeof(ifi));
+  message.put_attr_string(IFLA_IFNAME, veth_name);
+
+  size_t link_info = message.begin_nest(IFLA_LINKINFO);
+  message.put_attr(IFLA_INFO_KIND, "veth", strlen("veth"));
+  size_t info_data = message.begin_nest(IFLA_INFO_DATA);
+  size_t peer_info = message.begin_nest(VETH_INFO_PEER);
+  message.put(&ifi, sizeof(ifi));
+  message.put_attr_string(IFLA_IFNAME, peer_name);
+  message.end_nest(peer_info);
+  message.end_nest(info_data);
+  message.end_nest(link_info);
+
+  return _execute("", messages);
+}
+
+int Aca_Netlink_Config::delete_link(const std::string &link_name)
+{
+  std::vector<Netlink_Message> messages;
+  messages.emplace_back(RTM_DELLINK, 0);
+
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  messages.back().put(&ifi, sizeof(ifi));
+  messages.back().put_attr_string(IFLA_IFNAME, link_name);
+
+  return _execute("", messages);
+}
+
+int Aca_Netlink_Config::set_link_up(const std::string &ns_name, const std::string &link_name, uint mtu)
+{
+  std::vector<Netlink_Message> messages;
+  messages.push_back(create_link_message(0, link_name, IFF_UP, IFF_UP));
+  if (mtu > 0) {
+    messages.back().put_attr_u32(IFLA_MTU, mtu);
+  }
+
+  return _execute(ns_name, messages);
+}
+
+int Aca_Netlink_Config::move_to_namespace(const std::string &link_name, const std::string &ns_name)
+{
+  std::string netns_path = _netns_dir + "/" + ns_name;
+  int netns_fd = open(netns_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (netns_fd < 0) {
+    int rc = -errno;
+    ACA_LOG_ERROR("Aca_Netlink_Config::move_to_namespace - can't open %s, rc: %d\n",
+                  netns_path.c_str(), rc);
+    return rc;
+  }
+
+  std::vector<Netlink_Message> messages;
+  messages.push_back(create_link_message(0, link_name, 0, 0));
+  messages.back().put_attr_u32(IFLA_NET_NS_FD, netns_fd);
+
+  int rc = _execute("", messages);
+  close(netns_fd);
+  return rc;
+}
+
+int Aca_Netlink_Config::setup_veth_device(const std::string &ns_name, const veth_config &new_veth_config)
+{
+  int family, gateway_family;
+  unsigned char address[16], gateway[16], mac[6];
+  size_t address_len, gateway_len;
+  int prefix_len = atoi(new_veth_config.prefix_len.c_str());
+
+  if (parse_ip(new_veth_config.ip, family, address, address_len) != EXIT_SUCCESS ||
+      parse_ip(new_veth_config.gateway_ip, gateway_family, gateway, gateway_len) != EXIT_SUCCESS ||
+      parse_mac(new_veth_config.mac, mac) != EXIT_SUCCESS || prefix_len < 0 ||
+      prefix_len > (int)address_len * 8) {
+    ACA_LOG_ERROR("Aca_Netlink_Config::setup_veth_device - invalid config of %s\n",
+                  new_veth_config.veth_name.c_str());
+    return -EINVAL;
+  }
+
+  int rc;
+  std::shared_ptr<Netlink_Socket> netlink_socket = _get_socket(ns_name, rc);
+  if (netlink_socket == nullptr) {
+    return rc;
+  }
+  int link_index = _get_link_index(*netlink_socket, new_veth_config.veth_name);
+  if (link_index < 0) {
+    ACA_LOG_ERROR("Aca_Netlink_Config::setup_veth_device - %s not found in %s, rc: %d\n",
+                  new_veth_config.veth_name.c_str(), ns_name.c_str(), link_index);
+    return link_index;
+  }
+
+  std::vector<Netlink_Message> messages;
+
+  // the mac is set before the link goes up
+  messages.push_back(create_link_message(link_index, "", IFF_UP, IFF_UP));
+  messages.back().put_attr(IFLA_ADDRESS, mac, sizeof(mac));
+
+  messages.emplace_back(RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL);
+  struct ifaddrmsg ifa;
+  memset(&ifa, 0, sizeof(ifa));
+  ifa.ifa_family = family;
+  ifa.ifa_prefixlen = prefix_len;
+  ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+  ifa.ifa_index = link_index;
+  messages.back().put(&ifa, sizeof(ifa));
+  messages.back().put_attr(IFA_LOCAL, address, address_len);
+  messages.back().put_attr(IFA_ADDRESS, address, address_len);
+
+  messages.push_back(create_default_route_message(gateway_family, gateway, gateway_len));
+
+  std::vector<int> errors;
+  rc = _transact(*netlink_socket, messages, errors);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  // it is okay if the gateway is already setup
+  if (errors[2] != 0) {
+    ACA_LOG_DEBUG("Aca_Netlink_Config::setup_veth_device - default route via %s not added, rc: %d\n",
+                  new_veth_config.gateway_ip.c_str(), errors[2]);
+  }
+  return errors[0] != 0 ? errors[0] : errors[1];
+}
+
+int Aca_Netlink_Config::rename_link(const std::string &ns_name, const std::string &link_name,
+                                    const std::string &new_link_name)
+{
+  int rc;
+  std::shared_ptr<Netlink_Socket> netlink_socket = _get_socket(ns_name, rc);
+  if (netlink_socket == nullptr) {
+    return rc;
+  }
+  int link_index = _get_link_index(*netlink_socket, link_name);
+  if (link_index < 0) {
+    return link_index;
+  }
+
+  std::vector<Netlink_Message> messages;
+  messages.push_back(create_link_message(link_index, "", 0, IFF_UP));
+  messages.push_back(create_link_message(link_index, "", 0, 0));
+  messages.back().put_attr_string(IFLA_IFNAME, new_link_name);
+  messages.push_back(create_link_message(link_index, "", IFF_UP, IFF_UP));
+
+  std::vector<int> errors;
+  rc = _transact(*netlink_socket, messages, errors);
+  for (size_t i = 0; rc == EXIT_SUCCESS && i < errors.size(); i++) {
+    rc = errors[i];
+  }
+  return rc;
+}
+
+int Aca_Netlink_Config::add_default_route(const std::string &ns_name, const std::string &gateway_ip)
+{
+  int family;
+  unsigned char gateway[16];
+  size_t gateway_len;
+
+  if (parse_ip(gateway_ip, family, gateway, gateway_len) != EXIT_SUCCESS) {
+    return -EINVAL;
+  }
+
+  std::vector<Netlink_Message> messages;
+  messages.push_back(create_default_route_message(family, gateway, gateway_len));
+  return _execute(ns_name, messages);
+}
+
+int Aca_Netlink_Config::get_link_index(const std::string &ns_name, const std::string &link_name)
+{
+  int rc;
+  std::shared_ptr<Netlink_Socket> netlink_socket = _get_socket(ns_name, rc);
+  if (netlink_socket == nullptr) {
+    return rc;
+  }
+  return _get_link_index(*netlink_socket, link_name);
+}
+
+std::shared_ptr<Aca_Netlink_Config::Netlink_Socket>
+Aca_Netlink_Config::_get_socket(const std::string &ns_name, int &rc)
+{
+  int netns_fd = -1;
+  ino_t netns_ino = 0;
+
+  if (!ns_name.empty()) {
+    std::string netns_path = _netns_dir + "/" + ns_name;
+    struct stat netns_stat;
+    netns_fd = open(netns_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (netns_fd < 0 || fstat(netns_fd, &netns_stat) != 0) {
+      rc = -errno;
+      ACA_LOG_ERROR("Aca_Netlink_Config::_get_socket - can't open %s, rc: %d\n",
+                    netns_path.c_str(), rc);
+      if (netns_fd >= 0) {
+        close(netns_fd);
+      }
+      // the namespace is gone, its socket must not keep it alive
+      std::lock_guard<std::mutex> lock(_sockets_mutex);
+      _sockets.erase(ns_name);
+      return nullptr;
+    }
+    netns_ino = netns_stat.st_ino;
+  }
+
+  std::lock_guard<std::mutex> lock(_sockets_mutex);
+
+  auto found = _sockets.find(ns_name);
+  if (found != _sockets.end() && found->second->netns_ino == netns_ino) {
+    if (netns_fd >= 0) {
+      close(netns_fd);
+    }
+    found->second->last_used = ++_sockets_used;
+    return found->second;
+  }
+  _evict_sockets();
+
+  // the socket belongs to the namespace of the thread creating it
+  int fd = -1;
+  rc = EXIT_SUCCESS;
+  auto open_socket = [&fd, &rc] {
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+      rc = -errno;
+    }
+  };
+  if (netns_fd < 0) {
+    open_socket();
+  } else {
+    std::thread([&] {
+      if (setns(netns_fd, CLONE_NEWNET) != 0) {
+        rc = -errno;
+      } else {
+        open_socket();
+      }
+    }).join();
+    close(netns_fd);
+  }
+
+  struct sockaddr_nl local;
+  memset(&local, 0, sizeof(local));
+  local.nl_family = AF_NETLINK;
+  if (fd >= 0 && bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+    rc = -errno;
+  }
+  if (rc != EXIT_SUCCESS) {
+    ACA_LOG_ERROR("Aca_Netlink_Config::_get_socket - can't open the socket of namespace [%s], rc: %d\n",
+                  ns_name.c_str(), rc);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return nullptr;
+  }
+
+  // the ACKs leave out the request they answer
+  int cap_ack = 1;
+  setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &cap_ack, sizeof(cap_ack));
+  struct timeval timeout = { NETLINK_RECEIVE_TIMEOUT_IN_SECONDS, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::shared_ptr<Netlink_Socket> netlink_socket = std::make_shared<Netlink_Socket>();
+  netlink_socket->fd = fd;
+  netlink_socket->netns_ino = netns_ino;
+  netlink_socket->next_seq = 1;
+  netlink_socket->last_used = ++_sockets_used;
+  _sockets[ns_name] = netlink_socket;
+  return netlink_socket;
+}
+
+void Aca_Netlink_Config::_evict_sockets()
+{
+  // the namespaces deleted or replaced outside of the agent
+  for (auto entry = _sockets.begin(); entry != _sockets.end();) {
+    struct stat netns_stat;
+    if (!entry->first.empty() &&
+        (stat((_netns_dir + "/" + entry->first).c_str(), &netns_stat) != 0 ||
+         netns_stat.st_ino != entry->second->netns_ino)) {
+      entry = _sockets.erase(entry);
+    } else {
+      entry++;
+    }
+  }
+
+  // room for the new socket, a batch still using an evicted one keeps it open
+  while (_sockets.size() >= NETLINK_MAX_CACHED_SOCKETS) {
+    auto oldest = _sockets.begin();
+    for (auto entry = _sockets.begin(); entry != _sockets.end(); entry++) {
+      if (entry->second->last_used < oldest->second->last_used) {
+        oldest = entry;
+      }
+    }
+    _sockets.erase(oldest);
+  }
+}
+
+int Aca_Netlink_Config::_execute(const std::string &ns_name, std::vector<Netlink_Message> &messages)
+{
+  int rc;
+  std::shared_ptr<Netlink_Socket> netlink_socket = _get_socket(ns_name, rc);
+  if (netlink_socket == nullptr) {
+    return rc;
+  }
+
+  std::vector<int> errors;
+  rc = _transact(*netlink_socket, messages, errors);
+  for (size_t i = 0; rc == EXIT_SUCCESS && i < errors.size(); i++) {
+    rc = errors[i];
+  }
+  return rc;
+}
+
+int Aca_Netlink_Config::_transact(Netlink_Socket &netlink_socket, std::vector<Netlink_Message> &messages,
+                                  std::vector<int> &errors, int *link_index)
+{
+  std::lock_guard<std::mutex> lock(netlink_socket.mutex);
+
+  size_t total = messages.size();
+  uint32_t first_seq = netlink_socket.next_seq;
+  std::vector<struct iovec> iov(total);
+  for (size_t i = 0; i < total; i++) {
+    struct nlmsghdr *header = messages[i].header();
+    header->nlmsg_seq = netlink_socket.next_seq++;
+    iov[i].iov_base = header;
+    iov[i].iov_len = header->nlmsg_len;
+  }
+
+  struct sockaddr_nl kernel;
+  memset(&kernel, 0, sizeof(kernel));
+  kernel.nl_family = AF_NETLINK;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &kernel;
+  msg.msg_namelen = sizeof(kernel);
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = total;
+  if (sendmsg(netlink_socket.fd, &msg, 0) < 0) {
+    int rc = -errno;
+    ACA_LOG_ERROR("Aca_Netlink_Config::_transact - sendmsg failed, rc: %d\n", rc);
+    return rc;
+  }
+
+  // the answers of an earlier batch which timed out have older sequence numbers
+  errors.assign(total, 0);
+  std::vector<bool> answered(total, false);
+  size_t pending = total;
+  std::vector<uint32_t> buffer(NETLINK_RECEIVE_BUFFER_SIZE / sizeof(uint32_t));
+  while (pending > 0) {
+    ssize_t received = recv(netlink_socket.fd, buffer.data(), NETLINK_RECEIVE_BUFFER_SIZE, 0);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int rc = errno == EAGAIN ? -ETIMEDOUT : -errno;
+      ACA_LOG_ERROR("Aca_Netlink_Config::_transact - %lu answers missing, rc: %d\n", pending, rc);
+      return rc;
+    }
+
+    int len = (int)received;
+    for (struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(buffer.data());
+         NLMSG_OK(header, len); header = NLMSG_NEXT(header, len)) {
+      uint32_t index = header->nlmsg_seq - first_seq;
+      if (index >= total || answered[index]) {
+        continue;
+      }
+      if (header->nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *error = static_cast<struct nlmsgerr *>(NLMSG_DATA(header));
+        errors[index] = error->error;
+        answered[index] = true;
+        pending--;
+      } else if (header->nlmsg_type == RTM_NEWLINK && link_index != nullptr) {
+        struct ifinfomsg *ifi = static_cast<struct ifinfomsg *>(NLMSG_DATA(header));
+        *link_index = ifi->ifi_index;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int Aca_Netlink_Config::_get_link_index(Netlink_Socket &netlink_socket, const std::string &link_name)
+{
+  std::vector<Netlink_Message> messages;
+  messages.emplace_back(RTM_GETLINK, 0);
+
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  messages.back().put(&ifi, sizeof(ifi));
+  messages.back().put_attr_string(IFLA_IFNAME, link_name);
+
+  std::vector<int> errors;
+  int link_index = 0;
+  int rc = _transact(netlink_socket, messages, errors, &link_index);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  if (errors[0] != 0) {
+    return errors[0];
+  }
+  return link_index > 0 ? link_index : -ENODEV;
+}
+} // namespace aca_net_config
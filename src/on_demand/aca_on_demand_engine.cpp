@@ -22,12 +22,14 @@
 #include "aca_config.h"
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include <signal.h>
 #include <syslog.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <atomic>
 #include <chrono>
 #include <errno.h>
 #include <stdexcept>
@@ -35,7 +37,6 @@
 #include <net/ethernet.h>
 #include <netinet/ip.h>
 #include <arpa/inet.h>
-#include <uuid/uuid.h>
 #include <unistd.h>
 #include "goalstateprovisioner.pb.h"
 #include "aca_dhcp_server.h"
@@ -56,6 +57,23 @@ using namespace aca_arp_responder;
 using namespace alcor::schema;
 
 extern std::atomic_ulong g_total_execute_system_time;
+extern std::atomic_ulong g_total_on_demand_requests_issued;
+extern std::atomic_ulong g_total_on_demand_requests_coalesced;
+extern std::atomic_ulong g_total_on_demand_negative_cache_hits;
+extern std::atomic_ulong g_total_on_demand_negative_cache_misses;
+extern std::atomic_ulong g_total_on_demand_dropped_newest;
+extern std::atomic_ulong g_total_on_demand_dropped_oldest;
+extern std::atomic_ulong g_total_on_demand_dropped_fair_share;
+extern std::atomic_ulong g_total_on_demand_pending_packets_dropped;
+extern std::atomic_ulong g_total_on_demand_pending_packets_replayed;
+extern std::atomic_ulong g_total_on_demand_prefetch_issued;
+extern std::atomic_ulong g_total_on_demand_prefetch_hits;
+extern std::atomic_ulong g_total_on_demand_prefetch_late;
+extern std::atomic_ulong g_total_on_demand_prefetch_unused;
+extern std::atomic_ulong g_total_on_demand_batches_sent;
+extern std::atomic_ulong g_total_on_demand_batched_requests;
+extern uint g_on_demand_pending_queue_max_packets;
+extern ulong g_on_demand_pending_queue_max_bytes;
 extern bool g_demo_mode;
 extern string g_ncm_address, g_ncm_port;
 extern GoalStateProvisionerClientImpl *g_grpc_client;
@@ -71,157 +89,220 @@ ACA_On_Demand_Engine &ACA_On_Demand_Engine::get_instance()
   return instance;
 }
 
+uint64_t ACA_On_Demand_Engine::generate_request_id()
+{
+  static std::atomic<uint64_t> next_request_id(
+          chrono::duration_cast<chrono::microseconds>(
+                  chrono::system_clock::now().time_since_epoch())
+                  .count());
+  return next_request_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+string ACA_On_Demand_Engine::request_id_to_string(uint64_t request_id)
+{
+  return std::to_string(request_id);
+}
+
+bool ACA_On_Demand_Engine::parse_request_id(const string &request_id_str, uint64_t &request_id)
+{
+  char *end = nullptr;
+
+  // strtoull would also take a sign or leading spaces
+  if (request_id_str.empty() || !isdigit(request_id_str[0])) {
+    return false;
+  }
+  errno = 0;
+  request_id = strtoull(request_id_str.c_str(), &end, 10);
+  return errno == 0 && *end == '\0';
+}
+
 /* 
-  This function checks request_uuid_on_demand_payload_map periodically and removes any 
-  entry that has been staying in the map for more than ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS
+  This function advances the timing wheel of request_id_on_demand_payload_table
+  every ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS and removes any entry
+  that has been staying in the table for more than ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS
 */
 void ACA_On_Demand_Engine::clean_remaining_payload()
 {
   ACA_LOG_DEBUG("\n", "Entering clean_remaining_payload");
   last_time_cleaned_remaining_payload = std::chrono::steady_clock::now();
+  std::vector<on_demand_payload *> expired_payloads;
 
   while (true) {
     usleep(ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS);
 
-    ACA_LOG_DEBUG("\n", "Checking if there's any leftover inside request_uuid_on_demand_payload_map");
     std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
-    /* Critical section begins */
-    _payload_map_mutex.lock();
-    auto size_before_cleanup = request_uuid_on_demand_payload_map.size();
-    for (auto it = request_uuid_on_demand_payload_map.cbegin();
-         it != request_uuid_on_demand_payload_map.cend();) {
-      auto request_id = it->first;
-      auto payload = it->second;
-      ACA_LOG_DEBUG("key = %s", request_id.c_str());
-      if (cast_to_microseconds(last_time_cleaned_remaining_payload - payload->insert_time)
-                  .count() >= ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS) {
-        ACA_LOG_DEBUG("Need to cleanup this key: %d\n", request_id.c_str());
-        request_uuid_on_demand_payload_map.erase(it++);
-      } else {
-        ++it;
-      }
+    expired_payloads.clear();
+    auto expired_count = request_id_on_demand_payload_table.expire(expired_payloads, start);
+    for (auto payload : expired_payloads) {
+      _drop_on_demand_request(payload);
     }
-    auto size_after_cleanup = request_uuid_on_demand_payload_map.size();
-    _payload_map_mutex.unlock();
-    /* Critical section ends */
+    g_total_on_demand_prefetch_unused += ACA_On_Demand_Prefetcher::get_instance().expire(start);
     std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
 
-    auto cleanup_time = cast_to_microseconds(end - start).count();
-
-    ACA_LOG_DEBUG("Cleaned up [%ld] entries in the map, which took [%ld]us, which is [%ld]ms\n",
-                  size_after_cleanup - size_before_cleanup, cleanup_time,
-                  us_to_ms(cleanup_time));
-
-    ACA_LOG_DEBUG("%s\n", "request_uuid_on_demand_payload_map check finished, sleeping");
-    last_time_cleaned_remaining_payload = std::chrono::steady_clock::now();
+    if (expired_count > 0) {
+      auto cleanup_time = cast_to_microseconds(end - start).count();
+      ACA_LOG_DEBUG("Cleaned up [%ld] entries in the table, which took [%ld]us, which is [%ld]ms\n",
+                    expired_count, cleanup_time, us_to_ms(cleanup_time));
+    }
+    last_time_cleaned_remaining_payload = end;
   }
 }
 
 void ACA_On_Demand_Engine::process_async_replies_asyncly(
-        string request_id, OperationStatus replyStatus,
+        uint64_t request_id, OperationStatus replyStatus,
         std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time)
 {
   ACA_LOG_DEBUG("Trying to process this hostOperationReply in another thread id: [%ld]",
                 std::this_thread::get_id());
-  std::unordered_map<std::__cxx11::string, on_demand_payload *, std::hash<std::__cxx11::string> >::iterator found_data;
-  on_demand_payload *request_payload;
+  on_demand_payload *request_payload = nullptr;
   ACA_LOG_DEBUG("%s\n", "Got an GRPC reply that is OK, need to process it.");
   ACA_LOG_DEBUG("Return from NCM - Reply Status: %s\n", to_string(replyStatus).c_str());
-  found_data = request_uuid_on_demand_payload_map.find(request_id);
-  if (found_data != request_uuid_on_demand_payload_map.end()) {
-    request_payload = found_data->second;
-    ACA_LOG_DEBUG("Found data into the map, UUID: [%s], in_port: [%d], protocol: [%d]\n",
-                  request_id.c_str(), request_payload->in_port, request_payload->protocol);
 
-    ACA_LOG_DEBUG("%s\n", "Printing out stuffs inside the unordered_map.");
+  std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // take() removes the entry, so a reply can't race with the expiry of the same request
+  bool found_data = request_id_on_demand_payload_table.take(request_id, request_payload);
+  std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
+  auto take_time = cast_to_microseconds(end - start).count();
+  ACA_LOG_DEBUG("Taking one entry from request_id_on_demand_payload_table took [%ld]us, which is [%ld]ms\n",
+                take_time, us_to_ms(take_time));
+
+  if (found_data) {
+    ACA_LOG_DEBUG("Found data into the table, request id: [%lu], in_port: [%d], protocol: [%d]\n",
+                  request_id, request_payload->in_port, request_payload->protocol);
+
+    // release the packets waiting for this reply, new packets to the same
+    // destination will go with a new request from now on
+    std::vector<on_demand_payload *> payloads;
+    payloads.push_back(request_payload);
+    release_on_demand_request(request_payload, payloads);
+
+    // the payloads go back to their pools when the handles go out of scope
+    std::vector<on_demand_payload_handle> payload_handles;
+    payload_handles.reserve(payloads.size());
+    for (auto payload : payloads) {
+      payload_handles.push_back(_payload_pool.adopt(payload));
+    }
+
+    if (replyStatus != OperationStatus::SUCCESS) {
+      // don't ask NCM about this destination again until it has a goal state for it
+      ACA_On_Demand_Negative_Cache::get_instance().add(
+              request_payload->tunnel_id, request_payload->flow_key.ip_dest);
+    } else {
+      // ask for the likely next destinations before waiting for this one
+      prefetch_neighbors(request_payload);
+    }
+
+    on_demand(request_id, replyStatus, payloads);
+
+    if (payloads.size() > 1) {
+      ACA_LOG_DEBUG("For request id: [%lu], released %ld pending packets\n",
+                    request_id, payloads.size() - 1);
+    }
 
-    on_demand(request_id, replyStatus, request_payload->in_port,
-              request_payload->packet, request_payload->packet_size,
-              request_payload->protocol, request_payload->insert_time);
-    std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
-    /* Critical section begins */
-    _payload_map_mutex.lock();
-    request_uuid_on_demand_payload_map.erase(request_id);
-    _payload_map_mutex.unlock();
-    /* Critical section ends */
-    std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
     auto end_high_rest = std::chrono::high_resolution_clock::now();
-    auto cleanup_time = cast_to_microseconds(end - start).count();
     auto process_successful_host_operation_reply_time =
             cast_to_microseconds(end_high_rest - received_ncm_reply_time).count();
-    ACA_LOG_DEBUG("Erasing one entry into request_uuid_on_demand_payload_map took [%ld]us, which is [%ld]ms\n",
-                  cleanup_time, us_to_ms(cleanup_time));
-    ACA_LOG_DEBUG("For UUID: [%s], processing a successful host operation reply took %ld milliseconds\n",
-                 request_id.c_str(),
+    ACA_LOG_DEBUG("For request id: [%lu], processing a successful host operation reply took %ld milliseconds\n",
+                 request_id,
                  us_to_ms(process_successful_host_operation_reply_time));
+  } else if (ACA_On_Demand_Prefetcher::get_instance().complete(request_id)) {
+    ACA_LOG_DEBUG("Prefetch request id: [%lu] completed\n", request_id);
+  } else {
+    ACA_LOG_DEBUG("Request id: [%lu] not found in the table, it may have expired\n",
+                  request_id);
   }
 }
 
-void ACA_On_Demand_Engine::process_async_grpc_replies()
+void ACA_On_Demand_Engine::process_async_grpc_reply(AsyncClientCall *call, bool ok)
 {
-  void *got_tag;
-  bool ok = false;
   HostRequestReply_HostRequestOperationStatus hostOperationStatus;
-  OperationStatus replyStatus;
-  string request_id;
-  ACA_LOG_DEBUG("%s\n", "Beginning of process_async_grpc_replies");
-  std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time_prev =
+  OperationStatus replyStatus = OperationStatus::FAILURE;
+  string request_id_str;
+  uint64_t request_id;
+  // every poller thread measures the interval between its own replies
+  static thread_local std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time_prev =
           std::chrono::high_resolution_clock::now();
-  while (_cq.Next(&got_tag, &ok)) {
-    std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time =
-            std::chrono::high_resolution_clock::now();
-
-    if (ok) {
-      ACA_LOG_DEBUG("%s\n", "_cq->Next is good, ready to static cast the Async Client Call");
-      auto received_ncm_reply_interval =
-              cast_to_microseconds(received_ncm_reply_time - received_ncm_reply_time_prev)
-                      .count();
-      ACA_LOG_DEBUG("[METRICS] Elapsed time between receiving the last and current hostOperationReply took: %ld microseconds or %ld milliseconds\n",
-                   received_ncm_reply_interval, (received_ncm_reply_interval / 1000));
-      received_ncm_reply_time_prev = received_ncm_reply_time;
-
-      AsyncClientCall *call = static_cast<AsyncClientCall *>(got_tag);
-      auto call_status_copy = call->status;
-      auto call_reply_copy = call->reply;
-      ACA_LOG_DEBUG("%s\n", "Async Client Call casted successfully.");
-
-      if (call->status.ok()) {
-        ACA_LOG_DEBUG("%s\n", "Got an GRPC reply that is OK, need to process it.");
-        for (int i = 0; i < call->reply.operation_statuses_size(); i++) {
-          hostOperationStatus = call->reply.operation_statuses(i);
-          replyStatus = hostOperationStatus.operation_status();
-          request_id = hostOperationStatus.request_id();
-        }
-        ACA_LOG_DEBUG("For UUID: [%s], NCM called returned at: %ld milliseconds\n",
-                      request_id.c_str(),
-                      chrono::duration_cast<chrono::milliseconds>(
-                              received_ncm_reply_time.time_since_epoch())
-                              .count());
-        ACA_LOG_DEBUG("Return from NCM - Reply Status: %s\n",
-                      to_string(replyStatus).c_str());
-        ACA_LOG_DEBUG("Received hostOperationReply in thread id: [%ld]\n",
-                     std::this_thread::get_id());
-        marl::schedule([=]{
-          process_async_replies_asyncly(request_id, replyStatus, received_ncm_reply_time);
-        });
+  std::chrono::_V2::high_resolution_clock::time_point received_ncm_reply_time =
+          std::chrono::high_resolution_clock::now();
+
+  // the call is over either way, answered, failed or past its deadline,
+  // the next batch can go
+  _request_batcher.complete(call->request_id);
+
+  if (!ok) {
+    ACA_LOG_DEBUG("%s\n", "Got an GRPC reply that is NOT OK, don't need to process the data");
+    return;
+  }
+
+  auto received_ncm_reply_interval =
+          cast_to_microseconds(received_ncm_reply_time - received_ncm_reply_time_prev).count();
+  ACA_LOG_DEBUG("[METRICS] Elapsed time between receiving the last and current hostOperationReply took: %ld microseconds or %ld milliseconds\n",
+                received_ncm_reply_interval, (received_ncm_reply_interval / 1000));
+  received_ncm_reply_time_prev = received_ncm_reply_time;
+
+  if (call->status.ok()) {
+    ACA_LOG_DEBUG("%s\n", "Got an GRPC reply that is OK, need to process it.");
+    ACA_LOG_DEBUG("For request id: [%lu], NCM called returned at: %ld milliseconds\n",
+                  call->request_id,
+                  chrono::duration_cast<chrono::milliseconds>(
+                          received_ncm_reply_time.time_since_epoch())
+                          .count());
+    ACA_LOG_DEBUG("Received hostOperationReply in thread id: [%ld]\n",
+                  std::this_thread::get_id());
+    // a batch carries one status per request, a prefetch one status per
+    // destination but all of them with the same request id
+    std::vector<uint64_t> scheduled_request_ids;
+    for (int i = 0; i < call->reply.operation_statuses_size(); i++) {
+      hostOperationStatus = call->reply.operation_statuses(i);
+      replyStatus = hostOperationStatus.operation_status();
+      request_id_str = hostOperationStatus.request_id();
+      ACA_LOG_DEBUG("Return from NCM - request id: [%s], Reply Status: %s\n",
+                    request_id_str.c_str(), to_string(replyStatus).c_str());
+      if (!parse_request_id(request_id_str, request_id)) {
+        ACA_LOG_ERROR("Invalid request id in hostOperationReply: [%s]\n",
+                      request_id_str.c_str());
+        continue;
       }
-    } else {
-      ACA_LOG_DEBUG("%s\n", "Got an GRPC reply that is NOT OK, don't need to process the data");
+      if (std::find(scheduled_request_ids.begin(), scheduled_request_ids.end(),
+                    request_id) != scheduled_request_ids.end()) {
+        continue;
+      }
+      scheduled_request_ids.push_back(request_id);
+      marl::schedule([=] {
+        process_async_replies_asyncly(request_id, replyStatus, received_ncm_reply_time);
+      });
     }
+  } else {
+    // a call past its deadline ends here too, its batch slot was given back above
+    ACA_LOG_ERROR("GRPC call to NCM of request id: [%lu] failed with code %d, error details: %s\n",
+                  call->request_id, call->status.error_code(),
+                  call->status.error_message().c_str());
   }
 }
 
-void ACA_On_Demand_Engine::unknown_recv(uint16_t vlan_id, string ip_src,
+bool ACA_On_Demand_Engine::send_on_demand_batch(HostRequest *request, uint64_t batch_id)
+{
+  ACA_LOG_DEBUG("For request id: [%lu], sending a batch of %d on-demand requests\n",
+                batch_id, request->state_requests_size());
+  if (!_reply_shards.send(g_grpc_client, request, batch_id)) {
+    return false;
+  }
+  g_total_on_demand_batches_sent++;
+  g_total_on_demand_batched_requests += request->state_requests_size();
+  return true;
+}
+
+void ACA_On_Demand_Engine::unknown_recv(uint tunnel_id, string ip_src,
                                         string ip_dest, int port_src, int port_dest,
-                                        Protocol protocol, char *uuid_str)
+                                        Protocol protocol, uint64_t request_id)
 {
   HostRequest HostRequest_builder;
   HostRequest_ResourceStateRequest *new_state_requests =
           HostRequest_builder.add_state_requests();
   HostRequestReply hostRequestReply;
 
-  uint tunnel_id = ACA_Vlan_Manager::get_instance().get_tunnelId_by_vlanId(vlan_id);
-  new_state_requests->set_request_id(uuid_str);
+  // the request id only becomes text here, at the grpc boundary
+  new_state_requests->set_request_id(request_id_to_string(request_id));
   new_state_requests->set_tunnel_id(tunnel_id);
   new_state_requests->set_source_ip(ip_src);
   new_state_requests->set_source_port(port_src);
@@ -231,125 +312,232 @@ void ACA_On_Demand_Engine::unknown_recv(uint16_t vlan_id, string ip_src,
   new_state_requests->set_ethertype(EtherType::IPV4);
   std::chrono::_V2::steady_clock::time_point call_ncm_time =
           std::chrono::steady_clock::now();
-  ACA_LOG_DEBUG("For UUID: [%s], calling NCM for info of IP [%s] at: [%ld], tunnel_id: [%ld]\n",
-                uuid_str, ip_dest.c_str(), call_ncm_time, tunnel_id);
+  ACA_LOG_DEBUG("For request id: [%lu], calling NCM for info of IP [%s] at: [%ld], tunnel_id: [%ld]\n",
+                request_id, ip_dest.c_str(), call_ncm_time, tunnel_id);
   std::chrono::_V2::high_resolution_clock::time_point start =
           std::chrono::high_resolution_clock::now();
   // this is a timestamp in milliseconds
   ACA_LOG_DEBUG(
-          "For UUID: [%s], on-demand sent on %ld milliseconds\n", uuid_str,
+          "For request id: [%lu], on-demand sent on %ld milliseconds\n", request_id,
           chrono::duration_cast<chrono::milliseconds>(start.time_since_epoch()).count());
-  g_grpc_client->RequestGoalStates(&HostRequest_builder, &_cq);
+  // unary call when batching is off or too many requests wait for their batch
+  if (!_request_batcher.add(request_id, *new_state_requests)) {
+    _reply_shards.send(g_grpc_client, &HostRequest_builder, request_id);
+  }
 }
 
-void ACA_On_Demand_Engine::on_demand(string uuid_for_call, OperationStatus status,
-                                     uint32_t in_port, void *packet,
-                                     int packet_size, Protocol protocol,
-                                     std::chrono::_V2::steady_clock::time_point insert_time)
+void ACA_On_Demand_Engine::prefetch_neighbors(on_demand_payload *payload)
+{
+  ACA_On_Demand_Prefetcher &prefetcher = ACA_On_Demand_Prefetcher::get_instance();
+  std::vector<uint32_t> prefetch_ips;
+  char ip_str[INET_ADDRSTRLEN];
+
+  if (!prefetcher.enabled()) {
+    return;
+  }
+
+  uint16_t vlan_id = payload->flow_key.vlan_id;
+  // the neighbors with an arp entry are programmed already
+  auto is_programmed = [vlan_id](uint32_t ip_dest) {
+    arp_entry_data stData;
+    char ip_dest_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &ip_dest, ip_dest_str, sizeof(ip_dest_str));
+    stData.ipv4_address = ip_dest_str;
+    stData.vlan_id = vlan_id;
+    return aca_arp_responder::ACA_ARP_Responder::get_instance().does_arp_entry_exist(stData);
+  };
+
+  uint64_t request_id = generate_request_id();
+  if (prefetcher.prefetch(payload->tunnel_id, vlan_id, payload->ip_src,
+                          payload->flow_key.ip_dest, request_id, is_programmed,
+                          prefetch_ips) == 0) {
+    return;
+  }
+
+  HostRequest HostRequest_builder;
+  string request_id_str = request_id_to_string(request_id);
+  inet_ntop(AF_INET, &payload->ip_src, ip_str, sizeof(ip_str));
+  string ip_src(ip_str);
+  for (auto ip_dest : prefetch_ips) {
+    HostRequest_ResourceStateRequest *new_state_requests =
+            HostRequest_builder.add_state_requests();
+    inet_ntop(AF_INET, &ip_dest, ip_str, sizeof(ip_str));
+    new_state_requests->set_request_id(request_id_str);
+    new_state_requests->set_tunnel_id(payload->tunnel_id);
+    new_state_requests->set_source_ip(ip_src);
+    new_state_requests->set_source_port(0);
+    new_state_requests->set_destination_ip(ip_str);
+    new_state_requests->set_destination_port(0);
+    new_state_requests->set_protocol(payload->protocol);
+    new_state_requests->set_ethertype(EtherType::IPV4);
+  }
+  g_total_on_demand_prefetch_issued += prefetch_ips.size();
+  ACA_LOG_DEBUG("For request id: [%lu], prefetching %ld neighbors in tunnel_id: [%d]\n",
+                request_id, prefetch_ips.size(), payload->tunnel_id);
+  if (!_reply_shards.send(g_grpc_client, &HostRequest_builder, request_id)) {
+    // no reply will come, give the budget back now
+    prefetcher.complete(request_id);
+  }
+}
+
+bool ACA_On_Demand_Engine::coalesce_on_demand_request(on_demand_payload_handle &payload)
+{
+  std::vector<on_demand_payload *> dropped_payloads;
+  if (!_inflight_requests.coalesce(payload->flow_key, payload->request_id, payload.get(),
+                                   payload->packet.size(), g_on_demand_pending_queue_max_packets,
+                                   g_on_demand_pending_queue_max_bytes, dropped_payloads)) {
+    return false;
+  }
+  // queued on the outstanding request, or in dropped_payloads
+  payload.release();
+  if (!dropped_payloads.empty()) {
+    ACA_LOG_DEBUG("Pending queue of the on-demand request is full, %ld packets dropped\n",
+                  dropped_payloads.size());
+    g_total_on_demand_pending_packets_dropped += dropped_payloads.size();
+    for (auto dropped_payload : dropped_payloads) {
+      _free_payload(dropped_payload);
+    }
+  }
+  return true;
+}
+
+void ACA_On_Demand_Engine::release_on_demand_request(on_demand_payload *payload,
+                                                     std::vector<on_demand_payload *> &pending_payloads)
+{
+  _inflight_requests.release(payload->flow_key, payload->request_id, pending_payloads);
+}
+
+void ACA_On_Demand_Engine::on_demand(uint64_t request_id, OperationStatus status,
+                                     const std::vector<on_demand_payload *> &payloads)
 {
   ACA_LOG_DEBUG("%s\n", "Inside of on_demand function");
   string bridge = "br-tun";
-  string inport = "in_port=controller";
-  string whitespace = " ";
-  string action = "actions=output:" + to_string(in_port);
-  string rs_action = "actions=resubmit(,20)";
-  string packetpre = "packet=";
-  string options = "";
-  string serialized_packet = "";
-  const struct ether_header *eth_header = (struct ether_header *)packet;
-  const u_char *ch = (const u_char *)packet;
-  char str[10];
-
-  if (status == OperationStatus::SUCCESS) {
-    ACA_LOG_DEBUG("%s\n", "It was an succesful operation, let's wait a little bit, so that the goalstate is created/updated");
-
-    if (protocol == Protocol::ARP) {
-      char *base = (char *)packet;
-      unsigned char *vlan_hdr = (unsigned char *)(base + 12);
-      vlan_message *vlanmsg = (vlan_message *)vlan_hdr;
-      unsigned char *arp_hdr = (unsigned char *)(base + SIZE_ETHERNET + 4);
-      arp_message *arpmsg = (arp_message *)arp_hdr;
-      arp_entry_data stData;
-      // get the ip address from arp message
-      stData.ipv4_address =
-              aca_arp_responder::ACA_ARP_Responder::get_instance()._get_requested_ip(arpmsg);
-      // get the vlan id from vlan header
-      if (vlanmsg) {
-        stData.vlan_id = ntohs(vlanmsg->vlan_tci) & 0x0fff;
-      } else {
-        stData.vlan_id = 0;
-      }
-      /*
-        Implementing a "Smart" sleep here, which checks if the target arp entry exists,
-        if exists, stop sleeping and go forward; 
-        otherwise, sleep for another 1000 us (0.001) seconds and then check again.
-        If arp still not found after one second, it lets the packet drop.
-      */
-      int wait_time = 1000000; // one second
-      int check_frequency_us = 1000; // 0.001 seconds, or 10000 microseconds.
-      bool found_arp_entry = false;
-      int times_to_check = wait_time / check_frequency_us;
-      int i = 0;
-      std::chrono::_V2::steady_clock::time_point start =
-              std::chrono::steady_clock::now();
-
-      do {
-        found_arp_entry =
-                aca_arp_responder::ACA_ARP_Responder::get_instance().does_arp_entry_exist(stData);
-        if (!found_arp_entry) {
-          i++;
-          usleep(check_frequency_us);
-        }
-      } while (!found_arp_entry && i < times_to_check);
-      std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
-      auto total_time_slept = cast_to_microseconds(end - start).count();
-      auto total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed =
-              cast_to_microseconds(end - insert_time).count();
-      auto total_time_before_sending_grpc_request_to_before_wait_starts =
-              cast_to_microseconds(start - insert_time).count();
-
-      ACA_LOG_DEBUG(
-              "For UUID: [%s], wait started at: [%ld] finished at: [%ld], took: %ld microseconds or %ld milliseconds\nThe whole operation took %ld microseconds or %ld milliseconds\nFrom before sending GRPC request to before waiting for GS ready (T3 - T1) took %ld microseconds or %ld milliseconds",
-              uuid_for_call.c_str(), start, end, total_time_slept, us_to_ms(total_time_slept),
-              total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed,
-              us_to_ms(total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed),
-              total_time_before_sending_grpc_request_to_before_wait_starts,
-              us_to_ms(total_time_before_sending_grpc_request_to_before_wait_starts));
-
-      int parse_arp_request_rc =
-              aca_arp_responder::ACA_ARP_Responder::get_instance()._parse_arp_request(
-                      in_port, vlanmsg, arpmsg);
-      if (parse_arp_request_rc == EXIT_SUCCESS) {
-        ACA_LOG_DEBUG("%s", "On-demand arp request packet sent to arp_responder.\n");
 
-      } else {
-        ACA_LOG_DEBUG("%s", "On-demand arp request packet FAILED to send to arp_responder.\n");
-      }
-    } else {
-      for (int i = 0; i < packet_size; i++) {
-        sprintf(str, "%02x", *ch);
-        serialized_packet.append(str);
-        ch++;
-      }
-      options = inport + whitespace + packetpre + serialized_packet + whitespace + action;
-      //aca_ovs_control::ACA_OVS_Control::get_instance().packet_out(
-      //        bridge.c_str(), options.c_str());
-      aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(
-              bridge.c_str(), options.c_str());
-      ACA_LOG_DEBUG("On-demand packet with protocol %d sent to ovs: %s\n",
-                    protocol, options.c_str());
+  if (status != OperationStatus::SUCCESS) {
+    for (auto payload : payloads) {
+      const struct ether_header *eth_header = (struct ether_header *)payload->packet.data();
+      ACA_LOG_ERROR("Packet dropped from %s to %s\n",
+                    ether_ntoa((ether_addr *)&eth_header->ether_shost),
+                    ether_ntoa((ether_addr *)&eth_header->ether_dhost));
     }
+    return;
+  }
+
+  ACA_LOG_DEBUG("%s\n", "It was an succesful operation, let's wait a little bit, so that the goalstate is created/updated");
+
+  // all the payloads go to the same destination with the same protocol
+  on_demand_payload *request_payload = payloads.front();
+
+  if (request_payload->protocol == Protocol::ARP) {
+    for (auto payload : payloads) {
+      _reply_on_demand_arp(request_id, payload);
+    }
+    return;
+  }
+
+  /*
+    The arp entry of a L2 neighbor is added once its flow is committed to the
+    switch, wait for it so that the replayed packets don't come back to the controller.
+    If it is still not found after ON_DEMAND_ARP_WAIT_TIMEOUT_IN_MICROSECONDS, the packets are sent anyway.
+  */
+  arp_entry_data stData;
+  char ip_dest[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &request_payload->flow_key.ip_dest, ip_dest, sizeof(ip_dest));
+  stData.ipv4_address = ip_dest;
+  stData.vlan_id = request_payload->flow_key.vlan_id;
+  if (!aca_arp_responder::ACA_ARP_Responder::get_instance().wait_for_arp_entry(
+              stData, std::chrono::microseconds(ON_DEMAND_ARP_WAIT_TIMEOUT_IN_MICROSECONDS))) {
+    ACA_LOG_DEBUG("For request id: [%lu], neighbor (ip = %s and vlan id = %u) not programmed in time\n",
+                  request_id, stData.ipv4_address.c_str(), stData.vlan_id);
+  }
+
+  // the packets go out of their pool buffers as they are, no hex round trip
+  std::vector<PacketOutFrame> packet_outs;
+  packet_outs.reserve(payloads.size());
+  for (auto payload : payloads) {
+    packet_outs.push_back(PacketOutFrame{ OF13_PORT_CONTROLLER, payload->packet.data(),
+                                          payload->packet.size(),
+                                          { PacketOutAction::output(payload->in_port) } });
+  }
+  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(bridge.c_str(),
+                                                                          packet_outs);
+  g_total_on_demand_pending_packets_replayed += payloads.size() - 1;
+  ACA_LOG_DEBUG("For request id: [%lu], %ld on-demand packets with protocol %d sent to ovs\n",
+                request_id, packet_outs.size(), request_payload->protocol);
+}
+
+void ACA_On_Demand_Engine::_reply_on_demand_arp(uint64_t request_id, on_demand_payload *payload)
+{
+  char *base = (char *)payload->packet.data();
+  unsigned char *vlan_hdr = (unsigned char *)(base + 12);
+  vlan_message *vlanmsg = (vlan_message *)vlan_hdr;
+  unsigned char *arp_hdr = (unsigned char *)(base + SIZE_ETHERNET + 4);
+  arp_message *arpmsg = (arp_message *)arp_hdr;
+  arp_entry_data stData;
+  // get the ip address from arp message
+  stData.ipv4_address =
+          aca_arp_responder::ACA_ARP_Responder::get_instance()._get_requested_ip(arpmsg);
+  // get the vlan id from vlan header
+  if (vlanmsg) {
+    stData.vlan_id = ntohs(vlanmsg->vlan_tci) & 0x0fff;
+  } else {
+    stData.vlan_id = 0;
+  }
+  /*
+    Wait for the goal state to program the target arp entry, the arp responder
+    wakes this request up as soon as the entry is added.
+    If arp still not found after ON_DEMAND_ARP_WAIT_TIMEOUT_IN_MICROSECONDS, it lets the packet drop.
+  */
+  std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  bool found_arp_entry =
+          aca_arp_responder::ACA_ARP_Responder::get_instance().wait_for_arp_entry(
+                  stData, std::chrono::microseconds(ON_DEMAND_ARP_WAIT_TIMEOUT_IN_MICROSECONDS));
+  std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
+  auto total_time_waited = cast_to_microseconds(end - start).count();
+  auto total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed =
+          cast_to_microseconds(end - payload->insert_time).count();
+  auto total_time_before_sending_grpc_request_to_before_wait_starts =
+          cast_to_microseconds(start - payload->insert_time).count();
+
+  ACA_LOG_DEBUG(
+          "For request id: [%lu], wait started at: [%ld] finished at: [%ld], took: %ld microseconds or %ld milliseconds\nThe whole operation took %ld microseconds or %ld milliseconds\nFrom before sending GRPC request to before waiting for GS ready (T3 - T1) took %ld microseconds or %ld milliseconds",
+          request_id, start, end, total_time_waited, us_to_ms(total_time_waited),
+          total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed,
+          us_to_ms(total_time_for_goalstate_from_send_gs_to_gs_received_and_programmed),
+          total_time_before_sending_grpc_request_to_before_wait_starts,
+          us_to_ms(total_time_before_sending_grpc_request_to_before_wait_starts));
+
+  if (!found_arp_entry) {
+    ACA_LOG_DEBUG("For request id: [%lu], arp entry (ip = %s and vlan id = %u) not programmed in time\n",
+                  request_id, stData.ipv4_address.c_str(), stData.vlan_id);
+  }
+
+  int parse_arp_request_rc =
+          aca_arp_responder::ACA_ARP_Responder::get_instance()._parse_arp_request(
+                  payload->in_port, vlanmsg, arpmsg);
+  if (parse_arp_request_rc == EXIT_SUCCESS) {
+    ACA_LOG_DEBUG("%s", "On-demand arp request packet sent to arp_responder.\n");
+
   } else {
-    ACA_LOG_ERROR("Packet dropped from %s to %s\n",
-                  ether_ntoa((ether_addr *)&eth_header->ether_shost),
-                  ether_ntoa((ether_addr *)&eth_header->ether_dhost));
+    ACA_LOG_DEBUG("%s", "On-demand arp request packet FAILED to send to arp_responder.\n");
   }
 }
 
-void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
+void ACA_On_Demand_Engine::parse_packet(const packet_in_ptr_t &packet_in)
+{
+  // the handlers read the frame in place, packet_in holds the openflow buffer until they return
+  parse_packet(packet_in->in_port(), (void *)packet_in->frame(), packet_in->frame_len());
+}
+
+void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet, size_t packet_len)
 {
 
   const struct ether_header *eth_header;
+  if (packet_len < SIZE_ETHERNET) {
+    ACA_LOG_ERROR("Packet too short: %ld bytes\n", packet_len);
+    return;
+  }
   /* The packet is larger than the ether_header struct,
      but we just want to look at the first part of the packet
      that contains the header. We force the compiler
@@ -367,6 +555,7 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
   uint16_t vlan_id = 0;
   vlan_message *vlanmsg = nullptr;
   string ip_src, ip_dest;
+  uint32_t ip_src_addr = 0, ip_dest_addr = 0;
   int port_src, port_dest, packet_size;
   Protocol _protocol = Protocol::Protocol_INT_MAX_SENTINEL_DO_NOT_USE_;
 
@@ -374,6 +563,10 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
 
   if (ether_type == ETHERTYPE_VLAN) {
     ACA_LOG_DEBUG("%s", "Ethernet Type: 802.1Q VLAN tagging (0x8100) \n");
+    if (packet_len < SIZE_ETHERNET + 4) {
+      ACA_LOG_ERROR("Vlan packet too short: %ld bytes\n", packet_len);
+      return;
+    }
 
     ether_type = ntohs(*(uint16_t *)(base + 16));
     vlan_len = 4;
@@ -388,6 +581,10 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
   if (ether_type == ETHERTYPE_ARP) {
 
     ACA_LOG_DEBUG("%s", "Ethernet Type: ARP (0x0806) \n");
+    if (packet_len < SIZE_ETHERNET + vlan_len + 28) {
+      ACA_LOG_ERROR("Arp packet too short: %ld bytes\n", packet_len);
+      return;
+    }
     ACA_LOG_DEBUG("   From: %s\n", inet_ntoa(*(in_addr *)(base + 14 + vlan_len + 14)));
     ACA_LOG_DEBUG("     to: %s\n",
                   inet_ntoa(*(in_addr *)(base + 14 + vlan_len + 14 + 10)));
@@ -395,19 +592,30 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
     unsigned char *arp_hdr = (unsigned char *)(base + SIZE_ETHERNET + vlan_len);
     /* arp request procedure,type = 1 */
     if (ntohs(*(uint16_t *)(arp_hdr + 6)) == 0x0001) {
-      if (aca_arp_responder::ACA_ARP_Responder::get_instance().arp_recv(
-                  in_port, vlan_hdr, arp_hdr) == ENOTSUP) {
+      arp_message *arpmsg = (arp_message *)arp_hdr;
+      int arp_recv_rc = aca_arp_responder::ACA_ARP_Responder::get_instance().arp_recv(
+              in_port, vlan_hdr, arp_hdr);
+      if (arp_recv_rc == ENOTSUP) {
         _protocol = Protocol::ARP;
-        arp_message *arpmsg = (arp_message *)arp_hdr;
         ip_src = aca_arp_responder::ACA_ARP_Responder::get_instance()._get_source_ip(arpmsg);
         ip_dest = aca_arp_responder::ACA_ARP_Responder::get_instance()._get_requested_ip(arpmsg);
+        ip_src_addr = arpmsg->spa;
+        ip_dest_addr = arpmsg->tpa;
         packet_size = SIZE_ETHERNET + vlan_len + 28;
         port_src = 0;
         port_dest = 0;
+      } else if (arp_recv_rc == EXIT_SUCCESS &&
+                 ACA_On_Demand_Prefetcher::get_instance().on_arp_replied(vlan_id, arpmsg->tpa)) {
+        // answered locally thanks to a prefetch
+        g_total_on_demand_prefetch_hits++;
       }
     }
   } else if (ether_type == ETHERTYPE_IP) {
     ACA_LOG_DEBUG("%s", "Ethernet Type: IP (0x0800) \n");
+    if (packet_len < SIZE_ETHERNET + vlan_len + 20) {
+      ACA_LOG_ERROR("Ip packet too short: %ld bytes\n", packet_len);
+      return;
+    }
 
     /* define/compute ip header offset */
     const struct sniff_ip *ip = (struct sniff_ip *)(base + SIZE_ETHERNET + vlan_len);
@@ -416,9 +624,14 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
     if (size_ip < 20) {
       ACA_LOG_ERROR("size_udp < 20: %d bytes\n", size_ip);
       return;
+    } else if (packet_len < (size_t)(SIZE_ETHERNET + vlan_len + size_ip)) {
+      ACA_LOG_ERROR("Ip header truncated: %ld bytes\n", packet_len);
+      return;
     } else {
       ip_src = string(inet_ntoa(ip->ip_src));
       ip_dest = string(inet_ntoa(ip->ip_dst));
+      ip_src_addr = ip->ip_src.s_addr;
+      ip_dest_addr = ip->ip_dst.s_addr;
       packet_size = SIZE_ETHERNET + vlan_len + size_ip;
 
       /* print source and destination IP addresses */
@@ -445,6 +658,10 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
     }
 
     if (ip->ip_p == IPPROTO_TCP) {
+      if (packet_len < (size_t)packet_size + 20) {
+        ACA_LOG_ERROR("Tcp header truncated: %ld bytes\n", packet_len);
+        return;
+      }
       /* define/compute tcp header offset */
       const struct sniff_tcp *tcp =
               (struct sniff_tcp *)(base + SIZE_ETHERNET + vlan_len + size_ip);
@@ -456,9 +673,13 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
       if (size_tcp < 20) {
         ACA_LOG_ERROR("size_tcp < 20: %d bytes \n", size_tcp);
         return;
+      } else if (packet_len < (size_t)(packet_size + size_tcp)) {
+        ACA_LOG_ERROR("Tcp header truncated: %ld bytes\n", packet_len);
+        return;
       } else {
         port_src = ntohs(tcp->th_sport);
         port_dest = ntohs(tcp->th_dport);
+        packet_size += size_tcp;
 
         ACA_LOG_DEBUG("   Src port: %d\n", ntohs(tcp->th_sport));
         ACA_LOG_DEBUG("   Dst port: %d\n", ntohs(tcp->th_dport));
@@ -476,6 +697,10 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
         }
       }
     } else if (ip->ip_p == IPPROTO_UDP) {
+      if (packet_len < (size_t)packet_size + 8) {
+        ACA_LOG_ERROR("Udp header truncated: %ld bytes\n", packet_len);
+        return;
+      }
       /* define/compute udp header offset */
       const struct sniff_udp *udp =
               (struct sniff_udp *)(base + SIZE_ETHERNET + vlan_len + size_ip);
@@ -490,6 +715,7 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
       } else {
         port_src = ntohs(udp->uh_sport);
         port_dest = ntohs(udp->uh_dport);
+        packet_size += 8;
         ACA_LOG_DEBUG("   Src port: %d\n", port_src);
         ACA_LOG_DEBUG("   Dst port: %d\n", port_dest);
 
@@ -514,7 +740,13 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
         }
       }
     } else if (ip->ip_p == IPPROTO_ICMP) {
+      if (packet_len < (size_t)packet_size + 8) {
+        ACA_LOG_ERROR("Icmp header truncated: %ld bytes\n", packet_len);
+        return;
+      }
       _protocol = Protocol::ICMP;
+      // icmp header
+      packet_size += 8;
     }
   } else if (ether_type == ETHERTYPE_REVARP) {
     ACA_LOG_DEBUG("%s", "Ethernet Type: REVARP (0x8035) \n");
@@ -525,41 +757,109 @@ void ACA_On_Demand_Engine::parse_packet(uint32_t in_port, void *packet)
   }
 
   if (_protocol != Protocol::Protocol_INT_MAX_SENTINEL_DO_NOT_USE_) {
-    packet_size = SIZE_ETHERNET + vlan_len + packet_size;
-    uuid_t uuid;
-    uuid_generate_time(uuid);
-    char uuid_str[37];
-    uuid_unparse_lower(uuid, uuid_str);
-    on_demand_payload *data = new on_demand_payload;
-    void *packet_copy = malloc(packet_size);
-    memcpy(packet_copy, packet, packet_size);
+    on_demand_payload_handle data = _payload_pool.make();
+    // only the headers parsed above are needed to replay the packet
+    data->packet = _packet_buffer_pool.copy(packet, packet_size);
+    if (!data->packet) {
+      ACA_LOG_ERROR("Failed to copy %d bytes of packet headers, packet dropped\n", packet_size);
+      return;
+    }
     data->in_port = in_port;
-    data->packet = packet_copy;
-    data->packet_size = packet_size;
     data->protocol = _protocol;
     data->insert_time = std::chrono::steady_clock::now();
+    data->request_id = generate_request_id();
+    data->flow_key.vlan_id = vlan_id;
+    data->flow_key.ip_dest = ip_dest_addr;
+    data->flow_key.protocol = _protocol;
+    data->ip_src = ip_src_addr;
+
+    if (coalesce_on_demand_request(data)) {
+      g_total_on_demand_requests_coalesced++;
+      ACA_LOG_DEBUG("Packet to [%s] with protocol [%d] coalesced into the outstanding on-demand request\n",
+                    ip_dest.c_str(), _protocol);
+      return;
+    }
+
+    if (ACA_On_Demand_Prefetcher::get_instance().on_demand_requested(vlan_id, ip_dest_addr)) {
+      // prefetched, but its goal state didn't make it before the first packet
+      g_total_on_demand_prefetch_late++;
+    }
+
+    uint tunnel_id = ACA_Vlan_Manager::get_instance().get_tunnelId_by_vlanId(vlan_id);
+    if (ACA_On_Demand_Negative_Cache::get_instance().contains(tunnel_id, ip_dest_addr)) {
+      g_total_on_demand_negative_cache_hits++;
+      ACA_LOG_DEBUG("NCM recently had no goal state for [%s] in tunnel [%d], packet dropped\n",
+                    ip_dest.c_str(), tunnel_id);
+      // give up the in-flight request registered above, with anything attached to it meanwhile
+      _drop_on_demand_request(data.release());
+      return;
+    }
+    g_total_on_demand_negative_cache_misses++;
+    data->tunnel_id = tunnel_id;
+
+    on_demand_pending_request pending_request;
+    pending_request.payload = data.release();
+    pending_request.ip_src = ip_src;
+    pending_request.ip_dest = ip_dest;
+    pending_request.port_src = port_src;
+    pending_request.port_dest = port_dest;
+
+    // never wait here, an overloaded agent drops requests instead of stalling the packet-in workers
+    std::vector<on_demand_pending_request> dropped_requests;
+    admission_policy dropped_by =
+            _admission_queue.push(in_port, pending_request, dropped_requests);
+    if (dropped_by != ADMISSION_POLICY_MAX) {
+      if (dropped_by == ADMISSION_DROP_NEWEST) {
+        g_total_on_demand_dropped_newest += dropped_requests.size();
+      } else if (dropped_by == ADMISSION_DROP_OLDEST) {
+        g_total_on_demand_dropped_oldest += dropped_requests.size();
+      } else {
+        g_total_on_demand_dropped_fair_share += dropped_requests.size();
+      }
+      for (auto &dropped_request : dropped_requests) {
+        ACA_LOG_DEBUG("On-demand admission queue is full, request id: [%lu] from port [%d] dropped\n",
+                      dropped_request.payload->request_id, dropped_request.payload->in_port);
+        _drop_on_demand_request(dropped_request.payload);
+      }
+    }
+  }
+}
+
+void ACA_On_Demand_Engine::dispatch_on_demand_requests()
+{
+  ACA_LOG_DEBUG("%s\n", "Entering dispatch_on_demand_requests");
+  on_demand_pending_request pending_request;
+
+  while (_admission_queue.pop(pending_request)) {
+    on_demand_payload *data = pending_request.payload;
+
     std::chrono::_V2::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    /* Sleep until the size is less than the max limit. */
-    while (request_uuid_on_demand_payload_map.size() >= REQUEST_UUID_ON_DEMAND_PAYLOAD_MAP_MAX_SIZE) {
+    /* Only the dispatcher waits for room in the table, new packets keep going through admission. */
+    while (request_id_on_demand_payload_table.size() >= REQUEST_UUID_ON_DEMAND_PAYLOAD_MAP_MAX_SIZE) {
       usleep(REQUEST_UUID_ON_DEMAND_PAYLOAD_MAP_SIZE_CHECK_FREQUENCY_IN_MICROSECONDS);
     }
 
-    /* Critical section begins */
-    _payload_map_mutex.lock();
-    request_uuid_on_demand_payload_map[uuid_str] = data;
-    _payload_map_mutex.unlock();
-    /* Critical section ends */
+    if (!request_id_on_demand_payload_table.insert(data->request_id, data)) {
+      // the table keeps the payload of the request already there, this one is never sent
+      ACA_LOG_ERROR("Request id: [%lu] from port [%d] is already in request_id_on_demand_payload_table, dropping it\n",
+                    data->request_id, data->in_port);
+      _drop_on_demand_request(data);
+      continue;
+    }
     std::chrono::_V2::steady_clock::time_point end = std::chrono::steady_clock::now();
 
-    auto cleanup_time = cast_to_microseconds(end - start).count();
+    auto insert_time = cast_to_microseconds(end - start).count();
 
-    ACA_LOG_DEBUG("Inserting one entry into request_uuid_on_demand_payload_map took [%ld]us, which is [%ld]ms\n",
-                  cleanup_time, us_to_ms(cleanup_time));
-    ACA_LOG_DEBUG("Inserted data into the map, UUID: [%s], in_port: [%d], protocol: [%d]\n",
-                  uuid_str, in_port, _protocol);
+    ACA_LOG_DEBUG("Inserting one entry into request_id_on_demand_payload_table took [%ld]us, which is [%ld]ms\n",
+                  insert_time, us_to_ms(insert_time));
+    ACA_LOG_DEBUG("Inserted data into the table, request id: [%lu], in_port: [%d], protocol: [%d]\n",
+                  data->request_id, data->in_port, data->protocol);
 
-    unknown_recv(vlan_id, ip_src, ip_dest, port_src, port_dest, _protocol, uuid_str);
+    g_total_on_demand_requests_issued++;
+    unknown_recv(data->tunnel_id, pending_request.ip_src, pending_request.ip_dest,
+                 pending_request.port_src, pending_request.port_dest,
+                 data->protocol, data->request_id);
   }
 }
 
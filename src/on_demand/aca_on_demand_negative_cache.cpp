@@ -0,0 +1,135 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "aca_on_demand_negative_cache.h"
+#include "aca_config.h"
+#include <arpa/inet.h>
+
+namespace aca_on_demand_engine
+{
+ACA_On_Demand_Negative_Cache &ACA_On_Demand_Negative_Cache::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_On_Demand_Negative_Cache instance(ON_DEMAND_NEGATIVE_CACHE_MAX_SIZE,
+                                               ON_DEMAND_NEGATIVE_CACHE_TTL_IN_MICROSECONDS);
+  return instance;
+}
+
+ACA_On_Demand_Negative_Cache::ACA_On_Demand_Negative_Cache(size_t max_entries, uint64_t ttl_us)
+        : _max_entries_per_shard(1), _ttl_us(0), _size(0)
+{
+  configure(max_entries, ttl_us);
+}
+
+void ACA_On_Demand_Negative_Cache::configure(size_t max_entries, uint64_t ttl_us)
+{
+  size_t per_shard = max_entries / NEGATIVE_CACHE_SHARD_COUNT;
+  _max_entries_per_shard.store(per_shard == 0 ? 1 : per_shard);
+  _ttl_us.store(ttl_us);
+}
+
+void ACA_On_Demand_Negative_Cache::add(uint32_t tunnel_id, uint32_t ip_dest, time_point now)
+{
+  uint64_t key = _get_key(tunnel_id, ip_dest);
+  Shard &shard = _get_shard(key);
+  time_point expire_time = now + std::chrono::microseconds(_ttl_us.load());
+  size_t max_entries = _max_entries_per_shard.load();
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto found = shard.entries.find(key);
+  if (found != shard.entries.end()) {
+    // NCM failed again, restart the TTL and make it the newest entry
+    found->second.expire_time = expire_time;
+    shard.order.splice(shard.order.end(), shard.order, found->second.order);
+    return;
+  }
+
+  // drop the expired entries, then the oldest ones if the shard is still full
+  while (!shard.order.empty()) {
+    auto oldest = shard.entries.find(shard.order.front());
+    if (oldest->second.expire_time > now && shard.entries.size() < max_entries) {
+      break;
+    }
+    _erase(shard, oldest);
+  }
+
+  shard.order.push_back(key);
+  Entry &entry = shard.entries[key];
+  entry.expire_time = expire_time;
+  entry.order = std::prev(shard.order.end());
+  _size.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ACA_On_Demand_Negative_Cache::contains(uint32_t tunnel_id, uint32_t ip_dest, time_point now)
+{
+  uint64_t key = _get_key(tunnel_id, ip_dest);
+  Shard &shard = _get_shard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto found = shard.entries.find(key);
+  if (found == shard.entries.end()) {
+    return false;
+  }
+  if (found->second.expire_time <= now) {
+    _erase(shard, found);
+    return false;
+  }
+  return true;
+}
+
+bool ACA_On_Demand_Negative_Cache::invalidate(uint32_t tunnel_id, uint32_t ip_dest)
+{
+  uint64_t key = _get_key(tunnel_id, ip_dest);
+  Shard &shard = _get_shard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto found = shard.entries.find(key);
+  if (found == shard.entries.end()) {
+    return false;
+  }
+  _erase(shard, found);
+  return true;
+}
+
+bool ACA_On_Demand_Negative_Cache::invalidate(uint32_t tunnel_id, const std::string &ip_dest)
+{
+  struct in_addr addr;
+
+  // inet_pton returns 1 for success 0 for failure
+  if (inet_pton(AF_INET, ip_dest.c_str(), &addr) != 1) {
+    return false;
+  }
+  return invalidate(tunnel_id, addr.s_addr);
+}
+
+void ACA_On_Demand_Negative_Cache::clear()
+{
+  for (int i = 0; i < NEGATIVE_CACHE_SHARD_COUNT; i++) {
+    Shard &shard = _shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    _size.fetch_sub(shard.entries.size(), std::memory_order_relaxed);
+    shard.entries.clear();
+    shard.order.clear();
+  }
+}
+
+void ACA_On_Demand_Negative_Cache::_erase(Shard &shard,
+                                          std::unordered_map<uint64_t, Entry>::iterator entry)
+{
+  shard.order.erase(entry->second.order);
+  shard.entries.erase(entry);
+  _size.fetch_sub(1, std::memory_order_relaxed);
+}
+} // namespace aca_on_demand_engine
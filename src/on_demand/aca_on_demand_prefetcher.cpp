@@ -0,0 +1,327 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_on_demand_prefetcher.h"
+#include "aca_config.h"
+#include <algorithm>
+#include <arpa/inet.h>
+
+namespace aca_on_demand_engine
+{
+ACA_On_Demand_Prefetcher &ACA_On_Demand_Prefetcher::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_On_Demand_Prefetcher instance((prefetch_mode)ON_DEMAND_PREFETCH_MODE,
+                                           ON_DEMAND_PREFETCH_MAX_OUTSTANDING_PER_VPC);
+  return instance;
+}
+
+ACA_On_Demand_Prefetcher::ACA_On_Demand_Prefetcher(prefetch_mode mode, size_t max_outstanding_per_vpc)
+        : _mode(PREFETCH_DISABLED), _max_outstanding_per_vpc(0), _tracked_count(0)
+{
+  configure(mode, max_outstanding_per_vpc);
+}
+
+void ACA_On_Demand_Prefetcher::configure(prefetch_mode mode, size_t max_outstanding_per_vpc)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _mode = mode < PREFETCH_MODE_MAX ? mode : PREFETCH_DISABLED;
+  _max_outstanding_per_vpc = max_outstanding_per_vpc;
+}
+
+size_t ACA_On_Demand_Prefetcher::prefetch(uint32_t tunnel_id, uint16_t vlan_id,
+                                          uint32_t ip_src, uint32_t ip_dest, uint64_t request_id,
+                                          const std::function<bool(uint32_t)> &is_programmed,
+                                          std::vector<uint32_t> &prefetch_ips, time_point now)
+{
+  std::vector<uint32_t> candidates;
+  size_t budget;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_mode == PREFETCH_DISABLED) {
+      return 0;
+    }
+    _learn(tunnel_id, ip_src, ip_dest, now);
+
+    budget = _budget(tunnel_id);
+    if (budget == 0) {
+      return 0;
+    }
+
+    // the most recently co-accessed destinations first
+    auto found_peers = _co_accessed_peers.find(_get_key(tunnel_id, ip_dest));
+    if (found_peers != _co_accessed_peers.end()) {
+      auto &ip_dests = found_peers->second.ip_dests;
+      for (auto peer = ip_dests.rbegin(); peer != ip_dests.rend(); ++peer) {
+        if (!_is_tracked(vlan_id, *peer)) {
+          candidates.push_back(*peer);
+        }
+      }
+    }
+    size_t co_accessed = candidates.size();
+
+    if (_mode == PREFETCH_SUBNET) {
+      uint32_t subnet = ntohl(ip_dest) & 0xffffff00;
+      // skip the network and the broadcast addresses
+      for (uint32_t host = 1; host < 255; host++) {
+        uint32_t peer = htonl(subnet | host);
+        if (peer != ip_dest && !_is_tracked(vlan_id, peer) &&
+            std::find(candidates.begin(), candidates.begin() + co_accessed, peer) ==
+                    candidates.begin() + co_accessed) {
+          candidates.push_back(peer);
+        }
+      }
+    }
+  }
+
+  // is_programmed looks the neighbor up, which must not hold up the
+  // arp and on-demand packets waiting for the lock
+  std::vector<uint32_t> picked_ips;
+  for (auto candidate : candidates) {
+    if (picked_ips.size() >= budget) {
+      break;
+    }
+    if (!is_programmed || !is_programmed(candidate)) {
+      picked_ips.push_back(candidate);
+    }
+  }
+  if (picked_ips.empty()) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // another prefetch may have used the budget or tracked the same destinations meanwhile
+  if (_mode == PREFETCH_DISABLED) {
+    return 0;
+  }
+  budget = _budget(tunnel_id);
+  size_t picked_before = prefetch_ips.size();
+  for (auto picked_ip : picked_ips) {
+    if (prefetch_ips.size() - picked_before >= budget) {
+      break;
+    }
+    if (_track(vlan_id, picked_ip, now)) {
+      prefetch_ips.push_back(picked_ip);
+    }
+  }
+
+  size_t picked = prefetch_ips.size() - picked_before;
+  if (picked > 0) {
+    _outstanding_requests[request_id] = Outstanding_Request{
+      tunnel_id, picked,
+      now + std::chrono::microseconds(ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS)
+    };
+    _outstanding_order.push_back(request_id);
+    _outstanding_per_vpc[tunnel_id] += picked;
+  }
+  return picked;
+}
+
+bool ACA_On_Demand_Prefetcher::complete(uint64_t request_id)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found = _outstanding_requests.find(request_id);
+  if (found == _outstanding_requests.end()) {
+    return false;
+  }
+  auto found_vpc = _outstanding_per_vpc.find(found->second.tunnel_id);
+  found_vpc->second -= found->second.count;
+  if (found_vpc->second == 0) {
+    _outstanding_per_vpc.erase(found_vpc);
+  }
+  // its id stays in _outstanding_order until it would have expired
+  _outstanding_requests.erase(found);
+  return true;
+}
+
+size_t ACA_On_Demand_Prefetcher::expire(time_point now)
+{
+  std::vector<uint64_t> expired_requests;
+  size_t unused = 0;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // every request expires after the same time, the oldest ones are at the front
+    while (!_outstanding_order.empty()) {
+      auto found = _outstanding_requests.find(_outstanding_order.front());
+      if (found != _outstanding_requests.end()) {
+        if (found->second.expire_time > now) {
+          break;
+        }
+        expired_requests.push_back(found->first);
+      }
+      _outstanding_order.pop_front();
+    }
+
+    while (!_tracked_order.empty()) {
+      auto tracked = _tracked_destinations.find(_tracked_order.front());
+      if (tracked->second.expire_time > now) {
+        break;
+      }
+      _untrack(tracked);
+      unused++;
+    }
+  }
+
+  for (auto request_id : expired_requests) {
+    complete(request_id);
+  }
+  return unused;
+}
+
+bool ACA_On_Demand_Prefetcher::on_arp_replied(uint16_t vlan_id, uint32_t ip_dest)
+{
+  // called for every arp request answered locally, don't take the lock
+  // when there is nothing to untrack
+  if (_mode == PREFETCH_DISABLED || _tracked_count == 0) {
+    return false;
+  }
+  return _untrack(vlan_id, ip_dest);
+}
+
+bool ACA_On_Demand_Prefetcher::on_demand_requested(uint16_t vlan_id, uint32_t ip_dest)
+{
+  if (_mode == PREFETCH_DISABLED || _tracked_count == 0) {
+    return false;
+  }
+  return _untrack(vlan_id, ip_dest);
+}
+
+size_t ACA_On_Demand_Prefetcher::outstanding(uint32_t tunnel_id)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found_vpc = _outstanding_per_vpc.find(tunnel_id);
+  return found_vpc == _outstanding_per_vpc.end() ? 0 : found_vpc->second;
+}
+
+size_t ACA_On_Demand_Prefetcher::tracked()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _tracked_destinations.size();
+}
+
+void ACA_On_Demand_Prefetcher::_learn(uint32_t tunnel_id, uint32_t ip_src,
+                                      uint32_t ip_dest, time_point now)
+{
+  uint64_t source_key = _get_key(tunnel_id, ip_src);
+  auto history = _access_history.find(source_key);
+
+  if (history == _access_history.end()) {
+    if (_access_history.size() >= ON_DEMAND_PREFETCH_MAX_ENTRIES) {
+      _access_history.erase(_access_history_order.front());
+      _access_history_order.pop_front();
+    }
+    _access_history_order.push_back(source_key);
+    _access_history[source_key] =
+            Access_History{ ip_dest, now, std::prev(_access_history_order.end()) };
+    return;
+  }
+
+  // this source went to ip_dest right after its previous destination
+  if (history->second.last_ip_dest != ip_dest &&
+      now - history->second.last_access_time <=
+              std::chrono::microseconds(ON_DEMAND_PREFETCH_CO_ACCESS_WINDOW_IN_MICROSECONDS)) {
+    uint64_t peers_key = _get_key(tunnel_id, history->second.last_ip_dest);
+    auto peers = _co_accessed_peers.find(peers_key);
+    if (peers == _co_accessed_peers.end()) {
+      if (_co_accessed_peers.size() >= ON_DEMAND_PREFETCH_MAX_ENTRIES) {
+        _co_accessed_peers.erase(_co_accessed_peers_order.front());
+        _co_accessed_peers_order.pop_front();
+      }
+      _co_accessed_peers_order.push_back(peers_key);
+      peers = _co_accessed_peers
+                      .emplace(peers_key,
+                               Co_Accessed_Peers{ {}, std::prev(_co_accessed_peers_order.end()) })
+                      .first;
+    } else {
+      _co_accessed_peers_order.splice(_co_accessed_peers_order.end(),
+                                      _co_accessed_peers_order, peers->second.order);
+    }
+
+    auto &ip_dests = peers->second.ip_dests;
+    for (auto peer = ip_dests.begin(); peer != ip_dests.end(); ++peer) {
+      if (*peer == ip_dest) {
+        ip_dests.erase(peer);
+        break;
+      }
+    }
+    ip_dests.push_back(ip_dest);
+    if (ip_dests.size() > ON_DEMAND_PREFETCH_MAX_CO_ACCESSED_PEERS) {
+      ip_dests.pop_front();
+    }
+  }
+
+  history->second.last_ip_dest = ip_dest;
+  history->second.last_access_time = now;
+  _access_history_order.splice(_access_history_order.end(), _access_history_order,
+                               history->second.order);
+}
+
+size_t ACA_On_Demand_Prefetcher::_budget(uint32_t tunnel_id)
+{
+  auto found_vpc = _outstanding_per_vpc.find(tunnel_id);
+  size_t outstanding = found_vpc == _outstanding_per_vpc.end() ? 0 : found_vpc->second;
+  return outstanding >= _max_outstanding_per_vpc ? 0 : _max_outstanding_per_vpc - outstanding;
+}
+
+bool ACA_On_Demand_Prefetcher::_is_tracked(uint16_t vlan_id, uint32_t ip_dest)
+{
+  return _tracked_destinations.find(_get_key(vlan_id, ip_dest)) != _tracked_destinations.end();
+}
+
+bool ACA_On_Demand_Prefetcher::_track(uint16_t vlan_id, uint32_t ip_dest, time_point now)
+{
+  uint64_t key = _get_key(vlan_id, ip_dest);
+
+  if (_tracked_destinations.find(key) != _tracked_destinations.end()) {
+    return false;
+  }
+
+  if (_tracked_destinations.size() >= ON_DEMAND_PREFETCH_MAX_ENTRIES) {
+    _untrack(_tracked_destinations.find(_tracked_order.front()));
+  }
+  _tracked_order.push_back(key);
+  _tracked_destinations[key] = Tracked_Destination{
+    now + std::chrono::microseconds(ON_DEMAND_PREFETCH_TRACKING_TTL_IN_MICROSECONDS),
+    std::prev(_tracked_order.end())
+  };
+  _tracked_count = _tracked_destinations.size();
+  return true;
+}
+
+bool ACA_On_Demand_Prefetcher::_untrack(uint16_t vlan_id, uint32_t ip_dest)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto tracked = _tracked_destinations.find(_get_key(vlan_id, ip_dest));
+  if (tracked == _tracked_destinations.end()) {
+    return false;
+  }
+  _untrack(tracked);
+  return true;
+}
+
+void ACA_On_Demand_Prefetcher::_untrack(std::unordered_map<uint64_t, Tracked_Destination>::iterator tracked)
+{
+  _tracked_order.erase(tracked->second.order);
+  _tracked_destinations.erase(tracked);
+  _tracked_count = _tracked_destinations.size();
+}
+} // namespace aca_on_demand_engine
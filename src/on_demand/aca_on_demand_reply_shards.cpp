@@ -0,0 +1,82 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_on_demand_reply_shards.h"
+#include "aca_log.h"
+#include "marl/defer.h"
+
+namespace aca_on_demand_engine
+{
+ACA_On_Demand_Reply_Shards::ACA_On_Demand_Reply_Shards(size_t shard_count,
+                                                       reply_handler_t reply_handler,
+                                                       marl::Scheduler *scheduler)
+        : _reply_handler(reply_handler), _scheduler(scheduler)
+{
+  if (shard_count == 0) {
+    shard_count = 1;
+  }
+  for (size_t i = 0; i < shard_count; i++) {
+    _cqs.emplace_back(new grpc::CompletionQueue());
+  }
+  for (size_t i = 0; i < shard_count; i++) {
+    _pollers.emplace_back([this, i] { _poll(i); });
+  }
+}
+
+ACA_On_Demand_Reply_Shards::~ACA_On_Demand_Reply_Shards()
+{
+  for (auto &cq : _cqs) {
+    cq->Shutdown();
+  }
+  for (auto &poller : _pollers) {
+    poller.join();
+  }
+}
+
+bool ACA_On_Demand_Reply_Shards::send(GoalStateProvisionerClientImpl *client,
+                                      HostRequest *request, uint64_t request_id)
+{
+  ACA_Object_Pool<AsyncClientCall>::handle call = _call_pool.make();
+  grpc::CompletionQueue *cq = _cqs[request_id % _cqs.size()].get();
+
+  call->request_id = request_id;
+
+  if (!client->RequestGoalStates(request, cq, call.get())) {
+    return false;
+  }
+  // the poller of the shard recycles the call when its reply comes
+  call.release();
+  return true;
+}
+
+void ACA_On_Demand_Reply_Shards::_poll(size_t shard)
+{
+  void *got_tag;
+  bool ok = false;
+
+  if (_scheduler != nullptr) {
+    _scheduler->bind();
+  }
+  defer(if (_scheduler != nullptr) { _scheduler->unbind(); });
+
+  ACA_LOG_DEBUG("Polling the replies of on-demand shard %ld in thread id: [%ld]\n",
+                shard, std::this_thread::get_id());
+  while (_cqs[shard]->Next(&got_tag, &ok)) {
+    ACA_Object_Pool<AsyncClientCall>::handle call =
+            _call_pool.adopt(static_cast<AsyncClientCall *>(got_tag));
+    _reply_handler(call.get(), ok);
+  }
+}
+} // namespace aca_on_demand_engine
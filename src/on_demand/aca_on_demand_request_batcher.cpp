@@ -0,0 +1,147 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_on_demand_request_batcher.h"
+#include "aca_log.h"
+#include <algorithm>
+
+namespace aca_on_demand_engine
+{
+ACA_On_Demand_Request_Batcher::ACA_On_Demand_Request_Batcher(send_fn_t send, uint64_t window_us,
+                                                             size_t max_batch_size,
+                                                             size_t max_outstanding_batches,
+                                                             size_t max_pending_requests)
+        : _send(send), _window_us(window_us), _max_batch_size(max_batch_size),
+          _max_outstanding_batches(max_outstanding_batches == 0 ? 1 : max_outstanding_batches),
+          _max_pending_requests(max_pending_requests == 0 ? 1 : max_pending_requests),
+          _shutdown(false)
+{
+  if (enabled()) {
+    _flusher = std::thread([this] { _flush(); });
+  }
+}
+
+ACA_On_Demand_Request_Batcher::~ACA_On_Demand_Request_Batcher()
+{
+  shutdown();
+}
+
+bool ACA_On_Demand_Request_Batcher::add(uint64_t request_id,
+                                        const HostRequest_ResourceStateRequest &state_request)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_shutdown || !enabled() || _pending.size() >= _max_pending_requests) {
+      return false;
+    }
+    _pending.push_back(Pending_Request{ request_id, std::chrono::steady_clock::now(), state_request });
+    // the flusher sleeps until the window of the oldest request ends,
+    // it only has to wake up earlier for a first request or a full batch
+    if (_pending.size() != 1 && _pending.size() != _max_batch_size) {
+      return true;
+    }
+  }
+  _cv.notify_one();
+  return true;
+}
+
+bool ACA_On_Demand_Request_Batcher::complete(uint64_t batch_id)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_outstanding.erase(batch_id) == 0) {
+      return false;
+    }
+  }
+  _cv.notify_one();
+  return true;
+}
+
+void ACA_On_Demand_Request_Batcher::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _shutdown = true;
+  }
+  _cv.notify_all();
+  if (_flusher.joinable()) {
+    _flusher.join();
+  }
+}
+
+size_t ACA_On_Demand_Request_Batcher::pending()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending.size();
+}
+
+size_t ACA_On_Demand_Request_Batcher::outstanding()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _outstanding.size();
+}
+
+bool ACA_On_Demand_Request_Batcher::_batch_ready(time_point now) const
+{
+  if (_pending.empty() || _outstanding.size() >= _max_outstanding_batches) {
+    return false;
+  }
+  return _pending.size() >= _max_batch_size ||
+         _pending.front().enqueue_time + std::chrono::microseconds(_window_us) <= now;
+}
+
+void ACA_On_Demand_Request_Batcher::_flush()
+{
+  ACA_LOG_DEBUG("Batching the on-demand requests in thread id: [%ld]\n",
+                std::this_thread::get_id());
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_shutdown) {
+    time_point now = std::chrono::steady_clock::now();
+    if (!_batch_ready(now)) {
+      if (_pending.empty() || _outstanding.size() >= _max_outstanding_batches) {
+        // wait for a request or a reply
+        _cv.wait(lock);
+      } else {
+        _cv.wait_until(lock, _pending.front().enqueue_time +
+                                     std::chrono::microseconds(_window_us));
+      }
+      continue;
+    }
+
+    HostRequest request;
+    uint64_t batch_id = _pending.front().request_id;
+    size_t batch_size = std::min(_pending.size(), _max_batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+      request.add_state_requests()->Swap(&_pending.front().state_request);
+      _pending.pop_front();
+    }
+    _outstanding.insert(batch_id);
+
+    // the requests added meanwhile go to the next batch
+    lock.unlock();
+    bool sent = _send(&request, batch_id);
+    lock.lock();
+
+    if (!sent) {
+      ACA_LOG_ERROR("Failed to send the on-demand batch of request id: [%lu] with %ld requests\n",
+                    batch_id, batch_size);
+      _outstanding.erase(batch_id);
+    }
+  }
+}
+} // namespace aca_on_demand_engine
@@ -20,6 +20,7 @@
 #include <shared_mutex>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
 
@@ -27,7 +28,7 @@ using namespace std;
 
 namespace aca_arp_responder
 {
-ACA_ARP_Responder::ACA_ARP_Responder()
+ACA_ARP_Responder::ACA_ARP_Responder() : _next_waiter_id(0)
 {
   _init_arp_db();
   _init_arp_ofp();
@@ -84,6 +85,69 @@ bool ACA_ARP_Responder::does_arp_entry_exist(arp_entry_data stData)
   return entry_exist;
 }
 
+bool ACA_ARP_Responder::wait_for_arp_entry(arp_entry_data stData,
+                                           std::chrono::microseconds timeout)
+{
+  marl::Event ready(marl::Event::Mode::Manual);
+  uint64_t waiter_id;
+
+  {
+    // check and register under the same lock, an entry added in between
+    // is either seen here or its notification sees this waiter
+    lock_guard<mutex> lock(_arp_waiters_mutex);
+    if (does_arp_entry_exist(stData)) {
+      return true;
+    }
+    waiter_id = _next_waiter_id++;
+    _arp_waiters[stData].push_back({ waiter_id, ready });
+  }
+
+  if (ready.wait_for(timeout)) {
+    return true;
+  }
+
+  // timed out, remove the waiter unless it was notified in the meantime
+  {
+    lock_guard<mutex> lock(_arp_waiters_mutex);
+    auto found = _arp_waiters.find(stData);
+    if (found != _arp_waiters.end()) {
+      auto &waiters = found->second;
+      for (auto it = waiters.begin(); it != waiters.end(); it++) {
+        if (it->waiter_id == waiter_id) {
+          waiters.erase(it);
+          break;
+        }
+      }
+      if (waiters.empty()) {
+        _arp_waiters.erase(found);
+      }
+    }
+  }
+
+  return does_arp_entry_exist(stData);
+}
+
+void ACA_ARP_Responder::_notify_arp_waiters(const arp_entry_data &stData)
+{
+  vector<arp_entry_waiter> waiters;
+
+  {
+    lock_guard<mutex> lock(_arp_waiters_mutex);
+    auto found = _arp_waiters.find(stData);
+    if (found == _arp_waiters.end()) {
+      return;
+    }
+    waiters.swap(found->second);
+    _arp_waiters.erase(found);
+  }
+
+  ACA_LOG_DEBUG("Waking up %ld requests waiting for arp entry (ip = %s and vlan id = %u)\n",
+                waiters.size(), stData.ipv4_address.c_str(), stData.vlan_id);
+  for (auto &waiter : waiters) {
+    waiter.ready.signal();
+  }
+}
+
 int ACA_ARP_Responder::add_arp_entry(arp_config *arp_cfg_in)
 {
   arp_entry_data stData;
@@ -106,6 +170,8 @@ int ACA_ARP_Responder::add_arp_entry(arp_config *arp_cfg_in)
     ACA_LOG_DEBUG("Arp Entry with ip: %s and vlan id %u added\n",
                   arp_cfg_in->ipv4_address.c_str(), arp_cfg_in->vlan_id);
 
+    _notify_arp_waiters(stData);
+
     return EXIT_SUCCESS;
   } catch (std::invalid_argument &ia) {
     ACA_LOG_ERROR("%s,validate arp config failed! (ip = %s and vlan id = %u)\n",
@@ -231,13 +297,9 @@ void ACA_ARP_Responder::arp_xmit(uint32_t in_port, void *vlanmsg, void *message,
 {
   arp_message *arpmsg = nullptr;
   string bridge = "br-tun";
-  string inport = "in_port=controller";
-  string whitespace = " ";
-  string action = "actions=output:" + to_string(in_port);
-  string rs_action = "actions=resubmit(,22)";
-  string packetpre = "packet=";
-  string packet;
-  string options;
+  uint8_t packet[ARP_PACKET_MAX_LEN];
+  size_t packet_len;
+  packet_out_actions_t actions;
 
   arpmsg = (arp_message *)message;
   if (!arpmsg) {
@@ -245,24 +307,25 @@ void ACA_ARP_Responder::arp_xmit(uint32_t in_port, void *vlanmsg, void *message,
     return;
   }
 
-  packet = _serialize_arp_message((vlan_message *)vlanmsg, arpmsg);
-  if (packet.empty()) {
+  packet_len = _serialize_arp_message((vlan_message *)vlanmsg, arpmsg, packet);
+  if (packet_len == 0) {
     ACA_LOG_ERROR("%s", "Serialized ARP Reply is null!\n");
     return;
   }
 
   if (is_found) {
-    options = inport + whitespace + packetpre + packet + whitespace + action;
+    actions.push_back(PacketOutAction::output(in_port));
     //delete the constructed arp reply
     delete arpmsg;
   } else {
-    options = inport + whitespace + packetpre + packet + whitespace + rs_action;
+    actions.push_back(PacketOutAction::resubmit(22));
   }
 
-  ACA_LOG_DEBUG("ACA_ARP_Responder sent arp packet to ovs: %s\n", options.c_str());
+  ACA_LOG_DEBUG("ACA_ARP_Responder sent arp packet of %ld bytes to ovs, is_found: %d\n",
+                packet_len, is_found);
 
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(bridge.c_str(),
-                                                                          options.c_str());
+  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().packet_out(
+          bridge.c_str(), OF13_PORT_CONTROLLER, packet, packet_len, actions);
 }
 
 int ACA_ARP_Responder::_parse_arp_request(uint32_t in_port, vlan_message *vlanmsg,
@@ -367,64 +430,35 @@ string ACA_ARP_Responder::_get_source_ip(arp_message *arpmsg)
   return source_ip;
 }
 
-string ACA_ARP_Responder::_serialize_arp_message(vlan_message *vlanmsg, arp_message *arpmsg)
+size_t ACA_ARP_Responder::_serialize_arp_message(vlan_message *vlanmsg,
+                                                 arp_message *arpmsg, uint8_t *packet)
 {
-  string packet;
-  char str[80];
+  size_t len = 0;
+  uint16_t ether_type = htons(0x0806);
   if (!arpmsg) {
-    return string();
+    return 0;
   }
 
-  //fix arp header
-  sprintf(str, "%04x", ntohs(arpmsg->hrd));
-  packet.append(str);
-  sprintf(str, "%04x", ntohs(arpmsg->pro));
-  packet.append(str);
-  sprintf(str, "%02x", arpmsg->hln);
-  packet.append(str);
-  sprintf(str, "%02x", arpmsg->pln);
-  packet.append(str);
-  sprintf(str, "%04x", ntohs(arpmsg->op));
-  packet.append(str);
-
-  //fix ip and mac address of source node
-  for (int i = 0; i < 6; i++) {
-    sprintf(str, "%02x", arpmsg->sha[i]);
-    packet.append(str);
-  }
-  sprintf(str, "%08x", ntohl(arpmsg->spa));
-  packet.append(str);
-
-  //fix ip and mac address of target node
-  for (int i = 0; i < 6; i++) {
-    sprintf(str, "%02x", arpmsg->tha[i]);
-    packet.append(str);
-  }
-  sprintf(str, "%08x", ntohl(arpmsg->tpa));
-  packet.append(str);
-
+  // the headers are in network byte order already, they go out as they are
   //fix the ethernet header
-  string packet_header;
-  for (int i = 0; i < 6; i++) {
-    sprintf(str, "%02x", arpmsg->tha[i]);
-    packet_header.append(str);
-  }
-
-  for (int i = 0; i < 6; i++) {
-    sprintf(str, "%02x", arpmsg->sha[i]);
-    packet_header.append(str);
-  }
+  memcpy(packet + len, arpmsg->tha, 6);
+  len += 6;
+  memcpy(packet + len, arpmsg->sha, 6);
+  len += 6;
   //fix the vlan header
   if (vlanmsg) {
-    sprintf(str, "%04x", ntohs(vlanmsg->vlan_proto));
-    packet_header.append(str);
-    sprintf(str, "%04x", ntohs(vlanmsg->vlan_tci));
-    packet_header.append(str);
+    memcpy(packet + len, &vlanmsg->vlan_proto, sizeof(vlanmsg->vlan_proto));
+    len += sizeof(vlanmsg->vlan_proto);
+    memcpy(packet + len, &vlanmsg->vlan_tci, sizeof(vlanmsg->vlan_tci));
+    len += sizeof(vlanmsg->vlan_tci);
   }
-
   //arp protocol：0806
-  packet_header.append("0806");
-  packet.insert(0, packet_header);
-  return packet;
+  memcpy(packet + len, &ether_type, sizeof(ether_type));
+  len += sizeof(ether_type);
+
+  //fix arp header, ip and mac address of source and target node
+  memcpy(packet + len, arpmsg, sizeof(arp_message));
+  len += sizeof(arp_message);
+  return len;
 }
 } // namespace aca_arp_responder
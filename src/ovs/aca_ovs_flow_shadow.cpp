@@ -0,0 +1,306 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_ovs_flow_shadow.h"
+#include "aca_config.h"
+#include "aca_log.h"
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <unordered_set>
+
+namespace aca_ovs_l2_programmer
+{
+ACA_OVS_Flow_Shadow &ACA_OVS_Flow_Shadow::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_OVS_Flow_Shadow instance(OVS_FLOW_SHADOW_MAX_FLOWS_PER_BRIDGE, _get_run_cookie());
+  return instance;
+}
+
+uint64_t ACA_OVS_Flow_Shadow::_get_run_cookie()
+{
+  // the start time of the agent tells its runs apart
+  uint64_t start_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+  return OVS_FLOW_AGENT_COOKIE | (start_us & ~OVS_FLOW_AGENT_COOKIE_MASK);
+}
+
+ACA_OVS_Flow_Shadow::ACA_OVS_Flow_Shadow(size_t max_flows_per_bridge, uint64_t cookie)
+        : _max_flows_per_bridge(max_flows_per_bridge), _cookie(cookie)
+{
+}
+
+std::string ACA_OVS_Flow_Shadow::_get_value(const FlowBuilder &flow)
+{
+  std::string value = flow.actions_string();
+  if (flow.has_cookie()) {
+    value += ",cookie=" + std::to_string(flow.cookie());
+  }
+  return value;
+}
+
+bool ACA_OVS_Flow_Shadow::update(const std::string &bridge, const FlowBuilder &flow,
+                                 const std::string &action)
+{
+  if (!flow.valid() || (action != "add" && action != "mod" && action != "del")) {
+    // nothing is programmed from it, let the flow-mod report the problem
+    return true;
+  }
+
+  std::string match = flow.match_string();
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto &table = _bridges[bridge][flow.table_id()];
+  size_t &size = _sizes[bridge];
+  auto found = table.find(match);
+
+  if (action == "del") {
+    // the flow may be there without the shadow knowing, the delete is sent anyway
+    if (found != table.end()) {
+      table.erase(found);
+      size--;
+    }
+    return true;
+  }
+
+  if (flow.idle_timeout() != 0 || flow.hard_timeout() != 0) {
+    if (found != table.end()) {
+      table.erase(found);
+      size--;
+    }
+    return true;
+  }
+
+  std::string value = _get_value(flow);
+
+  if (found != table.end()) {
+    Entry &entry = found->second;
+    if (entry.in_sync && entry.value == value) {
+      if (!entry.wanted) {
+        // a flow kept by reconcile() is the agent's from now on
+        entry.flow = flow;
+        entry.wanted = true;
+      }
+      return false;
+    }
+    entry.value = std::move(value);
+    entry.flow = flow;
+    entry.wanted = true;
+    entry.in_sync = true;
+    return true;
+  }
+
+  // a strict modify of a flow which is not there does not add it
+  if (action == "add") {
+    if (size < _max_flows_per_bridge) {
+      table.emplace(std::move(match), Entry{ std::move(value), flow, true, true });
+      size++;
+    } else {
+      _set_overflowed(bridge);
+    }
+  }
+  return true;
+}
+
+void ACA_OVS_Flow_Shadow::_set_overflowed(const std::string &bridge)
+{
+  if (_overflowed.insert(bridge).second) {
+    ACA_LOG_WARN("ACA_OVS_Flow_Shadow - bridge %s has more than %lu flows, its unknown flows are no longer deleted\n",
+                 bridge.c_str(), _max_flows_per_bridge);
+  }
+}
+
+void ACA_OVS_Flow_Shadow::invalidate(const std::string &bridge, const std::string &flow)
+{
+  size_t table_pos = flow.find("table=");
+  if (table_pos == std::string::npos) {
+    invalidate(bridge);
+    return;
+  }
+
+  char *end = nullptr;
+  unsigned long table_id = strtoul(flow.c_str() + table_pos + 6, &end, 10);
+  if (end == flow.c_str() + table_pos + 6 || table_id > UINT8_MAX) {
+    invalidate(bridge);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found_bridge = _bridges.find(bridge);
+  if (found_bridge == _bridges.end()) {
+    return;
+  }
+  auto found_table = found_bridge->second.find(static_cast<uint8_t>(table_id));
+  if (found_table != found_bridge->second.end()) {
+    for (auto &entry : found_table->second) {
+      entry.second.in_sync = false;
+    }
+  }
+}
+
+void ACA_OVS_Flow_Shadow::invalidate_command(const std::string &command)
+{
+  std::istringstream tokens(command);
+  std::string verb, bridge;
+  tokens >> verb >> bridge;
+
+  // add-flow, add-flows, mod-flows, del-flows, replace-flows...
+  if (verb.find("-flow") == std::string::npos || bridge.empty()) {
+    return;
+  }
+  // "add-flows" and "replace-flows" read the flows from a file
+  if (verb == "add-flows" || verb == "replace-flows") {
+    invalidate(bridge);
+  } else {
+    std::string flow;
+    std::getline(tokens, flow);
+    invalidate(bridge, flow);
+  }
+}
+
+void ACA_OVS_Flow_Shadow::invalidate(const std::string &bridge)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found_bridge = _bridges.find(bridge);
+  if (found_bridge == _bridges.end()) {
+    return;
+  }
+  for (auto &table : found_bridge->second) {
+    for (auto &entry : table.second) {
+      entry.second.in_sync = false;
+    }
+  }
+}
+
+void ACA_OVS_Flow_Shadow::reconcile(const std::string &bridge,
+                                    const std::vector<FlowBuilder> &found, bool keep_unknown,
+                                    std::vector<FlowBuilder> &missing, std::vector<size_t> &stale)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto &tables = _bridges[bridge];
+  size_t &size = _sizes[bridge];
+  std::unordered_set<const Entry *> seen;
+
+  for (size_t i = 0; i < found.size(); i++) {
+    const FlowBuilder &flow = found[i];
+    auto &table = tables[flow.table_id()];
+    std::string match = flow.match_string();
+    // every flow found has the agent cookie, only the actions tell them apart
+    std::string value = flow.actions_string();
+    auto entry = table.find(match);
+
+    if (entry == table.end()) {
+      if (keep_unknown && size < _max_flows_per_bridge) {
+        auto kept = table.emplace(std::move(match), Entry{ std::move(value), flow, false, true });
+        seen.insert(&kept.first->second);
+        size++;
+      } else if (keep_unknown) {
+        _set_overflowed(bridge);
+      } else if (_overflowed.count(bridge) == 0) {
+        stale.push_back(i);
+      }
+      continue;
+    }
+
+    Entry &e = entry->second;
+    seen.insert(&e);
+    if (!e.wanted) {
+      // kept by an earlier pass, still waiting for sweep()
+      e.value = std::move(value);
+      e.flow = flow;
+    } else if (e.flow.has_cookie() || e.value != value) {
+      // the add replaces the flow found
+      missing.push_back(e.flow);
+    }
+    e.in_sync = true;
+  }
+
+  for (auto &table : tables) {
+    for (auto entry = table.second.begin(); entry != table.second.end();) {
+      Entry &e = entry->second;
+      if (seen.count(&e) > 0) {
+        entry++;
+      } else if (!e.wanted) {
+        // gone from the bridge
+        entry = table.second.erase(entry);
+        size--;
+      } else {
+        // a flow with a cookie of its own is not dumped, it is added again too
+        missing.push_back(e.flow);
+        e.in_sync = true;
+        entry++;
+      }
+    }
+  }
+}
+
+std::vector<FlowBuilder> ACA_OVS_Flow_Shadow::sweep(const std::string &bridge)
+{
+  std::vector<FlowBuilder> unclaimed;
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found_bridge = _bridges.find(bridge);
+  if (found_bridge == _bridges.end()) {
+    return unclaimed;
+  }
+
+  size_t &size = _sizes[bridge];
+  for (auto &table : found_bridge->second) {
+    for (auto entry = table.second.begin(); entry != table.second.end();) {
+      if (entry->second.wanted) {
+        entry++;
+        continue;
+      }
+      unclaimed.push_back(entry->second.flow);
+      entry = table.second.erase(entry);
+      size--;
+    }
+  }
+  return unclaimed;
+}
+
+FlowBuilder ACA_OVS_Flow_Shadow::tag(const FlowBuilder &flow) const
+{
+  FlowBuilder tagged = flow;
+  if (!flow.has_cookie() && _cookie != 0) {
+    tagged.cookie(_cookie);
+  }
+  return tagged;
+}
+
+void ACA_OVS_Flow_Shadow::clear(const std::string &bridge)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _bridges.erase(bridge);
+  _sizes.erase(bridge);
+  _overflowed.erase(bridge);
+}
+
+void ACA_OVS_Flow_Shadow::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _bridges.clear();
+  _sizes.clear();
+  _overflowed.clear();
+}
+
+size_t ACA_OVS_Flow_Shadow::size(const std::string &bridge)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found = _sizes.find(bridge);
+  return found == _sizes.end() ? 0 : found->second;
+}
+} // namespace aca_ovs_l2_programmer
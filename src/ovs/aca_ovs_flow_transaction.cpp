@@ -0,0 +1,276 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_ovs_flow_transaction.h"
+#include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_shadow.h"
+#include "aca_log.h"
+#include "marl/scheduler.h"
+#include <algorithm>
+#include <atomic>
+
+extern std::atomic_ulong g_total_ovs_flow_bundles_committed;
+extern std::atomic_ulong g_total_ovs_bundled_flows;
+extern std::atomic_ulong g_total_ovs_failed_flows;
+
+namespace aca_ovs_l2_programmer
+{
+// k is the fiber (or the thread outside of marl), v is its transaction
+static std::mutex transactions_mutex;
+static std::unordered_map<const void *, ACA_OVS_Flow_Transaction *> transactions;
+
+static const void *get_current_fiber()
+{
+  static thread_local char thread_key;
+  marl::Scheduler::Fiber *fiber = marl::Scheduler::Fiber::current();
+
+  if (fiber != nullptr) {
+    return fiber;
+  }
+  return &thread_key;
+}
+
+ACA_OVS_Flow_Transaction::Scope::Scope(ACA_OVS_Flow_Transaction *transaction)
+        : _fiber(get_current_fiber()), _transaction(transaction), _previous(nullptr)
+{
+  std::lock_guard<std::mutex> lock(transactions_mutex);
+  auto found = transactions.find(_fiber);
+  if (found != transactions.end()) {
+    _previous = found->second;
+  }
+  if (transaction != nullptr) {
+    transactions[_fiber] = transaction;
+  } else if (found != transactions.end()) {
+    transactions.erase(found);
+  }
+}
+
+ACA_OVS_Flow_Transaction::Scope::~Scope()
+{
+  // another fiber may get the same address later on
+  if (_transaction != nullptr) {
+    _transaction->_release_fiber(_fiber);
+  }
+
+  std::lock_guard<std::mutex> lock(transactions_mutex);
+  if (_previous != nullptr) {
+    transactions[_fiber] = _previous;
+  } else {
+    transactions.erase(_fiber);
+  }
+}
+
+ACA_OVS_Flow_Transaction::ACA_OVS_Flow_Transaction(size_t bundle_size)
+        : _bundle_size(bundle_size == 0 ? 1 : bundle_size), _size(0)
+{
+}
+
+ACA_OVS_Flow_Transaction *ACA_OVS_Flow_Transaction::current()
+{
+  const void *fiber = get_current_fiber();
+  std::lock_guard<std::mutex> lock(transactions_mutex);
+
+  auto found = transactions.find(fiber);
+  return found == transactions.end() ? nullptr : found->second;
+}
+
+void ACA_OVS_Flow_Transaction::add(const std::string &bridge,
+                                   const std::string &flow, const std::string &action)
+{
+  ofmsg_ptr_t flow_mod = create_flow_mod(flow, action);
+  if (!flow_mod) {
+    ACA_LOG_ERROR("ACA_OVS_Flow_Transaction::add - action %s not supported in flow %s\n",
+                  action.c_str(), flow.c_str());
+    return;
+  }
+  _add(bridge, flow_mod);
+}
+
+void ACA_OVS_Flow_Transaction::add(const std::string &bridge,
+                                   const FlowBuilder &flow, const std::string &action)
+{
+  ofmsg_ptr_t flow_mod = create_flow_mod(flow, action);
+  if (!flow_mod) {
+    ACA_LOG_ERROR("ACA_OVS_Flow_Transaction::add - action %s not supported in flow %s\n",
+                  action.c_str(), flow.to_string().c_str());
+    return;
+  }
+  _add(bridge, flow_mod);
+}
+
+void ACA_OVS_Flow_Transaction::_add(const std::string &bridge, ofmsg_ptr_t flow_mod)
+{
+  const void *fiber = get_current_fiber();
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto &flows = _flows[bridge];
+  if (flows.empty()) {
+    _bridges.push_back(bridge);
+  }
+  _unattached_flows[fiber].emplace_back(bridge, flows.size());
+  flows.push_back(Flow{ std::move(flow_mod), -1 });
+  _size++;
+}
+
+void ACA_OVS_Flow_Transaction::after_commit(std::function<void()> action)
+{
+  ACA_OVS_Flow_Transaction *transaction = current();
+
+  if (transaction == nullptr) {
+    action();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(transaction->_mutex);
+  transaction->_actions.push_back(std::move(action));
+}
+
+void ACA_OVS_Flow_Transaction::attach_operation_status(int status_index)
+{
+  const void *fiber = get_current_fiber();
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found = _unattached_flows.find(fiber);
+  if (found == _unattached_flows.end()) {
+    return;
+  }
+  for (auto &flow : found->second) {
+    _flows[flow.first][flow.second].status_index = status_index;
+  }
+  _unattached_flows.erase(found);
+}
+
+void ACA_OVS_Flow_Transaction::_release_fiber(const void *fiber)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _unattached_flows.erase(fiber);
+}
+
+int ACA_OVS_Flow_Transaction::commit(ulong &culminative_time)
+{
+  std::vector<std::string> bridges;
+  std::unordered_map<std::string, std::vector<Flow> > flows;
+  std::vector<std::function<void()> > actions;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    bridges.swap(_bridges);
+    flows.swap(_flows);
+    actions.swap(_actions);
+    _unattached_flows.clear();
+    _size = 0;
+  }
+
+  int bundles = 0;
+  std::vector<Pending_Completion> completions;
+  for (auto &bridge : bridges) {
+    auto &bridge_flows = flows[bridge];
+    Pending_Completion pending{ bridge,
+                                std::make_shared<FlowCompletion>(bridge_flows.size()),
+                                std::vector<int>() };
+    pending.status_indexes.reserve(bridge_flows.size());
+    for (auto &flow : bridge_flows) {
+      pending.status_indexes.push_back(flow.status_index);
+    }
+
+    for (size_t begin = 0; begin < bridge_flows.size(); begin += _bundle_size) {
+      size_t end = std::min(begin + _bundle_size, bridge_flows.size());
+      std::vector<ofmsg_ptr_t> bundle;
+      bundle.reserve(end - begin);
+      for (size_t i = begin; i < end; i++) {
+        bundle.push_back(bridge_flows[i].flow_mod);
+      }
+      ACA_OVS_L2_Programmer::get_instance().execute_openflow_bundle(
+              culminative_time, bridge, bundle, pending.completion, begin);
+      g_total_ovs_bundled_flows += bundle.size();
+      bundles++;
+    }
+    // one barrier answers all the bundles of the bridge
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow_barrier(bridge, pending.completion);
+    completions.push_back(std::move(pending));
+  }
+  g_total_ovs_flow_bundles_committed += bundles;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto &pending : completions) {
+    _completions.push_back(std::move(pending));
+  }
+  for (auto &action : actions) {
+    _committed_actions.push_back(std::move(action));
+  }
+  return bundles;
+}
+
+std::vector<int> ACA_OVS_Flow_Transaction::wait_for_completion(std::chrono::microseconds timeout)
+{
+  std::vector<Pending_Completion> completions;
+  std::vector<std::function<void()> > actions;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    completions.swap(_completions);
+    actions.swap(_committed_actions);
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  std::vector<int> failed_statuses;
+  for (auto &pending : completions) {
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now());
+    bool done = pending.completion->wait_for(std::max(remaining, std::chrono::microseconds(0)));
+    if (!done || pending.completion->failed() > 0) {
+      // the flows the shadow recorded for the bridge may not be there
+      ACA_OVS_Flow_Shadow::get_instance().invalidate(pending.bridge);
+    }
+    if (!done) {
+      ACA_LOG_ERROR("ACA_OVS_Flow_Transaction::wait_for_completion - %lu flows to bridge %s not answered in time\n",
+                    pending.completion->size(), pending.bridge.c_str());
+    } else if (pending.completion->failed() > 0) {
+      ACA_LOG_ERROR("ACA_OVS_Flow_Transaction::wait_for_completion - %lu of %lu flows to bridge %s failed\n",
+                    pending.completion->failed(), pending.completion->size(),
+                    pending.bridge.c_str());
+    }
+
+    for (size_t i = 0; i < pending.status_indexes.size(); i++) {
+      uint32_t error = pending.completion->error(i);
+      if (done && error == 0) {
+        continue;
+      }
+      // the errors of the switch, the others are summed up above
+      if (error != 0 && error < FLOW_ERROR_NO_CONNECTION) {
+        ACA_LOG_ERROR("ACA_OVS_Flow_Transaction::wait_for_completion - flow %lu to bridge %s failed with error 0x%x\n",
+                      i, pending.bridge.c_str(), error);
+      }
+      g_total_ovs_failed_flows++;
+      if (pending.status_indexes[i] >= 0) {
+        failed_statuses.push_back(pending.status_indexes[i]);
+      }
+    }
+  }
+
+  // the flows are in place, or never will be, the state depending on them goes now
+  for (auto &action : actions) {
+    action();
+  }
+
+  std::sort(failed_statuses.begin(), failed_statuses.end());
+  failed_statuses.erase(std::unique(failed_statuses.begin(), failed_statuses.end()),
+                        failed_statuses.end());
+  return failed_statuses;
+}
+
+size_t ACA_OVS_Flow_Transaction::size()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _size;
+}
+} // namespace aca_ovs_l2_programmer
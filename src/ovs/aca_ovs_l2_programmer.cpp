@@ -18,6 +18,10 @@
 #include "aca_net_config.h"
 #include "aca_vlan_manager.h"
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_shadow.h"
+#include "aca_ovs_flow_transaction.h"
+#include "aca_ovsdb_client.h"
+#include "aca_ovsdb_port_monitor.h"
 #include <chrono>
 #include <thread>
 #include <errno.h>
@@ -39,51 +43,12 @@ mutex setup_ovs_bridges_mutex;
 
 extern std::atomic_ulong g_total_execute_ovsdb_time;
 extern std::atomic_ulong g_total_execute_openflow_time;
+extern std::atomic_ulong g_total_ovs_flows_suppressed;
+extern std::atomic_ulong g_total_ovs_flows_sent;
 extern bool g_demo_mode;
 
 namespace aca_ovs_l2_programmer
 {
-static int aca_set_port_vlan_workitem(const string port_name, uint vlan_id)
-{
-  ACA_LOG_DEBUG("%s", "aca_set_port_vlan_workitem ---> Entering\n");
-
-  ulong not_care_culminative_time = 0;
-  int overall_rc;
-
-  if (port_name.empty()) {
-    throw std::invalid_argument("port_name is empty");
-  }
-
-  if (vlan_id == 0 || vlan_id >= 4095) {
-    throw std::invalid_argument("vlan_id is invalid: " + to_string(vlan_id));
-  }
-
-  uint retry_times = 0;
-  string cmd_string = "set port " + port_name + " tag=" + to_string(vlan_id);
-
-  do {
-    std::this_thread::sleep_for(chrono::milliseconds(PORT_SCAN_SLEEP_INTERVAL));
-
-    overall_rc = EXIT_SUCCESS;
-    ACA_OVS_L2_Programmer::get_instance().execute_ovsdb_command(
-            cmd_string, not_care_culminative_time, overall_rc);
-
-    if (overall_rc == EXIT_SUCCESS)
-      break;
-  } while (++retry_times < MAX_PORT_SCAN_RETRY);
-
-  if (overall_rc != EXIT_SUCCESS) {
-    ACA_LOG_ERROR("Not able to set the vlan tag %d for port %s even after waiting\n",
-                  vlan_id, port_name.c_str());
-  }
-
-  // TODO: after this workitem thread is done, it should provide the updated success/fail result back to DPM
-
-  ACA_LOG_DEBUG("aca_set_port_vlan_workitem <--- Exiting, overall_rc = %d\n", overall_rc);
-
-  return overall_rc;
-}
-
 ACA_OVS_L2_Programmer &ACA_OVS_L2_Programmer::get_instance()
 {
   // Instance is destroyed when program exits.
@@ -172,11 +137,14 @@ int ACA_OVS_L2_Programmer::setup_ovs_bridges_if_need()
   setup_ovs_bridges_mutex.lock();
 
   // check to see if br-int and br-tun is already there
-  execute_ovsdb_command("br-exists br-int", not_care_culminative_time, overall_rc);
+  overall_rc = _execute_ovsdb_transaction(
+          [](ACA_OVSDB_Client &client) { return client.bridge_exists("br-int"); },
+          "br-exists br-int", not_care_culminative_time);
   bool br_int_existed = (overall_rc == EXIT_SUCCESS);
-  overall_rc = EXIT_SUCCESS;
 
-  execute_ovsdb_command("br-exists br-tun", not_care_culminative_time, overall_rc);
+  overall_rc = _execute_ovsdb_transaction(
+          [](ACA_OVSDB_Client &client) { return client.bridge_exists("br-tun"); },
+          "br-exists br-tun", not_care_culminative_time);
   bool br_tun_existed = (overall_rc == EXIT_SUCCESS);
   ACA_LOG_INFO("Environment br-int=%d and br-tun=%d\n", br_int_existed, br_tun_existed);
   overall_rc = EXIT_SUCCESS;
@@ -316,6 +284,20 @@ std::string ACA_OVS_L2_Programmer::get_system_port_id(std::string port_name)
   return port_id_map[port_name];
 }
 
+// openflow port number of an interface, as a string
+static string get_interface_ofport(const string &interface)
+{
+  int64_t ofport;
+  int rc = ACA_OVSDB_Client::get_instance().get_ofport(interface, ofport);
+  if (rc == EXIT_SUCCESS) {
+    return to_string(ofport);
+  }
+  ACA_LOG_DEBUG("get_interface_ofport - ovsdb query of %s failed, rc: %d\n", interface.c_str(), rc);
+
+  string ofport_query = "ovs-vsctl get Interface " + interface + " ofport";
+  return aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(ofport_query);
+}
+
 std::unordered_map<std::string, std::string> ACA_OVS_L2_Programmer::get_system_port_ids()
 {
   // these 2 system ports belong to br-tun
@@ -325,13 +307,11 @@ std::unordered_map<std::string, std::string> ACA_OVS_L2_Programmer::get_system_p
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::get_system_port_ids ---> Entering\n");
   auto ovsdb_client_start = chrono::steady_clock::now();
 
-  string patch_int_ofport_query = "ovs-vsctl get Interface " + patch_int_port + " ofport";
-  string patch_int_ofport_id = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(patch_int_ofport_query);
+  string patch_int_ofport_id = get_interface_ofport(patch_int_port);
   ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_system_port_ids - adding %s - %s mapping to port_id_map\n", patch_int_port.c_str(), patch_int_ofport_id.c_str());
   port_id_map[patch_int_port] = patch_int_ofport_id;
 
-  string vxlan_ofport_query = "ovs-vsctl get Interface " + vxlan_generic_port + " ofport";
-  string vxlan_ofport_id = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(vxlan_ofport_query);
+  string vxlan_ofport_id = get_interface_ofport(vxlan_generic_port);
   ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_system_port_ids - adding %s - %s mapping to port_id_map\n", vxlan_generic_port.c_str(), vxlan_ofport_id.c_str());
   port_id_map[vxlan_generic_port] = vxlan_ofport_id;
 
@@ -360,19 +340,29 @@ std::unordered_map<uint64_t, std::string> ACA_OVS_L2_Programmer::get_ovs_bridge_
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::get_ovs_bridge_mapping ---> Entering\n");
   auto ovsdb_client_start = chrono::steady_clock::now();
 
-  string br_int_cmd_string = "ovs-vsctl " + get_br_int_dpid;
-  // raw string output format is like a hex string "00003af45ed7aa45"
-  string br_int_dpid_raw = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(br_int_cmd_string);
-  // trim the (") symbol at the start and the end to get 00003af45ed7aa45, and then convert to decimal
-  uint64_t br_int_dpid = std::stoul(br_int_dpid_raw.substr(1, br_int_dpid_raw.length() - 3), nullptr, 16);
-  ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", br_int_dpid, br_int_str.c_str());
-  switch_dpid_map[br_int_dpid] = br_int_str;
+  // all the bridges in one query when ovsdb-server is reachable
+  std::unordered_map<std::string, uint64_t> datapath_ids;
+  int rc = ACA_OVSDB_Client::get_instance().get_datapath_ids(datapath_ids);
+  if (rc == EXIT_SUCCESS && datapath_ids.count(br_int_str) && datapath_ids.count(br_tun_str)) {
+    ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", datapath_ids[br_int_str], br_int_str.c_str());
+    switch_dpid_map[datapath_ids[br_int_str]] = br_int_str;
+    ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", datapath_ids[br_tun_str], br_tun_str.c_str());
+    switch_dpid_map[datapath_ids[br_tun_str]] = br_tun_str;
+  } else {
+    string br_int_cmd_string = "ovs-vsctl " + get_br_int_dpid;
+    // raw string output format is like a hex string "00003af45ed7aa45"
+    string br_int_dpid_raw = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(br_int_cmd_string);
+    // trim the (") symbol at the start and the end to get 00003af45ed7aa45, and then convert to decimal
+    uint64_t br_int_dpid = std::stoul(br_int_dpid_raw.substr(1, br_int_dpid_raw.length() - 3), nullptr, 16);
+    ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", br_int_dpid, br_int_str.c_str());
+    switch_dpid_map[br_int_dpid] = br_int_str;
 
-  string br_tun_cmd_string = "ovs-vsctl " + get_br_tun_dpid;
-  string br_tun_dpid_raw = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(br_tun_cmd_string);
-  uint64_t br_tun_dpid = std::stoul(br_tun_dpid_raw.substr(1, br_tun_dpid_raw.length() - 3), nullptr, 16);
-  ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", br_tun_dpid, br_tun_str.c_str());
-  switch_dpid_map[br_tun_dpid] = br_tun_str;
+    string br_tun_cmd_string = "ovs-vsctl " + get_br_tun_dpid;
+    string br_tun_dpid_raw = aca_net_config::Aca_Net_Config::get_instance().execute_system_command_with_return(br_tun_cmd_string);
+    uint64_t br_tun_dpid = std::stoul(br_tun_dpid_raw.substr(1, br_tun_dpid_raw.length() - 3), nullptr, 16);
+    ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::get_ovs_bridge_mapping - adding %ld - %s mapping to switch_dpid_map\n", br_tun_dpid, br_tun_str.c_str());
+    switch_dpid_map[br_tun_dpid] = br_tun_str;
+  }
 
   auto ovsdb_client_end = chrono::steady_clock::now();
   auto ovsdb_client_time_total_time =
@@ -433,10 +423,16 @@ int ACA_OVS_L2_Programmer::create_port(const string vpc_id, const string port_na
                         " tag=" + to_string(internal_vlan_id) +
                         " -- set Interface " + port_name + " type=internal";
 
-    execute_ovsdb_command(cmd_string, culminative_time, overall_rc);
+    int command_rc = _execute_ovsdb_transaction(
+            [&](ACA_OVSDB_Client &client) {
+              return client.add_port("br-int", port_name, internal_vlan_id, "internal");
+            },
+            cmd_string, culminative_time);
+    if (command_rc != EXIT_SUCCESS)
+      overall_rc = command_rc;
 
     cmd_string = "ip addr add " + virtual_ip + " dev " + port_name;
-    int command_rc = aca_net_config::Aca_Net_Config::get_instance().execute_system_command(
+    command_rc = aca_net_config::Aca_Net_Config::get_instance().execute_system_command(
             cmd_string, culminative_time);
     if (command_rc != EXIT_SUCCESS)
       overall_rc = command_rc;
@@ -461,22 +457,12 @@ int ACA_OVS_L2_Programmer::create_port(const string vpc_id, const string port_na
     // created by nova compute agent running on the compute host
 
     // just need to set the vlan tag on the ovs port, the ovs port may be not created by nova yet
-    string cmd_string = "set port " + port_name + " tag=" + to_string(internal_vlan_id);
-
-    execute_ovsdb_command(cmd_string, culminative_time, overall_rc);
+    overall_rc = set_port_tag(port_name, internal_vlan_id, culminative_time);
 
     // if the ovs port is not there to set to vlan, we will return PENDING as the result
-    // and spin up the new thread to keep trying that in the backgroud
+    // and the port monitor sets it once nova plugs the interface
     if (overall_rc != EXIT_SUCCESS) {
-      overall_rc = EINPROGRESS;
-
-      // start a new background thread work set the port vlan
-      std::thread t(aca_set_port_vlan_workitem, port_name, internal_vlan_id);
-
-      // purposely not wait for this aca_set_port_vlan_workitem
-      if (t.joinable()) {
-        t.detach();
-      }
+      overall_rc = ACA_OVSDB_Port_Monitor::get_instance().add(port_name, internal_vlan_id);
     }
   }
 
@@ -505,10 +491,17 @@ int ACA_OVS_L2_Programmer::delete_port(const string vpc_id, const string port_na
   int overall_rc = ACA_Vlan_Manager::get_instance().delete_ovs_port(
           vpc_id, port_name, tunnel_id, culminative_time);
 
+  // the port may still be waiting for its interface
+  ACA_OVSDB_Port_Monitor::get_instance().remove(port_name);
+
   if (g_demo_mode) {
     string cmd_string = "del-port br-int " + port_name;
 
-    execute_ovsdb_command(cmd_string, culminative_time, overall_rc);
+    int command_rc = _execute_ovsdb_transaction(
+            [&](ACA_OVSDB_Client &client) { return client.del_port("br-int", port_name); },
+            cmd_string, culminative_time);
+    if (command_rc != EXIT_SUCCESS)
+      overall_rc = command_rc;
   }
 
   ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::delete_port <--- Exiting, overall_rc = %d\n", overall_rc);
@@ -581,6 +574,13 @@ void ACA_OVS_L2_Programmer::execute_ovsdb_command(const std::string cmd_string,
 
   auto ovsdb_client_start = chrono::steady_clock::now();
 
+  // a deleted bridge takes its flows along
+  size_t del_br = cmd_string.find("del-br ");
+  if (del_br != string::npos) {
+    string bridge = cmd_string.substr(del_br + 7);
+    ACA_OVS_Flow_Shadow::get_instance().clear(bridge.substr(0, bridge.find(' ')));
+  }
+
   string ovsdb_cmd_string = "ovs-vsctl " + cmd_string;
   int rc = aca_net_config::Aca_Net_Config::get_instance().execute_system_command(ovsdb_cmd_string);
 
@@ -604,6 +604,41 @@ void ACA_OVS_L2_Programmer::execute_ovsdb_command(const std::string cmd_string,
   ACA_LOG_DEBUG("ACA_OVS_L2_Programmer::execute_ovsdb_command <--- Exiting, rc = %d\n", rc);
 }
 
+int ACA_OVS_L2_Programmer::set_port_tag(const string port_name, uint vlan_id,
+                                        ulong &culminative_time)
+{
+  return _execute_ovsdb_transaction(
+          [&](ACA_OVSDB_Client &client) { return client.set_port_tag(port_name, vlan_id); },
+          "set port " + port_name + " tag=" + to_string(vlan_id), culminative_time);
+}
+
+int ACA_OVS_L2_Programmer::_execute_ovsdb_transaction(
+        const std::function<int(ACA_OVSDB_Client &)> &transaction,
+        const std::string &cmd_string, ulong &culminative_time)
+{
+  auto ovsdb_client_start = chrono::steady_clock::now();
+
+  int rc = transaction(ACA_OVSDB_Client::get_instance());
+
+  auto ovsdb_client_time_total_time =
+          cast_to_microseconds(chrono::steady_clock::now() - ovsdb_client_start).count();
+
+  culminative_time += ovsdb_client_time_total_time;
+
+  g_total_execute_ovsdb_time += ovsdb_client_time_total_time;
+
+  ACA_LOG_DEBUG("Elapsed time for ovsdb transaction took: %ld microseconds or %ld milliseconds. rc: %d, cmd: [%s]\n",
+                ovsdb_client_time_total_time, us_to_ms(ovsdb_client_time_total_time),
+                rc, cmd_string.c_str());
+
+  if (rc == ENOTCONN) {
+    rc = EXIT_SUCCESS;
+    execute_ovsdb_command(cmd_string, culminative_time, rc);
+  }
+
+  return rc;
+}
+
 void ACA_OVS_L2_Programmer::execute_openflow_command(const std::string cmd_string,
                                                      ulong &culminative_time, int &overall_rc)
 {
@@ -611,6 +646,9 @@ void ACA_OVS_L2_Programmer::execute_openflow_command(const std::string cmd_strin
 
   auto openflow_client_start = chrono::steady_clock::now();
 
+  // the flow shadow can't tell what the command changes
+  ACA_OVS_Flow_Shadow::get_instance().invalidate_command(cmd_string);
+
   string openflow_cmd_string = "ovs-ofctl " + cmd_string;
   int rc = aca_net_config::Aca_Net_Config::get_instance().execute_system_command(openflow_cmd_string);
 
@@ -638,12 +676,65 @@ void ACA_OVS_L2_Programmer::execute_openflow(ulong &culminative_time,
                                              const std::string bridge,
                                              const std::string flow_string,
                                              const std::string action)
+{
+  _execute_openflow(culminative_time, bridge, flow_string, action);
+}
+
+void ACA_OVS_L2_Programmer::execute_openflow(ulong &culminative_time,
+                                             const std::string bridge,
+                                             const FlowBuilder &flow,
+                                             const std::string action)
+{
+  _execute_openflow(culminative_time, bridge, flow, action);
+}
+
+// false if the flow-mod changes nothing on the bridge
+static bool update_flow_shadow(const std::string &bridge, const FlowBuilder &flow,
+                               const std::string &action)
+{
+  return ACA_OVS_Flow_Shadow::get_instance().update(bridge, flow, action);
+}
+
+static bool update_flow_shadow(const std::string &bridge, const std::string &flow,
+                               const std::string &action)
+{
+  ACA_OVS_Flow_Shadow::get_instance().invalidate(bridge, flow);
+  return true;
+}
+
+// the flows added or modified carry the agent cookie, a flow dump tells them apart then
+static FlowBuilder tag_flow(const FlowBuilder &flow, const std::string &action)
+{
+  return action == "del" ? flow : ACA_OVS_Flow_Shadow::get_instance().tag(flow);
+}
+
+static const std::string &tag_flow(const std::string &flow, const std::string &action)
+{
+  return flow;
+}
+
+template <typename Flow>
+void ACA_OVS_L2_Programmer::_execute_openflow(ulong &culminative_time,
+                                              const std::string &bridge,
+                                              const Flow &flow, const std::string &action)
 {
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow ---> Entering\n");
+
+  if (!update_flow_shadow(bridge, flow, action)) {
+    g_total_ovs_flows_suppressed++;
+    ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow <--- Exiting, flow already programmed\n");
+    return;
+  }
+  g_total_ovs_flows_sent++;
+
   auto openflow_client_start = chrono::steady_clock::now();
 
-  if (NULL != ofctrl) {
-    ofctrl->execute_flow(bridge, flow_string, action);
+  ACA_OVS_Flow_Transaction *transaction = ACA_OVS_Flow_Transaction::current();
+  if (transaction != nullptr) {
+    // sent with the rest of the goal state when the transaction commits
+    transaction->add(bridge, tag_flow(flow, action), action);
+  } else if (NULL != ofctrl) {
+    ofctrl->execute_flow(bridge, tag_flow(flow, action), action);
   } else {
     ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::execute_openflow didn't find OF controller\n");
   }
@@ -663,6 +754,86 @@ void ACA_OVS_L2_Programmer::execute_openflow(ulong &culminative_time,
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow ---> Exiting\n");
 }
 
+void ACA_OVS_L2_Programmer::execute_openflow_bundle(ulong &culminative_time,
+                                                    const std::string bridge,
+                                                    const std::vector<ofmsg_ptr_t> &flow_mods,
+                                                    const flow_completion_ptr_t &completion,
+                                                    size_t offset)
+{
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow_bundle ---> Entering\n");
+  auto openflow_client_start = chrono::steady_clock::now();
+
+  if (NULL != ofctrl) {
+    ofctrl->execute_flow_bundle(bridge, flow_mods, completion, offset);
+  } else {
+    ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::execute_openflow_bundle didn't find OF controller\n");
+    if (completion) {
+      completion->fail(offset, offset + flow_mods.size(), FLOW_ERROR_NO_CONNECTION);
+    }
+  }
+
+  auto openflow_client_end = chrono::steady_clock::now();
+  auto openflow_client_time_total_time =
+          cast_to_microseconds(openflow_client_end - openflow_client_start).count();
+
+  culminative_time += openflow_client_time_total_time;
+
+  g_total_execute_openflow_time += openflow_client_time_total_time;
+
+  ACA_LOG_DEBUG("Elapsed time for a bundle of %lu flows took: %ld microseconds or %ld milliseconds.\n",
+                flow_mods.size(), openflow_client_time_total_time,
+                us_to_ms(openflow_client_time_total_time));
+
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow_bundle <--- Exiting\n");
+}
+
+void ACA_OVS_L2_Programmer::execute_openflow_barrier(const std::string bridge,
+                                                     const flow_completion_ptr_t &completion)
+{
+  if (NULL != ofctrl) {
+    ofctrl->execute_barrier(bridge, completion);
+  } else {
+    ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::execute_openflow_barrier didn't find OF controller\n");
+    completion->fail(0, completion->size(), FLOW_ERROR_NO_CONNECTION);
+    completion->resolve();
+  }
+}
+
+void ACA_OVS_L2_Programmer::execute_openflow_group_mod(ulong &culminative_time,
+                                                       const std::string bridge,
+                                                       group_mod_command command, uint32_t group_id,
+                                                       uint8_t group_type,
+                                                       const std::vector<GroupBucket> &buckets,
+                                                       const flow_completion_ptr_t &completion,
+                                                       size_t index)
+{
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow_group_mod ---> Entering\n");
+  auto openflow_client_start = chrono::steady_clock::now();
+
+  if (NULL != ofctrl) {
+    ofctrl->execute_group_mod(bridge, command, group_id, group_type, buckets, completion, index);
+  } else {
+    ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::execute_openflow_group_mod didn't find OF controller\n");
+    if (completion) {
+      completion->fail(index, FLOW_ERROR_NO_CONNECTION);
+    }
+  }
+
+  auto openflow_client_end = chrono::steady_clock::now();
+  auto openflow_client_time_total_time =
+          cast_to_microseconds(openflow_client_end - openflow_client_start).count();
+
+  culminative_time += openflow_client_time_total_time;
+
+  g_total_execute_openflow_time += openflow_client_time_total_time;
+
+  ACA_LOG_DEBUG("Elapsed time for a group-mod of %lu buckets took: %ld microseconds or %ld milliseconds.\n",
+                buckets.size(), openflow_client_time_total_time,
+                us_to_ms(openflow_client_time_total_time));
+
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::execute_openflow_group_mod <--- Exiting\n");
+}
+
 void ACA_OVS_L2_Programmer::packet_out(const char *bridge, const char *options)
 {
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Entering\n");
@@ -687,4 +858,54 @@ void ACA_OVS_L2_Programmer::packet_out(const char *bridge, const char *options)
   ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Exiting\n");
 }
 
+void ACA_OVS_L2_Programmer::packet_out(const char *bridge, uint32_t in_port,
+                                       const uint8_t *packet, size_t len,
+                                       const packet_out_actions_t &actions)
+{
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Entering\n");
+  auto openflow_client_start = chrono::steady_clock::now();
+
+  if (NULL != ofctrl) {
+      ofctrl->packet_out(bridge, in_port, packet, len, actions);
+  } else {
+      ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::packet_out didn't find OF controller\n");
+  }
+
+  auto openflow_client_end = chrono::steady_clock::now();
+  auto openflow_client_time_total_time =
+          cast_to_microseconds(openflow_client_end - openflow_client_start).count();
+
+  g_total_execute_openflow_time += openflow_client_time_total_time;
+
+  ACA_LOG_DEBUG("Elapsed time for openflow client call took: %ld microseconds or %ld milliseconds.\n",
+               openflow_client_time_total_time,
+               us_to_ms(openflow_client_time_total_time));
+
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Exiting\n");
+}
+
+void ACA_OVS_L2_Programmer::packet_out(const char *bridge, const std::vector<PacketOutFrame> &frames)
+{
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Entering\n");
+  auto openflow_client_start = chrono::steady_clock::now();
+
+  if (NULL != ofctrl) {
+      ofctrl->packet_out(bridge, frames);
+  } else {
+      ACA_LOG_ERROR("%s", "ACA_OVS_L2_Programmer::packet_out didn't find OF controller\n");
+  }
+
+  auto openflow_client_end = chrono::steady_clock::now();
+  auto openflow_client_time_total_time =
+          cast_to_microseconds(openflow_client_end - openflow_client_start).count();
+
+  g_total_execute_openflow_time += openflow_client_time_total_time;
+
+  ACA_LOG_DEBUG("Elapsed time for openflow client call of %ld packets took: %ld microseconds or %ld milliseconds.\n",
+               frames.size(), openflow_client_time_total_time,
+               us_to_ms(openflow_client_time_total_time));
+
+  ACA_LOG_DEBUG("%s", "ACA_OVS_L2_Programmer::packet_out ---> Exiting\n");
+}
+
 } // namespace aca_ovs_l2_programmer
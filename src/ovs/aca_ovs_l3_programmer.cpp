@@ -19,6 +19,7 @@
 #include "aca_vlan_manager.h"
 #include "aca_ovs_l2_programmer.h"
 #include "aca_ovs_l3_programmer.h"
+#include "aca_ovs_flow_transaction.h"
 #include "goalstateprovisioner.grpc.pb.h"
 #include "aca_arp_responder.h"
 #include <unordered_map>
@@ -81,7 +82,6 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
   string current_gateway_mac;
   char hex_ip_buffer[HEX_IP_BUFFER_SIZE];
   int addr;
-  string cmd_string;
   ulong culminative_dataplane_programming_time = 0;
 
   string router_id = current_RouterConfiguration.id();
@@ -230,36 +230,34 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
           stArpCfg.ipv4_address = found_gateway_ip;
           stArpCfg.vlan_id = source_vlan_id;
 
-          ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+          // answered once the flows of the router are committed
+          ACA_OVS_Flow_Transaction::after_commit([stArpCfg]() mutable {
+            ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+          });
 
           ACA_LOG_DEBUG("Add arp entry for gateway: ip = %s,vlan id = %u and mac = %s",
                         found_gateway_ip.c_str(), source_vlan_id,
                         found_gateway_mac.c_str());
 
           // Program ICMP responder:
-          cmd_string =
-                  "table=52,priority=50,icmp,dl_vlan=" +
-                  to_string(source_vlan_id) + ",nw_dst=" + found_gateway_ip +
-                  " actions=move:NXM_OF_ETH_SRC[]->NXM_OF_ETH_DST[],mod_dl_src:" + found_gateway_mac +
-                  ",move:NXM_OF_IP_SRC[]->NXM_OF_IP_DST[],mod_nw_src:" + found_gateway_ip +
-                  ",load:0xff->NXM_NX_IP_TTL[],load:0->NXM_OF_ICMP_TYPE[],in_port";
+          FlowBuilder icmp_flow;
+          icmp_flow.table(52).priority(50).icmp().dl_vlan(source_vlan_id).nw_dst(found_gateway_ip)
+                  .move_dl_src_to_dst().mod_dl_src(found_gateway_mac)
+                  .move_nw_src_to_dst().mod_nw_src(found_gateway_ip)
+                  .load_nw_ttl(0xff).load_icmp_type(0).output(FLOW_PORT_IN_PORT);
 
           ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
-                  "br-tun",
-                  cmd_string,
-                  "add");
+                                                                 "br-tun", icmp_flow, "add");
           // Should be able to ping the gateway now
 
           // add essential rule to restore from neighbor host DVR mac to destination GW mac:
           // Note: all port from the same subnet on current host will share this rule
-          cmd_string = "table=0,priority=25,dl_vlan=" +
-                       to_string(source_vlan_id) + ",dl_src=" + HOST_DVR_MAC_MATCH +
-                       " actions=mod_dl_src:" + found_gateway_mac + " output:NORMAL";
+          FlowBuilder dvr_flow;
+          dvr_flow.table(0).priority(25).dl_vlan(source_vlan_id).dl_src(string() + HOST_DVR_MAC_MATCH)
+                  .mod_dl_src(found_gateway_mac).output(FLOW_PORT_NORMAL);
 
           ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
-                    "br-int",
-                    cmd_string,
-                    "add");
+                                                                 "br-int", dvr_flow, "add");
 
           for (int k = 0; k < current_subnet_routing_table.routing_rules_size(); k++) {
             auto current_routing_rule = current_subnet_routing_table.routing_rules(k);
@@ -349,33 +347,22 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
                     ACA_LOG_INFO("current_subnet_routing_table.subnet_id(): %s\n",
                                  current_subnet_routing_table.subnet_id().c_str());
 
-                    if (is_port_on_same_host) {
-                      if (current_fixed_ip.subnet_id() !=
-                          current_subnet_routing_table.subnet_id()) {
-                        cmd_string =
-                                "table=0,priority=50,ip,dl_vlan=" +
-                                to_string(source_vlan_id) +
-                                ",nw_dst=" + current_routing_rule.destination() +
-                                ",dl_dst=" + found_gateway_mac +
-                                " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                                ",mod_dl_src:" + gw_mac +
-                                ",mod_dl_dst:" + virtual_mac_address + ",output:IN_PORT";
+                    // the ports of one subnet on this host need no routing flow
+                    if (!is_port_on_same_host ||
+                        current_fixed_ip.subnet_id() != current_subnet_routing_table.subnet_id()) {
+                      FlowBuilder flow;
+                      flow.table(0).priority(50).ip().dl_vlan(source_vlan_id)
+                              .nw_dst(current_routing_rule.destination()).dl_dst(found_gateway_mac)
+                              .mod_vlan_vid(destination_vlan_id);
+                      if (is_port_on_same_host) {
+                        flow.mod_dl_src(gw_mac).mod_dl_dst(virtual_mac_address).output(FLOW_PORT_IN_PORT);
+                      } else {
+                        flow.mod_dl_src(_host_dvr_mac).mod_dl_dst(virtual_mac_address).resubmit(2);
                       }
-                    } else {
-                      cmd_string =
-                              "table=0,priority=50,ip,dl_vlan=" +
-                              to_string(source_vlan_id) +
-                              ",nw_dst=" + current_routing_rule.destination() +
-                              ",dl_dst=" + found_gateway_mac +
-                              " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                              ",mod_dl_src:" + _host_dvr_mac +
-                              ",mod_dl_dst:" + virtual_mac_address + ",resubmit(,2)";
-                    }
 
-                    ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_dataplane_programming_time,
-                            "br-tun",
-                            cmd_string,
-                            "add");
+                      ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_dataplane_programming_time,
+                                                                             "br-tun", flow, "add");
+                    }
                   }
                 }
                 if (strcmp(remote_host_ip, "") != 0) {
@@ -397,14 +384,13 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
             } else if (current_routing_rule.operation_type() == OperationType::DELETE) {
               int source_vlan_id =
                       ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(found_tunnel_id);
-              string cmd_string =
-                      "table=0,priority=50,ip,dl_vlan=" +
-                      to_string(source_vlan_id) + ",dl_dst=" + found_gateway_mac +
-                      ",nw_dst=" + current_routing_rule.destination();
+              FlowBuilder flow;
+              flow.table(0).priority(50).ip().dl_vlan(source_vlan_id)
+                      .dl_dst(found_gateway_mac).nw_dst(current_routing_rule.destination());
 
               ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_dataplane_programming_time,
                                                                      "br-tun",
-                                                                     cmd_string,
+                                                                     flow,
                                                                      "del");
               if (new_subnet_routing_table_entry.routing_rules.erase(
                           current_routing_rule.id())) {
@@ -505,7 +491,6 @@ int ACA_OVS_L3_Programmer::delete_router(RouterConfiguration &current_RouterConf
   int overall_rc;
   int source_vlan_id;
   string current_gateway_mac;
-  string cmd_string;
 
   string router_id = current_RouterConfiguration.id();
   if (router_id.empty()) {
@@ -551,29 +536,33 @@ int ACA_OVS_L3_Programmer::delete_router(RouterConfiguration &current_RouterConf
     stArpCfg.ipv4_address = subnet_it->second.gateway_ip;
     stArpCfg.vlan_id = source_vlan_id;
 
-    ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfg);
+    ACA_OVS_Flow_Transaction::after_commit([stArpCfg]() mutable {
+      ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfg);
+    });
 
     ACA_LOG_DEBUG("Delete arp entry for gateway: ip = %s,vlan id = %u",
                   stArpCfg.ipv4_address.c_str(), source_vlan_id);
 
     // Delete ICMP responder:
-    cmd_string = "table=52,icmp,dl_vlan=" + to_string(source_vlan_id) +
-                 ",nw_dst=" + subnet_it->second.gateway_ip;
+    // the strict delete needs the priority the flow was added with
+    FlowBuilder icmp_flow;
+    icmp_flow.table(52).priority(50).icmp().dl_vlan(source_vlan_id)
+            .nw_dst(subnet_it->second.gateway_ip);
 
     ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
                                                            "br-tun",
-                                                           cmd_string,
+                                                           icmp_flow,
                                                            "del");
 
     // remove essential rule which restore from neighbor host DVR mac to destination GW mac
 
     // Note: all port from the same subnet on current host will share this rule
-    cmd_string = "table=0,priority=25,dl_vlan=" + to_string(source_vlan_id) +
-                 ",dl_src=" + HOST_DVR_MAC_MATCH;
+    FlowBuilder dvr_flow;
+    dvr_flow.table(0).priority(25).dl_vlan(source_vlan_id).dl_src(string() + HOST_DVR_MAC_MATCH);
 
     ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
                                                            "br-int",
-                                                           cmd_string,
+                                                           dvr_flow,
                                                            "del");
   }
 
@@ -617,7 +606,6 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
   string current_gateway_mac;
   char hex_ip_buffer[HEX_IP_BUFFER_SIZE];
   int addr;
-  string cmd_string;
 
   string router_id = current_RouterConfiguration.id();
   if (router_id.empty()) {
@@ -766,37 +754,35 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
         stArpCfg.ipv4_address = found_gateway_ip;
         stArpCfg.vlan_id = source_vlan_id;
 
-        ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+        // answered once the flows of the router are committed
+        ACA_OVS_Flow_Transaction::after_commit([stArpCfg]() mutable {
+          ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+        });
 
         ACA_LOG_DEBUG("Add arp entry for gateway: ip = %s,vlan id = %u and mac = %s",
                       found_gateway_ip.c_str(), source_vlan_id,
                       found_gateway_mac.c_str());
 
         // Program ICMP responder:
-        cmd_string =
-                "table=52,priority=50,icmp,dl_vlan=" +
-                to_string(source_vlan_id) + ",nw_dst=" + found_gateway_ip +
-                " actions=move:NXM_OF_ETH_SRC[]->NXM_OF_ETH_DST[],mod_dl_src:" + found_gateway_mac +
-                ",move:NXM_OF_IP_SRC[]->NXM_OF_IP_DST[],mod_nw_src:" + found_gateway_ip +
-                ",load:0xff->NXM_NX_IP_TTL[],load:0->NXM_OF_ICMP_TYPE[],in_port";
+        FlowBuilder icmp_flow;
+        icmp_flow.table(52).priority(50).icmp().dl_vlan(source_vlan_id).nw_dst(found_gateway_ip)
+                .move_dl_src_to_dst().mod_dl_src(found_gateway_mac)
+                .move_nw_src_to_dst().mod_nw_src(found_gateway_ip)
+                .load_nw_ttl(0xff).load_icmp_type(0).output(FLOW_PORT_IN_PORT);
 
         ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
-                                                               "br-tun",
-                                                               cmd_string,
-                                                               "add");
+                                                               "br-tun", icmp_flow, "add");
 
         // Should be able to ping the gateway now
 
         // add essential rule to restore from neighbor host DVR mac to destination GW mac:
         // Note: all port from the same subnet on current host will share this rule
-        cmd_string = "table=0,priority=25,dl_vlan=" +
-                     to_string(source_vlan_id) + ",dl_src=" + HOST_DVR_MAC_MATCH +
-                     " actions=mod_dl_src:" + found_gateway_mac + " output:NORMAL";
+        FlowBuilder dvr_flow;
+        dvr_flow.table(0).priority(25).dl_vlan(source_vlan_id).dl_src(string() + HOST_DVR_MAC_MATCH)
+                .mod_dl_src(found_gateway_mac).output(FLOW_PORT_NORMAL);
 
         ACA_OVS_L2_Programmer::get_instance().execute_openflow(dataplane_programming_time,
-                                                               "br-int",
-                                                               cmd_string,
-                                                               "add");
+                                                               "br-int", dvr_flow, "add");
 
         for (int k = 0; k < current_subnet_routing_table.routing_rules_size(); k++) {
           auto current_routing_rule = current_subnet_routing_table.routing_rules(k);
@@ -883,33 +869,22 @@ int ACA_OVS_L3_Programmer::create_or_update_router(RouterConfiguration &current_
                   ACA_LOG_INFO("current_subnet_routing_table.subnet_id(): %s\n",
                                 current_subnet_routing_table.subnet_id().c_str());
 
-                  if (is_port_on_same_host) {
-                    if (current_fixed_ip.subnet_id() !=
-                        current_subnet_routing_table.subnet_id()) {
-                      cmd_string =
-                              "table=0,priority=50,ip,dl_vlan=" +
-                              to_string(source_vlan_id) +
-                              ",nw_dst=" + current_routing_rule.destination() +
-                              ",dl_dst=" + found_gateway_mac +
-                              " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                              ",mod_dl_src:" + gw_mac +
-                              ",mod_dl_dst:" + virtual_mac_address + ",output:IN_PORT";
+                  // the ports of one subnet on this host need no routing flow
+                  if (!is_port_on_same_host ||
+                      current_fixed_ip.subnet_id() != current_subnet_routing_table.subnet_id()) {
+                    FlowBuilder flow;
+                    flow.table(0).priority(50).ip().dl_vlan(source_vlan_id)
+                            .nw_dst(current_routing_rule.destination()).dl_dst(found_gateway_mac)
+                            .mod_vlan_vid(destination_vlan_id);
+                    if (is_port_on_same_host) {
+                      flow.mod_dl_src(gw_mac).mod_dl_dst(virtual_mac_address).output(FLOW_PORT_IN_PORT);
+                    } else {
+                      flow.mod_dl_src(_host_dvr_mac).mod_dl_dst(virtual_mac_address).resubmit(2);
                     }
-                  } else {
-                    cmd_string =
-                            "table=0,priority=50,ip,dl_vlan=" +
-                            to_string(source_vlan_id) +
-                            ",nw_dst=" + current_routing_rule.destination() +
-                            ",dl_dst=" + found_gateway_mac +
-                            " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                            ",mod_dl_src:" + _host_dvr_mac +
-                            ",mod_dl_dst:" + virtual_mac_address + ",resubmit(,2)";
-                  }
 
-                  ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_dataplane_programming_time,
-                          "br-tun",
-                          cmd_string,
-                          "add");
+                    ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_dataplane_programming_time,
+                                                                           "br-tun", flow, "add");
+                  }
                 }
               }
               if (strcmp(remote_host_ip, "") != 0) {
@@ -1011,7 +986,6 @@ int ACA_OVS_L3_Programmer::create_or_update_l3_neighbor(
   bool found_subnet_in_router = false;
   int source_vlan_id;
   int destination_vlan_id;
-  string cmd_string;
 
   if (neighbor_id.empty()) {
     throw std::invalid_argument("neighbor_id is empty");
@@ -1087,25 +1061,18 @@ int ACA_OVS_L3_Programmer::create_or_update_l3_neighbor(
         // sent to openflow controller, that's ACA
 
         // the openflow rule depends on whether the hosting ip is on this compute host or not
+        FlowBuilder flow;
+        flow.table(0).priority(25).ip().dl_vlan(source_vlan_id).nw_dst(virtual_ip)
+                .dl_dst(subnet_it->second.gateway_mac).mod_vlan_vid(destination_vlan_id);
         if (is_port_on_same_host) {
-          cmd_string = "table=0,priority=25,ip,dl_vlan=" +
-                       to_string(source_vlan_id) + ",nw_dst=" + virtual_ip +
-                       ",dl_dst=" + subnet_it->second.gateway_mac +
-                       " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                       ",mod_dl_src:" + destination_gw_mac +
-                       ",mod_dl_dst:" + virtual_mac + ",output:IN_PORT";
+          flow.mod_dl_src(destination_gw_mac).mod_dl_dst(virtual_mac).output(FLOW_PORT_IN_PORT);
         } else {
-          cmd_string = "table=0,priority=25,ip,dl_vlan=" +
-                       to_string(source_vlan_id) + ",nw_dst=" + virtual_ip +
-                       ",dl_dst=" + subnet_it->second.gateway_mac +
-                       " actions=mod_vlan_vid:" + to_string(destination_vlan_id) +
-                       ",mod_dl_src:" + _host_dvr_mac +
-                       ",mod_dl_dst:" + virtual_mac + ",resubmit(,2)";
+          flow.mod_dl_src(_host_dvr_mac).mod_dl_dst(virtual_mac).resubmit(2);
         }
 
         ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                                "br-tun",
-                                                               cmd_string,
+                                                               flow,
                                                                "add");
       }
       // we found our interested router from _routers_table which has the destination subnet GW connected to it.
@@ -1188,12 +1155,12 @@ int ACA_OVS_L3_Programmer::delete_l3_neighbor(const string neighbor_id, const st
 
         // for the first implementation with static routing rules (non on-demand)
         // go ahead to remove it
-        string cmd_string = "table=0,priority=50,ip,dl_vlan=" +
-                            to_string(source_vlan_id) + ",nw_dst=" + virtual_ip;
+        FlowBuilder flow;
+        flow.table(0).priority(50).ip().dl_vlan(source_vlan_id).nw_dst(virtual_ip);
 
         ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                                "br-tun",
-                                                               cmd_string,
+                                                               flow,
                                                                "del");
 
         // once we have the on demand routing rule implemented, we will need remove any
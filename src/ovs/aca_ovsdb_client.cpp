@@ -0,0 +1,706 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "aca_ovsdb_client.h"
+#include "aca_log.h"
+#include "aca_config.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <openvswitch/json.h>
+#include <openvswitch/shash.h>
+
+using namespace std;
+
+namespace aca_ovs_l2_programmer
+{
+#define OVSDB_DATABASE "Open_vSwitch"
+#define OVSDB_RECEIVE_BUFFER_SIZE 4096
+#define OVSDB_MONITOR_ID "aca_interfaces"
+
+// ["Open_vSwitch"], the operations are added to it
+static struct json *_create_transaction()
+{
+  return json_array_create_1(json_string_create(OVSDB_DATABASE));
+}
+
+// {"op": op, "table": table}
+static struct json *_create_operation(const char *op, const char *table)
+{
+  struct json *operation = json_object_create();
+  json_object_put_string(operation, "op", op);
+  json_object_put_string(operation, "table", table);
+  return operation;
+}
+
+// [column, "==", value]
+static struct json *_create_condition(const char *column, struct json *value)
+{
+  return json_array_create_3(json_string_create(column), json_string_create("=="), value);
+}
+
+// [["name", "==", name]]
+static struct json *_create_where_name(const string &name)
+{
+  return json_array_create_1(_create_condition("name", json_string_create(name.c_str())));
+}
+
+// select the columns of the rows of table where name is name, all the rows
+// if name is empty
+static struct json *_create_select(const char *table, const string &name,
+                                   const char *column)
+{
+  struct json *operation = _create_operation("select", table);
+  json_object_put(operation, "where",
+                  name.empty() ? json_array_create_empty() : _create_where_name(name));
+  struct json *columns = json_array_create_1(json_string_create(column));
+  if (strcmp(column, "name") != 0) {
+    json_array_add(columns, json_string_create("name"));
+  }
+  json_object_put(operation, "columns", columns);
+  return operation;
+}
+
+// ["uuid", uuid]
+static struct json *_create_uuid(const string &uuid)
+{
+  return json_array_create_2(json_string_create("uuid"), json_string_create(uuid.c_str()));
+}
+
+// fails the transaction if the bridge does not exist
+static struct json *_create_wait_bridge(const string &bridge)
+{
+  struct json *operation = _create_operation("wait", "Bridge");
+  json_object_put(operation, "where", _create_where_name(bridge));
+  json_object_put(operation, "columns", json_array_create_1(json_string_create("name")));
+  json_object_put_string(operation, "until", "==");
+  struct json *row = json_object_create();
+  json_object_put_string(row, "name", bridge.c_str());
+  json_object_put(operation, "rows", json_array_create_1(row));
+  json_object_put(operation, "timeout", json_integer_create(0));
+  return operation;
+}
+
+static const struct json *_get_member(const struct json *object, const char *name)
+{
+  if (object == nullptr || object->type != JSON_OBJECT) {
+    return nullptr;
+  }
+  return static_cast<const struct json *>(shash_find_data(json_object(object), name));
+}
+
+/*
+ * check the result of each operation of a transaction, an operation that
+ * failed has an "error" in its result, a failed commit adds one more result.
+ */
+static int _check_result(const struct json *result, size_t operations)
+{
+  if (result == nullptr || result->type != JSON_ARRAY || json_array(result)->n < operations) {
+    ACA_LOG_ERROR("%s", "ACA_OVSDB_Client - malformed transaction result\n");
+    return EPROTO;
+  }
+  const struct json_array *results = json_array(result);
+  for (size_t i = 0; i < results->n; i++) {
+    const struct json *error = _get_member(results->elems[i], "error");
+    if (error == nullptr || error->type != JSON_STRING) {
+      continue;
+    }
+    const struct json *details = _get_member(results->elems[i], "details");
+    ACA_LOG_DEBUG("ACA_OVSDB_Client - operation %lu failed: %s %s\n", i, json_string(error),
+                  details != nullptr && details->type == JSON_STRING ? json_string(details) : "");
+    if (strcmp(json_string(error), "timed out") == 0) {
+      // a wait for a missing row
+      return ENOENT;
+    }
+    if (strcmp(json_string(error), "constraint violation") == 0) {
+      // a name index is violated
+      return EEXIST;
+    }
+    return EPROTO;
+  }
+  return EXIT_SUCCESS;
+}
+
+// {"count": n} of an update or a mutate
+static int64_t _get_count(const struct json *result, size_t i)
+{
+  const struct json *count = _get_member(json_array(result)->elems[i], "count");
+  return count != nullptr && count->type == JSON_INTEGER ? json_integer(count) : 0;
+}
+
+// {"rows": [...]} of a select
+static const struct json_array *_get_rows(const struct json *result, size_t i)
+{
+  const struct json *rows = _get_member(json_array(result)->elems[i], "rows");
+  return rows != nullptr && rows->type == JSON_ARRAY ? json_array(rows) : nullptr;
+}
+
+ACA_OVSDB_Client &ACA_OVSDB_Client::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_OVSDB_Client instance(OVSDB_SOCKET_PATH, OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS);
+  return instance;
+}
+
+ACA_OVSDB_Client::ACA_OVSDB_Client(const string &socket_path, uint64_t timeout_us)
+        : _socket_path(socket_path), _timeout_us(timeout_us), _fd(-1), _next_id(0),
+          _parser(nullptr)
+{
+}
+
+ACA_OVSDB_Client::~ACA_OVSDB_Client()
+{
+  close();
+}
+
+int ACA_OVSDB_Client::set_port_tag(const string &port, uint32_t tag)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+
+  struct json *operation = _create_operation("update", "Port");
+  json_object_put(operation, "where", _create_where_name(port));
+  struct json *row = json_object_create();
+  json_object_put(row, "tag", json_integer_create(tag));
+  json_object_put(operation, "row", row);
+  json_array_add(params, operation);
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  if (rc == EXIT_SUCCESS && _get_count(result, 0) == 0) {
+    // nova has not plugged the port yet
+    rc = ENOENT;
+  }
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::add_port(const string &bridge, const string &port, uint32_t tag,
+                               const string &type, const map<string, string> &options)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+
+  json_array_add(params, _create_wait_bridge(bridge));
+
+  struct json *operation = _create_operation("insert", "Interface");
+  struct json *row = json_object_create();
+  json_object_put_string(row, "name", port.c_str());
+  if (!type.empty()) {
+    json_object_put_string(row, "type", type.c_str());
+  }
+  if (!options.empty()) {
+    struct json *pairs = json_array_create_empty();
+    for (auto &option : options) {
+      json_array_add(pairs, json_array_create_2(json_string_create(option.first.c_str()),
+                                                json_string_create(option.second.c_str())));
+    }
+    json_object_put(row, "options", json_array_create_2(json_string_create("map"), pairs));
+  }
+  json_object_put(operation, "row", row);
+  json_object_put_string(operation, "uuid-name", "new_interface");
+  json_array_add(params, operation);
+
+  operation = _create_operation("insert", "Port");
+  row = json_object_create();
+  json_object_put_string(row, "name", port.c_str());
+  json_object_put(row, "interfaces",
+                  json_array_create_2(json_string_create("named-uuid"),
+                                      json_string_create("new_interface")));
+  if (tag != 0) {
+    json_object_put(row, "tag", json_integer_create(tag));
+  }
+  json_object_put(operation, "row", row);
+  json_object_put_string(operation, "uuid-name", "new_port");
+  json_array_add(params, operation);
+
+  // [["ports", "insert", ["named-uuid", "new_port"]]]
+  operation = _create_operation("mutate", "Bridge");
+  json_object_put(operation, "where", _create_where_name(bridge));
+  json_object_put(operation, "mutations",
+                  json_array_create_1(json_array_create_3(
+                          json_string_create("ports"), json_string_create("insert"),
+                          json_array_create_2(json_string_create("named-uuid"),
+                                              json_string_create("new_port")))));
+  json_array_add(params, operation);
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 4);
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::del_port(const string &bridge, const string &port)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+  json_array_add(params, _create_select("Port", port, "_uuid"));
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  const struct json_array *rows = rc == EXIT_SUCCESS ? _get_rows(result, 0) : nullptr;
+  string uuid;
+  const struct json *row_uuid = rows != nullptr && rows->n > 0 ?
+                                        _get_member(rows->elems[0], "_uuid") :
+                                        nullptr;
+  // ["uuid", "<uuid>"]
+  if (row_uuid != nullptr && row_uuid->type == JSON_ARRAY && json_array(row_uuid)->n == 2 &&
+      json_array(row_uuid)->elems[1]->type == JSON_STRING) {
+    uuid = json_string(json_array(row_uuid)->elems[1]);
+  }
+  json_destroy(result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  if (uuid.empty()) {
+    return ENOENT;
+  }
+
+  // the port and its interfaces are garbage collected once no bridge has them
+  params = _create_transaction();
+  struct json *operation = _create_operation("mutate", "Bridge");
+  struct json *where = _create_where_name(bridge);
+  json_array_add(where, json_array_create_3(json_string_create("ports"),
+                                            json_string_create("includes"), _create_uuid(uuid)));
+  json_object_put(operation, "where", where);
+  json_object_put(operation, "mutations",
+                  json_array_create_1(json_array_create_3(json_string_create("ports"),
+                                                          json_string_create("delete"),
+                                                          _create_uuid(uuid))));
+  json_array_add(params, operation);
+
+  rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  if (rc == EXIT_SUCCESS && _get_count(result, 0) == 0) {
+    // the port is not on that bridge
+    rc = ENOENT;
+  }
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::bridge_exists(const string &bridge)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+  json_array_add(params, _create_select("Bridge", bridge, "name"));
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  if (rc == EXIT_SUCCESS) {
+    const struct json_array *rows = _get_rows(result, 0);
+    rc = rows != nullptr && rows->n > 0 ? EXIT_SUCCESS : ENOENT;
+  }
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::get_datapath_ids(unordered_map<string, uint64_t> &datapath_ids)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+  json_array_add(params, _create_select("Bridge", "", "datapath_id"));
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  const struct json_array *rows = rc == EXIT_SUCCESS ? _get_rows(result, 0) : nullptr;
+  for (size_t i = 0; rows != nullptr && i < rows->n; i++) {
+    const struct json *name = _get_member(rows->elems[i], "name");
+    const struct json *datapath_id = _get_member(rows->elems[i], "datapath_id");
+    // a bridge ovs-vswitchd has not set up yet has an empty set instead
+    if (name != nullptr && name->type == JSON_STRING && datapath_id != nullptr &&
+        datapath_id->type == JSON_STRING) {
+      datapath_ids[json_string(name)] = strtoull(json_string(datapath_id), nullptr, 16);
+    }
+  }
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::get_ofport(const string &interface, int64_t &ofport)
+{
+  struct json *result = nullptr;
+  struct json *params = _create_transaction();
+  json_array_add(params, _create_select("Interface", interface, "ofport"));
+
+  int rc = _transact(params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  rc = _check_result(result, 1);
+  if (rc == EXIT_SUCCESS) {
+    const struct json_array *rows = _get_rows(result, 0);
+    const struct json *value = rows != nullptr && rows->n > 0 ?
+                                       _get_member(rows->elems[0], "ofport") :
+                                       nullptr;
+    // an empty set until ovs-vswitchd has assigned one
+    if (value != nullptr && value->type == JSON_INTEGER) {
+      ofport = json_integer(value);
+    } else {
+      rc = ENOENT;
+    }
+  }
+  json_destroy(result);
+  return rc;
+}
+
+int ACA_OVSDB_Client::monitor_ofports(ofport_fn_t on_ofport)
+{
+  struct json *result = nullptr;
+  struct json *columns = json_array_create_2(json_string_create("name"), json_string_create("ofport"));
+  struct json *request = json_object_create();
+  json_object_put(request, "columns", columns);
+  struct json *requests = json_object_create();
+  json_object_put(requests, "Interface", request);
+  struct json *params = json_array_create_3(json_string_create(OVSDB_DATABASE),
+                                            json_string_create(OVSDB_MONITOR_ID), requests);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _on_ofport = on_ofport;
+  int rc = _call("monitor", params, &result);
+  if (rc != EXIT_SUCCESS) {
+    return rc;
+  }
+  // the reply holds the interfaces there already
+  _dispatch_updates(result);
+  json_destroy(result);
+  return EXIT_SUCCESS;
+}
+
+int ACA_OVSDB_Client::wait_for_updates(uint64_t timeout_us)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_fd < 0) {
+    return ENOTCONN;
+  }
+  time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+
+  // the first update waits up to the timeout, the ones already received
+  // are dispatched right after it
+  int rc = EXIT_SUCCESS;
+  bool updated = false;
+  while (rc == EXIT_SUCCESS) {
+    struct json *msg = nullptr;
+    rc = _receive(&msg, updated ? std::chrono::steady_clock::now() : deadline);
+    if (rc == EXIT_SUCCESS) {
+      updated = true;
+      rc = _handle_request(msg, deadline);
+      json_destroy(msg);
+    }
+  }
+  if (rc == ETIMEDOUT) {
+    return updated ? EXIT_SUCCESS : ETIMEDOUT;
+  }
+  _close();
+  return rc;
+}
+
+void ACA_OVSDB_Client::close()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _close();
+}
+
+int ACA_OVSDB_Client::_transact(struct json *params, struct json **result)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _call("transact", params, result);
+}
+
+int ACA_OVSDB_Client::_call(const char *method, struct json *params, struct json **result)
+{
+  time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(_timeout_us);
+
+  int rc = _connect();
+  if (rc != EXIT_SUCCESS) {
+    json_destroy(params);
+    return rc;
+  }
+
+  int64_t id = _next_id++;
+  struct json *request = json_object_create();
+  json_object_put_string(request, "method", method);
+  json_object_put(request, "params", params);
+  json_object_put(request, "id", json_integer_create(id));
+  rc = _send(request, deadline);
+  json_destroy(request);
+
+  while (rc == EXIT_SUCCESS) {
+    struct json *msg = nullptr;
+    rc = _receive(&msg, deadline);
+    if (rc != EXIT_SUCCESS) {
+      break;
+    }
+
+    if (_get_member(msg, "method") != nullptr) {
+      rc = _handle_request(msg, deadline);
+      json_destroy(msg);
+      continue;
+    }
+
+    const struct json *reply_id = _get_member(msg, "id");
+    if (reply_id == nullptr || reply_id->type != JSON_INTEGER || json_integer(reply_id) != id) {
+      json_destroy(msg);
+      continue;
+    }
+
+    const struct json *error = _get_member(msg, "error");
+    if (error != nullptr && error->type != JSON_NULL) {
+      char *error_string = json_to_string(error, 0);
+      ACA_LOG_ERROR("ACA_OVSDB_Client::_call - %s refused: %s\n", method, error_string);
+      free(error_string);
+      rc = EPROTO;
+    } else {
+      *result = static_cast<struct json *>(shash_find_and_delete(json_object(msg), "result"));
+      rc = *result != nullptr ? EXIT_SUCCESS : EPROTO;
+    }
+    json_destroy(msg);
+    return rc;
+  }
+
+  if (rc == ETIMEDOUT) {
+    ACA_LOG_ERROR("ACA_OVSDB_Client::_call - %s timed out\n", method);
+  }
+  // the stream is in an unknown state, start over on the next call
+  _close();
+  return rc;
+}
+
+int ACA_OVSDB_Client::_handle_request(struct json *msg, time_point deadline)
+{
+  const struct json *method = _get_member(msg, "method");
+  if (method == nullptr || method->type != JSON_STRING) {
+    return EXIT_SUCCESS;
+  }
+
+  if (strcmp(json_string(method), "echo") == 0) {
+    // ovsdb-server probes an idle connection with an echo, answer it with
+    // its own params
+    struct json *reply = json_object_create();
+    struct json *echo_params =
+            static_cast<struct json *>(shash_find_and_delete(json_object(msg), "params"));
+    struct json *echo_id = static_cast<struct json *>(shash_find_and_delete(json_object(msg), "id"));
+    json_object_put(reply, "id", echo_id != nullptr ? echo_id : json_null_create());
+    json_object_put(reply, "result",
+                    echo_params != nullptr ? echo_params : json_array_create_empty());
+    json_object_put(reply, "error", json_null_create());
+    int rc = _send(reply, deadline);
+    json_destroy(reply);
+    return rc;
+  }
+
+  if (strcmp(json_string(method), "update") == 0) {
+    // [monitor id, table updates]
+    const struct json *params = _get_member(msg, "params");
+    if (params != nullptr && params->type == JSON_ARRAY && json_array(params)->n == 2) {
+      _dispatch_updates(json_array(params)->elems[1]);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+void ACA_OVSDB_Client::_dispatch_updates(const struct json *table_updates)
+{
+  // {"Interface": {<uuid>: {"old": {...}, "new": {"name": ..., "ofport": ...}}}}
+  const struct json *rows = _get_member(table_updates, "Interface");
+  if (rows == nullptr || rows->type != JSON_OBJECT || !_on_ofport) {
+    return;
+  }
+
+  const struct shash_node **nodes = shash_sort(json_object(rows));
+  size_t n = shash_count(json_object(rows));
+  for (size_t i = 0; i < n; i++) {
+    const struct json *row_update = static_cast<const struct json *>(nodes[i]->data);
+    const struct json *row = _get_member(row_update, "new");
+    bool deleted = row == nullptr;
+    if (deleted) {
+      row = _get_member(row_update, "old");
+    }
+    const struct json *name = _get_member(row, "name");
+    const struct json *ofport = _get_member(row, "ofport");
+    if (name == nullptr || name->type != JSON_STRING) {
+      continue;
+    }
+    // an empty set until ovs-vswitchd has assigned one
+    _on_ofport(json_string(name),
+               !deleted && ofport != nullptr && ofport->type == JSON_INTEGER ? json_integer(ofport) : 0);
+  }
+  free(nodes);
+}
+
+int ACA_OVSDB_Client::_connect()
+{
+  if (_fd >= 0) {
+    return EXIT_SUCCESS;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (_socket_path.size() >= sizeof(addr.sun_path)) {
+    ACA_LOG_ERROR("ACA_OVSDB_Client::_connect - socket path %s too long\n",
+                  _socket_path.c_str());
+    return ENOTCONN;
+  }
+  strncpy(addr.sun_path, _socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    ACA_LOG_ERROR("ACA_OVSDB_Client::_connect - socket failed, errno %d\n", errno);
+    return ENOTCONN;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    ACA_LOG_DEBUG("ACA_OVSDB_Client::_connect - connect to %s failed, errno %d\n",
+                  _socket_path.c_str(), errno);
+    ::close(fd);
+    return ENOTCONN;
+  }
+  // blocking is done in poll() with the deadline of the transaction
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  ACA_LOG_INFO("ACA_OVSDB_Client::_connect - connected to %s\n", _socket_path.c_str());
+  _fd = fd;
+  return EXIT_SUCCESS;
+}
+
+void ACA_OVSDB_Client::_close()
+{
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+  if (_parser != nullptr) {
+    json_parser_abort(_parser);
+    _parser = nullptr;
+  }
+  _input.clear();
+}
+
+// milliseconds left until the deadline, for poll()
+static int _get_poll_timeout(std::chrono::steady_clock::time_point deadline)
+{
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+  return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+}
+
+int ACA_OVSDB_Client::_send(struct json *msg, time_point deadline)
+{
+  char *text = json_to_string(msg, 0);
+  size_t len = strlen(text);
+  size_t sent = 0;
+  int rc = EXIT_SUCCESS;
+
+  while (sent < len) {
+    ssize_t n = send(_fd, text + sent, len - sent, MSG_NOSIGNAL);
+    if (n >= 0) {
+      sent += n;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      ACA_LOG_ERROR("ACA_OVSDB_Client::_send - send failed, errno %d\n", errno);
+      rc = ENOTCONN;
+      break;
+    }
+    struct pollfd pfd = { _fd, POLLOUT, 0 };
+    if (poll(&pfd, 1, _get_poll_timeout(deadline)) == 0) {
+      ACA_LOG_ERROR("%s", "ACA_OVSDB_Client::_send - timed out\n");
+      rc = ETIMEDOUT;
+      break;
+    }
+  }
+  free(text);
+  return rc;
+}
+
+int ACA_OVSDB_Client::_receive(struct json **msg, time_point deadline)
+{
+  char buffer[OVSDB_RECEIVE_BUFFER_SIZE];
+
+  while (true) {
+    if (!_input.empty()) {
+      if (_parser == nullptr) {
+        _parser = json_parser_create(0);
+      }
+      // the parser stops at the end of a message, the rest stays in _input
+      size_t used = json_parser_feed(_parser, _input.data(), _input.size());
+      _input.erase(0, used);
+      if (json_parser_is_done(_parser)) {
+        struct json *json = json_parser_finish(_parser);
+        _parser = nullptr;
+        if (json->type == JSON_STRING) {
+          // the parser reports its errors as a string
+          ACA_LOG_ERROR("ACA_OVSDB_Client::_receive - bad message: %s\n", json_string(json));
+          json_destroy(json);
+          return EPROTO;
+        }
+        if (json->type != JSON_OBJECT) {
+          json_destroy(json);
+          continue;
+        }
+        *msg = json;
+        return EXIT_SUCCESS;
+      }
+    }
+
+    ssize_t n = recv(_fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      _input.append(buffer, n);
+      continue;
+    }
+    if (n == 0) {
+      ACA_LOG_ERROR("%s", "ACA_OVSDB_Client::_receive - connection closed by ovsdb-server\n");
+      return ENOTCONN;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      ACA_LOG_ERROR("ACA_OVSDB_Client::_receive - recv failed, errno %d\n", errno);
+      return ENOTCONN;
+    }
+    struct pollfd pfd = { _fd, POLLIN, 0 };
+    if (poll(&pfd, 1, _get_poll_timeout(deadline)) == 0) {
+      return ETIMEDOUT;
+    }
+  }
+}
+} // namespace aca_ovs_l2_programmer
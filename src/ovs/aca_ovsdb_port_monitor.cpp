@@ -0,0 +1,242 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "aca_ovsdb_port_monitor.h"
+#include "aca_ovs_l2_programmer.h"
+#include "aca_log.h"
+#include "aca_config.h"
+#include <cerrno>
+#include <cstdlib>
+
+namespace aca_ovs_l2_programmer
+{
+// the updates are waited for in slices of it, so that shutdown() and the
+// timeouts of the pending ports are not held up
+#define OVSDB_MONITOR_WAIT_SLICE_IN_MICROSECONDS 100000 // 100 milliseconds
+
+ACA_OVSDB_Port_Monitor &ACA_OVSDB_Port_Monitor::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_OVSDB_Port_Monitor instance(
+          OVSDB_SOCKET_PATH,
+          [](const std::string &port_name, uint32_t vlan_id) {
+            ulong not_care_culminative_time = 0;
+            return ACA_OVS_L2_Programmer::get_instance().set_port_tag(
+                    port_name, vlan_id, not_care_culminative_time);
+          },
+          OVSDB_MAX_PENDING_PORTS, OVSDB_PENDING_PORT_TIMEOUT_IN_MICROSECONDS,
+          PORT_SCAN_SLEEP_INTERVAL * 1000UL);
+  return instance;
+}
+
+ACA_OVSDB_Port_Monitor::ACA_OVSDB_Port_Monitor(const std::string &socket_path,
+                                               configure_fn_t configure,
+                                               size_t max_pending_ports,
+                                               uint64_t timeout_us, uint64_t retry_interval_us)
+        : _configure(configure), _max_pending_ports(max_pending_ports == 0 ? 1 : max_pending_ports),
+          _timeout_us(timeout_us), _retry_interval_us(retry_interval_us), _shutdown(false),
+          _next_scan(std::chrono::steady_clock::now()),
+          _client(socket_path, OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS)
+{
+}
+
+ACA_OVSDB_Port_Monitor::~ACA_OVSDB_Port_Monitor()
+{
+  shutdown();
+}
+
+int ACA_OVSDB_Port_Monitor::add(const std::string &port_name, uint32_t vlan_id)
+{
+  bool plugged;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_shutdown) {
+      return EXIT_FAILURE;
+    }
+    plugged = _interfaces.count(port_name) > 0;
+  }
+
+  // the interface got its ofport after the caller tried
+  if (plugged) {
+    int rc = _configure(port_name, vlan_id);
+    if (rc == EXIT_SUCCESS) {
+      return rc;
+    }
+  }
+
+  time_point now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found = _pending.find(port_name);
+  if (found != _pending.end()) {
+    // the port is created again, with the vlan of its new state
+    found->second.vlan_id = vlan_id;
+    return EINPROGRESS;
+  }
+  if (_pending.size() >= _max_pending_ports) {
+    ACA_LOG_ERROR("ACA_OVSDB_Port_Monitor::add - %lu ports pending already, port %s refused\n",
+                  _pending.size(), port_name.c_str());
+    return ENOSPC;
+  }
+
+  Pending_Port &pending_port = _pending[port_name];
+  pending_port.vlan_id = vlan_id;
+  pending_port.expire_time = now + std::chrono::microseconds(_timeout_us);
+  pending_port.retry_time = now + std::chrono::microseconds(_retry_interval_us);
+
+  if (!_monitor_thread.joinable()) {
+    _monitor_thread = std::thread([this] { _monitor(); });
+  }
+  return EINPROGRESS;
+}
+
+bool ACA_OVSDB_Port_Monitor::remove(const std::string &port_name)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending.erase(port_name) > 0;
+}
+
+size_t ACA_OVSDB_Port_Monitor::pending()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending.size();
+}
+
+void ACA_OVSDB_Port_Monitor::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _shutdown = true;
+  }
+  _cv.notify_all();
+  if (_monitor_thread.joinable()) {
+    _monitor_thread.join();
+  }
+  _client.close();
+}
+
+void ACA_OVSDB_Port_Monitor::_on_ofport(const std::string &interface, int64_t ofport)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (ofport <= 0) {
+    _interfaces.erase(interface);
+    return;
+  }
+  if (_interfaces.insert(interface).second && _pending.count(interface) > 0) {
+    _plugged.push_back(interface);
+  }
+}
+
+void ACA_OVSDB_Port_Monitor::_monitor()
+{
+  ACA_LOG_DEBUG("Monitoring the ovsdb interfaces in thread id: [%ld]\n",
+                std::this_thread::get_id());
+
+  bool monitored = false;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shutdown) {
+        break;
+      }
+    }
+
+    if (!monitored) {
+      int rc = _client.monitor_ofports([this](const std::string &interface, int64_t ofport) {
+        _on_ofport(interface, ofport);
+      });
+      monitored = rc == EXIT_SUCCESS;
+      if (!monitored) {
+        ACA_LOG_ERROR("ACA_OVSDB_Port_Monitor::_monitor - can't monitor the interfaces, rc: %d, polling the pending ports\n",
+                      rc);
+      }
+    }
+
+    if (monitored) {
+      int rc = _client.wait_for_updates(OVSDB_MONITOR_WAIT_SLICE_IN_MICROSECONDS);
+      if (rc != EXIT_SUCCESS && rc != ETIMEDOUT) {
+        ACA_LOG_ERROR("ACA_OVSDB_Port_Monitor::_monitor - monitor lost, rc: %d\n", rc);
+        monitored = false;
+        // the monitor starts over with all the interfaces
+        std::lock_guard<std::mutex> lock(_mutex);
+        _interfaces.clear();
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait_for(lock, std::chrono::microseconds(_retry_interval_us),
+                   [this] { return _shutdown; });
+    }
+
+    _configure_ports(monitored);
+  }
+}
+
+void ACA_OVSDB_Port_Monitor::_configure_ports(bool monitored)
+{
+  std::vector<std::pair<std::string, uint32_t> > due_ports;
+  time_point now = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto &port_name : _plugged) {
+      auto found = _pending.find(port_name);
+      if (found != _pending.end()) {
+        due_ports.emplace_back(port_name, found->second.vlan_id);
+      }
+    }
+    _plugged.clear();
+
+    // every retry interval, drop the expired ports and try again the ones
+    // which failed, all of them when the monitor is down
+    if (now >= _next_scan) {
+      _next_scan = now + std::chrono::microseconds(_retry_interval_us);
+      for (auto it = _pending.begin(); it != _pending.end();) {
+        if (it->second.expire_time <= now) {
+          ACA_LOG_ERROR("Not able to set the vlan tag %d for port %s even after waiting\n",
+                        it->second.vlan_id, it->first.c_str());
+          it = _pending.erase(it);
+          continue;
+        }
+        if (it->second.retry_time <= now && (!monitored || _interfaces.count(it->first) > 0)) {
+          due_ports.emplace_back(it->first, it->second.vlan_id);
+        }
+        it++;
+      }
+    }
+  }
+
+  for (auto &due_port : due_ports) {
+    int rc = _configure(due_port.first, due_port.second);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _pending.find(due_port.first);
+    // a port removed or created again meanwhile is left as it is
+    if (found == _pending.end() || found->second.vlan_id != due_port.second) {
+      continue;
+    }
+    if (rc == EXIT_SUCCESS) {
+      ACA_LOG_DEBUG("ACA_OVSDB_Port_Monitor::_configure_ports - vlan tag %d set for port %s\n",
+                    due_port.second, due_port.first.c_str());
+      _pending.erase(found);
+    } else {
+      found->second.retry_time = std::chrono::steady_clock::now() +
+                                 std::chrono::microseconds(_retry_interval_us);
+    }
+  }
+}
+} // namespace aca_ovs_l2_programmer
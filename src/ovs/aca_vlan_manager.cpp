@@ -16,6 +16,7 @@
 #include "aca_util.h"
 #include "aca_vlan_manager.h"
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_transaction.h"
 #include "aca_arp_responder.h"
 
 #undef OFP_ASSERT
@@ -125,13 +126,13 @@ int ACA_Vlan_Manager::create_ovs_port(string /*vpc_id*/, string ovs_port,
     int internal_vlan_id = current_vpc_table_entry->vlan_id;
     string patch_int_port_id = ACA_OVS_L2_Programmer::get_instance().get_system_port_id("patch-int");
 
-    string cmd_string =
-            "table=4, priority=1,tun_id=" + to_string(tunnel_id) +
-            " actions=mod_vlan_vid:" + to_string(internal_vlan_id) + ",output:" + patch_int_port_id;
+    FlowBuilder flow;
+    flow.table(4).priority(1).tun_id(tunnel_id)
+            .mod_vlan_vid(internal_vlan_id).output(patch_int_port_id);
 
     ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                            "br-tun",
-                                                           cmd_string,
+                                                           flow,
                                                            "add");
     current_vpc_table_entry->ovs_ports.insert(ovs_port, nullptr);
   }
@@ -163,12 +164,12 @@ int ACA_Vlan_Manager::delete_ovs_port(string /*vpc_id*/, string ovs_port,
       // also delete the rule assoicated with the VPC:
       // table 4 = incoming vxlan, allow incoming vxlan traffic matching tunnel_id
       // to stamp with internal vlan and deliver to br-int
-      string cmd_string = "table=4, priority=1,tun_id=" +
-                          to_string(tunnel_id);
+      FlowBuilder flow;
+      flow.table(4).priority(1).tun_id(tunnel_id);
 
       ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                              "br-tun",
-                                                             cmd_string,
+                                                             flow,
                                                              "del");
     }
   }
@@ -190,16 +191,14 @@ int ACA_Vlan_Manager::create_l2_neighbor(string virtual_ip, string virtual_mac,
   // match internal vlan based on VPC and destination neighbor mac,
   // strip the internal vlan, encap with tunnel id,
   // output to the neighbor host through vxlan-generic ovs port
-  string match_string = "table=20,priority=50,dl_vlan=" + to_string(internal_vlan_id) +
-                        ",dl_dst:" + virtual_mac;
-
-  string action_string = ",actions=strip_vlan,load:" + to_string(tunnel_id) +
-                         "->NXM_NX_TUN_ID[],set_field:" + remote_host_ip +
-                         "->tun_dst,output:" + VXLAN_GENERIC_OUTPORT_NUMBER;
+  FlowBuilder flow;
+  flow.table(20).priority(50).dl_vlan(internal_vlan_id).dl_dst(virtual_mac)
+          .strip_vlan().load_tun_id(tunnel_id).set_tun_dst(remote_host_ip)
+          .output(VXLAN_GENERIC_OUTPORT_NUMBER);
 
   aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                                                 "br-tun",
-                                                                                match_string + action_string,
+                                                                                flow,
                                                                                 "add");
 
   // create arp entry in arp responder for the l2 neighbor
@@ -207,7 +206,12 @@ int ACA_Vlan_Manager::create_l2_neighbor(string virtual_ip, string virtual_mac,
   stArpCfg.ipv4_address = virtual_ip;
   stArpCfg.vlan_id = internal_vlan_id;
 
-  overall_rc = ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+  // the entry wakes up the on-demand requests replaying their packets to the
+  // neighbor, so it waits for the flow above to be committed
+  ACA_OVS_Flow_Transaction::after_commit([stArpCfg]() mutable {
+    ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfg);
+  });
+  overall_rc = EXIT_SUCCESS;
 
   ACA_LOG_DEBUG("create_l2_neighbor arp entry with ip = %s, vlan id = %u and mac = %s\n",
                 virtual_ip.c_str(), internal_vlan_id, virtual_mac.c_str());
@@ -231,12 +235,12 @@ int ACA_Vlan_Manager::delete_l2_neighbor(string virtual_ip, string virtual_mac,
   arp_config stArpCfg;
 
   // delete the rule l2 neighbor rule
-  string match_string = "table=20,priority=50,dl_vlan=" + to_string(internal_vlan_id) +
-                        ",dl_dst:" + virtual_mac;
+  FlowBuilder flow;
+  flow.table(20).priority(50).dl_vlan(internal_vlan_id).dl_dst(virtual_mac);
 
   aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow(culminative_time,
                                                                                 "br-tun",
-                                                                                match_string,
+                                                                                flow,
                                                                                 "del");
 
   if (rc != EXIT_SUCCESS) {
@@ -249,7 +253,10 @@ int ACA_Vlan_Manager::delete_l2_neighbor(string virtual_ip, string virtual_mac,
   stArpCfg.ipv4_address = virtual_ip;
   stArpCfg.vlan_id = internal_vlan_id;
 
-  ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfg);
+  // keeps its order with the entries added after_commit()
+  ACA_OVS_Flow_Transaction::after_commit([stArpCfg]() mutable {
+    ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfg);
+  });
 
   ACA_LOG_DEBUG("delete_l2_neighbor arp entry with ip = %s, vlan id = %u and mac = %s\n",
                 virtual_ip.c_str(), internal_vlan_id, virtual_mac.c_str());
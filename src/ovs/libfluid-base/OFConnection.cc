@@ -57,6 +57,18 @@ void OFConnection::send(void* data, size_t len) {
         this->conn->send((uint8_t*) data, len);    
 }
 
+ssize_t OFConnection::send(const struct iovec* iov, int iovcnt) {
+    if (this->conn == NULL)
+        return -1;
+    return this->conn->send(iov, iovcnt);
+}
+
+size_t OFConnection::get_send_backlog() {
+    if (this->conn == NULL)
+        return 0;
+    return this->conn->get_send_backlog();
+}
+
 void OFConnection::add_timed_callback(void* (*cb)(void*),
                                       int interval,
                                       void* arg) {
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include <event2/event.h>
+#include <event2/buffer.h>
 #include <event2/bufferevent.h>
 #include <event2/bufferevent_ssl.h>
 
@@ -226,6 +227,24 @@ void BaseOFConnection::send(void* data, size_t len) {
     bufferevent_write(this->m_implementation->bev, data, len);
 }
 
+size_t BaseOFConnection::send(const struct iovec* iov, int iovcnt) {
+    struct bufferevent* bev = this->m_implementation->bev;
+    size_t len = 0;
+
+    bufferevent_lock(bev);
+    struct evbuffer* output = bufferevent_get_output(bev);
+    for (int i = 0; i < iovcnt; i++) {
+        evbuffer_add(output, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    bufferevent_unlock(bev);
+    return len;
+}
+
+size_t BaseOFConnection::get_send_backlog() {
+    return evbuffer_get_length(bufferevent_get_output(this->m_implementation->bev));
+}
+
 void BaseOFConnection::add_timed_callback(void* (*cb)(void*), int interval, void* arg) {
     struct timeval tv = { interval / 1000, (interval % 1000) * 1000 };
     struct timed_callback* tc = new struct timed_callback;
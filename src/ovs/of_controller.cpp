@@ -12,22 +12,29 @@
 //     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <algorithm>
 #include <set>
 
 #include "of_controller.h"
+#include "aca_config.h"
 #include "aca_log.h"
 #include "aca_util.h"
 #include "aca_on_demand_engine.h"
+#include "aca_ovs_flow_shadow.h"
+#include "aca_zeta_oam_path_cache.h"
 
 using namespace fluid_base;
 using namespace fluid_msg;
 
+extern uint g_ovs_flow_bundle_size;
+
 void OFController::stop() {
     switch_map_mutex.lock();
 
     for (auto iter: switch_conn_map) {
         // close all OFConnection
         if (NULL != iter.second) {
+            shutdown_send_queue(iter.second);
             iter.second->close();
         }
     }
@@ -35,9 +42,30 @@ void OFController::stop() {
     switch_id_map.clear();
 
     switch_map_mutex.unlock();
+
+    flow_dump_mutex.lock();
+    flow_dumps.clear();
+    flow_dump_mutex.unlock();
+    sweep_cancel.signal();
 }
 
 void OFController::message_callback(OFConnection* ofconn, uint8_t type, void* data, size_t len) {
+    // the controller owns the message buffers (keep_data_ownership is off),
+    // packet-ins hand theirs over to the packet handlers, the others are freed here
+    if (type == fluid_msg::of13::OFPT_PACKET_IN) {
+        packet_in_ptr_t pin = PacketInView::create(data, len, [this](void* d) {
+            this->free_data(d);
+        });
+        if (!pin) {
+            ACA_LOG_ERROR("%s", "OFController::message_callback - failed to parse packet in\n");
+            return;
+        }
+        marl::schedule([=] {
+            aca_on_demand_engine::ACA_On_Demand_Engine::get_instance().parse_packet(pin);
+        });
+        return;
+    }
+
     if (type == fluid_msg::of13::OFPT_FEATURES_REPLY) {
         ACA_LOG_INFO("OFController::message_callback - ovs connection id=%d up\n", ofconn->get_id());
 
@@ -45,7 +73,6 @@ void OFController::message_callback(OFConnection* ofconn, uint8_t type, void* da
         auto err = reply.unpack((uint8_t *) data);
         if (err != 0) {
             ACA_LOG_ERROR("%s", "OFController::message_callback - failed to parse feature reply\n");
-            return;
         } else {
             uint64_t dpid = reply.datapath_id();
             ACA_LOG_INFO("OFController::message_callback - ovs connection %d with dpid %ld\n", ofconn->get_id(), dpid);
@@ -54,6 +81,14 @@ void OFController::message_callback(OFConnection* ofconn, uint8_t type, void* da
             std::string bridge_name = switch_dpid_map[dpid];
             add_switch_to_conn_map(bridge_name, ofconn->get_id(), ofconn);
 
+            // the switch may have restarted and lost its flows, they are sent
+            // again until the flow dump tells which ones are still there
+            aca_ovs_l2_programmer::ACA_OVS_Flow_Shadow::get_instance().invalidate(bridge_name);
+            if (bridge_name == "br-tun") {
+                // the OAM direct paths may be gone with them, they are injected again
+                aca_zeta_oam_server::ACA_Zeta_Oam_Path_Cache::get_instance().clear();
+            }
+
             // setup default flows for each bridge
             if (bridge_name == "br-int") {
                 setup_default_br_int_flows();
@@ -62,30 +97,45 @@ void OFController::message_callback(OFConnection* ofconn, uint8_t type, void* da
             if (bridge_name == "br-tun") {
                 setup_default_br_tun_flows();
             }
+
+            dump_flows(ofconn, bridge_name);
         }
+    } else if (type == fluid_msg::of13::OFPT_MULTIPART_REPLY) {
+        on_flow_stats_reply(ofconn, data);
     } else if (type == fluid_msg::of13::OFPT_BARRIER_REPLY) {
         auto t = std::chrono::high_resolution_clock::now();
         ACA_LOG_INFO("OFController::message_callback - recv OFPT_BARRIER_REPLY on %ld\n", t.time_since_epoch().count());
-    } else if (type == fluid_msg::of13::OFPT_PACKET_IN) {
-        fluid_msg::of13::PacketIn *pin = new fluid_msg::of13::PacketIn();
-        pin->unpack((uint8_t *)data);
-        uint32_t in_port = pin->match().in_port()->value();
-        marl::schedule([=] {
-            aca_on_demand_engine::ACA_On_Demand_Engine::get_instance().parse_packet(
-                    in_port,
-                    (void *)pin->data());
-            delete pin;
-        });
-    } else if (type == 33) { // OFPRAW_OFPT14_BUNDLE_CONTROL
+        flow_completions.on_message(ofconn->get_id(), data, len);
+    } else if (type == fluid_msg::of13::OFPT_ERROR) {
+        const uint8_t* msg = static_cast<const uint8_t*>(data);
+        ACA_LOG_ERROR("OFController::message_callback - ovs connection id=%d recv OFPT_ERROR type %d code %d for xid %u\n",
+                      ofconn->get_id(),
+                      len >= OF13_HEADER_LEN + 4 ? (msg[8] << 8 | msg[9]) : -1,
+                      len >= OF13_HEADER_LEN + 4 ? (msg[10] << 8 | msg[11]) : -1,
+                      FlowCompletionTracker::read_xid(data));
+        flow_completions.on_message(ofconn->get_id(), data, len);
+
+        // a flow the shadow recorded for the bridge may be the rejected one
+        switch_map_mutex.lock();
+        auto bridge = switch_id_map.find(ofconn->get_id());
+        if (bridge != switch_id_map.end()) {
+            aca_ovs_l2_programmer::ACA_OVS_Flow_Shadow::get_instance().invalidate(bridge->second);
+        }
+        switch_map_mutex.unlock();
+    } else if (type == 33 || type == fluid_msg::of13::OFPT_EXPERIMENTER) {
+        // OFPRAW_OFPT14_BUNDLE_CONTROL, or the ONF extension carrying it on OpenFlow 1.3
         auto t = std::chrono::high_resolution_clock::now();
 
         BundleReplyMessage bundle_reply;
-        bundle_reply.unpack(data);
-        ACA_LOG_INFO("OFController::message_callback - recv bundle_ctrl_reply of type %ld of bundle id %ld on %ld\n",
-                     bundle_reply.get_type(),
-                     bundle_reply.get_bundle_id(),
-                     t.time_since_epoch().count());
+        if (bundle_reply.unpack(data)) {
+            ACA_LOG_INFO("OFController::message_callback - recv bundle_ctrl_reply of type %ld of bundle id %ld on %ld\n",
+                         bundle_reply.get_type(),
+                         bundle_reply.get_bundle_id(),
+                         t.time_since_epoch().count());
+        }
     }
+
+    free_data(data);
 }
 
 void OFController::connection_callback(OFConnection* ofconn, OFConnection::Event type) {
@@ -99,10 +149,14 @@ void OFController::connection_callback(OFConnection* ofconn, OFConnection::Event
         std::string bridge = switch_id_map[ofconn->get_id()];
         ACA_LOG_WARN("OFController::connection_callback - ovs connection id=%d closed by user, remove %s from switch map\n", ofconn->get_id(), bridge.c_str());
         remove_switch_from_conn_maps(bridge, ofconn->get_id());
+        flow_completions.close_connection(ofconn->get_id());
+        drop_flow_dumps(ofconn->get_id());
     } else if (type == OFConnection::EVENT_DEAD) {
         std::string bridge = switch_id_map[ofconn->get_id()];
         ACA_LOG_WARN("OFController::connection_callback - ovs connection id=%d closed due to inactivity, remove %s from switch map\n", ofconn->get_id(), bridge.c_str());
         remove_switch_from_conn_maps(bridge, ofconn->get_id());
+        flow_completions.close_connection(ofconn->get_id());
+        drop_flow_dumps(ofconn->get_id());
     }
 }
 
@@ -129,12 +183,14 @@ void OFController::add_switch_to_conn_map(std::string bridge, int ofconn_id, OFC
     // if found, remove
     if (ofconn_iter != switch_conn_map.end()) {
         if (NULL != ofconn_iter->second) { // k is bridge name, v is OFConnection*
+            shutdown_send_queue(ofconn_iter->second);
             ofconn_iter->second->close();
         }
         ACA_LOG_DEBUG("Removed ofconn_name: %s from switch_conn_map, when adding a new connection with the same name\n", bridge.c_str());
         switch_conn_map.erase(bridge);
     }
 
+    add_send_queue(ofconn);
     switch_conn_map[bridge] = ofconn;
     
     if (switch_id_map.find(ofconn_id) != switch_id_map.end()) {
@@ -165,6 +221,7 @@ void OFController::remove_switch_from_conn_maps(std::string bridge, int ofconn_i
     // if found, remove
     if (ofconn_iter != switch_conn_map.end()) {
         if (NULL != ofconn_iter->second) { // k is bridge name, v is OFConnection*
+            shutdown_send_queue(ofconn_iter->second);
             ofconn_iter->second->close();
         }
         switch_conn_map.erase(bridge);
@@ -183,6 +240,7 @@ void OFController::remove_switch_from_conn_map(std::string bridge) {
     // if found, remove
     if (ofconn_iter != switch_conn_map.end()) {
         if (NULL != ofconn_iter->second) { // k is bridge name, v is OFConnection*
+            shutdown_send_queue(ofconn_iter->second);
             ofconn_iter->second->close();
         }
         switch_conn_map.erase(bridge);
@@ -204,15 +262,92 @@ void OFController::remove_switch_from_conn_map(int ofconn_id) {
                  ofconn_id);
 }
 
-void OFController::send_flow(OFConnection *ofconn, ofmsg_ptr_t &&p) {
+void OFController::add_send_queue(OFConnection *ofconn) {
+    std::unique_lock<std::shared_mutex> lock(send_queue_mutex);
+
+    // connection ids are not reused, the queues of the closed connections are
+    // dropped here once their flusher is gone
+    for (auto iter = send_queues.begin(); iter != send_queues.end();) {
+        if (iter->first != ofconn->get_id() && iter->second->finished()) {
+            iter = send_queues.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    auto& queue = send_queues[ofconn->get_id()];
+
+    if (queue) {
+        return;
+    }
+    queue = std::make_shared<OFSendQueue>(
+            [ofconn](const struct iovec* iov, int iovcnt) {
+                return ofconn->send(iov, iovcnt);
+            },
+            [ofconn]() {
+                return ofconn->get_send_backlog();
+            });
+}
+
+void OFController::shutdown_send_queue(OFConnection *ofconn) {
+    std::shared_ptr<OFSendQueue> queue;
+
+    send_queue_mutex.lock_shared();
+    auto found = send_queues.find(ofconn->get_id());
+    if (found != send_queues.end()) {
+        queue = found->second;
+    }
+    send_queue_mutex.unlock_shared();
+
+    if (!queue) {
+        return;
+    }
+    // the messages still sent to the closed connection are dropped by the queue
+    queue->shutdown();
+    ACA_LOG_INFO("OFController::shutdown_send_queue - ovs connection id=%d sent %lu messages in %lu writes, "
+                 "%lu dropped, %lu backpressure waits\n",
+                 ofconn->get_id(), queue->messages_sent(), queue->writes(), queue->dropped(),
+                 queue->backpressure_waits());
+}
+
+void OFController::send_data(OFConnection *ofconn, void *data, size_t len) {
+    std::shared_ptr<OFSendQueue> queue;
+
+    send_queue_mutex.lock_shared();
+    auto found = send_queues.find(ofconn->get_id());
+    if (found != send_queues.end()) {
+        queue = found->second;
+    }
+    send_queue_mutex.unlock_shared();
+
+    // the connection has no queue until its features reply came in
+    if (!queue) {
+        ofconn->send(data, len);
+        return;
+    }
+    if (!queue->send(data, len)) {
+        ACA_LOG_ERROR("OFController::send_data - ovs connection id=%d dropped a message of %ld bytes\n",
+                      ofconn->get_id(), len);
+    }
+}
+
+void OFController::send_flow(OFConnection *ofconn, ofmsg_ptr_t &&p,
+                             const flow_completion_ptr_t &completion, size_t index) {
     p->set_xid(xid.fetch_add(1));
     auto buf = p->pack();
 
     if (!buf) {
+        if (completion) {
+            completion->fail(index, FLOW_ERROR_MALFORMED);
+        }
         return;
     }
 
-    ofconn->send(buf->data(), buf->len());
+    // registered before sending, the answer may come back before send_data returns
+    if (completion) {
+        flow_completions.add_flow(ofconn->get_id(), p->xid(), completion, index);
+    }
+    send_data(ofconn, buf->data(), buf->len());
 }
 
 void OFController::send_packet_out(OFConnection *ofconn, ofbuf_ptr_t &&po) {
@@ -220,28 +355,175 @@ void OFController::send_packet_out(OFConnection *ofconn, ofbuf_ptr_t &&po) {
         return;
     }
     
-    ofconn->send(po->data(), po->len());
+    send_data(ofconn, po->data(), po->len());
 }
 
-void OFController::send_bundle_flow_mods(OFConnection *ofconn, std::vector<ofmsg_ptr_t> flow_mods) {
+void OFController::send_bundle_flow_mods(OFConnection *ofconn, std::vector<ofmsg_ptr_t> flow_mods,
+                                         const flow_completion_ptr_t &completion, size_t offset) {
     xid.fetch_add(1);
-    BundleFlowModMessage bundle(flow_mods, &xid);
+    BundleFlowModMessage bundle(flow_mods, bundle_id.fetch_add(1), &xid);
     auto buf_open_req = bundle.pack_open_req();
-    ofconn->send(buf_open_req->data(), buf_open_req->len());
+    send_data(ofconn, buf_open_req->data(), buf_open_req->len());
     ACA_LOG_INFO("OFController::send_bundle_flow_mods - ovs connection id=%d send bundle open request of bundle_id %ld\n",
                  ofconn->get_id(), bundle.get_bundle_id());
 
-    // handle flow-mods
-    for (auto flow_mod : bundle.pack_flow_mods()) {
-        ofconn->send(flow_mod->data(), flow_mod->len());
+    // handle flow-mods, a rejected bundle-add is answered with the xid of its flow-mod
+    auto bufs_flow_mods = bundle.pack_flow_mods();
+    for (size_t i = 0; i < bufs_flow_mods.size(); i++) {
+        if (!bufs_flow_mods[i]) {
+            if (completion) {
+                completion->fail(offset + i, FLOW_ERROR_MALFORMED);
+            }
+            continue;
+        }
+        if (completion) {
+            flow_completions.add_flow(ofconn->get_id(), flow_mods[i]->xid(), completion, offset + i);
+        }
+        send_data(ofconn, bufs_flow_mods[i]->data(), bufs_flow_mods[i]->len());
     }
 
+    // a failed commit applies none of the flows of the bundle
     auto buf_commit_req = bundle.pack_commit_req();
-    ofconn->send(buf_commit_req->data(), buf_commit_req->len());
+    if (completion) {
+        flow_completions.add_flows(ofconn->get_id(), FlowCompletionTracker::read_xid(buf_commit_req->data()),
+                                   completion, offset, offset + flow_mods.size());
+    }
+    send_data(ofconn, buf_commit_req->data(), buf_commit_req->len());
     ACA_LOG_INFO("OFController::send_bundle_flow_mods - ovs connection id=%d send bundle commit request of bundle_id %ld\n",
                  ofconn->get_id(), bundle.get_bundle_id());
 }
 
+void OFController::execute_flow_bundles(const std::string br, const std::vector<ofmsg_ptr_t>& flow_mods) {
+    // 0 disables the bundles, a bundle of one flow goes out as the flow alone
+    size_t bundle_size = g_ovs_flow_bundle_size > 0 ? g_ovs_flow_bundle_size : 1;
+
+    for (size_t begin = 0; begin < flow_mods.size(); begin += bundle_size) {
+        size_t end = std::min(begin + bundle_size, flow_mods.size());
+        execute_flow_bundle(br, std::vector<ofmsg_ptr_t>(flow_mods.begin() + begin, flow_mods.begin() + end));
+    }
+}
+
+void OFController::dump_flows(OFConnection *ofconn, const std::string &bridge) {
+    // the flows of the agent, whichever run programmed them
+    ofmsg_ptr_t request = create_flow_stats_request(OVS_FLOW_AGENT_COOKIE, OVS_FLOW_AGENT_COOKIE_MASK);
+    request->set_xid(xid.fetch_add(1));
+    auto buf = request->pack();
+
+    if (!buf) {
+        ACA_LOG_ERROR("OFController::dump_flows - failed to encode the flow stats request of bridge %s\n",
+                      bridge.c_str());
+        return;
+    }
+
+    flow_dump_mutex.lock();
+    FlowDump& dump = flow_dumps[(uint64_t)ofconn->get_id() << 32 | request->xid()];
+    dump.bridge = bridge;
+    dump.first = dumped_bridges.insert(bridge).second;
+    flow_dump_mutex.unlock();
+
+    send_data(ofconn, buf->data(), buf->len());
+    ACA_LOG_INFO("OFController::dump_flows - ovs connection id=%d dump flows of bridge %s\n",
+                 ofconn->get_id(), bridge.c_str());
+}
+
+void OFController::drop_flow_dumps(int ofconn_id) {
+    flow_dump_mutex.lock();
+    for (auto dump = flow_dumps.begin(); dump != flow_dumps.end();) {
+        if ((int)(dump->first >> 32) == ofconn_id) {
+            dump = flow_dumps.erase(dump);
+        } else {
+            dump++;
+        }
+    }
+    flow_dump_mutex.unlock();
+}
+
+void OFController::on_flow_stats_reply(OFConnection *ofconn, void *data) {
+    uint64_t key = (uint64_t)ofconn->get_id() << 32 | FlowCompletionTracker::read_xid(data);
+    std::shared_ptr<FlowDump> finished;
+
+    flow_dump_mutex.lock();
+    auto dump = flow_dumps.find(key);
+    if (dump != flow_dumps.end()) {
+        bool more = false;
+        if (!decode_flow_stats_reply(data, dump->second.flows, more)) {
+            // the flows of the bridge stay unknown, they are sent again as they are programmed
+            ACA_LOG_ERROR("OFController::on_flow_stats_reply - failed to decode the flows of bridge %s\n",
+                          dump->second.bridge.c_str());
+            flow_dumps.erase(dump);
+        } else if (!more) {
+            finished = std::make_shared<FlowDump>(std::move(dump->second));
+            flow_dumps.erase(dump);
+        }
+    }
+    flow_dump_mutex.unlock();
+
+    if (finished) {
+        // off the connection thread, a bridge can have hundreds of thousands of flows
+        marl::schedule([this, finished] {
+            reconcile_flows(finished->bridge, finished->first, finished->flows);
+        });
+    }
+}
+
+void OFController::reconcile_flows(const std::string bridge, bool first, std::vector<DumpedFlow> &flows) {
+    auto& shadow = aca_ovs_l2_programmer::ACA_OVS_Flow_Shadow::get_instance();
+    std::vector<FlowBuilder> found;
+    std::vector<ofmsg_ptr_t> deletes;
+    // after a restart, the flows which can't be decoded wait for the sweep as well
+    auto unknown = std::make_shared<std::vector<ofmsg_ptr_t>>();
+
+    for (auto& dumped : flows) {
+        if (dumped.decoded) {
+            found.push_back(std::move(dumped.flow));
+        } else if (first) {
+            unknown->push_back(dumped.delete_flow_mod);
+        } else {
+            deletes.push_back(dumped.delete_flow_mod);
+        }
+    }
+
+    std::vector<FlowBuilder> missing;
+    std::vector<size_t> stale;
+    shadow.reconcile(bridge, found, first, missing, stale);
+
+    for (size_t i : stale) {
+        // the found flow has its cookie, a flow programmed since with the same match is left alone
+        deletes.push_back(create_del_flow(found[i], true));
+    }
+    std::vector<ofmsg_ptr_t> adds;
+    for (auto& flow : missing) {
+        adds.push_back(create_add_flow(shadow.tag(flow)));
+    }
+
+    // the deletes go first, a stale flow can have the match of a missing one
+    execute_flow_bundles(bridge, deletes);
+    execute_flow_bundles(bridge, adds);
+    ACA_LOG_INFO("OFController::reconcile_flows - bridge %s had %lu flows of the agent, %lu added, %lu deleted\n",
+                 bridge.c_str(), flows.size(), adds.size(), deletes.size());
+
+    if (!first) {
+        return;
+    }
+    marl::Event cancel = sweep_cancel;
+    marl::schedule([this, bridge, cancel, unknown] {
+        if (cancel.wait_for(std::chrono::seconds(OVS_FLOW_RECONCILE_GRACE_IN_SECONDS))) {
+            return;
+        }
+        sweep_flows(bridge, *unknown);
+    });
+}
+
+void OFController::sweep_flows(const std::string bridge, std::vector<ofmsg_ptr_t> &deletes) {
+    for (auto& flow : aca_ovs_l2_programmer::ACA_OVS_Flow_Shadow::get_instance().sweep(bridge)) {
+        deletes.push_back(create_del_flow(flow, true));
+    }
+
+    execute_flow_bundles(bridge, deletes);
+    ACA_LOG_INFO("OFController::sweep_flows - bridge %s had %lu flows left from before the restart\n",
+                 bridge.c_str(), deletes.size());
+}
+
 void OFController::setup_default_br_int_flows() {
     OFConnection* ofconn_br_int = get_instance("br-int");
 
@@ -278,14 +560,9 @@ void OFController::execute_flow(const std::string br, const std::string flow_str
     OFConnection* ofconn_br = get_instance(br);
 
     if (NULL != ofconn_br) {
-        if (action == "add") {
-            send_flow(ofconn_br, create_add_flow(flow_str));
-        } else if (action == "mod") {
-            // --strict mod
-            send_flow(ofconn_br, create_mod_flow(flow_str, true));
-        } else if (action == "del") {
-            // --strict del
-            send_flow(ofconn_br, create_del_flow(flow_str, true));
+        ofmsg_ptr_t flow_mod = create_flow_mod(flow_str, action);
+        if (flow_mod) {
+            send_flow(ofconn_br, std::move(flow_mod));
         } else {
             ACA_LOG_ERROR("OFController::execute_flow - action %s not supported in flow %s\n", action.c_str(), flow_str.c_str());
         }
@@ -296,6 +573,195 @@ void OFController::execute_flow(const std::string br, const std::string flow_str
     ofconn_br = NULL;
 }
 
+void OFController::execute_flow(const std::string br, const FlowBuilder& flow, const std::string action) {
+    OFConnection* ofconn_br = get_instance(br);
+
+    if (NULL != ofconn_br) {
+        ofmsg_ptr_t flow_mod = create_flow_mod(flow, action);
+        if (flow_mod) {
+            send_flow(ofconn_br, std::move(flow_mod));
+        } else {
+            ACA_LOG_ERROR("OFController::execute_flow - action %s not supported in flow %s\n",
+                          action.c_str(), flow.to_string().c_str());
+        }
+    } else {
+        ACA_LOG_ERROR("OFController::execute_flow - ovs connection to bridge %s not found\n", br.c_str());
+    }
+
+    ofconn_br = NULL;
+}
+
+void OFController::execute_flow_bundle(const std::string br, const std::vector<ofmsg_ptr_t>& flow_mods,
+                                       const flow_completion_ptr_t& completion, size_t offset) {
+    OFConnection* ofconn_br = get_instance(br);
+
+    if (NULL != ofconn_br) {
+        if (flow_mods.size() == 1) {
+            // a bundle of one flow is just the flow
+            send_flow(ofconn_br, ofmsg_ptr_t(flow_mods[0]), completion, offset);
+        } else if (!flow_mods.empty()) {
+            send_bundle_flow_mods(ofconn_br, flow_mods, completion, offset);
+        }
+    } else {
+        ACA_LOG_ERROR("OFController::execute_flow_bundle - ovs connection to bridge %s not found\n", br.c_str());
+        if (completion) {
+            completion->fail(offset, offset + flow_mods.size(), FLOW_ERROR_NO_CONNECTION);
+        }
+    }
+
+    ofconn_br = NULL;
+}
+
+void OFController::execute_barrier(const std::string br, const flow_completion_ptr_t& completion) {
+    OFConnection* ofconn_br = get_instance(br);
+
+    if (NULL != ofconn_br) {
+        uint8_t barrier[OF13_HEADER_LEN];
+        uint32_t barrier_xid = xid.fetch_add(1);
+        FlowCompletionTracker::encode_barrier_request(barrier, barrier_xid);
+        flow_completions.add_barrier(ofconn_br->get_id(), barrier_xid, completion);
+        send_data(ofconn_br, barrier, sizeof(barrier));
+    } else {
+        ACA_LOG_ERROR("OFController::execute_barrier - ovs connection to bridge %s not found\n", br.c_str());
+        completion->fail(0, completion->size(), FLOW_ERROR_NO_CONNECTION);
+        completion->resolve();
+    }
+
+    ofconn_br = NULL;
+}
+
+void OFController::execute_group_mod(const std::string br, group_mod_command command, uint32_t group_id,
+                                     uint8_t group_type, const std::vector<GroupBucket>& buckets,
+                                     const flow_completion_ptr_t& completion, size_t index) {
+    OFConnection* ofconn_br = get_instance(br);
+
+    if (NULL == ofconn_br) {
+        ACA_LOG_ERROR("OFController::execute_group_mod - ovs connection to bridge %s not found\n", br.c_str());
+        if (completion) {
+            completion->fail(index, FLOW_ERROR_NO_CONNECTION);
+        }
+        return;
+    }
+
+    uint8_t version = ofconn_br->get_version();
+    bool has_bucket_commands = version >= OF15_GROUP_VERSION;
+
+    // the buckets given, encoded for the cache of the group
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> new_buckets;
+    if (command != GROUP_MOD_DELETE && command != GROUP_MOD_REMOVE_BUCKET) {
+        new_buckets.reserve(buckets.size());
+        for (auto& bucket : buckets) {
+            new_buckets.emplace_back(bucket.bucket_id, std::vector<uint8_t>());
+            if (!encode_group_bucket(new_buckets.back().second, OF13_GROUP_VERSION, group_type, bucket)) {
+                ACA_LOG_ERROR("OFController::execute_group_mod - bucket %u of group %u on bridge %s has "
+                              "actions a bucket can't have: %s\n", bucket.bucket_id, group_id, br.c_str(),
+                              bucket.actions.to_string().c_str());
+                if (completion) {
+                    completion->fail(index, FLOW_ERROR_MALFORMED);
+                }
+                return;
+            }
+        }
+    }
+
+    // the group-mods of the change, sent back to back in one write
+    std::vector<uint8_t> batch;
+    std::vector<uint32_t> xids;
+    bool encoded = true;
+
+    std::lock_guard<std::mutex> lock(group_mutex);
+    auto& bridge_groups = groups[br];
+    auto group = bridge_groups.find(group_id);
+
+    if (command == GROUP_MOD_INSERT_BUCKET || command == GROUP_MOD_REMOVE_BUCKET) {
+        if (group == bridge_groups.end()) {
+            if (!has_bucket_commands) {
+                ACA_LOG_ERROR("OFController::execute_group_mod - group %u on bridge %s was not added by "
+                              "the controller, its buckets can't be changed over OpenFlow 1.3\n",
+                              group_id, br.c_str());
+                if (completion) {
+                    completion->fail(index, FLOW_ERROR_MALFORMED);
+                }
+                return;
+            }
+            group = bridge_groups.emplace(group_id, GroupState{group_type, {}}).first;
+        }
+        group_type = group->second.type;
+
+        if (command == GROUP_MOD_INSERT_BUCKET) {
+            for (auto& bucket : new_buckets) {
+                group->second.buckets[bucket.first] = std::move(bucket.second);
+            }
+        } else {
+            for (auto& bucket : buckets) {
+                group->second.buckets.erase(bucket.bucket_id);
+            }
+        }
+    } else if (command == GROUP_MOD_DELETE) {
+        if (group != bridge_groups.end()) {
+            bridge_groups.erase(group);
+        }
+    } else {
+        GroupState& state = bridge_groups[group_id];
+        state.type = group_type;
+        state.buckets.clear();
+        for (auto& bucket : new_buckets) {
+            state.buckets[bucket.first] = std::move(bucket.second);
+        }
+        group = bridge_groups.find(group_id);
+    }
+
+    if (has_bucket_commands) {
+        if (command == GROUP_MOD_REMOVE_BUCKET) {
+            // a remove takes out the one bucket of its command_bucket_id
+            for (auto& bucket : buckets) {
+                xids.push_back(xid.fetch_add(1));
+                encoded = encoded && encode_group_mod(batch, version, xids.back(), command, group_type,
+                                                      group_id, NULL, 0, bucket.bucket_id);
+            }
+        } else {
+            xids.push_back(xid.fetch_add(1));
+            encoded = encode_group_mod(batch, version, xids.back(), command, group_type, group_id, buckets,
+                                       command == GROUP_MOD_INSERT_BUCKET ? OF15_BUCKET_ID_LAST
+                                                                          : OF15_BUCKET_ID_ALL);
+        }
+    } else {
+        // the group as the controller left it, from its buckets already encoded
+        std::vector<uint8_t> group_buckets;
+        if (command != GROUP_MOD_DELETE) {
+            for (auto& bucket : group->second.buckets) {
+                group_buckets.insert(group_buckets.end(), bucket.second.begin(), bucket.second.end());
+            }
+        }
+        group_mod_command of13_command = command;
+        if (command == GROUP_MOD_INSERT_BUCKET || command == GROUP_MOD_REMOVE_BUCKET) {
+            of13_command = GROUP_MOD_MODIFY;
+        }
+        xids.push_back(xid.fetch_add(1));
+        encoded = encode_group_mod(batch, version, xids.back(), of13_command, group_type, group_id,
+                                   group_buckets.data(), group_buckets.size());
+    }
+
+    if (!encoded) {
+        ACA_LOG_ERROR("OFController::execute_group_mod - group %u on bridge %s does not fit in a group-mod\n",
+                      group_id, br.c_str());
+        if (completion) {
+            completion->fail(index, FLOW_ERROR_MALFORMED);
+        }
+        return;
+    }
+
+    // registered before sending, the answer may come back before send_data returns
+    if (completion) {
+        for (auto group_mod_xid : xids) {
+            flow_completions.add_flow(ofconn_br->get_id(), group_mod_xid, completion, index);
+        }
+    }
+    send_data(ofconn_br, batch.data(), batch.size());
+
+    ofconn_br = NULL;
+}
+
 void OFController::packet_out(const char* br, const char* opt) {
     OFConnection* ofconn_br = get_instance(std::string(br));
 
@@ -307,3 +773,44 @@ void OFController::packet_out(const char* br, const char* opt) {
 
     ofconn_br = NULL;
 }
+
+void OFController::packet_out(const char* br, uint32_t in_port, const uint8_t* packet, size_t len,
+                              const packet_out_actions_t& actions) {
+    OFConnection* ofconn_br = get_instance(std::string(br));
+
+    if (NULL != ofconn_br) {
+        std::vector<uint8_t> po;
+        if (encode_packet_out(po, xid.fetch_add(1), in_port, packet, len, actions)) {
+            send_data(ofconn_br, po.data(), po.size());
+        } else {
+            ACA_LOG_ERROR("OFController::packet_out - packet of %ld bytes too large for a packet-out\n", len);
+        }
+    } else {
+        ACA_LOG_ERROR("OFController::packet_out - ovs connection to bridge %s not found\n", br);
+    }
+
+    ofconn_br = NULL;
+}
+
+void OFController::packet_out(const char* br, const std::vector<PacketOutFrame>& frames) {
+    OFConnection* ofconn_br = get_instance(std::string(br));
+
+    if (NULL != ofconn_br) {
+        // openflow messages are self delimiting, pack them back to back
+        std::vector<uint8_t> batch;
+        for (auto& frame : frames) {
+            if (!encode_packet_out(batch, xid.fetch_add(1), frame.in_port, frame.packet, frame.len,
+                                   frame.actions)) {
+                ACA_LOG_ERROR("OFController::packet_out - packet of %ld bytes too large for a packet-out\n",
+                              frame.len);
+            }
+        }
+        if (!batch.empty()) {
+            send_data(ofconn_br, batch.data(), batch.size());
+        }
+    } else {
+        ACA_LOG_ERROR("OFController::packet_out - ovs connection to bridge %s not found\n", br);
+    }
+
+    ofconn_br = NULL;
+}
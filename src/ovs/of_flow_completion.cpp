@@ -0,0 +1,224 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "of_flow_completion.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+
+bool FlowCompletion::wait_for(std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _cv.wait_for(lock, timeout, [this] { return _done; });
+}
+
+bool FlowCompletion::done() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _done;
+}
+
+uint32_t FlowCompletion::error(size_t index) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return index < _errors.size() ? _errors[index] : 0;
+}
+
+size_t FlowCompletion::failed() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _failed;
+}
+
+void FlowCompletion::fail(size_t index, uint32_t error) {
+    fail(index, index + 1, error);
+}
+
+void FlowCompletion::fail(size_t begin, size_t end, uint32_t error) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = begin; i < end && i < _errors.size(); i++) {
+        if (_errors[i] == 0) {
+            _errors[i] = error;
+            _failed++;
+        }
+    }
+}
+
+void FlowCompletion::resolve() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+    }
+    _cv.notify_all();
+}
+
+void FlowCompletionTracker::add_flows(int conn_id, uint32_t xid, const flow_completion_ptr_t& completion,
+                                      size_t begin, size_t end) {
+    add(conn_id, xid, Request{ completion, begin, end, false });
+}
+
+void FlowCompletionTracker::add_barrier(int conn_id, uint32_t xid, const flow_completion_ptr_t& completion) {
+    add(conn_id, xid, Request{ completion, 0, 0, true });
+}
+
+void FlowCompletionTracker::add(int conn_id, uint32_t xid, const Request& request) {
+    std::vector<flow_completion_ptr_t> expired;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        time_point now = std::chrono::steady_clock::now();
+        take_expired(now, expired);
+
+        uint64_t key = get_key(conn_id, xid);
+        _requests[key] = request;
+        auto found = _completion_keys.find(request.completion.get());
+        if (found == _completion_keys.end()) {
+            uint64_t sequence = _next_sequence++;
+            found = _completion_keys.emplace(request.completion.get(),
+                                             CompletionKeys{ sequence, {} }).first;
+            _completion_order.push_back(CompletionOrder{ now, sequence, request.completion.get() });
+        }
+        found->second.keys.push_back(key);
+    }
+    fail_expired(expired);
+}
+
+bool FlowCompletionTracker::on_message(int conn_id, const void* data, size_t len) {
+    const uint8_t* msg = static_cast<const uint8_t*>(data);
+
+    if (len < OF13_HEADER_LEN ||
+        (msg[1] != OF13_ERROR_TYPE && msg[1] != OF13_BARRIER_REPLY_TYPE)) {
+        return false;
+    }
+
+    flow_completion_ptr_t completion;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _requests.find(get_key(conn_id, read_xid(msg)));
+        if (found == _requests.end()) {
+            return false;
+        }
+        Request& request = found->second;
+
+        if (msg[1] == OF13_ERROR_TYPE) {
+            // ofp_error_msg: header, type, code, then the start of the failed request
+            if (len < OF13_HEADER_LEN + 4 || request.barrier) {
+                return false;
+            }
+            uint16_t type, code;
+            memcpy(&type, msg + OF13_HEADER_LEN, sizeof(type));
+            memcpy(&code, msg + OF13_HEADER_LEN + 2, sizeof(code));
+            request.completion->fail(request.begin, request.end,
+                                     (static_cast<uint32_t>(ntohs(type)) << 16) | ntohs(code));
+            return true;
+        }
+
+        if (!request.barrier) {
+            return false;
+        }
+        // everything sent before the barrier is answered now
+        completion = request.completion;
+        remove(completion.get());
+    }
+    completion->resolve();
+    return true;
+}
+
+void FlowCompletionTracker::close_connection(int conn_id) {
+    std::vector<flow_completion_ptr_t> completions;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& request : _requests) {
+            if (static_cast<int>(request.first >> 32) == conn_id && request.second.barrier) {
+                completions.push_back(request.second.completion);
+            }
+        }
+        for (auto& completion : completions) {
+            remove(completion.get());
+        }
+    }
+    // the flows already failed keep their error
+    for (auto& completion : completions) {
+        completion->fail(0, completion->size(), FLOW_ERROR_CONNECTION_CLOSED);
+        completion->resolve();
+    }
+}
+
+size_t FlowCompletionTracker::expire(time_point now) {
+    std::vector<flow_completion_ptr_t> expired;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        take_expired(now, expired);
+    }
+    fail_expired(expired);
+    return expired.size();
+}
+
+size_t FlowCompletionTracker::pending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests.size();
+}
+
+uint32_t FlowCompletionTracker::read_xid(const void* data) {
+    uint32_t xid;
+    memcpy(&xid, static_cast<const uint8_t*>(data) + 4, sizeof(xid));
+    return ntohl(xid);
+}
+
+void FlowCompletionTracker::encode_barrier_request(uint8_t (&buf)[OF13_HEADER_LEN], uint32_t xid) {
+    uint16_t length = htons(OF13_HEADER_LEN);
+    uint32_t net_xid = htonl(xid);
+
+    buf[0] = 4; // OpenFlow 1.3
+    buf[1] = OF13_BARRIER_REQUEST_TYPE;
+    memcpy(buf + 2, &length, sizeof(length));
+    memcpy(buf + 4, &net_xid, sizeof(net_xid));
+}
+
+void FlowCompletionTracker::remove(const FlowCompletion* completion) {
+    auto found = _completion_keys.find(completion);
+    if (found == _completion_keys.end()) {
+        return;
+    }
+    for (uint64_t key : found->second.keys) {
+        _requests.erase(key);
+    }
+    _completion_keys.erase(found);
+}
+
+void FlowCompletionTracker::take_expired(time_point now, std::vector<flow_completion_ptr_t>& expired) {
+    while (!_completion_order.empty()) {
+        CompletionOrder& order = _completion_order.front();
+        auto found = _completion_keys.find(order.completion);
+        if (found != _completion_keys.end() && found->second.sequence == order.sequence) {
+            if (order.added + _expiry > now) {
+                break;
+            }
+            // the waiter gave up on it long ago, no answer is coming any more
+            for (uint64_t key : found->second.keys) {
+                auto request = _requests.find(key);
+                if (request != _requests.end() && request->second.completion.get() == order.completion) {
+                    expired.push_back(request->second.completion);
+                    break;
+                }
+            }
+            remove(order.completion);
+        }
+        _completion_order.pop_front();
+    }
+}
+
+void FlowCompletionTracker::fail_expired(const std::vector<flow_completion_ptr_t>& expired) {
+    // the flows already failed keep their error
+    for (auto& completion : expired) {
+        completion->fail(0, completion->size(), FLOW_ERROR_EXPIRED);
+        completion->resolve();
+    }
+}
@@ -23,6 +23,12 @@
 
 #include <iostream>
 #include <memory>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <openvswitch/match.h>
+#include <openvswitch/meta-flow.h>
+#include <openvswitch/ofp-actions.h>
+#include <openvswitch/ofpbuf.h>
 #include <openvswitch/ofp-msgs.h>
 #include <openvswitch/ofp-util.h>
 #include <openvswitch/ofp-parse.h>
@@ -47,7 +53,26 @@ typedef std::unique_ptr<char, FreeDeleter<char>> OFString;
 typedef std::unique_ptr<ofpact, FreeDeleter<ofpact>> OFPact;
 
 const ofputil_protocol DEFAULT_OF_VERSION = OFPUTIL_P_OF13_OXM;
-const ofputil_protocol BUNDLE_OF_VERSION  = OFPUTIL_P_OF14_OXM;
+// the switch connections negotiate OpenFlow 1.3, where ovs takes the bundles
+// as the ONF extension 230 messages, and the flow-mods inside a bundle have to
+// match the version of the connection
+const ofputil_protocol BUNDLE_OF_VERSION  = OFPUTIL_P_OF13_OXM;
+
+// the later ovs releases keep the match of a flow-mod as a minimatch,
+// these fill and release it whichever way the headers declare it
+static void set_flow_mod_match(struct match& dst, const struct match& src) {
+    dst = src;
+}
+
+static void set_flow_mod_match(struct minimatch& dst, const struct match& src) {
+    minimatch_init(&dst, &src);
+}
+
+static void destroy_flow_mod_match(struct match&) { }
+
+static void destroy_flow_mod_match(struct minimatch& match) {
+    minimatch_destroy(&match);
+}
 
 class OFPBuf : public OFRawBuf {
 public:
@@ -174,8 +199,9 @@ public:
         // free fm.ofpacts
         //OFPact ofpacts(fm.ofpacts);
         free(CONST_CAST(struct ofpact *, fm.ofpacts));
+        destroy_flow_mod_match(fm.match);
 
-        return std::make_shared<OFPBuf>(buf);
+        return pack_ofpbuf(buf);
     }
 
 private:
@@ -184,9 +210,531 @@ private:
     enum ofputil_protocol _of_ver;
 };
 
+// the match and the ofpacts of a FlowBuilder, what parse_ofp_flow_mod_str()
+// would make of the same flow in the ovs-ofctl syntax
+static struct eth_addr to_eth_addr(const uint8_t* mac) {
+    struct eth_addr addr;
+    memcpy(addr.ea, mac, sizeof(addr.ea));
+    return addr;
+}
+
+static void fill_flow_builder_match(const FlowBuilder& flow, struct match& match) {
+    const FlowBuilder::Match& m = flow.match();
+
+    match_init_catchall(&match);
+    if (m.fields & FlowBuilder::MATCH_IN_PORT) {
+        match_set_in_port(&match, OFP_PORT_C(m.in_port));
+    }
+    if (m.fields & FlowBuilder::MATCH_DL_TYPE) {
+        match_set_dl_type(&match, htons(m.dl_type));
+    }
+    if (m.fields & FlowBuilder::MATCH_DL_VLAN) {
+        // the outermost vlan, like dl_vlan
+        match_set_dl_vlan(&match, htons(m.dl_vlan), 0);
+    }
+    // exact addresses come with an all ones mask, which ovs stores the
+    // same way as an unmasked address
+    if (m.fields & FlowBuilder::MATCH_DL_SRC) {
+        match_set_dl_src_masked(&match, to_eth_addr(m.dl_src), to_eth_addr(m.dl_src_mask));
+    }
+    if (m.fields & FlowBuilder::MATCH_DL_DST) {
+        match_set_dl_dst_masked(&match, to_eth_addr(m.dl_dst), to_eth_addr(m.dl_dst_mask));
+    }
+    if (m.fields & FlowBuilder::MATCH_NW_PROTO) {
+        match_set_nw_proto(&match, m.nw_proto);
+    }
+    if (m.fields & FlowBuilder::MATCH_NW_SRC) {
+        match_set_nw_src_masked(&match, m.nw_src, m.nw_src_mask);
+    }
+    if (m.fields & FlowBuilder::MATCH_NW_DST) {
+        match_set_nw_dst_masked(&match, m.nw_dst, m.nw_dst_mask);
+    }
+    if (m.fields & FlowBuilder::MATCH_TP_SRC) {
+        match_set_tp_src(&match, htons(m.tp_src));
+    }
+    if (m.fields & FlowBuilder::MATCH_TP_DST) {
+        match_set_tp_dst(&match, htons(m.tp_dst));
+    }
+    if (m.fields & FlowBuilder::MATCH_TUN_ID) {
+        match_set_tun_id(&match, (ovs_be64)htobe64(m.tun_id));
+    }
+}
+
+// load:<value>-><field>[], the whole field
+static void put_reg_load(struct ofpbuf* ofpacts, enum mf_field_id id, const void* value) {
+    const struct mf_field* field = mf_from_id(id);
+    union mf_value mask;
+    memset(&mask, 0xff, sizeof(mask));
+    ofpact_put_reg_load(ofpacts, field, value, &mask);
+}
+
+// move:<src>[]->NXM_<dst>[], the whole field
+static void put_reg_move(struct ofpbuf* ofpacts, enum mf_field_id src, enum mf_field_id dst) {
+    struct ofpact_reg_move* move = ofpact_put_REG_MOVE(ofpacts);
+    move->src.field = mf_from_id(src);
+    move->src.ofs = 0;
+    move->src.n_bits = move->src.field->n_bits;
+    move->dst.field = mf_from_id(dst);
+    move->dst.ofs = 0;
+    move->dst.n_bits = move->dst.field->n_bits;
+}
+
+static void put_flow_builder_actions(const FlowBuilder& flow, struct ofpbuf* ofpacts) {
+    // ofpacts_check() would tell mod_vlan_vid whether the packet has a
+    // vlan header by then, it is tracked here the same way
+    bool has_vlan = flow.match().fields & FlowBuilder::MATCH_DL_VLAN;
+
+    for (auto& a : flow.actions()) {
+        union mf_value value;
+        memset(&value, 0, sizeof(value));
+
+        switch (a.type) {
+            case FlowBuilder::ACTION_OUTPUT: {
+                struct ofpact_output* output = ofpact_put_OUTPUT(ofpacts);
+                output->port = OFP_PORT_C(a.value);
+                output->max_len = a.value == FLOW_PORT_CONTROLLER ? UINT16_MAX : 0;
+                break;
+            }
+            case FlowBuilder::ACTION_RESUBMIT: {
+                struct ofpact_resubmit* resubmit = ofpact_put_RESUBMIT(ofpacts);
+                resubmit->in_port = OFPP_IN_PORT;
+                resubmit->table_id = a.value;
+                break;
+            }
+            case FlowBuilder::ACTION_GROUP:
+                ofpact_put_GROUP(ofpacts)->group_id = a.value;
+                break;
+            case FlowBuilder::ACTION_STRIP_VLAN:
+                ofpact_put_STRIP_VLAN(ofpacts);
+                has_vlan = false;
+                break;
+            case FlowBuilder::ACTION_MOD_VLAN_VID: {
+                struct ofpact_vlan_vid* vlan_vid = ofpact_put_SET_VLAN_VID(ofpacts);
+                vlan_vid->vlan_vid = a.value;
+                vlan_vid->push_vlan_if_needed = true;
+                vlan_vid->flow_has_vlan = has_vlan;
+                has_vlan = true;
+                break;
+            }
+            case FlowBuilder::ACTION_MOD_DL_SRC:
+                ofpact_put_SET_ETH_SRC(ofpacts)->mac = to_eth_addr(a.mac);
+                break;
+            case FlowBuilder::ACTION_MOD_DL_DST:
+                ofpact_put_SET_ETH_DST(ofpacts)->mac = to_eth_addr(a.mac);
+                break;
+            case FlowBuilder::ACTION_MOD_NW_SRC:
+                ofpact_put_SET_IPV4_SRC(ofpacts)->ipv4 = (ovs_be32)a.value;
+                break;
+            case FlowBuilder::ACTION_MOD_NW_DST:
+                ofpact_put_SET_IPV4_DST(ofpacts)->ipv4 = (ovs_be32)a.value;
+                break;
+            case FlowBuilder::ACTION_LOAD_TUN_ID:
+                value.be64 = (ovs_be64)htobe64(a.value);
+                put_reg_load(ofpacts, MFF_TUN_ID, &value);
+                break;
+            case FlowBuilder::ACTION_SET_TUN_DST: {
+                union mf_value mask;
+                memset(&mask, 0xff, sizeof(mask));
+                value.be32 = (ovs_be32)a.value;
+                ofpact_put_set_field(ofpacts, mf_from_id(MFF_TUN_DST), &value, &mask);
+                break;
+            }
+            case FlowBuilder::ACTION_LOAD_NW_TTL:
+                value.u8 = a.value;
+                put_reg_load(ofpacts, MFF_IP_TTL, &value);
+                break;
+            case FlowBuilder::ACTION_LOAD_ICMP_TYPE:
+                value.u8 = a.value;
+                put_reg_load(ofpacts, MFF_ICMPV4_TYPE, &value);
+                break;
+            case FlowBuilder::ACTION_MOVE_DL_SRC_TO_DST:
+                put_reg_move(ofpacts, MFF_ETH_SRC, MFF_ETH_DST);
+                break;
+            case FlowBuilder::ACTION_MOVE_NW_SRC_TO_DST:
+                put_reg_move(ofpacts, MFF_IPV4_SRC, MFF_IPV4_DST);
+                break;
+        }
+    }
+}
+
+/*
+  Flow-mod of a FlowBuilder, the ofputil_flow_mod is filled field by field
+  with what parse_ofp_flow_mod_str() would make of the same flow in the
+  ovs-ofctl syntax, so both encode to the same message.
+*/
+class TypedFlowModMessage : public OFBaseMessage {
+public:
+    TypedFlowModMessage(int op_type, const FlowBuilder& flow) :
+            _op_type(op_type),
+            _flow(flow) { }
+
+    ~TypedFlowModMessage() override = default;
+
+    ofbuf_ptr_t pack() override {
+        if (!_flow.valid()) {
+            ACA_LOG_ERROR("OFMessage - malformed flow: %s\n", _flow.to_string().c_str());
+            return {};
+        }
+
+        struct ofputil_flow_mod fm;
+        memset(&fm, 0, sizeof(fm));
+        fm.priority = _flow.priority();
+        fm.table_id = _flow.table_id();
+        fm.buffer_id = UINT32_MAX;
+        fm.out_port = OFPP_ANY;
+        fm.out_group = OFPG_ANY;
+
+        bool is_delete = false;
+        switch (_op_type) {
+            case MODIFY_FLOW:
+                fm.command = OFPFC_MODIFY;
+                break;
+            case MODIFY_FLOW_STRICT:
+                fm.command = OFPFC_MODIFY_STRICT;
+                break;
+            case DELETE_FLOW:
+                fm.command = OFPFC_DELETE;
+                is_delete = true;
+                break;
+            case DELETE_FLOW_STRICT:
+                fm.command = OFPFC_DELETE_STRICT;
+                is_delete = true;
+                break;
+            case ADD_FLOW:
+            default:
+                fm.command = OFPFC_ADD;
+                break;
+        }
+
+        if (is_delete) {
+            // a flow to delete matches its cookie
+            if (_flow.has_cookie()) {
+                fm.cookie = (ovs_be64)htobe64(_flow.cookie());
+                fm.cookie_mask = (ovs_be64)UINT64_MAX;
+            }
+        } else {
+            fm.idle_timeout = _flow.idle_timeout();
+            fm.hard_timeout = _flow.hard_timeout();
+            if (_flow.has_cookie()) {
+                fm.new_cookie = (ovs_be64)htobe64(_flow.cookie());
+                fm.modify_cookie = true;
+            } else if (fm.command != OFPFC_ADD) {
+                // a modify keeps the cookie of the flow
+                fm.new_cookie = (ovs_be64)UINT64_MAX;
+            }
+        }
+
+        struct match match;
+        fill_flow_builder_match(_flow, match);
+        set_flow_mod_match(fm.match, match);
+
+        uint64_t ofpacts_stub[1024 / 8];
+        struct ofpbuf ofpacts;
+        ofpbuf_use_stub(&ofpacts, ofpacts_stub, sizeof(ofpacts_stub));
+        if (!is_delete) {
+            put_flow_builder_actions(_flow, &ofpacts);
+            fm.ofpacts = static_cast<struct ofpact *>(ofpacts.data);
+            fm.ofpacts_len = ofpacts.size;
+        }
+
+        auto buf = ofputil_encode_flow_mod(&fm, DEFAULT_OF_VERSION);
+
+        ofpbuf_uninit(&ofpacts);
+        destroy_flow_mod_match(fm.match);
+
+        if (buf == nullptr) {
+            ACA_LOG_ERROR("OFMessage - failed to encode flow: %s\n", _flow.to_string().c_str());
+            return {};
+        }
+        return pack_ofpbuf(buf);
+    }
+
+private:
+    int _op_type;
+    FlowBuilder _flow;
+};
+
+/*
+  Flow-mod encoded from a flow of a flow stats reply, kept as the bytes of
+  the message since the match can have anything ovs has.
+*/
+class EncodedFlowModMessage : public OFBaseMessage {
+public:
+    EncodedFlowModMessage(struct ofpbuf* buf) :
+            _msg(static_cast<uint8_t*>(buf->data), static_cast<uint8_t*>(buf->data) + buf->size) { }
+
+    ~EncodedFlowModMessage() override = default;
+
+    ofbuf_ptr_t pack() override {
+        struct ofpbuf* buf = ofpbuf_clone_data(_msg.data(), _msg.size());
+        return pack_ofpbuf(buf);
+    }
+
+private:
+    std::vector<uint8_t> _msg;
+};
+
+class FlowStatsRequestMessage : public OFBaseMessage {
+public:
+    FlowStatsRequestMessage(uint64_t cookie, uint64_t cookie_mask) :
+            _cookie(cookie),
+            _cookie_mask(cookie_mask) { }
+
+    ~FlowStatsRequestMessage() override = default;
+
+    ofbuf_ptr_t pack() override {
+        struct ofputil_flow_stats_request fsr;
+        memset(&fsr, 0, sizeof(fsr));
+        fsr.aggregate = false;
+        match_init_catchall(&fsr.match);
+        fsr.cookie = (ovs_be64)htobe64(_cookie);
+        fsr.cookie_mask = (ovs_be64)htobe64(_cookie_mask);
+        fsr.out_port = OFPP_ANY;
+        fsr.out_group = OFPG_ANY;
+        // all the tables
+        fsr.table_id = 0xff;
+
+        return pack_ofpbuf(ofputil_encode_flow_stats_request(&fsr, DEFAULT_OF_VERSION));
+    }
+
+private:
+    uint64_t _cookie;
+    uint64_t _cookie_mask;
+};
+
+// the vlan id bits of a vlan tci
+#define FLOW_VLAN_VID_MASK 0x0fff
+
+static const struct eth_addr ETH_EXACT = { { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } } };
+static const ovs_be32 IP_EXACT = (ovs_be32)0xffffffff;
+
+static std::string eth_string(const struct eth_addr& mac, const struct eth_addr& mask) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x/%02x:%02x:%02x:%02x:%02x:%02x",
+             mac.ea[0], mac.ea[1], mac.ea[2], mac.ea[3], mac.ea[4], mac.ea[5],
+             mask.ea[0], mask.ea[1], mask.ea[2], mask.ea[3], mask.ea[4], mask.ea[5]);
+    return buf;
+}
+
+static bool is_zero(const struct eth_addr& mac) {
+    static const struct eth_addr zero = { { { 0, 0, 0, 0, 0, 0 } } };
+    return memcmp(mac.ea, zero.ea, sizeof(mac.ea)) == 0;
+}
+
+static std::string ip_string(ovs_be32 ip, ovs_be32 mask) {
+    char buf[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    addr.s_addr = ip;
+    std::string str = inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    addr.s_addr = mask;
+    return str + "/" + inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+}
+
+// the match of a flow stats entry into flow, the fields FlowBuilder has no
+// setter for are caught by comparing the matches afterwards
+static void decode_flow_builder_match(const struct match& match, FlowBuilder& flow) {
+    const struct flow& f = match.flow;
+    const struct flow& m = match.wc.masks;
+
+    if (m.in_port.ofp_port != 0) {
+        flow.in_port((uint16_t)f.in_port.ofp_port);
+    }
+    if (m.dl_type != 0) {
+        flow.dl_type(ntohs(f.dl_type));
+    }
+    if (m.vlans[0].tci != 0) {
+        flow.dl_vlan(ntohs(f.vlans[0].tci) & FLOW_VLAN_VID_MASK);
+    }
+    if (!is_zero(m.dl_src)) {
+        flow.dl_src(eth_string(f.dl_src, m.dl_src));
+    }
+    if (!is_zero(m.dl_dst)) {
+        flow.dl_dst(eth_string(f.dl_dst, m.dl_dst));
+    }
+    if (m.nw_proto != 0) {
+        flow.nw_proto(f.nw_proto);
+    }
+    if (m.nw_src != 0) {
+        flow.nw_src(ip_string(f.nw_src, m.nw_src));
+    }
+    if (m.nw_dst != 0) {
+        flow.nw_dst(ip_string(f.nw_dst, m.nw_dst));
+    }
+    if (m.tp_src != 0) {
+        flow.tp_src(ntohs(f.tp_src));
+    }
+    if (m.tp_dst != 0) {
+        flow.tp_dst(ntohs(f.tp_dst));
+    }
+    if (m.tunnel.tun_id != 0) {
+        flow.tun_id(be64toh((uint64_t)f.tunnel.tun_id));
+    }
+}
+
+// the ofpacts of a flow stats entry into flow, false if one of them is not a
+// FlowBuilder action
+static bool decode_flow_builder_actions(const struct ofpact* ofpacts, size_t ofpacts_len,
+                                        FlowBuilder& flow) {
+    const struct ofpact* a;
+    OFPACT_FOR_EACH (a, ofpacts, ofpacts_len) {
+        switch (a->type) {
+            case OFPACT_OUTPUT:
+                flow.output((uint16_t)ofpact_get_OUTPUT(a)->port);
+                break;
+            case OFPACT_CONTROLLER:
+                flow.output(FLOW_PORT_CONTROLLER);
+                break;
+            case OFPACT_RESUBMIT:
+                flow.resubmit(ofpact_get_RESUBMIT(a)->table_id);
+                break;
+            case OFPACT_GROUP:
+                flow.group(ofpact_get_GROUP(a)->group_id);
+                break;
+            case OFPACT_STRIP_VLAN:
+                flow.strip_vlan();
+                break;
+            case OFPACT_PUSH_VLAN:
+                // mod_vlan_vid pushes the header itself, its vlan id follows
+                break;
+            case OFPACT_SET_VLAN_VID:
+                flow.mod_vlan_vid(ofpact_get_SET_VLAN_VID(a)->vlan_vid);
+                break;
+            case OFPACT_SET_ETH_SRC:
+                flow.mod_dl_src(eth_string(ofpact_get_SET_ETH_SRC(a)->mac, ETH_EXACT));
+                break;
+            case OFPACT_SET_ETH_DST:
+                flow.mod_dl_dst(eth_string(ofpact_get_SET_ETH_DST(a)->mac, ETH_EXACT));
+                break;
+            case OFPACT_SET_IPV4_SRC:
+                flow.mod_nw_src(ip_string(ofpact_get_SET_IPV4_SRC(a)->ipv4, IP_EXACT));
+                break;
+            case OFPACT_SET_IPV4_DST:
+                flow.mod_nw_dst(ip_string(ofpact_get_SET_IPV4_DST(a)->ipv4, IP_EXACT));
+                break;
+            case OFPACT_SET_FIELD: {
+                // OpenFlow 1.3 carries most of the set and load actions as set_field
+                const struct ofpact_set_field* sf = ofpact_get_SET_FIELD(a);
+                const union mf_value* value = sf->value;
+                switch (sf->field->id) {
+                    case MFF_TUN_ID:
+                        flow.load_tun_id(be64toh((uint64_t)value->be64));
+                        break;
+                    case MFF_TUN_DST:
+                        flow.set_tun_dst(ip_string(value->be32, IP_EXACT));
+                        break;
+                    case MFF_IP_TTL:
+                        flow.load_nw_ttl(value->u8);
+                        break;
+                    case MFF_ICMPV4_TYPE:
+                        flow.load_icmp_type(value->u8);
+                        break;
+                    case MFF_ETH_SRC:
+                        flow.mod_dl_src(eth_string(value->mac, ETH_EXACT));
+                        break;
+                    case MFF_ETH_DST:
+                        flow.mod_dl_dst(eth_string(value->mac, ETH_EXACT));
+                        break;
+                    case MFF_IPV4_SRC:
+                        flow.mod_nw_src(ip_string(value->be32, IP_EXACT));
+                        break;
+                    case MFF_IPV4_DST:
+                        flow.mod_nw_dst(ip_string(value->be32, IP_EXACT));
+                        break;
+                    case MFF_VLAN_VID:
+                        flow.mod_vlan_vid(ntohs(value->be16) & FLOW_VLAN_VID_MASK);
+                        break;
+                    default:
+                        return false;
+                }
+                break;
+            }
+            case OFPACT_REG_MOVE: {
+                const struct ofpact_reg_move* move = ofpact_get_REG_MOVE(a);
+                if (move->src.field->id == MFF_ETH_SRC && move->dst.field->id == MFF_ETH_DST) {
+                    flow.move_dl_src_to_dst();
+                } else if (move->src.field->id == MFF_IPV4_SRC && move->dst.field->id == MFF_IPV4_DST) {
+                    flow.move_nw_src_to_dst();
+                } else {
+                    return false;
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+static void encode_instructions(const struct ofpact* ofpacts, size_t ofpacts_len, struct ofpbuf* buf) {
+    ofpacts_put_openflow_instructions(ofpacts, ofpacts_len, buf,
+                                      ofputil_protocol_to_ofp_version(DEFAULT_OF_VERSION));
+}
+
+/*
+ * decode a flow stats entry into a FlowBuilder.
+ * Return:
+ *    false if the flow has a match field or an action FlowBuilder can't give
+ *    back exactly, the FlowBuilder flow would encode to another flow-mod
+ */
+static bool decode_flow_builder(const struct ofputil_flow_stats& fs, FlowBuilder& flow) {
+    flow.table(fs.table_id).priority(fs.priority).cookie(be64toh((uint64_t)fs.cookie));
+    decode_flow_builder_match(fs.match, flow);
+    if (!decode_flow_builder_actions(fs.ofpacts, fs.ofpacts_len, flow) || !flow.valid()) {
+        return false;
+    }
+
+    struct match match;
+    fill_flow_builder_match(flow, match);
+    if (!match_equal(&match, &fs.match)) {
+        return false;
+    }
+
+    // compared as they go on the wire, ovs decodes some actions into
+    // other ofpacts than the ones they were encoded from
+    uint64_t ofpacts_stub[1024 / 8];
+    struct ofpbuf ofpacts;
+    ofpbuf_use_stub(&ofpacts, ofpacts_stub, sizeof(ofpacts_stub));
+    put_flow_builder_actions(flow, &ofpacts);
+
+    struct ofpbuf* expected = ofpbuf_new(256);
+    struct ofpbuf* actual = ofpbuf_new(256);
+    encode_instructions(fs.ofpacts, fs.ofpacts_len, expected);
+    encode_instructions(static_cast<const struct ofpact*>(ofpacts.data), ofpacts.size, actual);
+    bool same = expected->size == actual->size &&
+                memcmp(expected->data, actual->data, actual->size) == 0;
+
+    ofpbuf_delete(expected);
+    ofpbuf_delete(actual);
+    ofpbuf_uninit(&ofpacts);
+    return same;
+}
+
+// strict delete of exactly the flow of a flow stats entry, its cookie included
+static ofmsg_ptr_t create_del_flow(const struct ofputil_flow_stats& fs) {
+    struct ofputil_flow_mod fm;
+    memset(&fm, 0, sizeof(fm));
+    fm.command = OFPFC_DELETE_STRICT;
+    fm.priority = fs.priority;
+    fm.table_id = fs.table_id;
+    fm.cookie = fs.cookie;
+    fm.cookie_mask = (ovs_be64)UINT64_MAX;
+    fm.buffer_id = UINT32_MAX;
+    fm.out_port = OFPP_ANY;
+    fm.out_group = OFPG_ANY;
+    set_flow_mod_match(fm.match, fs.match);
+
+    auto buf = ofputil_encode_flow_mod(&fm, DEFAULT_OF_VERSION);
+    destroy_flow_mod_match(fm.match);
+    ofmsg_ptr_t flow_mod = std::make_shared<EncodedFlowModMessage>(buf);
+    ofpbuf_delete(buf);
+    return flow_mod;
+}
+
 ofbuf_ptr_t BundleFlowModMessage::pack_open_req() {
     struct ofputil_bundle_ctrl_msg bundle_ctrl;
     // needs to handshake OFPBCT_OPEN_REQUEST first for ovs to get ready for the following bundle
+    bundle_ctrl.bundle_id = _bundle_id;
     bundle_ctrl.type = OFPBCT_OPEN_REQUEST;
 
     // OFPBF_ORDERED ensures flows get programmed in order
@@ -196,11 +744,10 @@ ofbuf_ptr_t BundleFlowModMessage::pack_open_req() {
     bundle_ctrl.flags = OFPBF_ORDERED | OFPBF_ATOMIC;
     auto buf = ofputil_encode_bundle_ctrl_request(ofputil_protocol_to_ofp_version(BUNDLE_OF_VERSION),
                                                   &bundle_ctrl);
+    // take the xid from the caller's sequence, an error to the request can be matched then
+    static_cast<struct ofp_header*>(buf->data)->xid = htonl(_fm_xid->fetch_add(1));
     ofpmsg_update_length(buf);
 
-    // save bundle_id for later use
-    _bundle_id = bundle_ctrl.bundle_id;
-
     return std::make_shared<OFPBuf>(buf);
 }
 
@@ -215,6 +762,8 @@ ofbuf_ptr_t BundleFlowModMessage::pack_commit_req() {
     bundle_ctrl.flags = OFPBF_ORDERED | OFPBF_ATOMIC;
     auto buf = ofputil_encode_bundle_ctrl_request(ofputil_protocol_to_ofp_version(BUNDLE_OF_VERSION),
                                                   &bundle_ctrl);
+    // from the caller's sequence as well, a failed commit is reported with this xid
+    static_cast<struct ofp_header*>(buf->data)->xid = htonl(_fm_xid->fetch_add(1));
     ofpmsg_update_length(buf);
 
     return std::make_shared<OFPBuf>(buf);
@@ -230,12 +779,16 @@ std::vector<ofbuf_ptr_t> BundleFlowModMessage::pack_flow_mods() {
         // by default keep flags consistent with BundleCtrlMessage
         bundle_flow_mod.flags = OFPBF_ORDERED | OFPBF_ATOMIC;
 
-        // input is std::shared_ptr<OFMessage> of_msg, but need to retrieve data from casting it to std::shared_ptr<FlowModMessage>
-        auto fm_msg = std::static_pointer_cast<FlowModMessage>(of_msg);
-        // each flow-mod has a unique xid
-        fm_msg->set_xid(_fm_xid->fetch_add(1));
+        // each flow-mod has a unique xid, flow strings and FlowBuilder flows
+        // can be mixed in a bundle
+        of_msg->set_xid(_fm_xid->fetch_add(1));
 
-        auto fm_buf = fm_msg->pack();
+        auto fm_buf = of_msg->pack();
+        if (!fm_buf) {
+            // the flow failed to parse and was logged, leave it out
+            ret_buf.emplace_back(nullptr);
+            continue;
+        }
         // ofputil_bundle_add_msg->msg is (ofpheader*)
         bundle_flow_mod.msg = static_cast<struct ofp_header*>(fm_buf->data());
 
@@ -248,12 +801,20 @@ std::vector<ofbuf_ptr_t> BundleFlowModMessage::pack_flow_mods() {
     return ret_buf;
 }
 
-void BundleReplyMessage::unpack(void* data) {
+bool BundleReplyMessage::unpack(void* data) {
+    enum ofptype type;
+    if (ofptype_decode(&type, (ofp_header *)data) != 0 || type != OFPTYPE_BUNDLE_CONTROL) {
+        return false;
+    }
+
     struct ofputil_bundle_ctrl_msg bundle_ctrl_reply;
-    ofputil_decode_bundle_ctrl((ofp_header *)data, &bundle_ctrl_reply);
+    if (ofputil_decode_bundle_ctrl((ofp_header *)data, &bundle_ctrl_reply) != 0) {
+        return false;
+    }
 
     _type = bundle_ctrl_reply.type;
     _bundle_id = bundle_ctrl_reply.bundle_id;
+    return true;
 }
 
 ofmsg_ptr_t create_add_flow(const std::string& flow, bool bundle) {
@@ -274,6 +835,44 @@ ofmsg_ptr_t create_del_flow(const std::string& flow, bool strict) {
     return std::make_shared<FlowModMessage>(op_type, flow);
 }
 
+ofmsg_ptr_t create_add_flow(const FlowBuilder& flow) {
+    return std::make_shared<TypedFlowModMessage>(ADD_FLOW, flow);
+}
+
+ofmsg_ptr_t create_mod_flow(const FlowBuilder& flow, bool strict) {
+    int op_type = strict ? MODIFY_FLOW_STRICT : MODIFY_FLOW;
+    return std::make_shared<TypedFlowModMessage>(op_type, flow);
+}
+
+ofmsg_ptr_t create_del_flow(const FlowBuilder& flow, bool strict) {
+    int op_type = strict ? DELETE_FLOW_STRICT : DELETE_FLOW;
+    return std::make_shared<TypedFlowModMessage>(op_type, flow);
+}
+
+ofmsg_ptr_t create_flow_mod(const std::string& flow, const std::string& action) {
+    if (action == "add") {
+        return create_add_flow(flow, false);
+    } else if (action == "mod") {
+        // --strict mod
+        return create_mod_flow(flow, true);
+    } else if (action == "del") {
+        // --strict del
+        return create_del_flow(flow, true);
+    }
+    return nullptr;
+}
+
+ofmsg_ptr_t create_flow_mod(const FlowBuilder& flow, const std::string& action) {
+    if (action == "add") {
+        return create_add_flow(flow);
+    } else if (action == "mod") {
+        return create_mod_flow(flow, true);
+    } else if (action == "del") {
+        return create_del_flow(flow, true);
+    }
+    return nullptr;
+}
+
 std::vector<ofmsg_ptr_t> create_add_flows(const std::vector<std::string>& flows) {
     std::vector<ofmsg_ptr_t> ret;
     for (const auto &flow : flows) {
@@ -283,6 +882,51 @@ std::vector<ofmsg_ptr_t> create_add_flows(const std::vector<std::string>& flows)
     return ret;
 }
 
+ofmsg_ptr_t create_flow_stats_request(uint64_t cookie, uint64_t cookie_mask) {
+    return std::make_shared<FlowStatsRequestMessage>(cookie, cookie_mask);
+}
+
+bool decode_flow_stats_reply(void* data, std::vector<DumpedFlow>& flows, bool& more) {
+    const struct ofp_header* oh = static_cast<const struct ofp_header*>(data);
+    enum ofptype type;
+    if (ofptype_decode(&type, oh) != 0 || type != OFPTYPE_FLOW_STATS_REPLY) {
+        return false;
+    }
+    more = ofpmp_more(oh);
+
+    struct ofpbuf msg = ofpbuf_const_initializer(data, ntohs(oh->length));
+    uint64_t ofpacts_stub[1024 / 8];
+    struct ofpbuf ofpacts;
+    ofpbuf_use_stub(&ofpacts, ofpacts_stub, sizeof(ofpacts_stub));
+
+    int error;
+    for (;;) {
+        struct ofputil_flow_stats fs;
+        error = ofputil_decode_flow_stats_reply(&fs, &msg, false, &ofpacts);
+        if (error) {
+            break;
+        }
+        // they expire on their own
+        if (fs.idle_timeout != 0 || fs.hard_timeout != 0) {
+            continue;
+        }
+
+        flows.emplace_back();
+        DumpedFlow& dumped = flows.back();
+        dumped.decoded = decode_flow_builder(fs, dumped.flow);
+        if (!dumped.decoded) {
+            dumped.delete_flow_mod = create_del_flow(fs);
+        }
+    }
+
+    ofpbuf_uninit(&ofpacts);
+    if (error != EOF) {
+        ACA_LOG_ERROR("OFMessage - failed to decode flow stats reply, error: %d\n", error);
+        return false;
+    }
+    return true;
+}
+
 ofbuf_ptr_t create_packet_out(const char* option) {
     enum ofputil_protocol usable_protocols;
     struct ofputil_packet_out po;
@@ -0,0 +1,287 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "of_send_queue.h"
+
+#include <chrono>
+
+static size_t round_up_power_of_2(size_t n) {
+    size_t p = 2;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+OFSendQueue::OFSendQueue(writev_fn_t writev,
+                         backlog_fn_t backlog,
+                         size_t capacity,
+                         size_t flush_bytes,
+                         uint64_t flush_us,
+                         size_t max_backlog,
+                         uint64_t send_timeout_ms) :
+        _writev(writev),
+        _backlog(backlog),
+        _mask(round_up_power_of_2(capacity) - 1),
+        _flush_bytes(flush_bytes == 0 ? 1 : flush_bytes),
+        _flush_us(flush_us),
+        _max_backlog(max_backlog),
+        _send_timeout_ms(send_timeout_ms),
+        _slots(new Slot[_mask + 1]),
+        _send_pos(0),
+        _active_senders(0),
+        _shutdown(false),
+        _finished(false),
+        _queued_bytes(0),
+        _flush_pos(0),
+        _flush_offset(0),
+        _room_waiters(0),
+        _writing(false),
+        _messages_sent(0),
+        _bytes_sent(0),
+        _writes(0),
+        _dropped(0),
+        _backpressure_waits(0),
+        _send_waits(0) {
+    for (size_t i = 0; i <= _mask; i++) {
+        _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    _flusher = std::thread(&OFSendQueue::_run, this);
+}
+
+OFSendQueue::~OFSendQueue() {
+    shutdown();
+    if (_flusher.joinable()) {
+        _flusher.join();
+    }
+}
+
+bool OFSendQueue::send(const void* data, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+
+    // the flusher frees the ring once no sender is past this check
+    _active_senders.fetch_add(1);
+    if (_shutdown.load()) {
+        _active_senders.fetch_sub(1);
+        _dropped++;
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_send_timeout_ms);
+    size_t pos = _send_pos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = _slots[pos & _mask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+        if (diff == 0) {
+            if (_send_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                const uint8_t* bytes = static_cast<const uint8_t*>(data);
+                slot.data.assign(bytes, bytes + len);
+                slot.seq.store(pos + 1, std::memory_order_release);
+                break;
+            }
+        } else if (diff < 0) {
+            // the ring is full, wait for the flusher to give slots back
+            std::unique_lock<std::mutex> lock(_mutex);
+            _send_waits++;
+            _room_waiters++;
+            bool has_room = _room_cv.wait_until(lock, deadline, [this] {
+                return _shutdown.load() || _has_room();
+            });
+            _room_waiters--;
+            if (!has_room || _shutdown.load()) {
+                lock.unlock();
+                _active_senders.fetch_sub(1);
+                _dropped++;
+                return false;
+            }
+            pos = _send_pos.load(std::memory_order_relaxed);
+        } else {
+            // another sender took the slot
+            pos = _send_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // wake up the flusher when the first message of a batch comes in, and
+    // when the batch is large enough to go
+    size_t queued = _queued_bytes.fetch_add(len);
+    if (queued == 0 || (queued < _flush_bytes && queued + len >= _flush_bytes)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _flusher_cv.notify_one();
+    }
+    _active_senders.fetch_sub(1);
+    return true;
+}
+
+void OFSendQueue::shutdown() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _shutdown.store(true);
+    _flusher_cv.notify_all();
+    _room_cv.notify_all();
+
+    // the flusher checks the shutdown before each write, under _mutex
+    _writing_cv.wait(lock, [this] { return !_writing; });
+}
+
+bool OFSendQueue::_begin_write() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_shutdown.load()) {
+        return false;
+    }
+    _writing = true;
+    return true;
+}
+
+void OFSendQueue::_end_write() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _writing = false;
+    _writing_cv.notify_all();
+}
+
+bool OFSendQueue::_has_room() {
+    size_t pos = _send_pos.load(std::memory_order_relaxed);
+    return _slots[pos & _mask].seq.load(std::memory_order_acquire) == pos;
+}
+
+void OFSendQueue::_run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _flusher_cv.wait(lock, [this] {
+            return _shutdown.load() || _queued_bytes.load() > 0;
+        });
+        if (_shutdown.load()) {
+            break;
+        }
+
+        // let the batch fill up, unless it is large enough already
+        _flusher_cv.wait_for(lock, std::chrono::microseconds(_flush_us), [this] {
+            return _shutdown.load() || _queued_bytes.load() >= _flush_bytes;
+        });
+
+        lock.unlock();
+        _flush();
+        lock.lock();
+    }
+    lock.unlock();
+
+    // the connection may be closed already, what is left is dropped below,
+    // no sender touches the ring anymore once they are all out of send()
+    while (_active_senders.load() > 0) {
+        std::this_thread::yield();
+    }
+    size_t pos = _flush_pos;
+    while (_slots[pos & _mask].seq.load(std::memory_order_acquire) == pos + 1) {
+        _dropped++;
+        pos++;
+    }
+    _slots.reset();
+    _finished.store(true);
+}
+
+void OFSendQueue::_flush() {
+    struct iovec iov[OF_SEND_QUEUE_MAX_IOV];
+
+    while (true) {
+        // gather the published messages, in the order they were queued
+        int iovcnt = 0;
+        size_t batch_len = 0;
+        size_t pos = _flush_pos;
+        while (iovcnt < OF_SEND_QUEUE_MAX_IOV) {
+            Slot& slot = _slots[pos & _mask];
+            if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+            size_t offset = iovcnt == 0 ? _flush_offset : 0;
+            iov[iovcnt].iov_base = slot.data.data() + offset;
+            iov[iovcnt].iov_len = slot.data.size() - offset;
+            batch_len += iov[iovcnt].iov_len;
+            iovcnt++;
+            pos++;
+        }
+        if (iovcnt == 0) {
+            return;
+        }
+
+        if (!_begin_write()) {
+            return;
+        }
+        if (_backlog && _backlog() > _max_backlog) {
+            _end_write();
+            if (!_wait_for_socket()) {
+                return;
+            }
+            continue;
+        }
+
+        ssize_t written = _writev(iov, iovcnt);
+        _end_write();
+        if (written < 0) {
+            // the connection is gone, the batch is lost
+            _dropped += _release(batch_len);
+            continue;
+        }
+        if (written == 0) {
+            if (!_wait_for_socket()) {
+                return;
+            }
+            continue;
+        }
+
+        _writes++;
+        _bytes_sent += written;
+        _messages_sent += _release(written);
+    }
+}
+
+size_t OFSendQueue::_release(size_t len) {
+    size_t released = 0;
+    while (len > 0) {
+        Slot& slot = _slots[_flush_pos & _mask];
+        size_t left = slot.data.size() - _flush_offset;
+
+        if (len < left) {
+            // the socket took part of this message, the rest goes with the next write
+            _flush_offset += len;
+            break;
+        }
+        len -= left;
+        _flush_offset = 0;
+        released++;
+        _queued_bytes.fetch_sub(slot.data.size());
+        if (slot.data.capacity() > OF_SEND_QUEUE_SLOT_RETAIN_BYTES) {
+            std::vector<uint8_t>().swap(slot.data);
+        }
+        slot.seq.store(_flush_pos + _mask + 1, std::memory_order_release);
+        _flush_pos++;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_room_waiters > 0) {
+        _room_cv.notify_all();
+    }
+    return released;
+}
+
+bool OFSendQueue::_wait_for_socket() {
+    _backpressure_waits++;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _flusher_cv.wait_for(lock, std::chrono::microseconds(_flush_us == 0 ? 1 : _flush_us), [this] {
+        return _shutdown.load();
+    });
+    return !_shutdown.load();
+}
@@ -0,0 +1,108 @@
+// MIT License
+// Copyright(c) 2020 Futurewei Cloud
+//
+//     Permission is hereby granted,
+//     free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction,
+//     including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of the Software, and to permit persons
+//     to whom the Software is furnished to do so, subject to the following conditions:
+//
+//     The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+//     THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "aca_zeta_oam_path_cache.h"
+#include "aca_config.h"
+#include <atomic>
+
+extern std::atomic_ulong g_total_oam_direct_paths_expired;
+
+namespace aca_zeta_oam_server
+{
+ACA_Zeta_Oam_Path_Cache &ACA_Zeta_Oam_Path_Cache::get_instance()
+{
+  // Instance is destroyed when program exits.
+  // It is instantiated on first use.
+  static ACA_Zeta_Oam_Path_Cache instance(ZETA_OAM_PATH_CACHE_MAX_SIZE);
+  return instance;
+}
+
+ACA_Zeta_Oam_Path_Cache::ACA_Zeta_Oam_Path_Cache(size_t max_entries)
+        : _max_entries(max_entries == 0 ? 1 : max_entries)
+{
+}
+
+bool ACA_Zeta_Oam_Path_Cache::contains(const std::string &match,
+                                       const std::string &flow, time_point now)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _expire(now);
+
+  auto found = _entries.find(match);
+  return found != _entries.end() && found->second.flow == flow;
+}
+
+void ACA_Zeta_Oam_Path_Cache::add(const std::string &match, const std::string &flow,
+                                  uint16_t idle_timeout, time_point now)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _expire(now);
+
+  auto found = _entries.find(match);
+  if (found != _entries.end()) {
+    // the flow of the match was replaced on the switch
+    _expire_order.erase(found->second.order);
+    _entries.erase(found);
+  }
+  if (idle_timeout == 0) {
+    return;
+  }
+
+  if (_entries.size() >= _max_entries) {
+    // the entry closest to its expiration makes room
+    _entries.erase(_expire_order.begin()->second);
+    _expire_order.erase(_expire_order.begin());
+  }
+
+  Entry &entry = _entries[match];
+  entry.flow = flow;
+  entry.order = _expire_order.emplace(now + std::chrono::seconds(idle_timeout), match);
+}
+
+bool ACA_Zeta_Oam_Path_Cache::invalidate(const std::string &match)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto found = _entries.find(match);
+  if (found == _entries.end()) {
+    return false;
+  }
+  _expire_order.erase(found->second.order);
+  _entries.erase(found);
+  return true;
+}
+
+size_t ACA_Zeta_Oam_Path_Cache::size()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _entries.size();
+}
+
+void ACA_Zeta_Oam_Path_Cache::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _expire_order.clear();
+}
+
+void ACA_Zeta_Oam_Path_Cache::_expire(time_point now)
+{
+  while (!_expire_order.empty() && _expire_order.begin()->first <= now) {
+    _entries.erase(_expire_order.begin()->second);
+    _expire_order.erase(_expire_order.begin());
+    g_total_oam_direct_paths_expired++;
+  }
+}
+} // namespace aca_zeta_oam_server
@@ -28,10 +28,17 @@
 #undef ARRAY_SIZE
 #undef ROUND_UP
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_shadow.h"
+#include "aca_zeta_oam_path_cache.h"
+#include "aca_config.h"
 //#include "aca_ovs_control.h"
 
 using namespace std;
 //using namespace aca_ovs_control;
+using aca_ovs_l2_programmer::ACA_OVS_Flow_Shadow;
+
+extern std::atomic_ulong g_total_oam_direct_paths_injected;
+extern std::atomic_ulong g_total_oam_direct_paths_suppressed;
 
 namespace aca_zeta_oam_server
 {
@@ -249,43 +256,89 @@ void ACA_Zeta_Oam_Server::_parse_oam_none(uint /* in_port */, oam_message *oamms
   return;
 }
 
-int ACA_Zeta_Oam_Server::_add_direct_path(oam_match match, oam_action action)
+// table, priority and match of the direct path flow of a 5-tuple
+FlowBuilder ACA_Zeta_Oam_Server::_get_direct_path_flow(const oam_match &match)
 {
-  unsigned long not_care_culminative_time;
-  int overall_rc = EXIT_SUCCESS;
+  uint vlan_id =
+          aca_vlan_manager::ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(match.vni);
+  uint16_t sport = (uint16_t)strtoul(match.sport.c_str(), nullptr, 10);
+  uint16_t dport = (uint16_t)strtoul(match.dport.c_str(), nullptr, 10);
+
+  FlowBuilder flow = FlowBuilder()
+                             .table(20)
+                             .priority(50)
+                             .ip()
+                             .nw_proto((uint8_t)strtoul(match.proto.c_str(), nullptr, 10))
+                             .nw_src(match.sip)
+                             .nw_dst(match.dip);
+  // a port 0 is a wildcard
+  if (sport != 0) {
+    flow.tp_src(sport);
+  }
+  if (dport != 0) {
+    flow.tp_dst(dport);
+  }
+  flow.dl_vlan(vlan_id);
 
-  string vlan_id = to_string(aca_vlan_manager::ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(
-          match.vni));
+  return flow;
+}
 
-  string source_port_cmd = "";
+// send a direct path flow-mod to br-tun and wait for its answer
+int ACA_Zeta_Oam_Server::_execute_direct_path_flow(ofmsg_ptr_t flow_mod)
+{
+  unsigned long not_care_culminative_time;
+  auto completion = std::make_shared<FlowCompletion>(1);
 
-  string destination_port_cmd = "";
+  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_bundle(
+          not_care_culminative_time, "br-tun", { flow_mod }, completion);
+  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_barrier(
+          "br-tun", completion);
 
-  if (match.sport != "0") {
-    destination_port_cmd = ",tp_src=" + match.sport;
+  if (!completion->wait_for(std::chrono::microseconds(OVS_FLOW_COMPLETION_TIMEOUT_IN_MICROSECONDS))) {
+    ACA_LOG_ERROR("%s", "Direct path flow not answered in time\n");
+    return -ETIMEDOUT;
   }
-
-  if (match.dport != "0") {
-    source_port_cmd = ",tp_dst=" + match.dport;
+  if (completion->failed() > 0) {
+    ACA_LOG_ERROR("Direct path flow failed with error 0x%x\n", completion->error(0));
+    return EXIT_FAILURE;
   }
+  return EXIT_SUCCESS;
+}
 
-  string cmd_match = "ip,nw_proto=" + match.proto + ",nw_src=" + match.sip +
-                     ",nw_dst=" + match.dip + source_port_cmd +
-                     destination_port_cmd + ",dl_vlan=" + vlan_id;
-  string cmd_action = ",actions=\"strip_vlan,load:" + to_string(match.vni) +
-                      "->NXM_NX_TUN_ID[],set_field:" + action.node_nw_dst +
-                      "->tun_dst,mod_dl_dst=" + action.inst_dl_dst +
-                      ",mod_nw_dst=" + action.inst_nw_dst + ",output:vxlan-generic\"";
+int ACA_Zeta_Oam_Server::_add_direct_path(oam_match match, oam_action action)
+{
+  int overall_rc = EXIT_SUCCESS;
+  uint16_t idle_timeout = (uint16_t)strtoul(action.idle_timeout.c_str(), nullptr, 10);
 
   // Adding unicast rules in table20
-  string opt = "add-flow br-tun table=20,priority=50,idle_timeout=" + action.idle_timeout +
-               "," + cmd_match + cmd_action;
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          opt, not_care_culminative_time, overall_rc);
+  FlowBuilder flow = _get_direct_path_flow(match);
+  flow.idle_timeout(idle_timeout)
+          .strip_vlan()
+          .load_tun_id(match.vni)
+          .set_tun_dst(action.node_nw_dst)
+          .mod_dl_dst(action.inst_dl_dst)
+          .mod_nw_dst(action.inst_nw_dst)
+          .output(VXLAN_GENERIC_OUTPORT_NUMBER);
+
+  // the same injection again while the flow can't have expired
+  string flow_match = flow.match_string();
+  string flow_string = flow.to_string();
+  if (ACA_Zeta_Oam_Path_Cache::get_instance().contains(flow_match, flow_string)) {
+    g_total_oam_direct_paths_suppressed++;
+    ACA_LOG_DEBUG("Direct path already programmed: %s\n", flow_string.c_str());
+    return EXIT_SUCCESS;
+  }
+
+  overall_rc = _execute_direct_path_flow(
+          create_add_flow(ACA_OVS_Flow_Shadow::get_instance().tag(flow)));
 
   if (overall_rc == EXIT_SUCCESS) {
+    g_total_oam_direct_paths_injected++;
+    ACA_Zeta_Oam_Path_Cache::get_instance().add(flow_match, flow_string, idle_timeout);
     ACA_LOG_INFO("%s", "Add direct path succeeded!\n");
   } else {
+    // whatever the switch has for the match now, it is not the flow remembered
+    ACA_Zeta_Oam_Path_Cache::get_instance().invalidate(flow_match);
     ACA_LOG_ERROR("Add direct path failed!!! overrall_rc: %d\n", overall_rc);
   }
 
@@ -294,18 +347,13 @@ int ACA_Zeta_Oam_Server::_add_direct_path(oam_match match, oam_action action)
 
 int ACA_Zeta_Oam_Server::_del_direct_path(oam_match match)
 {
-  unsigned long not_care_culminative_time;
   int overall_rc;
-  string vlan_id = to_string(aca_vlan_manager::ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(
-          match.vni));
+  FlowBuilder flow = _get_direct_path_flow(match);
 
-  string opt = "del-flows br-tun \"table=20,priority=50,ip,nw_proto=" + match.proto +
-               ",nw_src=" + match.sip + ",nw_dst=" + match.dip +
-               ",tp_src=" + match.sport + ",tp_dst=" + match.dport + ",dl_vlan=" + vlan_id + "\" --strict";
+  ACA_Zeta_Oam_Path_Cache::get_instance().invalidate(flow.match_string());
 
   // delete flow
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          opt, not_care_culminative_time, overall_rc);
+  overall_rc = _execute_direct_path_flow(create_del_flow(flow, true));
 
   if (overall_rc == EXIT_SUCCESS) {
     ACA_LOG_INFO("%s", "Delete direct path succeeded!\n");
@@ -20,13 +20,17 @@
 #include "aca_ovs_control.h"
 #include "aca_on_demand_engine.h"
 #include "aca_zeta_oam_server.h"
+#include "aca_command_executor.h"
+#include "aca_config.h"
 #include <thread>
+#include <unordered_set>
 
 using namespace alcor::schema;
 using namespace aca_ovs_control;
 using namespace aca_vlan_manager;
 using namespace aca_ovs_l2_programmer;
 using namespace aca_on_demand_engine;
+using aca_net_config::Aca_Command_Executor;
 
 namespace aca_zeta_programming
 {
@@ -39,6 +43,16 @@ ACA_Zeta_Programming::~ACA_Zeta_Programming()
   clear_all_data();
 }
 
+// the bucket of a fwd, like
+// bucket="set_field:<ip>->tun_dst,mod_dl_dst:<mac>,output:vxlan-generic"
+static GroupBucket zeta_bucket(uint32_t bucket_id, const FWD_Info &fwd)
+{
+  return GroupBucket(bucket_id, FlowBuilder()
+                                        .set_tun_dst(fwd.ip_addr)
+                                        .mod_dl_dst(fwd.mac_addr)
+                                        .output(VXLAN_GENERIC_OUTPORT_NUMBER));
+}
+
 ACA_Zeta_Programming &ACA_Zeta_Programming::get_instance()
 {
   static ACA_Zeta_Programming instance;
@@ -58,11 +72,15 @@ void ACA_Zeta_Programming::create_entry(string zeta_gateway_id, uint oam_port,
   // CPU architecture can take advantage of it
   new_zeta_cfg->group_id =
           current_available_group_id.fetch_add(1, std::memory_order_relaxed);
+  new_zeta_cfg->next_bucket_id = 0;
 
   // fill in the ip_address and mac_address of fwds
   for (auto destination : current_AuxGateway.destinations()) {
     FWD_Info new_fwd(destination.ip_address(), destination.mac_address());
-    new_zeta_cfg->zeta_buckets.insert(new_fwd, nullptr);
+    uint32_t *bucket_id = nullptr;
+    if (!new_zeta_cfg->zeta_buckets.find(new_fwd, bucket_id)) {
+      new_zeta_cfg->zeta_buckets.insert(new_fwd, new uint32_t(new_zeta_cfg->next_bucket_id++));
+    }
   }
 
   _zeta_config_table.insert(zeta_gateway_id, new_zeta_cfg);
@@ -91,12 +109,13 @@ int ACA_Zeta_Programming::_create_group_punt_rule(uint tunnel_id, uint group_id)
 
   uint vlan_id = ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(tunnel_id);
 
-  string opt = "add-flow br-tun table=22,priority=50,dl_vlan=" + to_string(vlan_id) +
-               ",actions=\"strip_vlan,load:" + to_string(tunnel_id) +
-               "->NXM_NX_TUN_ID[],group:" + to_string(group_id) + "\"";
+  string opt = "table=22,priority=50,dl_vlan=" + to_string(vlan_id) +
+               ",actions=strip_vlan,load:" + to_string(tunnel_id) +
+               "->NXM_NX_TUN_ID[],group:" + to_string(group_id);
 
-  ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          opt, not_care_culminative_time, overall_rc);
+  // goes into the flow bundle of the goal state, if any
+  ACA_OVS_L2_Programmer::get_instance().execute_openflow(not_care_culminative_time,
+                                                         "br-tun", opt, "add");
 
   if (overall_rc == EXIT_SUCCESS) {
     ACA_LOG_INFO("%s", "_create_group_punt_rule succeeded!\n");
@@ -112,12 +131,14 @@ int ACA_Zeta_Programming::_create_group_punt_rule(uint tunnel_id, uint group_id)
 int ACA_Zeta_Programming::_delete_group_punt_rule(uint tunnel_id)
 {
   ACA_LOG_DEBUG("%s", "ACA_Zeta_Programming::_delete_group_punt_rule ---> Entering\n");
-  int overall_rc;
+  unsigned long not_care_culminative_time;
+  int overall_rc = EXIT_SUCCESS;
 
   uint vlan_id = ACA_Vlan_Manager::get_instance().get_or_create_vlan_id(tunnel_id);
   string opt = "table=22,priority=50,dl_vlan=" + to_string(vlan_id);
 
-  overall_rc = ACA_OVS_Control::get_instance().del_flows("br-tun", opt.c_str());
+  ACA_OVS_L2_Programmer::get_instance().execute_openflow(not_care_culminative_time,
+                                                         "br-tun", opt, "del");
 
   if (overall_rc == EXIT_SUCCESS) {
     ACA_LOG_INFO("%s", "_delete_group_punt_rule succeeded!\n");
@@ -190,8 +211,6 @@ int ACA_Zeta_Programming::create_zeta_config(const alcor::schema::GatewayConfigu
   ACA_LOG_DEBUG("%s", "ACA_Zeta_Programming::create_zeta_config ---> Entering\n");
   int overall_rc = EXIT_SUCCESS;
   zeta_config *current_zeta_cfg;
-  bool bucket_not_found = false;
-  CTSL::HashMap<FWD_Info, int *, FWD_Info_Hash> new_zeta_buckets;
 
   uint oam_port = current_AuxGateway.zeta_info().port_inband_operation();
 
@@ -209,31 +228,38 @@ int ACA_Zeta_Programming::create_zeta_config(const alcor::schema::GatewayConfigu
     oam_port_listener_thread->detach();
     ACA_LOG_INFO("Created thread for port %d and it is detached.\n", oam_port);
   } else {
+    std::unordered_set<FWD_Info, FWD_Info_Hash> destinations;
+    vector<FWD_Info> added_fwds;
+    vector<FWD_Info> removed_fwds;
+
     for (auto destination : current_AuxGateway.destinations()) {
       FWD_Info target_fwd(destination.ip_address(), destination.mac_address());
+      uint32_t *bucket_id = nullptr;
 
-      int *not_used = nullptr;
-
-      if (current_zeta_cfg->zeta_buckets.find(target_fwd, not_used)) {
-        continue;
-      } else {
-        bucket_not_found |= true;
-        break;
+      if (destinations.insert(target_fwd).second &&
+          !current_zeta_cfg->zeta_buckets.find(target_fwd, bucket_id)) {
+        added_fwds.push_back(target_fwd);
       }
-      new_zeta_buckets.insert(target_fwd, nullptr);
     }
 
-    // If the buckets have changed, update the buckets and group table rules.
-    if (bucket_not_found == true) {
-      current_zeta_cfg->zeta_buckets.clear();
-      for (auto destination : current_AuxGateway.destinations()) {
-        FWD_Info target_fwd =
-                FWD_Info(destination.ip_address(), destination.mac_address());
+    // the fwds which left the gateway
+    for (size_t i = 0; i < current_zeta_cfg->zeta_buckets.hashSize; i++) {
+      //-----Start share lock to enable mutiple concurrent reads-----
+      std::shared_lock<std::shared_timed_mutex> hash_bucket_lock(
+              (current_zeta_cfg->zeta_buckets.hashTable[i]).mutex_);
 
-        current_zeta_cfg->zeta_buckets.insert(target_fwd, nullptr);
+      for (auto hash_node = current_zeta_cfg->zeta_buckets.hashTable[i].head;
+           hash_node != nullptr; hash_node = hash_node->next) {
+        if (destinations.find(hash_node->getKey()) == destinations.end()) {
+          removed_fwds.push_back(hash_node->getKey());
+        }
       }
+      //-----End share lock to enable mutiple concurrent reads-----
+    }
 
-      overall_rc = _update_zeta_group_entry(current_zeta_cfg);
+    // If the buckets have changed, update the buckets and group table rules.
+    if (!added_fwds.empty() || !removed_fwds.empty()) {
+      overall_rc = _update_zeta_group_entry(current_zeta_cfg, added_fwds, removed_fwds);
     }
   }
   _zeta_config_table_mutex.unlock();
@@ -302,11 +328,9 @@ int ACA_Zeta_Programming::delete_zeta_config(const alcor::schema::GatewayConfigu
 int ACA_Zeta_Programming::_create_zeta_group_entry(zeta_config *zeta_cfg)
 {
   ACA_LOG_DEBUG("%s", "ACA_Zeta_Programming::_create_zeta_group_entry ---> Entering\n");
-  unsigned long not_care_culminative_time;
   int overall_rc = EXIT_SUCCESS;
-  // adding group table rule
-  string cmd = "-O OpenFlow13 add-group br-tun group_id=" + to_string(zeta_cfg->group_id) +
-               ",type=select";
+  std::vector<GroupBucket> buckets;
+  std::vector<string> static_arp_strings;
 
   for (size_t i = 0; i < zeta_cfg->zeta_buckets.hashSize; i++) {
     auto hash_node = zeta_cfg->zeta_buckets.hashTable[i].head;
@@ -319,15 +343,11 @@ int ACA_Zeta_Programming::_create_zeta_group_entry(zeta_config *zeta_cfg)
 
       while (hash_node != nullptr) {
         // add the static arp entries
-        string static_arp_string = "arp -s " + hash_node->getKey().ip_addr +
-                                   " " + hash_node->getKey().mac_addr;
-
-        aca_net_config::Aca_Net_Config::get_instance().execute_system_command(static_arp_string);
+        static_arp_strings.push_back("arp -s " + hash_node->getKey().ip_addr +
+                                     " " + hash_node->getKey().mac_addr);
 
         // fill zeta_gws
-        cmd += ",bucket=\"set_field:" + hash_node->getKey().ip_addr +
-               "->tun_dst,mod_dl_dst:" + hash_node->getKey().mac_addr +
-               ",output:vxlan-generic\"";
+        buckets.push_back(zeta_bucket(*hash_node->getValue(), hash_node->getKey()));
         hash_node = hash_node->next;
       }
       hash_bucket_lock.unlock();
@@ -335,11 +355,14 @@ int ACA_Zeta_Programming::_create_zeta_group_entry(zeta_config *zeta_cfg)
     }
   }
 
+  // the arp entries are added side by side, before the buckets using them,
+  // the worker is kept as _zeta_config_table_mutex is held
+  Aca_Command_Executor::get_instance().execute_blocking(static_arp_strings);
+
   //-----Start unique lock-----
   std::unique_lock<std::timed_mutex> group_entry_lock(_group_operation_mutex);
   // add group table rule
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          cmd, not_care_culminative_time, overall_rc);
+  overall_rc = _execute_group_mod(GROUP_MOD_ADD, zeta_cfg->group_id, buckets);
   group_entry_lock.unlock();
   //-----End unique lock-----
 
@@ -354,51 +377,59 @@ int ACA_Zeta_Programming::_create_zeta_group_entry(zeta_config *zeta_cfg)
   return overall_rc;
 }
 
-int ACA_Zeta_Programming::_update_zeta_group_entry(zeta_config *zeta_cfg)
+int ACA_Zeta_Programming::_update_zeta_group_entry(zeta_config *zeta_cfg,
+                                                   const vector<FWD_Info> &added_fwds,
+                                                   const vector<FWD_Info> &removed_fwds)
 {
   ACA_LOG_DEBUG("%s", "ACA_Zeta_Programming::_update_zeta_group_entry ---> Entering\n");
-  unsigned long not_care_culminative_time;
   int overall_rc = EXIT_SUCCESS;
-  // adding group table rule
-  string cmd = "-O OpenFlow13 mod-group br-tun group_id=" + to_string(zeta_cfg->group_id) +
-               ",type=select";
-
-  for (size_t i = 0; i < zeta_cfg->zeta_buckets.hashSize; i++) {
-    auto hash_node = zeta_cfg->zeta_buckets.hashTable[i].head;
-    if (hash_node == nullptr) {
-      continue;
-    } else {
-      //-----Start share lock to enable mutiple concurrent reads-----
-      std::shared_lock<std::shared_timed_mutex> hash_bucket_lock(
-              (zeta_cfg->zeta_buckets.hashTable[i]).mutex_);
-
-      while (hash_node != nullptr) {
-        // add the static arp entries
-        string static_arp_string = "arp -s " + hash_node->getKey().ip_addr +
-                                   " " + hash_node->getKey().mac_addr;
-
-        aca_net_config::Aca_Net_Config::get_instance().execute_system_command(static_arp_string);
+  std::vector<GroupBucket> added_buckets;
+  std::vector<GroupBucket> removed_buckets;
+  std::vector<string> static_arp_add_strings;
+  std::vector<string> static_arp_delete_strings;
+
+  for (auto &fwd : added_fwds) {
+    uint32_t bucket_id = zeta_cfg->next_bucket_id++;
+    zeta_cfg->zeta_buckets.insert(fwd, new uint32_t(bucket_id));
+    added_buckets.push_back(zeta_bucket(bucket_id, fwd));
+    static_arp_add_strings.push_back("arp -s " + fwd.ip_addr + " " + fwd.mac_addr);
+  }
 
-        cmd += ",bucket=\"set_field:" + hash_node->getKey().ip_addr +
-               "->tun_dst,mod_dl_dst:" + hash_node->getKey().mac_addr +
-               ",output:vxlan-generic\"";
-        hash_node = hash_node->next;
-      }
-      hash_bucket_lock.unlock();
-      //-----End share lock to enable mutiple concurrent reads-----
+  for (auto &fwd : removed_fwds) {
+    uint32_t *bucket_id = nullptr;
+    if (zeta_cfg->zeta_buckets.find(fwd, bucket_id)) {
+      // a remove only needs the id of the bucket
+      removed_buckets.push_back(GroupBucket(*bucket_id, FlowBuilder()));
+      zeta_cfg->zeta_buckets.erase(fwd);
+      static_arp_delete_strings.push_back("arp -d " + fwd.ip_addr);
     }
   }
 
+  // the arp entries are added side by side, before the buckets using them,
+  // the worker is kept as _zeta_config_table_mutex is held
+  Aca_Command_Executor::get_instance().execute_blocking(static_arp_add_strings);
+
   //-----Start unique lock-----
   std::unique_lock<std::timed_mutex> group_entry_lock(_group_operation_mutex);
-  // add group table rule
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          cmd, not_care_culminative_time, overall_rc);
+  // only the buckets changed go to the switch
+  if (!added_buckets.empty()) {
+    overall_rc = _execute_group_mod(GROUP_MOD_INSERT_BUCKET, zeta_cfg->group_id, added_buckets);
+  }
+  if (!removed_buckets.empty()) {
+    int rc = _execute_group_mod(GROUP_MOD_REMOVE_BUCKET, zeta_cfg->group_id, removed_buckets);
+    if (overall_rc == EXIT_SUCCESS) {
+      overall_rc = rc;
+    }
+  }
   group_entry_lock.unlock();
   //-----End unique lock-----
 
+  // and deleted once no bucket uses them
+  Aca_Command_Executor::get_instance().execute_blocking(static_arp_delete_strings);
+
   if (overall_rc == EXIT_SUCCESS) {
-    ACA_LOG_INFO("%s", "update_zeta_group_entry succeeded!\n");
+    ACA_LOG_INFO("update_zeta_group_entry succeeded, %lu buckets inserted and %lu removed!\n",
+                 added_buckets.size(), removed_buckets.size());
   } else {
     ACA_LOG_ERROR("update_zeta_group_entry failed!!! overrall_rc: %d\n", overall_rc);
   }
@@ -411,14 +442,14 @@ int ACA_Zeta_Programming::_update_zeta_group_entry(zeta_config *zeta_cfg)
 int ACA_Zeta_Programming::_delete_zeta_group_entry(zeta_config *zeta_cfg)
 {
   ACA_LOG_DEBUG("%s", "ACA_Zeta_Programming::_delete_zeta_group_entry ---> Entering\n");
-  unsigned long not_care_culminative_time;
   int overall_rc = EXIT_SUCCESS;
 
   // delete group table rule
-  string cmd = "-O OpenFlow13 del-groups br-tun group_id=" + to_string(zeta_cfg->group_id);
-
-  aca_ovs_l2_programmer::ACA_OVS_L2_Programmer::get_instance().execute_openflow_command(
-          cmd, not_care_culminative_time, overall_rc);
+  //-----Start unique lock-----
+  std::unique_lock<std::timed_mutex> group_entry_lock(_group_operation_mutex);
+  overall_rc = _execute_group_mod(GROUP_MOD_DELETE, zeta_cfg->group_id, {});
+  group_entry_lock.unlock();
+  //-----End unique lock-----
 
   if (overall_rc == EXIT_SUCCESS) {
     ACA_LOG_INFO("%s", "delete_zeta_group_entry succeeded!\n");
@@ -426,6 +457,7 @@ int ACA_Zeta_Programming::_delete_zeta_group_entry(zeta_config *zeta_cfg)
     ACA_LOG_ERROR("delete_zeta_group_entry failed!!! overrall_rc: %d\n", overall_rc);
   }
 
+  std::vector<string> static_arp_strings;
   for (size_t i = 0; i < zeta_cfg->zeta_buckets.hashSize; i++) {
     auto hash_node = zeta_cfg->zeta_buckets.hashTable[i].head;
     if (hash_node == nullptr) {
@@ -437,8 +469,7 @@ int ACA_Zeta_Programming::_delete_zeta_group_entry(zeta_config *zeta_cfg)
 
       while (hash_node != nullptr) {
         // delete the static arp entries
-        string static_arp_string = "arp -d " + hash_node->getKey().ip_addr;
-        aca_net_config::Aca_Net_Config::get_instance().execute_system_command(static_arp_string);
+        static_arp_strings.push_back("arp -d " + hash_node->getKey().ip_addr);
         hash_node = hash_node->next;
       }
       hash_bucket_lock.unlock();
@@ -446,11 +477,37 @@ int ACA_Zeta_Programming::_delete_zeta_group_entry(zeta_config *zeta_cfg)
     }
   }
 
+  Aca_Command_Executor::get_instance().execute_blocking(static_arp_strings);
+
   ACA_LOG_DEBUG("ACA_Zeta_Programming::_delete_zeta_group_entry <--- Exiting, overall_rc = %d\n",
                 overall_rc);
   return overall_rc;
 }
 
+int ACA_Zeta_Programming::_execute_group_mod(group_mod_command command, uint group_id,
+                                             const std::vector<GroupBucket> &buckets)
+{
+  unsigned long not_care_culminative_time;
+  auto completion = std::make_shared<FlowCompletion>(1);
+
+  ACA_OVS_L2_Programmer::get_instance().execute_openflow_group_mod(
+          not_care_culminative_time, "br-tun", command, group_id, OF_GROUP_TYPE_SELECT,
+          buckets, completion);
+  // an error to the group-mod comes back before the barrier reply
+  ACA_OVS_L2_Programmer::get_instance().execute_openflow_barrier("br-tun", completion);
+
+  if (!completion->wait_for(std::chrono::microseconds(OVS_FLOW_COMPLETION_TIMEOUT_IN_MICROSECONDS))) {
+    ACA_LOG_ERROR("group-mod %d of group %u not answered in time\n", command, group_id);
+    return -ETIMEDOUT;
+  }
+  if (completion->failed() > 0) {
+    ACA_LOG_ERROR("group-mod %d of group %u failed with error 0x%x\n", command, group_id,
+                  completion->error(0));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
 // Determine whether the group table rule already exists?
 bool ACA_Zeta_Programming::group_rule_exists(uint group_id)
 {
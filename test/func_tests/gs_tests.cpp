@@ -15,6 +15,7 @@
 // c includes
 #include "aca_log.h"
 #include "aca_util.h"
+#include "aca_config.h"
 #include "aca_comm_mgr.h"
 #include "aca_grpc.h"
 #include "aca_grpc_client.h"
@@ -77,6 +78,51 @@ std::atomic_ulong g_total_execute_openflow_time(0);
 std::atomic_ulong g_total_vpcs_table_mutex_time(0);
 // total time for goal state update in microseconds
 std::atomic_ulong g_total_update_GS_time(0);
+// total number of on-demand requests sent to NCM
+std::atomic_ulong g_total_on_demand_requests_issued(0);
+// total number of packets coalesced into an outstanding on-demand request
+std::atomic_ulong g_total_on_demand_requests_coalesced(0);
+// number of on-demand packets dropped / let through by the NCM negative cache
+std::atomic_ulong g_total_on_demand_negative_cache_hits(0);
+std::atomic_ulong g_total_on_demand_negative_cache_misses(0);
+// number of on-demand requests dropped by each admission policy when overloaded
+std::atomic_ulong g_total_on_demand_dropped_newest(0);
+std::atomic_ulong g_total_on_demand_dropped_oldest(0);
+std::atomic_ulong g_total_on_demand_dropped_fair_share(0);
+// number of packets dropped from / replayed out of the per-destination pending queues
+std::atomic_ulong g_total_on_demand_pending_packets_dropped(0);
+std::atomic_ulong g_total_on_demand_pending_packets_replayed(0);
+// number of destinations prefetched, and how many of them were used by an arp request,
+// still needed an on-demand request, or were not used before they stopped being tracked
+std::atomic_ulong g_total_on_demand_prefetch_issued(0);
+std::atomic_ulong g_total_on_demand_prefetch_hits(0);
+std::atomic_ulong g_total_on_demand_prefetch_late(0);
+std::atomic_ulong g_total_on_demand_prefetch_unused(0);
+// number of on-demand batches sent to NCM and of the requests they carried
+std::atomic_ulong g_total_on_demand_batches_sent(0);
+std::atomic_ulong g_total_on_demand_batched_requests(0);
+// number of flow bundles committed for the goal states and of the flow-mods they carried
+std::atomic_ulong g_total_ovs_flow_bundles_committed(0);
+std::atomic_ulong g_total_ovs_bundled_flows(0);
+std::atomic_ulong g_total_ovs_failed_flows(0);
+std::atomic_ulong g_total_ovs_flows_suppressed(0);
+std::atomic_ulong g_total_ovs_flows_sent(0);
+// number of zeta OAM direct paths sent to the switch, dropped as already
+// programmed, and forgotten once their flow could have idled out
+std::atomic_ulong g_total_oam_direct_paths_injected(0);
+std::atomic_ulong g_total_oam_direct_paths_suppressed(0);
+std::atomic_ulong g_total_oam_direct_paths_expired(0);
+// limits of the per-destination on-demand pending queues
+uint g_on_demand_pending_queue_max_packets = ON_DEMAND_PENDING_QUEUE_MAX_PACKETS;
+ulong g_on_demand_pending_queue_max_bytes = ON_DEMAND_PENDING_QUEUE_MAX_BYTES;
+// number of completion queues for the on-demand replies of NCM
+uint g_on_demand_reply_shard_count = ON_DEMAND_REPLY_SHARD_COUNT;
+// batching window, batch size and max outstanding batches of the on-demand requests
+uint g_on_demand_batch_window_us = ON_DEMAND_BATCH_WINDOW_IN_MICROSECONDS;
+uint g_on_demand_batch_max_requests = ON_DEMAND_BATCH_MAX_REQUESTS;
+uint g_on_demand_batch_max_outstanding = ON_DEMAND_BATCH_MAX_OUTSTANDING;
+// flow-mods per OpenFlow bundle of a goal state, 0 disables the bundles
+uint g_ovs_flow_bundle_size = OVS_FLOW_BUNDLE_SIZE;
 // total time for ACA message in microseconds
 std::atomic_ulong g_total_ACA_Message_time(0);
 
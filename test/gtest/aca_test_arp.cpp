@@ -155,6 +155,51 @@ TEST(arp_config_test_cases, update_arp_entry_invalid)
   EXPECT_EQ(retcode, EXIT_SUCCESS);
 }
 
+TEST(arp_config_test_cases, wait_for_arp_entry_added)
+{
+  arp_config stArpCfgIn;
+  arp_entry_data stData;
+
+  stArpCfgIn.ipv4_address = "10.0.2.1";
+  stArpCfgIn.mac_address = "AA:BB:CC:DD:EE:FF";
+  stArpCfgIn.vlan_id = 1201;
+  stData.ipv4_address = stArpCfgIn.ipv4_address;
+  stData.vlan_id = stArpCfgIn.vlan_id;
+
+  (void)ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfgIn);
+
+  // the goal state lands 100ms later
+  std::thread goal_state_thread([&stArpCfgIn] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ACA_ARP_Responder::get_instance().create_or_update_arp_entry(&stArpCfgIn);
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  bool found = ACA_ARP_Responder::get_instance().wait_for_arp_entry(
+          stData, std::chrono::seconds(5));
+  auto waited_ms = chrono::duration_cast<chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  goal_state_thread.join();
+
+  EXPECT_TRUE(found);
+  // woken up by the goal state, not by the timeout
+  EXPECT_LT(waited_ms, 1000);
+
+  (void)ACA_ARP_Responder::get_instance().delete_arp_entry(&stArpCfgIn);
+}
+
+TEST(arp_config_test_cases, wait_for_arp_entry_timeout)
+{
+  arp_entry_data stData;
+
+  stData.ipv4_address = "10.0.2.2";
+  stData.vlan_id = 1201;
+
+  bool found = ACA_ARP_Responder::get_instance().wait_for_arp_entry(
+          stData, std::chrono::milliseconds(50));
+  EXPECT_FALSE(found);
+}
 
 TEST(arp_request_test_cases, arps_recv_valid)
 {
@@ -13,9 +13,24 @@
 //     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "aca_net_config.h"
+#include "aca_command_executor.h"
+#include "aca_netlink_config.h"
+#include "aca_util.h"
 #include "gtest/gtest.h"
-
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <future>
+#include <vector>
+
+using namespace std;
 using aca_net_config::Aca_Net_Config;
+using aca_net_config::Aca_Command_Executor;
+using aca_net_config::Command_Result;
+using aca_net_config::Aca_Netlink_Config;
 
 static char EMPTY_STRING[] = "";
 static char VALID_STRING[] = "VALID_STRING";
@@ -422,4 +437,210 @@ TEST(net_config_test_cases, rename_veth_device_valid)
 
   rc = Aca_Net_Config::get_instance().execute_system_command(cmd_string);
   EXPECT_EQ(rc, EXIT_SUCCESS);
-}
\ No newline at end of file
+}
+
+//
+// Testing the command executor, on commands which need no privilege
+//
+TEST(net_config_test_cases, command_executor_results)
+{
+  Aca_Command_Executor executor(4, 10 * 1000 * 1000, 16);
+
+  Command_Result result = executor.execute("echo hello", true);
+  EXPECT_EQ(result.rc, EXIT_SUCCESS);
+  EXPECT_EQ(result.output, "hello\n");
+
+  // the exit status like system()
+  result = executor.execute("exit 3");
+  EXPECT_TRUE(WIFEXITED(result.rc));
+  EXPECT_EQ(WEXITSTATUS(result.rc), 3);
+
+  // the output past the buffer is dropped without blocking the command
+  result = executor.execute("head -c 100000 /dev/zero | tr '\\0' x", true);
+  EXPECT_EQ(result.rc, EXIT_SUCCESS);
+  EXPECT_EQ(result.output, string(16, 'x'));
+
+  // killed with what it started after its timeout
+  auto start = std::chrono::steady_clock::now();
+  result = executor.execute("sleep 10 & sleep 10; wait", false, 100 * 1000);
+  EXPECT_EQ(result.rc, -ETIMEDOUT);
+  EXPECT_LT(cast_to_microseconds(std::chrono::steady_clock::now() - start).count(), 2000000);
+
+  std::vector<Command_Result> results =
+          executor.execute(std::vector<string>{ "echo 1", "exit 1", "echo 3" }, true);
+  ASSERT_EQ(results.size(), 3UL);
+  EXPECT_EQ(results[0].output, "1\n");
+  EXPECT_NE(results[1].rc, EXIT_SUCCESS);
+  EXPECT_EQ(results[2].output, "3\n");
+}
+
+TEST(net_config_test_cases, command_executor_bounded_concurrency)
+{
+  Aca_Command_Executor executor(2, 10 * 1000 * 1000, 16);
+  std::vector<std::future<Command_Result> > futures;
+
+  // two at a time, in the order submitted
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 6; i++) {
+    futures.push_back(executor.submit("sleep 0.1; echo " + std::to_string(i), true));
+  }
+  EXPECT_EQ(executor.outstanding(), 6UL);
+  for (int i = 0; i < 6; i++) {
+    Command_Result result = futures[i].get();
+    EXPECT_EQ(result.rc, EXIT_SUCCESS);
+    EXPECT_EQ(result.output, std::to_string(i) + "\n");
+  }
+  auto elapse_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+  EXPECT_GE(elapse_us, 300000);
+  EXPECT_LT(elapse_us, 3000000);
+  EXPECT_EQ(executor.outstanding(), 0UL);
+}
+
+//
+// Commands per second through the executor against system(), and how long
+// the calling thread is held for each command: system() holds it for the
+// whole life of the child, submit() only for the spawn
+//
+TEST(net_config_test_cases, DISABLED_command_executor_benchmark)
+{
+  const int total_commands = 1000;
+  Aca_Command_Executor executor(32, 10 * 1000 * 1000, 4096);
+  std::vector<std::future<Command_Result> > futures;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_commands; i++) {
+    futures.push_back(executor.submit("sleep 0.01"));
+  }
+  auto submit_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+  for (auto &future : futures) {
+    EXPECT_EQ(future.get().rc, EXIT_SUCCESS);
+  }
+  auto executor_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  const int total_system_commands = total_commands / 10;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_system_commands; i++) {
+    EXPECT_EQ(system("sleep 0.01"), EXIT_SUCCESS);
+  }
+  auto system_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  printf("executor: %.0f commands/s, caller held %.1f us/command\n",
+         total_commands * 1e6 / executor_us, (double)submit_us / total_commands);
+  printf("system(): %.0f commands/s, caller held %.1f us/command\n",
+         total_system_commands * 1e6 / system_us, (double)system_us / total_system_commands);
+}
+
+//
+// Testing the netlink backend without privilege: a child process gets its
+// own user, network and mount namespaces, where it is root
+//
+// exit status of the child when it can't have its namespaces
+#define NETLINK_TEST_SKIPPED 77
+
+#define NETLINK_TEST_CHECK(condition)                                          \
+  if (!(condition)) {                                                          \
+    fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition);     \
+    _exit(EXIT_FAILURE);                                                       \
+  }
+
+static bool enter_user_namespace()
+{
+  uid_t uid = getuid();
+  gid_t gid = getgid();
+
+  if (unshare(CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWNS) != 0) {
+    return false;
+  }
+  auto write_file = [](const char *path, const string &content) {
+    int fd = open(path, O_WRONLY);
+    bool written = fd >= 0 && write(fd, content.c_str(), content.size()) ==
+                                      (ssize_t)content.size();
+    if (fd >= 0) {
+      close(fd);
+    }
+    return written;
+  };
+  write_file("/proc/self/setgroups", "deny");
+  return write_file("/proc/self/uid_map", "0 " + std::to_string(uid) + " 1") &&
+         write_file("/proc/self/gid_map", "0 " + std::to_string(gid) + " 1");
+}
+
+static void netlink_config_test(const string &netns_dir)
+{
+  Aca_Netlink_Config netlink_config(netns_dir);
+  string veth = "vethtest";
+  string peer = "peertest";
+  string test_ns = "test_ns";
+
+  NETLINK_TEST_CHECK(netlink_config.create_namespace(test_ns) == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.create_namespace(test_ns) == -EEXIST);
+
+  NETLINK_TEST_CHECK(netlink_config.create_veth_pair(veth, peer) == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.create_veth_pair(veth, peer) == -EEXIST);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index("", veth) > 0);
+  NETLINK_TEST_CHECK(netlink_config.set_link_up("", peer, 9000) == EXIT_SUCCESS);
+
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, veth) == -ENODEV);
+  NETLINK_TEST_CHECK(netlink_config.move_to_namespace(veth, test_ns) == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index("", veth) == -ENODEV);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, veth) > 0);
+
+  veth_config new_veth_config;
+  new_veth_config.veth_name = veth;
+  new_veth_config.ip = "10.0.0.2";
+  new_veth_config.prefix_len = "16";
+  new_veth_config.mac = "aa:bb:cc:dd:ee:ff";
+  new_veth_config.gateway_ip = "10.0.0.1";
+  NETLINK_TEST_CHECK(netlink_config.setup_veth_device(test_ns, new_veth_config) == EXIT_SUCCESS);
+  // the address is there already, the gateway too which is okay
+  NETLINK_TEST_CHECK(netlink_config.setup_veth_device(test_ns, new_veth_config) == -EEXIST);
+  NETLINK_TEST_CHECK(netlink_config.add_default_route(test_ns, "10.0.0.1") == -EEXIST);
+
+  new_veth_config.mac = "aa:bb:cc";
+  NETLINK_TEST_CHECK(netlink_config.setup_veth_device(test_ns, new_veth_config) == -EINVAL);
+
+  int link_index = netlink_config.get_link_index(test_ns, veth);
+  NETLINK_TEST_CHECK(netlink_config.rename_link(test_ns, veth, "eth0") == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, "eth0") == link_index);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, veth) == -ENODEV);
+
+  NETLINK_TEST_CHECK(netlink_config.delete_link(peer) == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, "eth0") == -ENODEV);
+
+  // deleted like "ip netns del", then added again under the same name
+  string netns_path = netns_dir + "/" + test_ns;
+  NETLINK_TEST_CHECK(umount2(netns_path.c_str(), MNT_DETACH) == 0);
+  NETLINK_TEST_CHECK(unlink(netns_path.c_str()) == 0);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, "lo") == -ENOENT);
+  NETLINK_TEST_CHECK(netlink_config.create_namespace(test_ns) == EXIT_SUCCESS);
+  NETLINK_TEST_CHECK(netlink_config.get_link_index(test_ns, "lo") > 0);
+}
+
+TEST(net_config_test_cases, netlink_config_in_user_namespace)
+{
+  char netns_dir[] = "/tmp/aca_netns_XXXXXX";
+  ASSERT_NE(mkdtemp(netns_dir), nullptr);
+
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    if (!enter_user_namespace()) {
+      _exit(NETLINK_TEST_SKIPPED);
+    }
+    netlink_config_test(netns_dir);
+    _exit(EXIT_SUCCESS);
+  }
+
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  if (WEXITSTATUS(status) == NETLINK_TEST_SKIPPED) {
+    printf("user namespaces are not available, skipping the netlink test\n");
+  } else {
+    EXPECT_EQ(WEXITSTATUS(status), EXIT_SUCCESS);
+  }
+
+  // the bind mount went away with the mount namespace of the child
+  unlink((string(netns_dir) + "/test_ns").c_str());
+  rmdir(netns_dir);
+}
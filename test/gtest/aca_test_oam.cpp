@@ -17,6 +17,7 @@
 #include "goalstateprovisioner.grpc.pb.h"
 #define private public
 #include "aca_zeta_oam_server.h"
+#include "aca_zeta_oam_path_cache.h"
 #include "aca_util.h"
 #include <string.h>
 #include "aca_vlan_manager.h"
@@ -48,6 +49,10 @@ extern string remote_ip_2;
 extern string auxGateway_id_1;
 extern string auxGateway_id_2;
 
+extern std::atomic_ulong g_total_oam_direct_paths_injected;
+extern std::atomic_ulong g_total_oam_direct_paths_suppressed;
+extern std::atomic_ulong g_total_oam_direct_paths_expired;
+
 extern uint tunnel_id_1;
 extern uint tunnel_id_2;
 extern uint oam_port_1;
@@ -193,3 +198,81 @@ TEST(oam_message_test_cases, del_direct_path_valid)
   retcode = ACA_OVS_Control::get_instance().flow_exists("br-tun", cmd.c_str());
   EXPECT_EQ(retcode, EXIT_FAILURE);
 }
+
+TEST(oam_message_test_cases, add_direct_path_suppresses_duplicates)
+{
+  int retcode = 0;
+  oam_match match;
+  oam_action action;
+
+  match.sip = vip_address_1;
+  match.dip = vip_address_2;
+  match.sport = "56";
+  match.dport = "78";
+  match.vni = 500;
+  match.proto = "6";
+
+  action.inst_nw_dst = vip_address_3;
+  action.node_nw_dst = remote_ip_1;
+  action.inst_dl_dst = vmac_address_1;
+  action.node_dl_dst = vmac_address_2;
+  action.idle_timeout = "120";
+
+  ulong injected = g_total_oam_direct_paths_injected.load();
+  ulong suppressed = g_total_oam_direct_paths_suppressed.load();
+
+  retcode = ACA_Zeta_Oam_Server::get_instance()._add_direct_path(match, action);
+  EXPECT_EQ(retcode, EXIT_SUCCESS);
+  retcode = ACA_Zeta_Oam_Server::get_instance()._add_direct_path(match, action);
+  EXPECT_EQ(retcode, EXIT_SUCCESS);
+  EXPECT_EQ(g_total_oam_direct_paths_injected.load(), injected + 1);
+  EXPECT_EQ(g_total_oam_direct_paths_suppressed.load(), suppressed + 1);
+
+  // another destination for the same 5-tuple replaces the flow
+  action.node_nw_dst = remote_ip_2;
+  ACA_Zeta_Oam_Server::get_instance()._add_direct_path(match, action);
+  EXPECT_EQ(g_total_oam_direct_paths_injected.load(), injected + 2);
+
+  // a deleted direct path is injected again
+  ACA_Zeta_Oam_Server::get_instance()._del_direct_path(match);
+  ACA_Zeta_Oam_Server::get_instance()._add_direct_path(match, action);
+  EXPECT_EQ(g_total_oam_direct_paths_injected.load(), injected + 3);
+
+  ACA_Zeta_Oam_Server::get_instance()._del_direct_path(match);
+}
+
+TEST(oam_message_test_cases, oam_path_cache_mirrors_idle_timeout)
+{
+  ACA_Zeta_Oam_Path_Cache path_cache(2);
+  auto start = std::chrono::steady_clock::now();
+  ulong expired = g_total_oam_direct_paths_expired.load();
+
+  ASSERT_FALSE(path_cache.contains("match1", "flow1", start));
+  path_cache.add("match1", "flow1", 10, start);
+  ASSERT_TRUE(path_cache.contains("match1", "flow1", start + std::chrono::seconds(9)));
+  // another flow for the same match is not a duplicate
+  ASSERT_FALSE(path_cache.contains("match1", "flow2", start));
+
+  // the entry is gone once the flow could have idled out
+  ASSERT_FALSE(path_cache.contains("match1", "flow1", start + std::chrono::seconds(10)));
+  ASSERT_EQ(path_cache.size(), 0);
+  ASSERT_EQ(g_total_oam_direct_paths_expired.load(), expired + 1);
+
+  // a flow without idle_timeout is not remembered
+  path_cache.add("match1", "flow1", 0, start);
+  ASSERT_FALSE(path_cache.contains("match1", "flow1", start));
+
+  // a deleted direct path is forgotten
+  path_cache.add("match1", "flow1", 10, start);
+  ASSERT_TRUE(path_cache.invalidate("match1"));
+  ASSERT_FALSE(path_cache.invalidate("match1"));
+
+  // when full, the entry closest to its expiration is evicted
+  path_cache.add("match1", "flow1", 30, start);
+  path_cache.add("match2", "flow2", 10, start);
+  path_cache.add("match3", "flow3", 20, start);
+  ASSERT_EQ(path_cache.size(), 2);
+  ASSERT_TRUE(path_cache.contains("match1", "flow1", start));
+  ASSERT_FALSE(path_cache.contains("match2", "flow2", start));
+  ASSERT_TRUE(path_cache.contains("match3", "flow3", start));
+}
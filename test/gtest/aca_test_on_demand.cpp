@@ -11,12 +11,92 @@
 #include <iostream>
 #include <string>
 #include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include "aca_grpc.h"
 #include "aca_grpc_client.h"
 #include "aca_on_demand_engine.h"
+#include "aca_on_demand_request_table.h"
+#include "aca_on_demand_negative_cache.h"
+#include "aca_on_demand_admission_queue.h"
+#include "aca_on_demand_pool.h"
+#include "aca_on_demand_pending_queue.h"
+#include "aca_on_demand_inflight_table.h"
+#include "aca_on_demand_prefetcher.h"
+#include "aca_on_demand_reply_shards.h"
+#include "aca_on_demand_request_batcher.h"
+#include <uuid/uuid.h>
+#include <arpa/inet.h>
+
+using namespace aca_on_demand_engine;
 
 extern GoalStateProvisionerClientImpl *g_grpc_client;
 
+// stand-in NCM which answers every state request with SUCCESS
+class Stand_In_NCM final : public GoalStateProvisioner::Service {
+  public:
+  grpc::Status RequestGoalStates(grpc::ServerContext *context, const HostRequest *request,
+                                 HostRequestReply *reply) override
+  {
+    for (int i = 0; i < request->state_requests_size(); i++) {
+      HostRequestReply_HostRequestOperationStatus *operation_status =
+              reply->add_operation_statuses();
+      operation_status->set_request_id(request->state_requests(i).request_id());
+      operation_status->set_operation_status(OperationStatus::SUCCESS);
+    }
+    return grpc::Status::OK;
+  }
+};
+
+// start the stand-in NCM on a free local port and point client to it
+static std::unique_ptr<grpc::Server>
+start_stand_in_ncm(Stand_In_NCM &ncm, GoalStateProvisionerClientImpl &client)
+{
+  int port = 0;
+  ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+  builder.RegisterService(&ncm);
+  std::unique_ptr<grpc::Server> server = builder.BuildAndStart();
+
+  client.chan_ = grpc::CreateChannel("127.0.0.1:" + std::to_string(port),
+                                     grpc::InsecureChannelCredentials());
+  client.stub_ = GoalStateProvisioner::NewStub(client.chan_);
+  return server;
+}
+
+/*
+ * send total_requests requests through reply_shards, one state request each,
+ * and wait until all of them are answered and their calls recycled.
+ * Return:
+ *    the number of replies which came back with SUCCESS
+ */
+static int send_and_wait_for_replies(ACA_On_Demand_Reply_Shards &reply_shards,
+                                     GoalStateProvisionerClientImpl &client,
+                                     std::atomic<int> &replies, int total_requests)
+{
+  for (int i = 0; i < total_requests; i++) {
+    HostRequest request;
+    uint64_t request_id = ACA_On_Demand_Engine::generate_request_id();
+    request.add_state_requests()->set_request_id(
+            ACA_On_Demand_Engine::request_id_to_string(request_id));
+    if (!reply_shards.send(&client, &request, request_id)) {
+      return -1;
+    }
+  }
+  // 10 seconds at most
+  for (int i = 0; i < 100000; i++) {
+    if (replies.load() >= total_requests && reply_shards.outstanding_calls() == 0) {
+      break;
+    }
+    usleep(100);
+  }
+  return replies.load();
+}
+
 TEST(aca_on_demand_testcases, DISABLED_grpc_client_connectivity_test)
 {
   sleep(10);
@@ -87,4 +167,804 @@ TEST(aca_on_demand_testcases, DISABLED_grpc_client_connectivity_test)
     if (counter == 2)
       break;
   }
-}
\ No newline at end of file
+}
+TEST(aca_on_demand_testcases, request_table_insert_take_expire)
+{
+  ACA_On_Demand_Request_Table<int> request_table(10000000, 1000); // 10s timeout, 1ms tick
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> expired;
+  int value = 0;
+
+  ASSERT_TRUE(request_table.insert(1, 100, start));
+  ASSERT_TRUE(request_table.insert(2, 200, start));
+  // duplicated request id is rejected
+  ASSERT_FALSE(request_table.insert(1, 300, start));
+  ASSERT_EQ(request_table.size(), 2);
+
+  ASSERT_TRUE(request_table.find(1, value));
+  ASSERT_EQ(value, 100);
+
+  // a request can only be taken once
+  ASSERT_TRUE(request_table.take(1, value));
+  ASSERT_EQ(value, 100);
+  ASSERT_FALSE(request_table.take(1, value));
+  ASSERT_EQ(request_table.size(), 1);
+
+  // nothing expires before the timeout
+  ASSERT_EQ(request_table.expire(expired, start + std::chrono::seconds(9)), 0);
+  ASSERT_TRUE(request_table.find(2, value));
+
+  ASSERT_EQ(request_table.expire(expired, start + std::chrono::seconds(11)), 1);
+  ASSERT_EQ(expired.size(), 1);
+  ASSERT_EQ(expired[0], 200);
+  ASSERT_FALSE(request_table.find(2, value));
+  ASSERT_EQ(request_table.size(), 0);
+}
+
+TEST(aca_on_demand_testcases, request_table_expire_in_insert_order)
+{
+  ACA_On_Demand_Request_Table<int> request_table(10000000, 1000); // 10s timeout, 1ms tick
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> expired;
+  int total_entries = 10000;
+
+  // one entry inserted every millisecond
+  for (int i = 0; i < total_entries; i++) {
+    ASSERT_TRUE(request_table.insert(i, i, start + std::chrono::milliseconds(i)));
+  }
+
+  // walk the clock every 100ms, only the entries older than 10s may expire
+  for (int elapsed_ms = 0; elapsed_ms <= 10000 + total_entries; elapsed_ms += 100) {
+    expired.clear();
+    request_table.expire(expired, start + std::chrono::milliseconds(elapsed_ms));
+    for (auto i : expired) {
+      ASSERT_GE(elapsed_ms - i, 10000);
+      ASSERT_LT(elapsed_ms - i, 10000 + 100);
+    }
+  }
+  ASSERT_EQ(request_table.size(), 0);
+}
+
+TEST(aca_on_demand_testcases, negative_cache_ttl_and_invalidate)
+{
+  ACA_On_Demand_Negative_Cache negative_cache(1024, 5000000); // 5s TTL
+  auto start = std::chrono::steady_clock::now();
+  uint32_t ip_dest = inet_addr("10.0.0.3");
+
+  ASSERT_FALSE(negative_cache.contains(20, ip_dest, start));
+  negative_cache.add(20, ip_dest, start);
+  ASSERT_TRUE(negative_cache.contains(20, ip_dest, start + std::chrono::seconds(4)));
+  // same ip in another tunnel is a different destination
+  ASSERT_FALSE(negative_cache.contains(21, ip_dest, start));
+
+  // the entry is gone after the TTL
+  ASSERT_FALSE(negative_cache.contains(20, ip_dest, start + std::chrono::seconds(6)));
+  ASSERT_EQ(negative_cache.size(), 0);
+
+  // a neighbor goal state for the destination removes the entry
+  negative_cache.add(20, ip_dest, start);
+  ASSERT_TRUE(negative_cache.invalidate(20, "10.0.0.3"));
+  ASSERT_FALSE(negative_cache.contains(20, ip_dest, start));
+  ASSERT_FALSE(negative_cache.invalidate(20, "10.0.0.3"));
+}
+
+TEST(aca_on_demand_testcases, negative_cache_max_size)
+{
+  const uint32_t max_entries = 1024;
+  ACA_On_Demand_Negative_Cache negative_cache(max_entries, 5000000); // 5s TTL
+  auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < 10 * max_entries; i++) {
+    negative_cache.add(20, htonl(i), start + std::chrono::microseconds(i));
+  }
+  ASSERT_LE(negative_cache.size(), max_entries);
+  // the newest entry is kept, the oldest one was evicted
+  ASSERT_TRUE(negative_cache.contains(20, htonl(10 * max_entries - 1), start));
+  ASSERT_FALSE(negative_cache.contains(20, htonl(0), start));
+}
+
+TEST(aca_on_demand_testcases, admission_queue_drop_newest_and_oldest)
+{
+  ACA_On_Demand_Admission_Queue<int> admission_queue(2, ADMISSION_DROP_NEWEST);
+  std::vector<int> dropped;
+  int item = 0;
+
+  ASSERT_EQ(admission_queue.push(1, 1, dropped), ADMISSION_POLICY_MAX);
+  ASSERT_EQ(admission_queue.push(1, 2, dropped), ADMISSION_POLICY_MAX);
+  ASSERT_TRUE(dropped.empty());
+
+  // full, the new request is dropped
+  ASSERT_EQ(admission_queue.push(1, 3, dropped), ADMISSION_DROP_NEWEST);
+  ASSERT_EQ(dropped.size(), 1);
+  ASSERT_EQ(dropped[0], 3);
+
+  // full, the oldest request makes room for the new one
+  dropped.clear();
+  admission_queue.set_policy(ADMISSION_DROP_OLDEST);
+  ASSERT_EQ(admission_queue.push(1, 4, dropped), ADMISSION_DROP_OLDEST);
+  ASSERT_EQ(dropped.size(), 1);
+  ASSERT_EQ(dropped[0], 1);
+
+  // the requests come out in arrival order
+  ASSERT_TRUE(admission_queue.pop(item, std::chrono::microseconds(0)));
+  ASSERT_EQ(item, 2);
+  ASSERT_TRUE(admission_queue.pop(item, std::chrono::microseconds(0)));
+  ASSERT_EQ(item, 4);
+  ASSERT_FALSE(admission_queue.pop(item, std::chrono::microseconds(1000)));
+}
+
+TEST(aca_on_demand_testcases, admission_queue_port_fair_share)
+{
+  ACA_On_Demand_Admission_Queue<int> admission_queue(8, ADMISSION_PORT_FAIR_SHARE);
+  std::vector<int> dropped;
+
+  // a noisy port fills up the whole queue
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(admission_queue.push(1, i, dropped), ADMISSION_POLICY_MAX);
+  }
+  // and keeps losing its own new requests
+  ASSERT_EQ(admission_queue.push(1, 100, dropped), ADMISSION_PORT_FAIR_SHARE);
+  ASSERT_EQ(dropped.back(), 100);
+
+  // a quiet port still gets in, at the expense of the oldest requests of the noisy one
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(admission_queue.push(2, 200 + i, dropped), ADMISSION_PORT_FAIR_SHARE);
+    ASSERT_EQ(dropped.back(), i);
+  }
+  ASSERT_EQ(admission_queue.size(1), 4);
+  ASSERT_EQ(admission_queue.size(2), 4);
+
+  // both ports are at their fair share now
+  ASSERT_EQ(admission_queue.push(2, 300, dropped), ADMISSION_PORT_FAIR_SHARE);
+  ASSERT_EQ(dropped.back(), 300);
+  ASSERT_EQ(admission_queue.size(), 8);
+}
+
+TEST(aca_on_demand_testcases, pending_queue_depth_and_byte_limits)
+{
+  ACA_On_Demand_Pending_Queue<int> pending_queue;
+  std::vector<int> dropped;
+  std::vector<int> taken;
+
+  // depth limit, the oldest packet makes room for the new one
+  ASSERT_TRUE(pending_queue.push(1, 100, 3, 1000, dropped));
+  ASSERT_TRUE(pending_queue.push(2, 100, 3, 1000, dropped));
+  ASSERT_TRUE(pending_queue.push(3, 100, 3, 1000, dropped));
+  ASSERT_TRUE(pending_queue.push(4, 100, 3, 1000, dropped));
+  ASSERT_EQ(dropped, std::vector<int>({ 1 }));
+  ASSERT_EQ(pending_queue.size(), 3);
+  ASSERT_EQ(pending_queue.bytes(), 300);
+
+  // byte limit, as many old packets as needed are dropped
+  ASSERT_TRUE(pending_queue.push(5, 250, 3, 400, dropped));
+  ASSERT_EQ(dropped, std::vector<int>({ 1, 2, 3 }));
+  ASSERT_EQ(pending_queue.bytes(), 350);
+
+  // a packet over the byte limit by itself is not queued
+  ASSERT_FALSE(pending_queue.push(6, 500, 3, 400, dropped));
+  ASSERT_EQ(pending_queue.size(), 2);
+
+  // the packets are replayed oldest first
+  pending_queue.take(taken);
+  ASSERT_EQ(taken, std::vector<int>({ 4, 5 }));
+  ASSERT_TRUE(pending_queue.empty());
+  ASSERT_EQ(pending_queue.bytes(), 0);
+}
+
+TEST(aca_on_demand_testcases, inflight_table_coalesces_same_destination)
+{
+  ACA_On_Demand_Inflight_Table<on_demand_flow_key, int, on_demand_flow_key_hash> inflight_table;
+  on_demand_flow_key flow_key = { 1, htonl(0x0a000002), Protocol::TCP };
+  on_demand_flow_key other_protocol = { 1, htonl(0x0a000002), Protocol::UDP };
+  std::vector<int> dropped;
+  std::vector<int> released;
+
+  // the first packet is issued as the request of its destination
+  ASSERT_FALSE(inflight_table.coalesce(flow_key, 100, 1, 100, 8, 16384, dropped));
+  ASSERT_EQ(inflight_table.issued(), 1);
+  ASSERT_EQ(inflight_table.coalesced(), 0);
+
+  // the next ones to the same destination are attached to it, not issued
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 101, 2, 100, 8, 16384, dropped));
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 102, 3, 100, 8, 16384, dropped));
+  ASSERT_TRUE(dropped.empty());
+  ASSERT_EQ(inflight_table.issued(), 1);
+  ASSERT_EQ(inflight_table.coalesced(), 2);
+  ASSERT_EQ(inflight_table.size(), 1);
+
+  // another protocol to the same destination is a request of its own
+  ASSERT_FALSE(inflight_table.coalesce(other_protocol, 103, 4, 100, 8, 16384, dropped));
+  ASSERT_EQ(inflight_table.issued(), 2);
+  ASSERT_EQ(inflight_table.size(), 2);
+
+  // only the request id issued for the destination releases it
+  ASSERT_FALSE(inflight_table.release(flow_key, 101, released));
+  ASSERT_TRUE(released.empty());
+
+  // the single reply releases every attached packet, oldest first
+  ASSERT_TRUE(inflight_table.release(flow_key, 100, released));
+  ASSERT_EQ(released, std::vector<int>({ 2, 3 }));
+  ASSERT_FALSE(inflight_table.release(flow_key, 100, released));
+  ASSERT_EQ(inflight_table.size(), 1);
+
+  // a packet after the reply issues a new request
+  ASSERT_FALSE(inflight_table.coalesce(flow_key, 104, 5, 100, 8, 16384, dropped));
+  ASSERT_EQ(inflight_table.issued(), 3);
+  ASSERT_EQ(inflight_table.coalesced(), 2);
+}
+
+TEST(aca_on_demand_testcases, inflight_table_drops_over_the_pending_limits)
+{
+  ACA_On_Demand_Inflight_Table<on_demand_flow_key, int, on_demand_flow_key_hash> inflight_table;
+  on_demand_flow_key flow_key = { 1, htonl(0x0a000002), Protocol::TCP };
+  std::vector<int> dropped;
+  std::vector<int> released;
+
+  // two pending packets at most
+  ASSERT_FALSE(inflight_table.coalesce(flow_key, 100, 1, 100, 2, 16384, dropped));
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 101, 2, 100, 2, 16384, dropped));
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 102, 3, 100, 2, 16384, dropped));
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 103, 4, 100, 2, 16384, dropped));
+  ASSERT_EQ(dropped, std::vector<int>({ 2 }));
+
+  // a packet over the byte limit by itself is dropped, but still coalesced
+  ASSERT_TRUE(inflight_table.coalesce(flow_key, 104, 5, 20000, 2, 16384, dropped));
+  ASSERT_EQ(dropped, std::vector<int>({ 2, 5 }));
+  ASSERT_EQ(inflight_table.issued(), 1);
+  ASSERT_EQ(inflight_table.coalesced(), 4);
+
+  ASSERT_TRUE(inflight_table.release(flow_key, 100, released));
+  ASSERT_EQ(released, std::vector<int>({ 3, 4 }));
+  ASSERT_EQ(inflight_table.size(), 0);
+}
+
+TEST(aca_on_demand_testcases, prefetcher_co_access_and_budget)
+{
+  // no budget while learning
+  ACA_On_Demand_Prefetcher prefetcher(PREFETCH_CO_ACCESSED, 0);
+  auto start = std::chrono::steady_clock::now();
+  auto not_programmed = [](uint32_t) { return false; };
+  uint32_t src = htonl(0x0a000001), x = htonl(0x0a000002), y = htonl(0x0a000003),
+           z = htonl(0x0a000004), w = htonl(0x0a000005);
+  std::vector<uint32_t> prefetch_ips;
+
+  // x was followed by y, z and w within the co-access window
+  prefetcher.prefetch(20, 1, src, x, 100, not_programmed, prefetch_ips, start);
+  prefetcher.prefetch(20, 1, src, y, 101, not_programmed, prefetch_ips, start);
+  prefetcher.prefetch(20, 1, src, x, 102, not_programmed, prefetch_ips, start + std::chrono::seconds(1));
+  prefetcher.prefetch(20, 1, src, z, 103, not_programmed, prefetch_ips, start + std::chrono::seconds(1));
+  prefetcher.prefetch(20, 1, src, x, 104, not_programmed, prefetch_ips, start + std::chrono::seconds(2));
+  prefetcher.prefetch(20, 1, src, w, 105, not_programmed, prefetch_ips, start + std::chrono::seconds(2));
+  ASSERT_TRUE(prefetch_ips.empty());
+  ASSERT_EQ(prefetcher.outstanding(20), 0);
+
+  // the budget of the VPC caps the prefetch, the most recent peers go first
+  prefetcher.configure(PREFETCH_CO_ACCESSED, 2);
+  auto now = start + std::chrono::seconds(3);
+  ASSERT_EQ(prefetcher.prefetch(20, 1, src, x, 200, not_programmed, prefetch_ips, now), 2);
+  ASSERT_EQ(prefetch_ips, std::vector<uint32_t>({ w, z }));
+  ASSERT_EQ(prefetcher.outstanding(20), 2);
+  prefetch_ips.clear();
+  ASSERT_EQ(prefetcher.prefetch(20, 1, src, x, 201, not_programmed, prefetch_ips, now), 0);
+  // other VPCs have their own budget
+  ASSERT_EQ(prefetcher.outstanding(30), 0);
+
+  // the reply gives the budget back, tracked destinations are not picked again
+  ASSERT_TRUE(prefetcher.complete(200));
+  ASSERT_FALSE(prefetcher.complete(200));
+  ASSERT_EQ(prefetcher.outstanding(20), 0);
+  ASSERT_EQ(prefetcher.prefetch(20, 1, src, x, 202, not_programmed, prefetch_ips, now), 1);
+  ASSERT_EQ(prefetch_ips, std::vector<uint32_t>({ y }));
+
+  // hit, late and unused prefetches
+  ASSERT_TRUE(prefetcher.on_arp_replied(1, w));
+  ASSERT_FALSE(prefetcher.on_arp_replied(1, w));
+  ASSERT_TRUE(prefetcher.on_demand_requested(1, z));
+  ASSERT_EQ(prefetcher.tracked(), 1);
+  ASSERT_EQ(prefetcher.expire(now + std::chrono::microseconds(ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS)), 1);
+  ASSERT_EQ(prefetcher.outstanding(20), 0);
+  ASSERT_EQ(prefetcher.tracked(), 0);
+}
+
+TEST(aca_on_demand_testcases, prefetcher_subnet)
+{
+  ACA_On_Demand_Prefetcher prefetcher(PREFETCH_SUBNET, 300);
+  uint32_t src = htonl(0x0a000101), x = htonl(0x0a000102);
+  std::vector<uint32_t> prefetch_ips;
+
+  // the whole /24 but the destination, the source and the network and broadcast addresses
+  auto is_programmed = [src](uint32_t ip) { return ip == src; };
+  ASSERT_EQ(prefetcher.prefetch(20, 1, src, x, 100, is_programmed, prefetch_ips), 252);
+  ASSERT_EQ(prefetch_ips.front(), htonl(0x0a000103));
+  ASSERT_EQ(prefetch_ips.back(), htonl(0x0a0001fe));
+
+  prefetcher.configure(PREFETCH_DISABLED, 300);
+  prefetch_ips.clear();
+  ASSERT_EQ(prefetcher.prefetch(20, 1, src, htonl(0x0a000202), 101, is_programmed, prefetch_ips), 0);
+}
+
+TEST(aca_on_demand_testcases, packet_buffer_pool_reuses_blocks)
+{
+  ACA_Packet_Buffer_Pool packet_buffer_pool;
+  uint8_t packet[256] = { 0x01, 0x02, 0x03 };
+
+  {
+    ACA_Packet_Buffer_Pool::Buffer buffer = packet_buffer_pool.copy(packet, 46);
+    ASSERT_TRUE((bool)buffer);
+    ASSERT_EQ(buffer.size(), 46);
+    ASSERT_EQ(memcmp(buffer.data(), packet, 46), 0);
+    ASSERT_EQ(packet_buffer_pool.used_blocks(), 1);
+
+    // ownership moves with the handle
+    ACA_Packet_Buffer_Pool::Buffer moved = std::move(buffer);
+    ASSERT_FALSE((bool)buffer);
+    ASSERT_EQ(packet_buffer_pool.used_blocks(), 1);
+  }
+  // the block went back to the pool with its handle
+  ASSERT_EQ(packet_buffer_pool.used_blocks(), 0);
+
+  // larger than the largest size class
+  ASSERT_FALSE((bool)packet_buffer_pool.allocate(257));
+
+  // memory stays flat under a steady load
+  size_t total_blocks = 0;
+  for (int round = 0; round < 100; round++) {
+    std::vector<ACA_Packet_Buffer_Pool::Buffer> buffers;
+    for (int i = 0; i < 1000; i++) {
+      buffers.push_back(packet_buffer_pool.copy(packet, 1 + i % 256));
+    }
+    if (round == 0) {
+      total_blocks = packet_buffer_pool.total_blocks();
+    }
+    ASSERT_EQ(packet_buffer_pool.total_blocks(), total_blocks);
+  }
+  ASSERT_EQ(packet_buffer_pool.used_blocks(), 0);
+}
+
+TEST(aca_on_demand_testcases, object_pool_handles)
+{
+  ACA_Object_Pool<std::string> string_pool;
+
+  {
+    ACA_Object_Pool<std::string>::handle name = string_pool.make("on-demand");
+    ASSERT_EQ(*name, "on-demand");
+    ASSERT_EQ(string_pool.used_blocks(), 1);
+
+    // a released record can be passed around and adopted again
+    std::string *raw_name = name.release();
+    ASSERT_EQ(string_pool.used_blocks(), 1);
+    ACA_Object_Pool<std::string>::handle adopted = string_pool.adopt(raw_name);
+  }
+  ASSERT_EQ(string_pool.used_blocks(), 0);
+}
+
+TEST(aca_on_demand_testcases, request_id_unique_and_monotonic)
+{
+  const int total_threads = 4;
+  const int ids_per_thread = 10000;
+  std::vector<std::vector<uint64_t> > request_ids(total_threads);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < total_threads; i++) {
+    threads.push_back(std::thread([&request_ids, i] {
+      for (int j = 0; j < ids_per_thread; j++) {
+        request_ids[i].push_back(ACA_On_Demand_Engine::generate_request_id());
+      }
+    }));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::unordered_set<uint64_t> all_ids;
+  for (auto &thread_ids : request_ids) {
+    for (int j = 1; j < ids_per_thread; j++) {
+      ASSERT_LT(thread_ids[j - 1], thread_ids[j]);
+    }
+    all_ids.insert(thread_ids.begin(), thread_ids.end());
+  }
+  ASSERT_EQ(all_ids.size(), total_threads * ids_per_thread);
+
+  // the id only travels to NCM and back as text
+  uint64_t request_id = ACA_On_Demand_Engine::generate_request_id();
+  uint64_t parsed_id = 0;
+  string request_id_str = ACA_On_Demand_Engine::request_id_to_string(request_id);
+  ASSERT_TRUE(ACA_On_Demand_Engine::parse_request_id(request_id_str, parsed_id));
+  ASSERT_EQ(parsed_id, request_id);
+  ASSERT_FALSE(ACA_On_Demand_Engine::parse_request_id("", parsed_id));
+  ASSERT_FALSE(ACA_On_Demand_Engine::parse_request_id("12345abc", parsed_id));
+  ASSERT_FALSE(ACA_On_Demand_Engine::parse_request_id("184467440737095516160", parsed_id));
+}
+
+/*
+  Compares the previous request table (one unordered_map keyed by the uuid string,
+  behind a single mutex, expired by scanning the whole map) with ACA_On_Demand_Request_Table
+  for 1M entries. Run it with --gtest_also_run_disabled_tests --gtest_filter=*request_table_benchmark
+*/
+TEST(aca_on_demand_testcases, DISABLED_request_table_benchmark)
+{
+  const int total_entries = 1000000;
+  std::vector<std::string> uuid_strs(total_entries);
+  std::vector<uint64_t> request_keys(total_entries);
+  int *not_used_payload = nullptr;
+
+  for (int i = 0; i < total_entries; i++) {
+    uuid_t uuid;
+    char uuid_str[37];
+    uuid_generate_time(uuid);
+    uuid_unparse_lower(uuid, uuid_str);
+    uuid_strs[i] = uuid_str;
+    request_keys[i] = ACA_On_Demand_Engine::generate_request_id();
+  }
+
+  auto print_rate = [&](const char *table_name, const char *operation,
+                        std::chrono::steady_clock::time_point begin,
+                        std::chrono::steady_clock::time_point end) {
+    auto elapsed_us = cast_to_microseconds(end - begin).count();
+    ACA_LOG_INFO("%s %s of %d entries took %ld us, %.0f ops/s\n", table_name,
+                 operation, total_entries, elapsed_us,
+                 total_entries * 1000000.0 / (elapsed_us == 0 ? 1 : elapsed_us));
+  };
+
+  // previous implementation
+  {
+    unordered_map<std::string, int *, std::hash<std::string> > payload_map;
+    std::mutex payload_map_mutex;
+    auto insert_time = std::chrono::steady_clock::now();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < total_entries; i++) {
+      payload_map_mutex.lock();
+      payload_map[uuid_strs[i]] = not_used_payload;
+      payload_map_mutex.unlock();
+    }
+    auto end = std::chrono::steady_clock::now();
+    print_rate("unordered_map", "insert", begin, end);
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < total_entries; i++) {
+      payload_map_mutex.lock();
+      ASSERT_NE(payload_map.find(uuid_strs[i]), payload_map.end());
+      payload_map_mutex.unlock();
+    }
+    end = std::chrono::steady_clock::now();
+    print_rate("unordered_map", "lookup", begin, end);
+
+    auto scan_and_expire = [&](std::chrono::steady_clock::time_point now) {
+      payload_map_mutex.lock();
+      for (auto it = payload_map.cbegin(); it != payload_map.cend();) {
+        if (cast_to_microseconds(now - insert_time).count() >=
+            ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS) {
+          payload_map.erase(it++);
+        } else {
+          ++it;
+        }
+      }
+      payload_map_mutex.unlock();
+    };
+
+    // cleanup pass when nothing is due yet
+    begin = std::chrono::steady_clock::now();
+    scan_and_expire(insert_time + std::chrono::seconds(5));
+    end = std::chrono::steady_clock::now();
+    print_rate("unordered_map", "cleanup (none due)", begin, end);
+    ASSERT_EQ(payload_map.size(), total_entries);
+
+    begin = std::chrono::steady_clock::now();
+    scan_and_expire(insert_time + std::chrono::seconds(11));
+    end = std::chrono::steady_clock::now();
+    print_rate("unordered_map", "expire", begin, end);
+    ASSERT_TRUE(payload_map.empty());
+  }
+
+  // sharded table with timing wheel expiry
+  {
+    ACA_On_Demand_Request_Table<int *> request_table(ON_DEMAND_ENTRY_EXPIRATION_IN_MICROSECONDS,
+                                                     ON_DEMAND_ENTRY_CLEANUP_FREQUENCY_IN_MICROSECONDS,
+                                                     total_entries);
+    std::vector<int *> expired;
+    auto insert_time = std::chrono::steady_clock::now();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < total_entries; i++) {
+      request_table.insert(request_keys[i], not_used_payload, insert_time);
+    }
+    auto end = std::chrono::steady_clock::now();
+    print_rate("ACA_On_Demand_Request_Table", "insert", begin, end);
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < total_entries; i++) {
+      ASSERT_TRUE(request_table.find(request_keys[i], not_used_payload));
+    }
+    end = std::chrono::steady_clock::now();
+    print_rate("ACA_On_Demand_Request_Table", "lookup", begin, end);
+
+    // cleanup pass when nothing is due yet, in 100ms ticks like the cleanup thread
+    begin = std::chrono::steady_clock::now();
+    for (int elapsed_ms = 0; elapsed_ms <= 5000; elapsed_ms += 100) {
+      request_table.expire(expired, insert_time + std::chrono::milliseconds(elapsed_ms));
+    }
+    end = std::chrono::steady_clock::now();
+    print_rate("ACA_On_Demand_Request_Table", "cleanup (none due)", begin, end);
+    ASSERT_EQ(request_table.size(), total_entries);
+
+    begin = std::chrono::steady_clock::now();
+    expired.reserve(total_entries);
+    request_table.expire(expired, insert_time + std::chrono::seconds(11));
+    end = std::chrono::steady_clock::now();
+    print_rate("ACA_On_Demand_Request_Table", "expire", begin, end);
+    ASSERT_EQ(expired.size(), total_entries);
+  }
+}
+
+TEST(aca_on_demand_testcases, reply_shards_replies_and_recycled_calls)
+{
+  const size_t total_shards = 4;
+  const int total_requests = 200;
+  Stand_In_NCM ncm;
+  GoalStateProvisionerClientImpl client;
+  std::unique_ptr<grpc::Server> server = start_stand_in_ncm(ncm, client);
+
+  std::atomic<int> replies(0);
+  std::atomic<int> wrong_shard(0);
+  std::mutex shard_threads_mutex;
+  std::unordered_map<uint64_t, std::thread::id> shard_threads;
+  {
+    ACA_On_Demand_Reply_Shards reply_shards(
+            total_shards, [&](AsyncClientCall *call, bool ok) {
+              uint64_t request_id = 0;
+              if (!ok || !call->status.ok() || call->reply.operation_statuses_size() != 1 ||
+                  !ACA_On_Demand_Engine::parse_request_id(
+                          call->reply.operation_statuses(0).request_id(), request_id)) {
+                return;
+              }
+              // every reply of a shard is handled by the same poller thread
+              std::lock_guard<std::mutex> lock(shard_threads_mutex);
+              auto inserted = shard_threads.emplace(request_id % total_shards,
+                                                    std::this_thread::get_id());
+              if (inserted.first->second != std::this_thread::get_id()) {
+                wrong_shard++;
+              }
+              replies++;
+            });
+    ASSERT_EQ(reply_shards.shard_count(), total_shards);
+
+    ASSERT_EQ(send_and_wait_for_replies(reply_shards, client, replies, total_requests),
+              total_requests);
+    ASSERT_EQ(reply_shards.outstanding_calls(), 0);
+    ASSERT_EQ(wrong_shard.load(), 0);
+  }
+
+  // the call of a request NCM never answers is recycled as well
+  server->Shutdown();
+  client.chan_ = grpc::CreateChannel("127.0.0.1:1", grpc::InsecureChannelCredentials());
+  client.stub_ = GoalStateProvisioner::NewStub(client.chan_);
+  ACA_On_Demand_Reply_Shards reply_shards(1, [](AsyncClientCall *call, bool ok) {});
+  HostRequest request;
+  request.add_state_requests()->set_request_id("1");
+  reply_shards.send(&client, &request, 1);
+  for (int i = 0; i < 100000 && reply_shards.outstanding_calls() > 0; i++) {
+    usleep(100);
+  }
+  ASSERT_EQ(reply_shards.outstanding_calls(), 0);
+}
+
+TEST(aca_on_demand_testcases, DISABLED_reply_shards_load_test)
+{
+  const int total_requests = 100000;
+  const size_t shard_counts[] = { 1, 2, 4, 8 };
+  Stand_In_NCM ncm;
+  GoalStateProvisionerClientImpl client;
+  std::unique_ptr<grpc::Server> server = start_stand_in_ncm(ncm, client);
+
+  for (size_t shard_count : shard_counts) {
+    std::atomic<int> replies(0);
+    ACA_On_Demand_Reply_Shards reply_shards(shard_count, [&replies](AsyncClientCall *call, bool ok) {
+      uint64_t request_id = 0;
+      // the same work as the engine does before it schedules the reply
+      for (int i = 0; ok && call->status.ok() && i < call->reply.operation_statuses_size(); i++) {
+        if (ACA_On_Demand_Engine::parse_request_id(
+                    call->reply.operation_statuses(i).request_id(), request_id)) {
+          replies++;
+        }
+      }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    int total_replies = send_and_wait_for_replies(reply_shards, client, replies, total_requests);
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+    ASSERT_EQ(total_replies, total_requests);
+    ACA_LOG_INFO("%ld shard(s): %d replies in %ld us, %.0f replies/s\n", shard_count,
+                 total_replies, elapsed_us, total_replies * 1000000.0 / elapsed_us);
+    ASSERT_EQ(reply_shards.outstanding_calls(), 0);
+  }
+}
+
+TEST(aca_on_demand_testcases, request_batcher_window_size_and_flow_control)
+{
+  std::mutex batches_mutex;
+  std::vector<std::vector<std::string> > batches;
+  std::vector<uint64_t> batch_ids;
+  auto send = [&](HostRequest *request, uint64_t batch_id) {
+    std::vector<std::string> request_ids;
+    for (int i = 0; i < request->state_requests_size(); i++) {
+      request_ids.push_back(request->state_requests(i).request_id());
+    }
+    std::lock_guard<std::mutex> lock(batches_mutex);
+    batches.push_back(request_ids);
+    batch_ids.push_back(batch_id);
+    return true;
+  };
+  auto total_batches = [&]() {
+    std::lock_guard<std::mutex> lock(batches_mutex);
+    return batches.size();
+  };
+  auto wait_for_batches = [&](size_t count) {
+    // one second at most
+    for (int i = 0; i < 10000 && total_batches() < count; i++) {
+      usleep(100);
+    }
+    return total_batches() == count;
+  };
+
+  // a window of 50 ms, 4 requests per batch, 2 batches waiting for their reply
+  // and 10 requests waiting for their batch at most
+  ACA_On_Demand_Request_Batcher batcher(send, 50000, 4, 2, 10);
+  HostRequest_ResourceStateRequest state_request;
+  ASSERT_TRUE(batcher.enabled());
+
+  // a full batch goes right away
+  for (uint64_t request_id = 1; request_id <= 4; request_id++) {
+    state_request.set_request_id(std::to_string(request_id));
+    ASSERT_TRUE(batcher.add(request_id, state_request));
+  }
+  ASSERT_TRUE(wait_for_batches(1));
+  ASSERT_EQ(batches[0], std::vector<std::string>({ "1", "2", "3", "4" }));
+  ASSERT_EQ(batch_ids[0], 1);
+
+  // a partial batch waits for the end of its window
+  state_request.set_request_id("5");
+  ASSERT_TRUE(batcher.add(5, state_request));
+  usleep(5000);
+  ASSERT_EQ(total_batches(), 1);
+  ASSERT_TRUE(wait_for_batches(2));
+  ASSERT_EQ(batches[1], std::vector<std::string>({ "5" }));
+  ASSERT_EQ(batch_ids[1], 5);
+
+  // with 2 batches outstanding the requests pile up until the pending limit
+  for (uint64_t request_id = 6; request_id <= 15; request_id++) {
+    state_request.set_request_id(std::to_string(request_id));
+    ASSERT_TRUE(batcher.add(request_id, state_request));
+  }
+  state_request.set_request_id("16");
+  ASSERT_FALSE(batcher.add(16, state_request));
+  usleep(60000);
+  ASSERT_EQ(total_batches(), 2);
+  ASSERT_EQ(batcher.outstanding(), 2);
+  ASSERT_EQ(batcher.pending(), 10);
+
+  // every reply lets one more batch go
+  ASSERT_FALSE(batcher.complete(12345));
+  ASSERT_TRUE(batcher.complete(1));
+  ASSERT_TRUE(wait_for_batches(3));
+  ASSERT_EQ(batches[2], std::vector<std::string>({ "6", "7", "8", "9" }));
+  ASSERT_TRUE(batcher.complete(5));
+  ASSERT_TRUE(wait_for_batches(4));
+  ASSERT_EQ(batch_ids[3], 10);
+  ASSERT_TRUE(batcher.complete(6));
+  ASSERT_TRUE(wait_for_batches(5));
+  ASSERT_EQ(batches[4], std::vector<std::string>({ "14", "15" }));
+  ASSERT_EQ(batcher.pending(), 0);
+  ASSERT_EQ(batcher.outstanding(), 2);
+
+  // no window, no batching
+  ACA_On_Demand_Request_Batcher unbatched(send, 0, 4, 2, 10);
+  ASSERT_FALSE(unbatched.enabled());
+  ASSERT_FALSE(unbatched.add(17, state_request));
+}
+
+TEST(aca_on_demand_testcases, request_batcher_failed_send_gives_slot_back)
+{
+  std::atomic<int> sends(0);
+  // the first batch can't be sent, NCM is unreachable
+  auto send = [&](HostRequest *request, uint64_t batch_id) { return sends++ > 0; };
+
+  // a single batch waiting for its reply at most
+  ACA_On_Demand_Request_Batcher batcher(send, 1000, 4, 1, 10);
+  HostRequest_ResourceStateRequest state_request;
+
+  state_request.set_request_id("1");
+  ASSERT_TRUE(batcher.add(1, state_request));
+  // one second at most
+  for (int i = 0; i < 10000 && sends < 1; i++) {
+    usleep(100);
+  }
+  ASSERT_EQ(sends, 1);
+
+  // the failed batch doesn't hold the only slot, the next one goes
+  state_request.set_request_id("2");
+  ASSERT_TRUE(batcher.add(2, state_request));
+  for (int i = 0; i < 10000 && sends < 2; i++) {
+    usleep(100);
+  }
+  ASSERT_EQ(sends, 2);
+  ASSERT_EQ(batcher.outstanding(), 1);
+  ASSERT_TRUE(batcher.complete(2));
+  ASSERT_EQ(batcher.outstanding(), 0);
+}
+
+TEST(aca_on_demand_testcases, DISABLED_request_batcher_load_test)
+{
+  const int total_requests = 100000;
+  // 0 sends every request in its own call
+  const uint64_t batch_windows_us[] = { 0, 100, 500, 1000, 5000 };
+  Stand_In_NCM ncm;
+  GoalStateProvisionerClientImpl client;
+  std::unique_ptr<grpc::Server> server = start_stand_in_ncm(ncm, client);
+
+  for (uint64_t window_us : batch_windows_us) {
+    // request ids go from 1 to total_requests
+    std::vector<std::chrono::steady_clock::time_point> sent_times(total_requests + 1);
+    std::mutex latencies_mutex;
+    std::vector<int64_t> latencies_us;
+    std::atomic<int> calls(0);
+    std::unique_ptr<ACA_On_Demand_Request_Batcher> batcher;
+
+    ACA_On_Demand_Reply_Shards reply_shards(ON_DEMAND_REPLY_SHARD_COUNT, [&](AsyncClientCall *call, bool ok) {
+      auto now = std::chrono::steady_clock::now();
+      uint64_t request_id = 0;
+      calls++;
+      batcher->complete(call->request_id);
+      for (int i = 0; ok && call->status.ok() && i < call->reply.operation_statuses_size(); i++) {
+        if (ACA_On_Demand_Engine::parse_request_id(
+                    call->reply.operation_statuses(i).request_id(), request_id)) {
+          std::lock_guard<std::mutex> lock(latencies_mutex);
+          latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         now - sent_times[request_id])
+                                         .count());
+        }
+      }
+    });
+    batcher.reset(new ACA_On_Demand_Request_Batcher(
+            [&](HostRequest *request, uint64_t batch_id) {
+              return reply_shards.send(&client, request, batch_id);
+            },
+            window_us, ON_DEMAND_BATCH_MAX_REQUESTS, ON_DEMAND_BATCH_MAX_OUTSTANDING,
+            ON_DEMAND_BATCH_MAX_PENDING_REQUESTS));
+
+    auto start = std::chrono::steady_clock::now();
+    HostRequest_ResourceStateRequest state_request;
+    for (uint64_t request_id = 1; request_id <= total_requests; request_id++) {
+      state_request.set_request_id(ACA_On_Demand_Engine::request_id_to_string(request_id));
+      sent_times[request_id] = std::chrono::steady_clock::now();
+      if (!batcher->add(request_id, state_request)) {
+        HostRequest request;
+        *request.add_state_requests() = state_request;
+        reply_shards.send(&client, &request, request_id);
+      }
+    }
+    // 30 seconds at most
+    size_t total_replies = 0;
+    for (int i = 0; i < 300000 && total_replies < total_requests; i++) {
+      usleep(100);
+      std::lock_guard<std::mutex> lock(latencies_mutex);
+      total_replies = latencies_us.size();
+    }
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    // the flusher sends through reply_shards, stop it first
+    batcher->shutdown();
+
+    std::lock_guard<std::mutex> lock(latencies_mutex);
+    ASSERT_EQ(latencies_us.size(), total_requests);
+    std::sort(latencies_us.begin(), latencies_us.end());
+    ACA_LOG_INFO("Batch window %ld us: %d requests in %d calls, %.0f requests/s, p50 %ld us, p99 %ld us\n",
+                 window_us, total_requests, calls.load(),
+                 total_requests * 1000000.0 / elapsed_us, latencies_us[total_requests / 2],
+                 latencies_us[total_requests * 99 / 100]);
+  }
+}
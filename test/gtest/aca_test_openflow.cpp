@@ -12,6 +12,7 @@
 //     FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //     WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include "aca_config.h"
 #include "aca_util.h"
 #include "gtest/gtest.h"
 //#include "ovs_control.h"
@@ -23,6 +24,22 @@
 #undef ARRAY_SIZE
 #undef ROUND_UP
 #include "aca_ovs_control.h"
+#include "of_packet_in.h"
+#include "of_packet_out.h"
+#include "of_flow_builder.h"
+#include "of_flow_completion.h"
+#include "of_group_mod.h"
+#include "of_message.h"
+#include "of_send_queue.h"
+#include "libfluid-msg/of13msg.hh"
+#include <openvswitch/ofp-parse.h>
+#include <openvswitch/ofp-util.h>
+#include <openvswitch/ofpbuf.h>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
 
 using namespace std;
 using namespace aca_ovs_control;
@@ -193,4 +210,1094 @@ TEST(ovs_flow_mod_cases, add_delete_flows_l2_neighbor)
   overall_rc = ACA_OVS_Control::get_instance().flow_exists(
           "br-tun", flow_exists_match_string.c_str());
   EXPECT_NE(overall_rc, EXIT_SUCCESS);
-}
\ No newline at end of file
+}
+
+//
+// Test suite: ovs_packet_in_cases
+//
+// Testing the zero copy packet-in view against the libfluid packet-in codec
+//
+// build an OpenFlow 1.3 packet-in the way ovs sends it, with an in_port match
+static uint8_t *build_packet_in(uint32_t in_port, uint8_t *frame, size_t frame_len, size_t &len)
+{
+  const size_t match_len = 4 + 8; // match header + in_port oxm
+  const size_t frame_offset = 24 + 16 + 2; // padded match + 2 bytes of padding
+  len = frame_offset + frame_len;
+  uint8_t *data = new uint8_t[len];
+  memset(data, 0, len);
+
+  data[0] = fluid_msg::of13::OFP_VERSION;
+  data[1] = fluid_msg::of13::OFPT_PACKET_IN;
+  *(uint16_t *)(data + 2) = htons(len);
+  *(uint32_t *)(data + 4) = htonl(1); // xid
+  *(uint32_t *)(data + 8) = htonl(0xffffffff); // buffer_id
+  *(uint16_t *)(data + 12) = htons(frame_len); // total_len
+  data[14] = fluid_msg::of13::OFPR_ACTION;
+  data[15] = 20; // table_id
+  uint64_t cookie = htobe64(0x1234567890abcdefULL);
+  memcpy(data + 16, &cookie, sizeof(cookie));
+  *(uint16_t *)(data + 24) = htons(fluid_msg::of13::OFPMT_OXM);
+  *(uint16_t *)(data + 26) = htons(match_len);
+  *(uint16_t *)(data + 28) = htons(fluid_msg::of13::OFPXMC_OPENFLOW_BASIC);
+  data[30] = fluid_msg::of13::OFPXMT_OFB_IN_PORT << 1;
+  data[31] = 4;
+  *(uint32_t *)(data + 32) = htonl(in_port);
+  memcpy(data + frame_offset, frame, frame_len);
+  return data;
+}
+
+TEST(ovs_packet_in_cases, packet_in_view_decode)
+{
+  uint8_t frame[64];
+  size_t len;
+  bool released = false;
+
+  for (size_t i = 0; i < sizeof(frame); i++) {
+    frame[i] = i;
+  }
+  uint8_t *data = build_packet_in(7, frame, sizeof(frame), len);
+
+  {
+    packet_in_ptr_t pin = PacketInView::create(data, len, [&](void *d) {
+      released = true;
+      fluid_msg::OFMsg::free_buffer((uint8_t *)d);
+    });
+    ASSERT_TRUE(pin != nullptr);
+    EXPECT_EQ(pin->in_port(), 7);
+    EXPECT_EQ(pin->cookie(), 0x1234567890abcdefULL);
+    EXPECT_EQ(pin->table_id(), 20);
+    EXPECT_EQ(pin->reason(), fluid_msg::of13::OFPR_ACTION);
+    EXPECT_EQ(pin->buffer_id(), 0xffffffff);
+    ASSERT_EQ(pin->frame_len(), sizeof(frame));
+    // the frame points into the received message, not into a copy
+    EXPECT_EQ(memcmp(pin->frame(), frame, sizeof(frame)), 0);
+    EXPECT_TRUE(pin->frame() > data && pin->frame() < data + len);
+
+    // a reference held by a handler keeps the buffer alive
+    packet_in_ptr_t handler_ref = pin;
+    pin.reset();
+    EXPECT_FALSE(released);
+  }
+  EXPECT_TRUE(released);
+}
+
+TEST(ovs_packet_in_cases, packet_in_view_malformed)
+{
+  uint8_t frame[64] = { 0 };
+  size_t len;
+  int released = 0;
+  auto release = [&](void *d) {
+    released++;
+    fluid_msg::OFMsg::free_buffer((uint8_t *)d);
+  };
+
+  // truncated message
+  uint8_t *data = build_packet_in(7, frame, sizeof(frame), len);
+  EXPECT_TRUE(PacketInView::create(data, 20, release) == nullptr);
+
+  // not a packet-in
+  data = build_packet_in(7, frame, sizeof(frame), len);
+  data[1] = fluid_msg::of13::OFPT_FLOW_MOD;
+  EXPECT_TRUE(PacketInView::create(data, len, release) == nullptr);
+
+  // the buffer is given back even when the message is rejected
+  EXPECT_EQ(released, 2);
+}
+
+/*
+  Packet-ins per second on one core, for the previous path (heap allocated
+  libfluid PacketIn, unpack() copying the frame and decoding the match into
+  heap allocated oxm fields) and for PacketInView.
+  Run it with --gtest_also_run_disabled_tests --gtest_filter=*packet_in_benchmark
+*/
+TEST(ovs_packet_in_cases, DISABLED_packet_in_benchmark)
+{
+  const int total_packets = 1000000;
+  uint8_t frame[128] = { 0 };
+  size_t len;
+  uint64_t checksum = 0;
+  uint8_t *data = build_packet_in(7, frame, sizeof(frame), len);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_packets; i++) {
+    fluid_msg::of13::PacketIn *pin = new fluid_msg::of13::PacketIn();
+    pin->unpack(data);
+    checksum += pin->match().in_port()->value() + ((uint8_t *)pin->data())[0];
+    delete pin;
+  }
+  auto unpack_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_packets; i++) {
+    packet_in_ptr_t pin = PacketInView::create(data, len, nullptr);
+    checksum += pin->in_port() + pin->frame()[0];
+  }
+  auto view_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+  fluid_msg::OFMsg::free_buffer(data);
+
+  printf("libfluid PacketIn unpack: %.0f packet-ins/s\n", total_packets * 1e6 / unpack_us);
+  printf("PacketInView:             %.0f packet-ins/s\n", total_packets * 1e6 / view_us);
+  printf("checksum %lu\n", checksum);
+}
+
+//
+// Test suite: ovs_packet_out_cases
+//
+// Testing the binary packet-out encoder against the ofp text parser of ovs
+//
+// hex string of a frame, the way the packet-out producers used to build it
+static string packet_to_hex(const uint8_t *packet, size_t len)
+{
+  string hex;
+  char str[3];
+  for (size_t i = 0; i < len; i++) {
+    sprintf(str, "%02x", packet[i]);
+    hex.append(str);
+  }
+  return hex;
+}
+
+TEST(ovs_packet_out_cases, packet_out_encode_matches_ofp_parser)
+{
+  uint8_t frame[60];
+  for (size_t i = 0; i < sizeof(frame); i++) {
+    frame[i] = i;
+  }
+  const string options[] = { "actions=output:5", "actions=resubmit(,22)" };
+  const packet_out_actions_t actions[] = { { PacketOutAction::output(5) },
+                                           { PacketOutAction::resubmit(22) } };
+
+  for (int i = 0; i < 2; i++) {
+    ofbuf_ptr_t parsed = create_packet_out(
+            ("in_port=controller packet=" + packet_to_hex(frame, sizeof(frame)) + " " + options[i])
+                    .c_str());
+    std::vector<uint8_t> encoded;
+    ASSERT_TRUE(encode_packet_out(encoded, 0, OF13_PORT_CONTROLLER, frame,
+                                  sizeof(frame), actions[i]));
+
+    // everything but the xid is the same
+    ASSERT_EQ(encoded.size(), parsed->len());
+    uint8_t *parsed_data = static_cast<uint8_t *>(parsed->data());
+    EXPECT_EQ(memcmp(encoded.data(), parsed_data, 4), 0) << options[i];
+    EXPECT_EQ(memcmp(encoded.data() + 8, parsed_data + 8, encoded.size() - 8), 0)
+            << options[i];
+  }
+
+  // messages are appended back to back
+  std::vector<uint8_t> batch;
+  ASSERT_TRUE(encode_packet_out(batch, 1, OF13_PORT_CONTROLLER, frame, sizeof(frame),
+                                actions[0]));
+  size_t first_len = batch.size();
+  ASSERT_TRUE(encode_packet_out(batch, 2, OF13_PORT_CONTROLLER, frame, sizeof(frame),
+                                actions[1]));
+  ASSERT_EQ(batch.size(), 2 * first_len);
+  EXPECT_EQ(ntohs(*(uint16_t *)(batch.data() + first_len + 2)), first_len);
+  EXPECT_EQ(ntohl(*(uint32_t *)(batch.data() + first_len + 4)), 2);
+
+  // too large for the 16 bits length
+  std::vector<uint8_t> jumbo(0x10000);
+  ASSERT_FALSE(encode_packet_out(batch, 3, OF13_PORT_CONTROLLER, jumbo.data(),
+                                 jumbo.size(), actions[0]));
+  ASSERT_EQ(batch.size(), 2 * first_len);
+}
+
+/*
+  Packet-outs per second on one core, for the previous path (frame printed as
+  hex, ofp text parsed back by parse_ofp_packet_out_str and encoded by ovs)
+  and for encode_packet_out.
+  Run it with --gtest_also_run_disabled_tests --gtest_filter=*packet_out_benchmark
+*/
+TEST(ovs_packet_out_cases, DISABLED_packet_out_benchmark)
+{
+  const int total_packets = 200000;
+  uint8_t frame[342] = { 0 }; // size of a dhcp reply
+  uint64_t checksum = 0;
+  packet_out_actions_t actions = { PacketOutAction::output(5) };
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_packets; i++) {
+    string options = "in_port=controller packet=" + packet_to_hex(frame, sizeof(frame)) +
+                     " actions=output:5";
+    ofbuf_ptr_t po = create_packet_out(options.c_str());
+    checksum += po->len();
+  }
+  auto parse_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> po;
+  for (int i = 0; i < total_packets; i++) {
+    po.clear();
+    encode_packet_out(po, i, OF13_PORT_CONTROLLER, frame, sizeof(frame), actions);
+    checksum += po.size();
+  }
+  auto encode_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  printf("hex + parse_ofp_packet_out_str: %.0f packet-outs/s\n", total_packets * 1e6 / parse_us);
+  printf("encode_packet_out:              %.0f packet-outs/s\n", total_packets * 1e6 / encode_us);
+  printf("checksum %lu\n", checksum);
+}
+
+//
+// Test suite: ovs_flow_builder_cases
+//
+// Testing the flow-mods of FlowBuilder against the ones parsed from the
+// same flows in the ovs-ofctl syntax
+//
+struct Flow_Builder_Case {
+  FlowBuilder flow;
+  string flow_string;
+  string action;
+};
+
+static std::vector<Flow_Builder_Case> get_flow_builder_cases()
+{
+  const string gw_mac = "fa:16:3e:d7:f2:00";
+  const string dvr_mac = "fe:16:11:00:00:01";
+  std::vector<Flow_Builder_Case> cases;
+
+  // l2 neighbor
+  cases.push_back({ FlowBuilder()
+                            .table(20)
+                            .priority(50)
+                            .dl_vlan(2)
+                            .dl_dst(vmac_address_1)
+                            .strip_vlan()
+                            .load_tun_id(20)
+                            .set_tun_dst(remote_ip_1)
+                            .output(VXLAN_GENERIC_OUTPORT_NUMBER),
+                    "table=20,priority=50,dl_vlan=2,dl_dst:" + vmac_address_1 +
+                            ",actions=strip_vlan,load:20->NXM_NX_TUN_ID[],set_field:" +
+                            remote_ip_1 + "->tun_dst,output:" + VXLAN_GENERIC_OUTPORT_NUMBER,
+                    "add" });
+  cases.push_back({ FlowBuilder().table(20).priority(50).dl_vlan(2).dl_dst(vmac_address_1),
+                    "table=20,priority=50,dl_vlan=2,dl_dst:" + vmac_address_1, "del" });
+  // tunnel ingress
+  cases.push_back({ FlowBuilder().table(4).priority(1).tun_id(20).mod_vlan_vid(2).output(1),
+                    "table=4, priority=1,tun_id=20 actions=mod_vlan_vid:2,output:1", "add" });
+  // icmp responder
+  cases.push_back({ FlowBuilder()
+                            .table(52)
+                            .priority(50)
+                            .icmp()
+                            .dl_vlan(2)
+                            .nw_dst(vip_address_1)
+                            .move_dl_src_to_dst()
+                            .mod_dl_src(gw_mac)
+                            .move_nw_src_to_dst()
+                            .mod_nw_src(vip_address_1)
+                            .load_nw_ttl(0xff)
+                            .load_icmp_type(0)
+                            .output(FLOW_PORT_IN_PORT),
+                    "table=52,priority=50,icmp,dl_vlan=2,nw_dst=" + vip_address_1 +
+                            " actions=move:NXM_OF_ETH_SRC[]->NXM_OF_ETH_DST[],mod_dl_src:" + gw_mac +
+                            ",move:NXM_OF_IP_SRC[]->NXM_OF_IP_DST[],mod_nw_src:" + vip_address_1 +
+                            ",load:0xff->NXM_NX_IP_TTL[],load:0->NXM_OF_ICMP_TYPE[],in_port",
+                    "add" });
+  // dvr
+  cases.push_back({ FlowBuilder()
+                            .table(0)
+                            .priority(25)
+                            .dl_vlan(2)
+                            .dl_src(string() + HOST_DVR_MAC_MATCH)
+                            .mod_dl_src(gw_mac)
+                            .output(FLOW_PORT_NORMAL),
+                    "table=0,priority=25,dl_vlan=2,dl_src=" + string() + HOST_DVR_MAC_MATCH +
+                            " actions=mod_dl_src:" + gw_mac + " output:NORMAL",
+                    "add" });
+  cases.push_back({ FlowBuilder()
+                            .table(0)
+                            .priority(50)
+                            .ip()
+                            .dl_vlan(2)
+                            .nw_dst("10.0.1.0/24")
+                            .dl_dst(gw_mac)
+                            .mod_vlan_vid(3)
+                            .mod_dl_src(dvr_mac)
+                            .mod_dl_dst(vmac_address_1)
+                            .resubmit(2),
+                    "table=0,priority=50,ip,dl_vlan=2,nw_dst=10.0.1.0/24,dl_dst=" + gw_mac +
+                            " actions=mod_vlan_vid:3,mod_dl_src:" + dvr_mac +
+                            ",mod_dl_dst:" + vmac_address_1 + ",resubmit(,2)",
+                    "add" });
+  cases.push_back({ FlowBuilder()
+                            .table(0)
+                            .priority(25)
+                            .ip()
+                            .dl_vlan(2)
+                            .nw_dst(vip_address_1)
+                            .dl_dst(gw_mac)
+                            .mod_vlan_vid(3)
+                            .mod_dl_src(gw_mac)
+                            .mod_dl_dst(vmac_address_1)
+                            .output(FLOW_PORT_IN_PORT),
+                    "table=0,priority=25,ip,dl_vlan=2,nw_dst=" + vip_address_1 + ",dl_dst=" +
+                            gw_mac + " actions=mod_vlan_vid:3,mod_dl_src:" + gw_mac +
+                            ",mod_dl_dst:" + vmac_address_1 + ",output:IN_PORT",
+                    "add" });
+  cases.push_back({ FlowBuilder().table(52).priority(50).icmp().dl_vlan(2).nw_dst(vip_address_1),
+                    "table=52,priority=50,icmp,dl_vlan=2,nw_dst=" + vip_address_1, "del" });
+  // cookie, timeout and a modify
+  cases.push_back({ FlowBuilder()
+                            .table(2)
+                            .priority(10)
+                            .cookie(0x1234)
+                            .idle_timeout(30)
+                            .udp()
+                            .tp_dst(67)
+                            .output(FLOW_PORT_CONTROLLER),
+                    "table=2,priority=10,cookie=0x1234,idle_timeout=30,udp,udp_dst=67,actions=CONTROLLER",
+                    "mod" });
+  return cases;
+}
+
+static void expect_same_flow_mod(ofmsg_ptr_t expected, ofmsg_ptr_t actual, const string &flow)
+{
+  expected->set_xid(7);
+  actual->set_xid(7);
+  ofbuf_ptr_t expected_buf = expected->pack();
+  ofbuf_ptr_t actual_buf = actual->pack();
+  ASSERT_TRUE(expected_buf != nullptr) << flow;
+  ASSERT_TRUE(actual_buf != nullptr) << flow;
+  ASSERT_EQ(expected_buf->len(), actual_buf->len()) << flow;
+  EXPECT_EQ(memcmp(expected_buf->data(), actual_buf->data(), actual_buf->len()), 0) << flow;
+}
+
+TEST(ovs_flow_builder_cases, flow_builder_encode_matches_ofp_parser)
+{
+  for (auto &test_case : get_flow_builder_cases()) {
+    ASSERT_TRUE(test_case.flow.valid()) << test_case.flow_string;
+    expect_same_flow_mod(create_flow_mod(test_case.flow_string, test_case.action),
+                         create_flow_mod(test_case.flow, test_case.action),
+                         test_case.flow_string);
+
+    // the text form of the builder parses back to the same flow-mod
+    string builder_string = test_case.flow.to_string(test_case.action != "del");
+    expect_same_flow_mod(create_flow_mod(builder_string, test_case.action),
+                         create_flow_mod(test_case.flow, test_case.action), builder_string);
+  }
+
+  EXPECT_TRUE(create_flow_mod(FlowBuilder().table(20), "replace") == nullptr);
+}
+
+TEST(ovs_flow_builder_cases, flow_builder_rejects_malformed_values)
+{
+  EXPECT_FALSE(FlowBuilder().dl_dst("fa:16:3e:d7:f2").valid());
+  EXPECT_FALSE(FlowBuilder().nw_dst("10.0.0.256").valid());
+  EXPECT_FALSE(FlowBuilder().nw_dst("10.0.0.0/33").valid());
+  EXPECT_FALSE(FlowBuilder().dl_vlan(4096).valid());
+  EXPECT_FALSE(FlowBuilder().output("").valid());
+  EXPECT_FALSE(FlowBuilder().output("patch-int").valid());
+  // a mac or an ip to set has to be exact
+  EXPECT_FALSE(FlowBuilder().mod_dl_src(string() + HOST_DVR_MAC_MATCH).valid());
+  EXPECT_FALSE(FlowBuilder().set_tun_dst("10.0.0.0/8").valid());
+
+  // the flow-mod of a malformed flow is dropped
+  ofmsg_ptr_t flow_mod = create_add_flow(FlowBuilder().table(20).output(""));
+  EXPECT_TRUE(flow_mod->pack() == nullptr);
+}
+
+//
+// Test suite: ovs_group_mod_cases
+//
+// Testing the group-mods encoded without ovs-ofctl against the ones of the ofp parser
+//
+static std::vector<uint8_t> parse_group_mod(int command, const string &group_str,
+                                            enum ofp_version version)
+{
+  struct ofputil_group_mod gm;
+  enum ofputil_protocol usable_protocols;
+  std::vector<uint8_t> encoded;
+
+  char *error = parse_ofp_group_mod_str(&gm, command, group_str.c_str(), NULL, &usable_protocols);
+  if (error) {
+    ADD_FAILURE() << group_str << ": " << error;
+    free(error);
+    return encoded;
+  }
+  struct ofpbuf *msg = ofputil_encode_group_mod(version, &gm);
+  encoded.assign((uint8_t *)msg->data, (uint8_t *)msg->data + msg->size);
+  ofpbuf_delete(msg);
+  ofputil_uninit_group_mod(&gm);
+  return encoded;
+}
+
+static GroupBucket zeta_test_bucket(uint32_t bucket_id, const string &ip, const string &mac)
+{
+  return GroupBucket(bucket_id, FlowBuilder().set_tun_dst(ip).mod_dl_dst(mac).output(100));
+}
+
+static void expect_same_group_mod(const std::vector<uint8_t> &expected,
+                                  const std::vector<uint8_t> &actual, const string &group_str)
+{
+  // everything but the xid is the same
+  ASSERT_EQ(expected.size(), actual.size()) << group_str;
+  EXPECT_EQ(memcmp(expected.data(), actual.data(), 4), 0) << group_str;
+  EXPECT_EQ(memcmp(expected.data() + 8, actual.data() + 8, actual.size() - 8), 0) << group_str;
+}
+
+TEST(ovs_group_mod_cases, group_mod_encode_matches_ofp_parser)
+{
+  std::vector<GroupBucket> buckets = {
+    zeta_test_bucket(0, "10.0.0.1", "aa:bb:cc:dd:ee:01"),
+    zeta_test_bucket(1, "10.0.0.2", "aa:bb:cc:dd:ee:02"),
+  };
+  string bucket_str[] = {
+    "set_field:10.0.0.1->tun_dst,mod_dl_dst:aa:bb:cc:dd:ee:01,output:100",
+    "set_field:10.0.0.2->tun_dst,mod_dl_dst:aa:bb:cc:dd:ee:02,output:100",
+  };
+
+  // the zeta group as _create_zeta_group_entry used to add it
+  string group_str = "group_id=7,type=select,bucket=" + bucket_str[0] + ",bucket=" + bucket_str[1];
+  std::vector<uint8_t> encoded;
+  ASSERT_TRUE(encode_group_mod(encoded, OF13_GROUP_VERSION, 0, GROUP_MOD_ADD,
+                               OF_GROUP_TYPE_SELECT, 7, buckets));
+  expect_same_group_mod(parse_group_mod(OFPGC11_ADD, group_str, OFP13_VERSION), encoded, group_str);
+
+  encoded.clear();
+  ASSERT_TRUE(encode_group_mod(encoded, OF13_GROUP_VERSION, 0, GROUP_MOD_DELETE,
+                               OF_GROUP_TYPE_ALL, 7, std::vector<GroupBucket>()));
+  expect_same_group_mod(parse_group_mod(OFPGC11_DELETE, "group_id=7", OFP13_VERSION), encoded,
+                        "group_id=7");
+
+  // the same group over OpenFlow 1.5, with its bucket ids
+  group_str = "group_id=7,type=select,bucket=bucket_id:0,actions=" + bucket_str[0] +
+              ",bucket=bucket_id:1,actions=" + bucket_str[1];
+  encoded.clear();
+  ASSERT_TRUE(encode_group_mod(encoded, OF15_GROUP_VERSION, 0, GROUP_MOD_ADD,
+                               OF_GROUP_TYPE_SELECT, 7, buckets));
+  expect_same_group_mod(parse_group_mod(OFPGC11_ADD, group_str, OFP15_VERSION), encoded, group_str);
+}
+
+TEST(ovs_group_mod_cases, group_mod_sends_only_the_buckets_changed)
+{
+  std::vector<uint8_t> bucket;
+  ASSERT_TRUE(encode_group_bucket(bucket, OF15_GROUP_VERSION, OF_GROUP_TYPE_SELECT,
+                                  zeta_test_bucket(9, "10.0.0.9", "aa:bb:cc:dd:ee:09")));
+
+  // an insert carries the new bucket only, after the last one of the group
+  std::vector<uint8_t> insert;
+  ASSERT_TRUE(encode_group_mod(insert, OF15_GROUP_VERSION, 1, GROUP_MOD_INSERT_BUCKET,
+                               OF_GROUP_TYPE_SELECT, 7,
+                               { zeta_test_bucket(9, "10.0.0.9", "aa:bb:cc:dd:ee:09") },
+                               OF15_BUCKET_ID_LAST));
+  ASSERT_EQ(insert.size(), OF15_GROUP_MOD_HEADER_LEN + bucket.size());
+  EXPECT_EQ(insert[0], OF15_GROUP_VERSION);
+  EXPECT_EQ(insert[1], OF_GROUP_MOD_TYPE);
+  EXPECT_EQ(ntohs(*(uint16_t *)(insert.data() + 2)), insert.size());
+  EXPECT_EQ(ntohs(*(uint16_t *)(insert.data() + 8)), GROUP_MOD_INSERT_BUCKET);
+  EXPECT_EQ(ntohl(*(uint32_t *)(insert.data() + 12)), 7);
+  EXPECT_EQ(ntohs(*(uint16_t *)(insert.data() + 16)), bucket.size());
+  EXPECT_EQ(ntohl(*(uint32_t *)(insert.data() + 20)), OF15_BUCKET_ID_LAST);
+  EXPECT_EQ(memcmp(insert.data() + OF15_GROUP_MOD_HEADER_LEN, bucket.data(), bucket.size()), 0);
+  // the bucket keeps its id and the weight of a select group
+  EXPECT_EQ(ntohl(*(uint32_t *)(bucket.data() + 4)), 9);
+  EXPECT_EQ(ntohs(*(uint16_t *)(bucket.data() + bucket.size() - 4)), 1);
+
+  // a remove is the header alone, naming the bucket
+  std::vector<uint8_t> remove;
+  ASSERT_TRUE(encode_group_mod(remove, OF15_GROUP_VERSION, 2, GROUP_MOD_REMOVE_BUCKET,
+                               OF_GROUP_TYPE_SELECT, 7, NULL, 0, 9));
+  ASSERT_EQ(remove.size(), OF15_GROUP_MOD_HEADER_LEN);
+  EXPECT_EQ(ntohs(*(uint16_t *)(remove.data() + 8)), GROUP_MOD_REMOVE_BUCKET);
+  EXPECT_EQ(ntohl(*(uint32_t *)(remove.data() + 20)), 9);
+
+  // OpenFlow 1.3 has no bucket commands
+  std::vector<uint8_t> of13;
+  EXPECT_FALSE(encode_group_mod(of13, OF13_GROUP_VERSION, 3, GROUP_MOD_REMOVE_BUCKET,
+                                OF_GROUP_TYPE_SELECT, 7, NULL, 0, 9));
+  EXPECT_TRUE(of13.empty());
+
+  // actions a bucket can't have leave the message alone
+  EXPECT_FALSE(encode_group_bucket(of13, OF13_GROUP_VERSION, OF_GROUP_TYPE_SELECT,
+                                   GroupBucket(0, FlowBuilder().resubmit(22))));
+  EXPECT_FALSE(encode_group_bucket(of13, OF13_GROUP_VERSION, OF_GROUP_TYPE_SELECT,
+                                   GroupBucket(0, FlowBuilder().output("patch-int"))));
+  EXPECT_TRUE(of13.empty());
+}
+
+/*
+  Flow-mods encoded per second on one core, for a l2 neighbor flow written as
+  a string and parsed by parse_ofp_flow_mod_str and for the same flow built
+  with FlowBuilder.
+  Run it with --gtest_also_run_disabled_tests --gtest_filter=*flow_mod_benchmark
+*/
+TEST(ovs_flow_builder_cases, DISABLED_flow_mod_benchmark)
+{
+  const int total_flows = 100000;
+  uint64_t checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_flows; i++) {
+    string flow = "table=20,priority=50,dl_vlan=" + to_string(i % 4000 + 1) +
+                  ",dl_dst:" + vmac_address_1 + ",actions=strip_vlan,load:" +
+                  to_string(i) + "->NXM_NX_TUN_ID[],set_field:" + remote_ip_1 +
+                  "->tun_dst,output:" + VXLAN_GENERIC_OUTPORT_NUMBER;
+    checksum += create_add_flow(flow)->pack()->len();
+  }
+  auto parse_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_flows; i++) {
+    FlowBuilder flow;
+    flow.table(20)
+            .priority(50)
+            .dl_vlan(i % 4000 + 1)
+            .dl_dst(vmac_address_1)
+            .strip_vlan()
+            .load_tun_id(i)
+            .set_tun_dst(remote_ip_1)
+            .output(VXLAN_GENERIC_OUTPORT_NUMBER);
+    checksum += create_add_flow(flow)->pack()->len();
+  }
+  auto typed_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  printf("parse_ofp_flow_mod_str: %.0f flow-mods/s\n", total_flows * 1e6 / parse_us);
+  printf("FlowBuilder:            %.0f flow-mods/s\n", total_flows * 1e6 / typed_us);
+  printf("checksum %lu\n", checksum);
+}
+
+//
+// Test suite: ovs_flow_completion_cases
+//
+// Testing the completion of flow-mods by the OFPT_ERROR and OFPT_BARRIER_REPLY
+// messages the switch answers with
+//
+static std::vector<uint8_t> make_of13_message(uint8_t type, uint32_t xid, uint16_t error_type = 0,
+                                              uint16_t error_code = 0)
+{
+  std::vector<uint8_t> msg(type == OF13_ERROR_TYPE ? OF13_HEADER_LEN + 4 : OF13_HEADER_LEN);
+  uint16_t length = htons(msg.size());
+  uint32_t net_xid = htonl(xid);
+  msg[0] = 4;
+  msg[1] = type;
+  memcpy(&msg[2], &length, sizeof(length));
+  memcpy(&msg[4], &net_xid, sizeof(net_xid));
+  if (type == OF13_ERROR_TYPE) {
+    uint16_t net_type = htons(error_type);
+    uint16_t net_code = htons(error_code);
+    memcpy(&msg[8], &net_type, sizeof(net_type));
+    memcpy(&msg[10], &net_code, sizeof(net_code));
+  }
+  return msg;
+}
+
+TEST(ovs_flow_completion_cases, barrier_resolves_flows_and_errors_fail_them)
+{
+  FlowCompletionTracker tracker;
+  flow_completion_ptr_t completion = std::make_shared<FlowCompletion>(6);
+
+  // flows 0-2 sent one by one, flows 3-5 in a bundle committed with xid 20
+  tracker.add_flow(1, 10, completion, 0);
+  tracker.add_flow(1, 11, completion, 1);
+  tracker.add_flow(1, 12, completion, 2);
+  tracker.add_flow(1, 13, completion, 3);
+  tracker.add_flow(1, 14, completion, 4);
+  tracker.add_flow(1, 15, completion, 5);
+  tracker.add_flows(1, 20, completion, 3, 6);
+  tracker.add_barrier(1, 21, completion);
+  EXPECT_EQ(tracker.pending(), 8UL);
+
+  // an error for the same xid on another connection is not ours
+  auto error = make_of13_message(OF13_ERROR_TYPE, 11, 5, 1);
+  EXPECT_FALSE(tracker.on_message(2, error.data(), error.size()));
+  EXPECT_TRUE(tracker.on_message(1, error.data(), error.size()));
+  EXPECT_FALSE(completion->done());
+
+  // a bundle-add rejected, then its commit failed
+  auto bundle_add_error = make_of13_message(OF13_ERROR_TYPE, 14, 5, 6);
+  auto commit_error = make_of13_message(OF13_ERROR_TYPE, 20, 0xffff, 0);
+  EXPECT_TRUE(tracker.on_message(1, bundle_add_error.data(), bundle_add_error.size()));
+  EXPECT_TRUE(tracker.on_message(1, commit_error.data(), commit_error.size()));
+
+  auto barrier_reply = make_of13_message(OF13_BARRIER_REPLY_TYPE, 21);
+  EXPECT_TRUE(tracker.on_message(1, barrier_reply.data(), barrier_reply.size()));
+  EXPECT_TRUE(completion->wait_for(std::chrono::microseconds(0)));
+  EXPECT_EQ(tracker.pending(), 0UL);
+
+  EXPECT_EQ(completion->failed(), 4UL);
+  EXPECT_EQ(completion->error(0), 0U);
+  EXPECT_EQ(completion->error(1), 0x00050001U);
+  EXPECT_EQ(completion->error(2), 0U);
+  // a flow keeps the first error it got
+  EXPECT_EQ(completion->error(3), 0xffff0000U);
+  EXPECT_EQ(completion->error(4), 0x00050006U);
+  EXPECT_EQ(completion->error(5), 0xffff0000U);
+
+  // answers to the requests of a resolved completion are ignored
+  EXPECT_FALSE(tracker.on_message(1, barrier_reply.data(), barrier_reply.size()));
+}
+
+TEST(ovs_flow_completion_cases, closed_connection_fails_pending_flows)
+{
+  FlowCompletionTracker tracker;
+  flow_completion_ptr_t completion = std::make_shared<FlowCompletion>(2);
+  flow_completion_ptr_t other_completion = std::make_shared<FlowCompletion>(1);
+
+  tracker.add_flow(1, 10, completion, 0);
+  tracker.add_flow(1, 11, completion, 1);
+  tracker.add_barrier(1, 12, completion);
+  tracker.add_flow(2, 13, other_completion, 0);
+  tracker.add_barrier(2, 14, other_completion);
+
+  auto error = make_of13_message(OF13_ERROR_TYPE, 10, 5, 1);
+  EXPECT_TRUE(tracker.on_message(1, error.data(), error.size()));
+  EXPECT_FALSE(completion->wait_for(std::chrono::microseconds(1000)));
+
+  tracker.close_connection(1);
+  EXPECT_TRUE(completion->done());
+  EXPECT_EQ(completion->error(0), 0x00050001U);
+  EXPECT_EQ(completion->error(1), (uint32_t)FLOW_ERROR_CONNECTION_CLOSED);
+  EXPECT_FALSE(other_completion->done());
+  EXPECT_EQ(tracker.pending(), 2UL);
+
+  uint8_t barrier[OF13_HEADER_LEN];
+  FlowCompletionTracker::encode_barrier_request(barrier, 14);
+  EXPECT_EQ(barrier[1], OF13_BARRIER_REQUEST_TYPE);
+  EXPECT_EQ(FlowCompletionTracker::read_xid(barrier), 14U);
+  barrier[1] = OF13_BARRIER_REPLY_TYPE;
+  EXPECT_TRUE(tracker.on_message(2, barrier, sizeof(barrier)));
+  EXPECT_TRUE(other_completion->done());
+  EXPECT_EQ(other_completion->failed(), 0UL);
+}
+
+TEST(ovs_flow_completion_cases, unanswered_completions_expire)
+{
+  FlowCompletionTracker tracker(std::chrono::seconds(1));
+  flow_completion_ptr_t answered = std::make_shared<FlowCompletion>(1);
+  flow_completion_ptr_t unanswered = std::make_shared<FlowCompletion>(2);
+  auto start = std::chrono::steady_clock::now();
+
+  tracker.add_flow(1, 10, answered, 0);
+  tracker.add_barrier(1, 11, answered);
+  tracker.add_flow(1, 12, unanswered, 0);
+  tracker.add_flow(1, 13, unanswered, 1);
+  tracker.add_barrier(1, 14, unanswered);
+
+  auto barrier_reply = make_of13_message(OF13_BARRIER_REPLY_TYPE, 11);
+  EXPECT_TRUE(tracker.on_message(1, barrier_reply.data(), barrier_reply.size()));
+  auto error = make_of13_message(OF13_ERROR_TYPE, 12, 5, 1);
+  EXPECT_TRUE(tracker.on_message(1, error.data(), error.size()));
+
+  // the waiter timed out, the requests stay until they expire
+  EXPECT_FALSE(unanswered->wait_for(std::chrono::microseconds(1000)));
+  EXPECT_EQ(tracker.expire(start), 0UL);
+  EXPECT_EQ(tracker.pending(), 3UL);
+
+  EXPECT_EQ(tracker.expire(start + std::chrono::seconds(2)), 1UL);
+  EXPECT_EQ(tracker.pending(), 0UL);
+  EXPECT_TRUE(unanswered->done());
+  // the flows already failed keep their error
+  EXPECT_EQ(unanswered->error(0), 0x00050001U);
+  EXPECT_EQ(unanswered->error(1), (uint32_t)FLOW_ERROR_EXPIRED);
+
+  // a late answer is not ours any more
+  barrier_reply = make_of13_message(OF13_BARRIER_REPLY_TYPE, 14);
+  EXPECT_FALSE(tracker.on_message(1, barrier_reply.data(), barrier_reply.size()));
+  EXPECT_EQ(tracker.expire(start + std::chrono::seconds(4)), 0UL);
+}
+
+//
+// Test suite: ovs_flow_dump_cases
+//
+// Testing the flow stats request and reply of the reconcile pass
+//
+TEST(ovs_flow_dump_cases, flow_stats_request_asks_for_agent_flows)
+{
+  ofmsg_ptr_t request = create_flow_stats_request(OVS_FLOW_AGENT_COOKIE, OVS_FLOW_AGENT_COOKIE_MASK);
+  request->set_xid(42);
+  ofbuf_ptr_t buf = request->pack();
+  ASSERT_TRUE(buf != nullptr);
+  const uint8_t *msg = static_cast<const uint8_t *>(buf->data());
+
+  // OFPT_MULTIPART_REQUEST of type OFPMP_FLOW, for every table
+  ASSERT_GE(buf->len(), 48UL);
+  EXPECT_EQ(msg[0], 4);
+  EXPECT_EQ(msg[1], 18);
+  EXPECT_EQ(FlowCompletionTracker::read_xid(buf->data()), 42U);
+  EXPECT_EQ(msg[8] << 8 | msg[9], 1);
+  EXPECT_EQ(msg[16], 0xff);
+
+  uint64_t cookie, cookie_mask;
+  memcpy(&cookie, msg + 32, sizeof(cookie));
+  memcpy(&cookie_mask, msg + 40, sizeof(cookie_mask));
+  EXPECT_EQ(be64toh(cookie), OVS_FLOW_AGENT_COOKIE);
+  EXPECT_EQ(be64toh(cookie_mask), OVS_FLOW_AGENT_COOKIE_MASK);
+
+  // only flow stats replies are decoded
+  auto barrier_reply = make_of13_message(OF13_BARRIER_REPLY_TYPE, 42);
+  std::vector<DumpedFlow> flows;
+  bool more = false;
+  EXPECT_FALSE(decode_flow_stats_reply(barrier_reply.data(), flows, more));
+  EXPECT_TRUE(flows.empty());
+}
+
+//
+// Test suite: ovs_send_queue_cases
+//
+// Testing the per connection send queue against a fake switch reading the
+// other end of a socket pair
+//
+class Fake_OF_Switch {
+  public:
+  Fake_OF_Switch(int sndbuf = 0) : _received(0), _bytes(0), _out_of_order(0)
+  {
+    socketpair(AF_UNIX, SOCK_STREAM, 0, _fds);
+    fcntl(_fds[0], F_SETFL, fcntl(_fds[0], F_GETFL) | O_NONBLOCK);
+    if (sndbuf > 0) {
+      setsockopt(_fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+      setsockopt(_fds[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+    }
+  }
+
+  ~Fake_OF_Switch()
+  {
+    close(_fds[0]);
+    if (_reader.joinable()) {
+      _reader.join();
+    }
+    close(_fds[1]);
+  }
+
+  // the controller side, non blocking
+  int controller_fd()
+  {
+    return _fds[0];
+  }
+
+  // wait until the controller side can be written
+  void wait_for_room()
+  {
+    struct pollfd pfd = { _fds[0], POLLOUT, 0 };
+    poll(&pfd, 1, 100);
+  }
+
+  // writev on the controller side, 0 when the socket is full
+  ssize_t writev(const struct iovec *iov, int iovcnt)
+  {
+    ssize_t written = ::writev(_fds[0], iov, iovcnt);
+    if (written < 0) {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    return written;
+  }
+
+  /*
+   * read the openflow messages until "total" came in, the xid of a message
+   * holds the sender in its high byte and a sequence number in the others
+   */
+  void start(uint64_t total)
+  {
+    _reader = std::thread([this, total] {
+      std::vector<uint8_t> buf(64 * 1024);
+      std::vector<uint8_t> stream;
+      std::unordered_map<uint8_t, uint32_t> next_seq;
+      while (_received.load() < total) {
+        ssize_t n = read(_fds[1], buf.data(), buf.size());
+        if (n <= 0) {
+          break;
+        }
+        _bytes += n;
+        stream.insert(stream.end(), buf.begin(), buf.begin() + n);
+        size_t pos = 0;
+        while (stream.size() - pos >= 8) {
+          const uint8_t *msg = stream.data() + pos;
+          size_t len = msg[2] << 8 | msg[3];
+          if (stream.size() - pos < len) {
+            break;
+          }
+          uint8_t sender = msg[4];
+          uint32_t seq = msg[5] << 16 | msg[6] << 8 | msg[7];
+          if (seq != next_seq[sender]++) {
+            _out_of_order++;
+          }
+          _received++;
+          pos += len;
+        }
+        stream.erase(stream.begin(), stream.begin() + pos);
+      }
+    });
+  }
+
+  void wait()
+  {
+    _reader.join();
+  }
+
+  uint64_t received()
+  {
+    return _received.load();
+  }
+
+  uint64_t bytes()
+  {
+    return _bytes.load();
+  }
+
+  uint64_t out_of_order()
+  {
+    return _out_of_order.load();
+  }
+
+  private:
+  int _fds[2];
+  std::thread _reader;
+  std::atomic<uint64_t> _received;
+  std::atomic<uint64_t> _bytes;
+  std::atomic<uint64_t> _out_of_order;
+};
+
+// an openflow message of "len" bytes from "sender"
+static std::vector<uint8_t> build_of_message(uint8_t sender, uint32_t seq, size_t len)
+{
+  std::vector<uint8_t> msg(len, sender);
+  msg[0] = OF13_VERSION;
+  msg[1] = fluid_msg::of13::OFPT_FLOW_MOD;
+  msg[2] = len >> 8;
+  msg[3] = len;
+  msg[4] = sender;
+  msg[5] = seq >> 16;
+  msg[6] = seq >> 8;
+  msg[7] = seq;
+  return msg;
+}
+
+TEST(ovs_send_queue_cases, send_queue_keeps_order_and_coalesces)
+{
+  const int senders = 4;
+  const uint32_t messages_per_sender = 5000;
+  Fake_OF_Switch fake_switch;
+  OFSendQueue queue([&](const struct iovec *iov, int iovcnt) {
+    return fake_switch.writev(iov, iovcnt);
+  });
+  std::atomic<uint64_t> total_bytes(0);
+
+  fake_switch.start(senders * messages_per_sender);
+  std::vector<std::thread> threads;
+  for (int s = 0; s < senders; s++) {
+    threads.emplace_back([&, s] {
+      for (uint32_t i = 0; i < messages_per_sender; i++) {
+        // mix of small flow-mods and a few slots grown past the retained size
+        size_t len = (i % 100 == 0) ? 2000 : 16 + (i % 200);
+        auto msg = build_of_message(s, i, len);
+        ASSERT_TRUE(queue.send(msg.data(), msg.size()));
+        total_bytes += len;
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  fake_switch.wait();
+  // the counters are updated once writev returned
+  for (int i = 0; i < 1000 && queue.messages_sent() < senders * messages_per_sender; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(fake_switch.received(), senders * messages_per_sender);
+  EXPECT_EQ(fake_switch.out_of_order(), 0);
+  EXPECT_EQ(fake_switch.bytes(), total_bytes.load());
+  EXPECT_EQ(queue.messages_sent(), senders * messages_per_sender);
+  EXPECT_EQ(queue.bytes_sent(), total_bytes.load());
+  EXPECT_EQ(queue.dropped(), 0);
+  // the messages went out in batches
+  EXPECT_LT(queue.writes(), queue.messages_sent());
+
+  queue.shutdown();
+  uint8_t msg[8] = { 0 };
+  EXPECT_FALSE(queue.send(msg, sizeof(msg)));
+  // the controller frees the queue once its flusher exited
+  for (int i = 0; i < 1000 && !queue.finished(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(queue.finished());
+}
+
+TEST(ovs_send_queue_cases, send_queue_applies_backpressure)
+{
+  const size_t capacity = 16;
+  const size_t len = 1024;
+  Fake_OF_Switch fake_switch(4096);
+  OFSendQueue queue(
+          [&](const struct iovec *iov, int iovcnt) {
+            return fake_switch.writev(iov, iovcnt);
+          },
+          nullptr, capacity, 1, 10, 0, 20);
+
+  // nobody reads, the socket and then the ring fill up
+  uint32_t accepted = 0;
+  while (accepted < 10000) {
+    auto msg = build_of_message(0, accepted, len);
+    if (!queue.send(msg.data(), msg.size())) {
+      break;
+    }
+    accepted++;
+  }
+  EXPECT_LT(accepted, 10000);
+  EXPECT_GT(queue.backpressure_waits(), 0);
+  EXPECT_GT(queue.send_waits(), 0);
+  EXPECT_EQ(queue.dropped(), 1);
+
+  // once the switch reads, every accepted message gets through, in order
+  fake_switch.start(accepted);
+  fake_switch.wait();
+  EXPECT_EQ(fake_switch.received(), accepted);
+  EXPECT_EQ(fake_switch.out_of_order(), 0);
+
+  // the backlog of the connection holds the flusher back as well
+  std::atomic<size_t> backlog(1);
+  std::atomic<uint64_t> written(0);
+  OFSendQueue backlogged_queue(
+          [&](const struct iovec *iov, int iovcnt) {
+            ssize_t len = 0;
+            for (int i = 0; i < iovcnt; i++) {
+              len += iov[i].iov_len;
+            }
+            written += len;
+            return len;
+          },
+          [&]() { return backlog.load(); }, capacity, 1, 10, 0, 1000);
+  auto msg = build_of_message(0, 0, len);
+  ASSERT_TRUE(backlogged_queue.send(msg.data(), msg.size()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(written.load(), 0);
+  EXPECT_GT(backlogged_queue.backpressure_waits(), 0);
+  backlog = 0;
+  for (int i = 0; i < 1000 && written.load() == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(written.load(), len);
+}
+
+TEST(ovs_send_queue_cases, send_queue_shutdown_waits_for_the_write)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool in_write = false;
+  bool release_write = false;
+  std::atomic<int> writes(0);
+  std::atomic<bool> write_returned(false);
+
+  OFSendQueue queue([&](const struct iovec *iov, int iovcnt) {
+    writes++;
+    std::unique_lock<std::mutex> lock(mutex);
+    in_write = true;
+    cv.notify_all();
+    cv.wait(lock, [&] { return release_write; });
+    write_returned = true;
+    ssize_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      len += iov[i].iov_len;
+    }
+    return len;
+  });
+
+  auto msg = build_of_message(0, 0, 64);
+  ASSERT_TRUE(queue.send(msg.data(), msg.size()));
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return in_write; }));
+  }
+  // queued behind the write in progress, dropped by the shutdown
+  ASSERT_TRUE(queue.send(msg.data(), msg.size()));
+
+  // the connection may only be closed once the write returned
+  std::thread shutdown_thread([&] {
+    queue.shutdown();
+    EXPECT_TRUE(write_returned.load());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    release_write = true;
+  }
+  cv.notify_all();
+  shutdown_thread.join();
+
+  for (int i = 0; i < 1000 && !queue.finished(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(queue.finished());
+  EXPECT_EQ(writes.load(), 1);
+  EXPECT_EQ(queue.messages_sent(), 1UL);
+  EXPECT_EQ(queue.dropped(), 1UL);
+}
+
+/*
+  Flow-mods per second from several fibers to a fake switch, for the previous
+  path (one locked write per message) and for OFSendQueue.
+  Run it with --gtest_also_run_disabled_tests --gtest_filter=*send_queue_benchmark
+*/
+TEST(ovs_send_queue_cases, DISABLED_send_queue_benchmark)
+{
+  const int senders = 4;
+  const uint32_t flows_per_sender = 250000;
+  const uint64_t total_flows = senders * flows_per_sender;
+  const size_t flow_mod_len = 136; // size of a typical l2 neighbor flow-mod
+
+  auto run = [&](std::function<bool(const std::vector<uint8_t> &)> send) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < senders; s++) {
+      threads.emplace_back([&, s] {
+        for (uint32_t i = 0; i < flows_per_sender; i++) {
+          send(build_of_message(s, i, flow_mod_len));
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    return start;
+  };
+
+  // one write per flow-mod, serialized by a lock like the bufferevent lock
+  uint64_t direct_writes = 0;
+  double direct_rate;
+  {
+    Fake_OF_Switch fake_switch;
+    std::mutex send_mutex;
+    fake_switch.start(total_flows);
+    auto start = run([&](const std::vector<uint8_t> &msg) {
+      struct iovec iov = { (void *)msg.data(), msg.size() };
+      size_t sent = 0;
+      std::lock_guard<std::mutex> lock(send_mutex);
+      while (sent < msg.size()) {
+        iov.iov_base = (void *)(msg.data() + sent);
+        iov.iov_len = msg.size() - sent;
+        ssize_t n = fake_switch.writev(&iov, 1);
+        direct_writes++;
+        if (n < 0) {
+          return false;
+        }
+        if (n == 0) {
+          fake_switch.wait_for_room();
+        }
+        sent += n;
+      }
+      return true;
+    });
+    fake_switch.wait();
+    auto us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+    direct_rate = total_flows * 1e6 / us;
+  }
+
+  double queue_rate;
+  uint64_t queue_writes;
+  {
+    Fake_OF_Switch fake_switch;
+    OFSendQueue queue([&](const struct iovec *iov, int iovcnt) {
+      return fake_switch.writev(iov, iovcnt);
+    });
+    fake_switch.start(total_flows);
+    auto start = run([&](const std::vector<uint8_t> &msg) {
+      return queue.send(msg.data(), msg.size());
+    });
+    fake_switch.wait();
+    auto us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+    queue_rate = total_flows * 1e6 / us;
+    queue_writes = queue.writes();
+  }
+
+  printf("locked write per message: %.0f flows/s, %lu writes\n", direct_rate, direct_writes);
+  printf("OFSendQueue writev:       %.0f flows/s, %lu writes\n", queue_rate, queue_writes);
+}
@@ -17,14 +17,29 @@
 #include "aca_config.h"
 #include "aca_vlan_manager.h"
 #include "aca_ovs_l2_programmer.h"
+#include "aca_ovs_flow_shadow.h"
+#include "aca_ovs_flow_transaction.h"
+#include "aca_ovsdb_client.h"
+#include "aca_ovsdb_port_monitor.h"
 #include "aca_comm_mgr.h"
 #include "gtest/gtest.h"
 #include "goalstate.pb.h"
 #include "aca_ovs_control.h"
 #include <unistd.h> /* for getopt */
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
+#include <vector>
+#include <openvswitch/json.h>
+#include <openvswitch/shash.h>
 
 using namespace std;
 using namespace alcor::schema;
@@ -1702,3 +1717,757 @@ TEST(ovs_l2_test_cases, DISABLED_2_ports_CREATE_test_traffic_CHILD_V2)
 
   // not deleting br-int and br-tun bridges so that parent can ping the two new ports
 }
+
+TEST(ovs_l2_test_cases, flow_transaction_scope_and_order)
+{
+  ACA_OVS_Flow_Transaction transaction(2);
+
+  EXPECT_EQ(ACA_OVS_Flow_Transaction::current(), nullptr);
+  {
+    ACA_OVS_Flow_Transaction::Scope scope(&transaction);
+    EXPECT_EQ(ACA_OVS_Flow_Transaction::current(), &transaction);
+
+    // a null scope hides the transaction until it goes away
+    {
+      ACA_OVS_Flow_Transaction::Scope no_transaction(nullptr);
+      EXPECT_EQ(ACA_OVS_Flow_Transaction::current(), nullptr);
+    }
+    EXPECT_EQ(ACA_OVS_Flow_Transaction::current(), &transaction);
+
+    // the flows are held by the transaction instead of being sent right away
+    ulong not_care_culminative_time = 0;
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-int", "table=0,priority=1,actions=resubmit(,2)", "add");
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-tun", "table=0,priority=1,actions=resubmit(,2)", "add");
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-int", "table=0,priority=1", "del");
+  }
+  EXPECT_EQ(ACA_OVS_Flow_Transaction::current(), nullptr);
+  EXPECT_EQ(transaction.size(), 3UL);
+}
+
+TEST(ovs_l2_test_cases, flow_transaction_reports_failed_operation_statuses)
+{
+  ACA_OVS_Flow_Transaction transaction(2);
+  ulong not_care_culminative_time = 0;
+
+  {
+    ACA_OVS_Flow_Transaction::Scope scope(&transaction);
+
+    // status 0 has no flow, statuses 1 and 2 have flows to a bridge which is
+    // not connected, so their flows are never answered
+    transaction.attach_operation_status(0);
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-not-connected", "table=0,priority=1,actions=resubmit(,2)", "add");
+    transaction.attach_operation_status(1);
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-not-connected", "table=0,priority=2,actions=resubmit(,2)", "add");
+    ACA_OVS_L2_Programmer::get_instance().execute_openflow(
+            not_care_culminative_time, "br-not-connected", "table=0,priority=3,actions=resubmit(,2)", "add");
+    transaction.attach_operation_status(2);
+  }
+
+  // the actions wait for the flows to be answered, they run right away without a transaction
+  std::vector<int> actions_run;
+  ACA_OVS_Flow_Transaction::after_commit([&]() { actions_run.push_back(0); });
+  {
+    ACA_OVS_Flow_Transaction::Scope scope(&transaction);
+    ACA_OVS_Flow_Transaction::after_commit([&]() { actions_run.push_back(1); });
+    ACA_OVS_Flow_Transaction::after_commit([&]() { actions_run.push_back(2); });
+  }
+  EXPECT_EQ(actions_run, std::vector<int>({ 0 }));
+
+  EXPECT_EQ(transaction.commit(not_care_culminative_time), 2);
+  EXPECT_EQ(actions_run, std::vector<int>({ 0 }));
+  auto start = chrono::steady_clock::now();
+  std::vector<int> failed_statuses = transaction.wait_for_completion(chrono::seconds(5));
+  EXPECT_LT(chrono::steady_clock::now() - start, chrono::seconds(1));
+  EXPECT_EQ(failed_statuses, std::vector<int>({ 1, 2 }));
+  EXPECT_EQ(actions_run, std::vector<int>({ 0, 1, 2 }));
+
+  // nothing left to wait for
+  EXPECT_TRUE(transaction.wait_for_completion(chrono::seconds(5)).empty());
+}
+
+TEST(ovs_l2_test_cases, flow_shadow_suppresses_unchanged_flows)
+{
+  ACA_OVS_Flow_Shadow shadow(3);
+  FlowBuilder neighbor;
+  neighbor.table(20).priority(50).dl_vlan(2).dl_dst("fa:16:3e:d7:f2:6c").strip_vlan().load_tun_id(20).output(100);
+
+  // only the first add and real changes go out
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+  EXPECT_FALSE(shadow.update("br-tun", neighbor, "add"));
+  EXPECT_FALSE(shadow.update("br-tun", neighbor, "mod"));
+  EXPECT_EQ(shadow.size("br-tun"), 1UL);
+  // same flow on another bridge
+  EXPECT_TRUE(shadow.update("br-int", neighbor, "add"));
+
+  FlowBuilder moved = neighbor;
+  moved.output(101);
+  EXPECT_TRUE(shadow.update("br-tun", moved, "add"));
+  EXPECT_FALSE(shadow.update("br-tun", moved, "add"));
+  FlowBuilder with_cookie = moved;
+  with_cookie.cookie(1);
+  EXPECT_TRUE(shadow.update("br-tun", with_cookie, "mod"));
+
+  // deletes always go out, the flow is added again afterwards
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "del"));
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "del"));
+  EXPECT_EQ(shadow.size("br-tun"), 0UL);
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+
+  // a strict modify of an unknown flow doesn't add it
+  FlowBuilder other;
+  other.table(4).priority(1).tun_id(20).mod_vlan_vid(2).output(1);
+  EXPECT_TRUE(shadow.update("br-tun", other, "mod"));
+  EXPECT_TRUE(shadow.update("br-tun", other, "mod"));
+
+  // flows which expire are not shadowed
+  FlowBuilder expiring = other;
+  expiring.idle_timeout(10);
+  EXPECT_TRUE(shadow.update("br-tun", expiring, "add"));
+  EXPECT_TRUE(shadow.update("br-tun", expiring, "add"));
+
+  // a flow text has the flows of its table sent again, or the ones of the
+  // bridge if it names no table
+  EXPECT_TRUE(shadow.update("br-tun", other, "add"));
+  EXPECT_EQ(shadow.size("br-tun"), 2UL);
+  shadow.invalidate("br-tun", "table=20,priority=1,actions=CONTROLLER");
+  EXPECT_FALSE(shadow.update("br-tun", other, "add"));
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+  EXPECT_FALSE(shadow.update("br-tun", neighbor, "add"));
+  shadow.invalidate_command("del-flows br-tun \"priority=50,ip\" --strict");
+  EXPECT_TRUE(shadow.update("br-tun", other, "add"));
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+  shadow.invalidate_command("add-group br-tun group_id=1,type=select");
+  EXPECT_FALSE(shadow.update("br-tun", other, "add"));
+  EXPECT_EQ(shadow.size("br-tun"), 2UL);
+
+  // past its size the shadow stops recording
+  FlowBuilder flow;
+  for (int i = 0; i < 4; i++) {
+    flow = FlowBuilder().table(30).priority(i).output(1);
+    EXPECT_TRUE(shadow.update("br-tun", flow, "add"));
+  }
+  EXPECT_EQ(shadow.size("br-tun"), 3UL);
+  EXPECT_TRUE(shadow.update("br-tun", flow, "add"));
+
+  shadow.clear("br-tun");
+  EXPECT_EQ(shadow.size("br-tun"), 0UL);
+  EXPECT_EQ(shadow.size("br-int"), 1UL);
+}
+
+TEST(ovs_l2_test_cases, flow_shadow_reconciles_found_flows)
+{
+  const uint64_t previous_cookie = OVS_FLOW_AGENT_COOKIE | 1;
+  ACA_OVS_Flow_Shadow shadow(10, OVS_FLOW_AGENT_COOKIE | 2);
+  FlowBuilder neighbor;
+  neighbor.table(20).priority(50).dl_vlan(2).dl_dst("fa:16:3e:d7:f2:6c").strip_vlan().load_tun_id(20).output(100);
+  FlowBuilder ingress;
+  ingress.table(4).priority(1).tun_id(20).mod_vlan_vid(2).output(1);
+  FlowBuilder gone;
+  gone.table(20).priority(50).dl_vlan(3).dl_dst("fa:16:3e:d7:f2:6d").strip_vlan().output(100);
+
+  // the flows the agent programs get its cookie, unless they have one
+  EXPECT_EQ(shadow.tag(neighbor).cookie(), shadow.cookie());
+  EXPECT_EQ(shadow.tag(FlowBuilder(ingress).cookie(7)).cookie(), 7UL);
+
+  // after a restart the flows found are kept, programming them again sends nothing
+  std::vector<FlowBuilder> found = { FlowBuilder(neighbor).cookie(previous_cookie),
+                                     FlowBuilder(gone).cookie(previous_cookie) };
+  std::vector<FlowBuilder> missing;
+  std::vector<size_t> stale;
+  shadow.reconcile("br-tun", found, true, missing, stale);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_TRUE(stale.empty());
+  EXPECT_EQ(shadow.size("br-tun"), 2UL);
+  EXPECT_FALSE(shadow.update("br-tun", neighbor, "add"));
+  EXPECT_TRUE(shadow.update("br-tun", ingress, "add"));
+
+  // the sweep deletes what was not programmed again, with the cookie it was found with
+  std::vector<FlowBuilder> unclaimed = shadow.sweep("br-tun");
+  ASSERT_EQ(unclaimed.size(), 1UL);
+  EXPECT_EQ(unclaimed[0].match_string(), gone.match_string());
+  EXPECT_EQ(unclaimed[0].cookie(), previous_cookie);
+  EXPECT_EQ(shadow.size("br-tun"), 2UL);
+  EXPECT_TRUE(shadow.sweep("br-tun").empty());
+
+  // the switch reconnects with a changed flow, an unknown one and one missing
+  shadow.invalidate("br-tun");
+  FlowBuilder moved = neighbor;
+  moved.output(101);
+  found = { FlowBuilder(moved).cookie(previous_cookie), FlowBuilder(gone).cookie(shadow.cookie()) };
+  missing.clear();
+  shadow.reconcile("br-tun", found, false, missing, stale);
+  ASSERT_EQ(missing.size(), 2UL);
+  EXPECT_EQ(missing[0].to_string(), neighbor.to_string());
+  EXPECT_EQ(missing[1].to_string(), ingress.to_string());
+  EXPECT_EQ(stale, std::vector<size_t>({ 1 }));
+  // both are known to be there once added
+  EXPECT_FALSE(shadow.update("br-tun", neighbor, "add"));
+  EXPECT_FALSE(shadow.update("br-tun", ingress, "add"));
+
+  // nothing to do when the bridge has what the agent wants
+  found = { FlowBuilder(neighbor).cookie(shadow.cookie()), FlowBuilder(ingress).cookie(shadow.cookie()) };
+  missing.clear();
+  stale.clear();
+  shadow.reconcile("br-tun", found, false, missing, stale);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_TRUE(stale.empty());
+}
+
+TEST(ovs_l2_test_cases, flow_shadow_keeps_unknown_flows_once_overflowed)
+{
+  ACA_OVS_Flow_Shadow shadow(1, OVS_FLOW_AGENT_COOKIE | 2);
+  FlowBuilder neighbor;
+  neighbor.table(20).priority(50).dl_vlan(2).dl_dst("fa:16:3e:d7:f2:6c").strip_vlan().load_tun_id(20).output(100);
+  FlowBuilder ingress;
+  ingress.table(4).priority(1).tun_id(20).mod_vlan_vid(2).output(1);
+  FlowBuilder unknown;
+  unknown.table(20).priority(50).dl_vlan(3).dl_dst("fa:16:3e:d7:f2:6d").strip_vlan().output(100);
+  std::vector<FlowBuilder> missing;
+  std::vector<size_t> stale;
+
+  // an unknown flow is stale while the shadow has all the wanted flows
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+  std::vector<FlowBuilder> found = { FlowBuilder(neighbor).cookie(shadow.cookie()),
+                                     FlowBuilder(unknown).cookie(shadow.cookie()) };
+  shadow.reconcile("br-tun", found, false, missing, stale);
+  EXPECT_EQ(stale, std::vector<size_t>({ 1 }));
+
+  // the wanted flow past the cap is not recorded, so nothing unknown is deleted
+  EXPECT_TRUE(shadow.update("br-tun", ingress, "add"));
+  EXPECT_EQ(shadow.size("br-tun"), 1UL);
+  found.push_back(FlowBuilder(ingress).cookie(shadow.cookie()));
+  missing.clear();
+  stale.clear();
+  shadow.reconcile("br-tun", found, false, missing, stale);
+  EXPECT_TRUE(missing.empty());
+  EXPECT_TRUE(stale.empty());
+
+  // until the bridge is cleared
+  shadow.clear("br-tun");
+  EXPECT_TRUE(shadow.update("br-tun", neighbor, "add"));
+  shadow.reconcile("br-tun", found, false, missing, stale);
+  EXPECT_EQ(stale, std::vector<size_t>({ 1, 2 }));
+}
+
+//
+// Test suite: ovsdb_client_cases
+//
+// Testing ACA_OVSDB_Client against a stand-in of ovsdb-server, which runs the
+// transactions on in-memory Bridge, Port and Interface tables, and monitors
+// the ofport of the interfaces plugged by plug()
+//
+class Fake_OVSDB_Server {
+  public:
+  // echo_every: probe the client with an echo before every echo_every replies
+  Fake_OVSDB_Server(const string &socket_path, int echo_every)
+          : socket_path(socket_path), echo_every(echo_every), transactions(0),
+            echo_replies(0), _stop(false), _monitoring(false)
+  {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(_listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(_listen_fd, 4);
+    _thread = std::thread(&Fake_OVSDB_Server::_serve, this);
+  }
+
+  ~Fake_OVSDB_Server()
+  {
+    _stop = true;
+    _thread.join();
+    close(_listen_fd);
+    unlink(socket_path.c_str());
+  }
+
+  const string socket_path;
+  const int echo_every;
+  // the tables, only touched by the server thread while a client is connected
+  std::set<string> bridges;
+  std::map<string, int64_t> port_tags;
+  std::map<string, string> port_bridges;
+  std::atomic<int> transactions;
+  std::atomic<int> echo_replies;
+
+  // the interface gets the next ofport, the monitor is told about it
+  void plug(const string &interface)
+  {
+    std::lock_guard<std::mutex> lock(_plug_mutex);
+    _plugs.push_back(interface);
+  }
+
+  private:
+  static struct json *_create_interface_update(const string &interface, int64_t ofport)
+  {
+    struct json *row = json_object_create();
+    json_object_put_string(row, "name", interface.c_str());
+    json_object_put(row, "ofport", json_integer_create(ofport));
+    struct json *row_update = json_object_create();
+    json_object_put(row_update, "new", row);
+    return row_update;
+  }
+
+  // plug the interfaces, fd is -1 while no client is connected
+  void _plug_interfaces(int fd)
+  {
+    std::vector<string> plugs;
+    {
+      std::lock_guard<std::mutex> lock(_plug_mutex);
+      plugs.swap(_plugs);
+    }
+    for (auto &interface : plugs) {
+      int64_t ofport = _ofports.size() + 1;
+      _ofports[interface] = ofport;
+      if (fd < 0 || !_monitoring) {
+        continue;
+      }
+      struct json *rows = json_object_create();
+      json_object_put(rows, interface.c_str(), _create_interface_update(interface, ofport));
+      struct json *table_updates = json_object_create();
+      json_object_put(table_updates, "Interface", rows);
+      struct json *update = json_object_create();
+      json_object_put_string(update, "method", "update");
+      json_object_put(update, "params",
+                      json_array_create_2(json_string_create(_monitor_id.c_str()), table_updates));
+      json_object_put(update, "id", json_null_create());
+      _send(fd, update);
+    }
+  }
+
+  static string _get_name(const struct json *operation)
+  {
+    const struct json *where = (const struct json *)shash_find_data(json_object(operation), "where");
+    if (where == nullptr || json_array(where)->n == 0) {
+      return "";
+    }
+    return json_string(json_array(json_array(where)->elems[0])->elems[2]);
+  }
+
+  static struct json *_create_count(int64_t count)
+  {
+    struct json *result = json_object_create();
+    json_object_put(result, "count", json_integer_create(count));
+    return result;
+  }
+
+  static struct json *_create_error(const char *error)
+  {
+    struct json *result = json_object_create();
+    json_object_put_string(result, "error", error);
+    return result;
+  }
+
+  struct json *_run(const struct json *operation)
+  {
+    struct shash *members = json_object(operation);
+    string op = json_string((const struct json *)shash_find_data(members, "op"));
+    string table = json_string((const struct json *)shash_find_data(members, "table"));
+    string name = _get_name(operation);
+
+    if (op == "update") {
+      const struct json *row = (const struct json *)shash_find_data(members, "row");
+      auto port = port_tags.find(name);
+      if (port == port_tags.end()) {
+        return _create_count(0);
+      }
+      port->second = json_integer((const struct json *)shash_find_data(json_object(row), "tag"));
+      return _create_count(1);
+    }
+    if (op == "wait") {
+      return bridges.count(name) ? json_object_create() : _create_error("timed out");
+    }
+    if (op == "insert") {
+      const struct json *row = (const struct json *)shash_find_data(members, "row");
+      string row_name = json_string((const struct json *)shash_find_data(json_object(row), "name"));
+      if (table == "Port") {
+        if (port_tags.count(row_name)) {
+          return _create_error("constraint violation");
+        }
+        const struct json *tag = (const struct json *)shash_find_data(json_object(row), "tag");
+        port_tags[row_name] = tag != nullptr ? json_integer(tag) : 0;
+        _inserted_port = row_name;
+      }
+      struct json *result = json_object_create();
+      json_object_put(result, "uuid", json_array_create_2(json_string_create("uuid"),
+                                                          json_string_create(row_name.c_str())));
+      return result;
+    }
+    if (op == "mutate") {
+      const struct json *mutation = json_array(
+              (const struct json *)shash_find_data(members, "mutations"))->elems[0];
+      string mutator = json_string(json_array(mutation)->elems[1]);
+      if (!bridges.count(name)) {
+        return _create_count(0);
+      }
+      if (mutator == "insert") {
+        port_bridges[_inserted_port] = name;
+        return _create_count(1);
+      }
+      // the where has ["ports", "includes", ["uuid", port]]
+      const struct json *where = (const struct json *)shash_find_data(members, "where");
+      const struct json *uuid = json_array(json_array(where)->elems[1])->elems[2];
+      string port = json_string(json_array(uuid)->elems[1]);
+      if (port_bridges[port] != name) {
+        return _create_count(0);
+      }
+      port_bridges.erase(port);
+      port_tags.erase(port);
+      return _create_count(1);
+    }
+
+    // select
+    struct json *rows = json_array_create_empty();
+    if (table == "Bridge") {
+      for (auto &bridge : bridges) {
+        if (!name.empty() && bridge != name) {
+          continue;
+        }
+        struct json *row = json_object_create();
+        json_object_put_string(row, "name", bridge.c_str());
+        json_object_put_string(row, "datapath_id",
+                               bridge == "br-int" ? "00003af45ed7aa45" : "0000000000000002");
+        json_array_add(rows, row);
+      }
+    } else if (port_tags.count(name)) {
+      struct json *row = json_object_create();
+      json_object_put_string(row, "name", name.c_str());
+      json_object_put(row, "ofport",
+                      json_integer_create(std::distance(port_tags.begin(), port_tags.find(name)) + 1));
+      // the port uuid is its name in the stand-in
+      json_object_put(row, "_uuid", json_array_create_2(json_string_create("uuid"),
+                                                        json_string_create(name.c_str())));
+      json_array_add(rows, row);
+    }
+    struct json *result = json_object_create();
+    json_object_put(result, "rows", rows);
+    return result;
+  }
+
+  void _send(int fd, struct json *msg)
+  {
+    char *text = json_to_string(msg, 0);
+    EXPECT_EQ(send(fd, text, strlen(text), MSG_NOSIGNAL), (ssize_t)strlen(text));
+    free(text);
+    json_destroy(msg);
+  }
+
+  void _reply(int fd, struct json *request)
+  {
+    struct shash *members = json_object(request);
+    const struct json *method = (const struct json *)shash_find_data(members, "method");
+    if (method == nullptr) {
+      echo_replies++;
+      return;
+    }
+    if (!strcmp(json_string(method), "monitor")) {
+      // the interfaces having an ofport, keyed by their uuid which is their name
+      const struct json_array *params = json_array((const struct json *)shash_find_data(members, "params"));
+      _monitor_id = json_string(params->elems[1]);
+      _monitoring = true;
+      struct json *rows = json_object_create();
+      for (auto &ofport : _ofports) {
+        json_object_put(rows, ofport.first.c_str(),
+                        _create_interface_update(ofport.first, ofport.second));
+      }
+      struct json *table_updates = json_object_create();
+      json_object_put(table_updates, "Interface", rows);
+
+      struct json *reply = json_object_create();
+      json_object_put(reply, "id", (struct json *)shash_find_and_delete(members, "id"));
+      json_object_put(reply, "result", table_updates);
+      json_object_put(reply, "error", json_null_create());
+      _send(fd, reply);
+      return;
+    }
+    ASSERT_STREQ(json_string(method), "transact");
+
+    if (echo_every > 0 && transactions % echo_every == 0) {
+      struct json *echo = json_object_create();
+      json_object_put_string(echo, "method", "echo");
+      json_object_put(echo, "params", json_array_create_1(json_string_create("probe")));
+      json_object_put_string(echo, "id", "echo");
+      _send(fd, echo);
+    }
+    transactions++;
+
+    // an operation that fails ends the transaction, the operations not run
+    // have a null result
+    const struct json_array *params = json_array((const struct json *)shash_find_data(members, "params"));
+    EXPECT_STREQ(json_string(params->elems[0]), "Open_vSwitch");
+    struct json *results = json_array_create_empty();
+    bool failed = false;
+    for (size_t i = 1; i < params->n; i++) {
+      struct json *result = failed ? json_null_create() : _run(params->elems[i]);
+      json_array_add(results, result);
+      failed = failed || shash_find_data(json_object(result), "error") != nullptr;
+    }
+
+    struct json *reply = json_object_create();
+    json_object_put(reply, "id", (struct json *)shash_find_and_delete(members, "id"));
+    json_object_put(reply, "result", results);
+    json_object_put(reply, "error", json_null_create());
+    _send(fd, reply);
+  }
+
+  void _serve()
+  {
+    while (!_stop) {
+      _plug_interfaces(-1);
+      struct pollfd pfd = { _listen_fd, POLLIN, 0 };
+      if (poll(&pfd, 1, 10) <= 0) {
+        continue;
+      }
+      int fd = accept(_listen_fd, nullptr, nullptr);
+      struct json_parser *parser = nullptr;
+      char buffer[4096];
+      while (!_stop) {
+        _plug_interfaces(fd);
+        pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 10) <= 0) {
+          continue;
+        }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          break;
+        }
+        for (size_t used = 0; used < (size_t)n;) {
+          if (parser == nullptr) {
+            parser = json_parser_create(0);
+          }
+          used += json_parser_feed(parser, buffer + used, n - used);
+          if (json_parser_is_done(parser)) {
+            struct json *request = json_parser_finish(parser);
+            parser = nullptr;
+            _reply(fd, request);
+            json_destroy(request);
+          }
+        }
+      }
+      if (parser != nullptr) {
+        json_parser_abort(parser);
+      }
+      _monitoring = false;
+      close(fd);
+    }
+  }
+
+  int _listen_fd;
+  std::atomic<bool> _stop;
+  std::thread _thread;
+  // the port of the add-port transaction running
+  string _inserted_port;
+  // the ofport of the plugged interfaces, and the monitor of the client
+  std::map<string, int64_t> _ofports;
+  bool _monitoring;
+  string _monitor_id;
+  std::mutex _plug_mutex;
+  std::vector<string> _plugs;
+};
+
+static string get_test_ovsdb_socket_path()
+{
+  return "/tmp/aca_test_ovsdb_" + to_string(getpid()) + ".sock";
+}
+
+TEST(ovsdb_client_cases, transactions_against_stand_in)
+{
+  Fake_OVSDB_Server server(get_test_ovsdb_socket_path(), 3);
+  server.bridges = { "br-int", "br-tun" };
+  server.port_tags = { { "tap-1", 0 }, { "patch-int", 0 } };
+  server.port_bridges = { { "tap-1", "br-int" }, { "patch-int", "br-tun" } };
+  ACA_OVSDB_Client client(server.socket_path, OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS);
+
+  // set port tag, the port may not be plugged yet
+  EXPECT_EQ(client.set_port_tag("tap-1", 20), EXIT_SUCCESS);
+  EXPECT_EQ(client.set_port_tag("tap-2", 20), ENOENT);
+
+  // add-port, once only and to an existing bridge
+  EXPECT_EQ(client.add_port("br-int", "tap-2", 30, "internal"), EXIT_SUCCESS);
+  EXPECT_EQ(client.add_port("br-int", "tap-2", 30, "internal"), EEXIST);
+  EXPECT_EQ(client.add_port("br-none", "tap-3"), ENOENT);
+  EXPECT_EQ(client.set_port_tag("tap-2", 40), EXIT_SUCCESS);
+
+  // bridge and interface queries
+  EXPECT_EQ(client.bridge_exists("br-tun"), EXIT_SUCCESS);
+  EXPECT_EQ(client.bridge_exists("br-none"), ENOENT);
+  std::unordered_map<string, uint64_t> datapath_ids;
+  EXPECT_EQ(client.get_datapath_ids(datapath_ids), EXIT_SUCCESS);
+  EXPECT_EQ(datapath_ids.size(), 2UL);
+  EXPECT_EQ(datapath_ids["br-int"], 0x3af45ed7aa45UL);
+  int64_t ofport = 0;
+  EXPECT_EQ(client.get_ofport("patch-int", ofport), EXIT_SUCCESS);
+  EXPECT_EQ(ofport, 1);
+  EXPECT_EQ(client.get_ofport("tap-3", ofport), ENOENT);
+
+  // del-port, from the bridge it is on
+  EXPECT_EQ(client.del_port("br-tun", "tap-2"), ENOENT);
+  EXPECT_EQ(client.del_port("br-int", "tap-2"), EXIT_SUCCESS);
+  EXPECT_EQ(client.del_port("br-int", "tap-2"), ENOENT);
+
+  EXPECT_EQ(server.port_tags["tap-1"], 20);
+  EXPECT_EQ(server.port_tags.count("tap-2"), 0UL);
+  EXPECT_EQ(server.transactions.load(), 16);
+
+  // reconnects after losing the connection
+  client.close();
+  EXPECT_EQ(client.set_port_tag("tap-1", 21), EXIT_SUCCESS);
+  EXPECT_EQ(server.port_tags["tap-1"], 21);
+  // the first connection answered all the echoes
+  EXPECT_EQ(server.echo_replies.load(), 6);
+
+  // ovs-vsctl takes over when ovsdb-server is not there
+  ACA_OVSDB_Client unreachable(server.socket_path + ".none", OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS);
+  EXPECT_EQ(unreachable.set_port_tag("tap-1", 20), ENOTCONN);
+}
+
+//
+// Port tag latency through the ovsdb client, and the cost of the fork and
+// exec of a trivial command, which every ovs-vsctl call paid on top of its
+// own database connection and transaction
+//
+TEST(ovsdb_client_cases, DISABLED_port_tag_benchmark)
+{
+  const int total_ports = 1000;
+  const int total_forks = 200;
+  Fake_OVSDB_Server server(get_test_ovsdb_socket_path(), 0);
+  server.bridges = { "br-int", "br-tun" };
+  for (int i = 0; i < total_ports; i++) {
+    server.port_tags["tap-" + to_string(i)] = 0;
+  }
+  ACA_OVSDB_Client client(server.socket_path, OVSDB_TRANSACT_TIMEOUT_IN_MICROSECONDS);
+  ASSERT_EQ(client.bridge_exists("br-int"), EXIT_SUCCESS);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_ports; i++) {
+    EXPECT_EQ(client.set_port_tag("tap-" + to_string(i), i % 4094 + 1), EXIT_SUCCESS);
+  }
+  auto client_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total_forks; i++) {
+    EXPECT_EQ(system("true"), 0);
+  }
+  auto fork_us = cast_to_microseconds(std::chrono::steady_clock::now() - start).count();
+
+  printf("ovsdb client set port tag: %.1f us/port, %.0f ports/s\n",
+         (double)client_us / total_ports, total_ports * 1e6 / client_us);
+  printf("system() fork and exec:    %.1f us/call, %.0f calls/s\n",
+         (double)fork_us / total_forks, total_forks * 1e6 / fork_us);
+}
+
+//
+// Testing ACA_OVSDB_Port_Monitor, the vlan tag of a pending port is set
+// once the stand-in reports its interface plugged
+//
+class Port_Tag_Recorder {
+  public:
+  // fails the first failures calls
+  Port_Tag_Recorder(int failures) : _failures(failures)
+  {
+  }
+
+  int configure(const string &port_name, uint32_t vlan_id)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _calls.emplace_back(port_name, vlan_id);
+    return (int)_calls.size() <= _failures ? ENOENT : EXIT_SUCCESS;
+  }
+
+  std::vector<std::pair<string, uint32_t> > calls()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _calls;
+  }
+
+  private:
+  const int _failures;
+  std::mutex _mutex;
+  std::vector<std::pair<string, uint32_t> > _calls;
+};
+
+static bool wait_for_no_pending_port(ACA_OVSDB_Port_Monitor &monitor)
+{
+  for (int i = 0; i < 200 && monitor.pending() > 0; i++) {
+    usleep(10000);
+  }
+  return monitor.pending() == 0;
+}
+
+TEST(ovsdb_client_cases, port_monitor_sets_tag_once_plugged)
+{
+  Fake_OVSDB_Server server(get_test_ovsdb_socket_path(), 0);
+  server.plug("tap-1");
+  Port_Tag_Recorder recorder(0);
+  // the retries and timeouts are long, only the monitor sets the tags
+  ACA_OVSDB_Port_Monitor monitor(
+          server.socket_path,
+          [&](const string &port_name, uint32_t vlan_id) {
+            return recorder.configure(port_name, vlan_id);
+          },
+          2, 60 * 1000 * 1000, 60 * 1000 * 1000);
+
+  // plugged before the monitor subscribed
+  EXPECT_EQ(monitor.add("tap-1", 10), EINPROGRESS);
+  ASSERT_TRUE(wait_for_no_pending_port(monitor));
+
+  // plugged while the port waits, the latest vlan of the port is set
+  EXPECT_EQ(monitor.add("tap-2", 20), EINPROGRESS);
+  EXPECT_EQ(monitor.add("tap-2", 21), EINPROGRESS);
+  server.plug("tap-2");
+  ASSERT_TRUE(wait_for_no_pending_port(monitor));
+
+  // known to be plugged, set right away
+  EXPECT_EQ(monitor.add("tap-1", 11), EXIT_SUCCESS);
+
+  // bounded, a removed port frees its room
+  EXPECT_EQ(monitor.add("tap-3", 30), EINPROGRESS);
+  EXPECT_EQ(monitor.add("tap-4", 40), EINPROGRESS);
+  EXPECT_EQ(monitor.add("tap-5", 50), ENOSPC);
+  EXPECT_TRUE(monitor.remove("tap-4"));
+  EXPECT_FALSE(monitor.remove("tap-4"));
+  EXPECT_EQ(monitor.add("tap-5", 50), EINPROGRESS);
+  EXPECT_EQ(monitor.pending(), 2UL);
+
+  std::vector<std::pair<string, uint32_t> > expected_calls = {
+    { "tap-1", 10 }, { "tap-2", 21 }, { "tap-1", 11 }
+  };
+  EXPECT_EQ(recorder.calls(), expected_calls);
+
+  monitor.shutdown();
+  EXPECT_EQ(monitor.add("tap-6", 60), EXIT_FAILURE);
+}
+
+TEST(ovsdb_client_cases, port_monitor_retries_and_expires)
+{
+  // without ovsdb-server, the pending ports are tried every retry interval
+  Port_Tag_Recorder recorder(2);
+  ACA_OVSDB_Port_Monitor unreachable(
+          get_test_ovsdb_socket_path() + ".none",
+          [&](const string &port_name, uint32_t vlan_id) {
+            return recorder.configure(port_name, vlan_id);
+          },
+          16, 60 * 1000 * 1000, 20 * 1000);
+  EXPECT_EQ(unreachable.add("tap-1", 10), EINPROGRESS);
+  ASSERT_TRUE(wait_for_no_pending_port(unreachable));
+  EXPECT_EQ(recorder.calls().size(), 3UL);
+
+  // a port never plugged is dropped after its timeout, without being tried
+  Fake_OVSDB_Server server(get_test_ovsdb_socket_path(), 0);
+  Port_Tag_Recorder never_called(0);
+  ACA_OVSDB_Port_Monitor monitor(
+          server.socket_path,
+          [&](const string &port_name, uint32_t vlan_id) {
+            return never_called.configure(port_name, vlan_id);
+          },
+          16, 100 * 1000, 20 * 1000);
+  EXPECT_EQ(monitor.add("tap-1", 10), EINPROGRESS);
+  ASSERT_TRUE(wait_for_no_pending_port(monitor));
+  EXPECT_TRUE(never_called.calls().empty());
+}